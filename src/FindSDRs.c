@@ -46,8 +46,8 @@
    Program:    FindSDRs
    File:       FindSDRs.c
    
-   Version:    V1.1
-   Date:       03.03.26
+   Version:    V1.2
+   Date:       16.10.26
    Function:   Find SDRs in a set of loops
    
    Copyright:  (c) UCL, Dr. Andrew C. R. Martin 1996-2026
@@ -121,6 +121,10 @@
    V1.0a 30.01.09 Compile cleanups
    V1.1  03.03.26 Reports [conserved] in lower case if this is not a
                   reason for a residue being key
+   V1.2  16.10.26 Hydrophobic contacts and H-bonds use a residue table
+                  with bounding spheres
+   V1.3  16.10.26 Ooi data and atom tests use the residue type and atom
+                  role codes set when the PDB file is read
 
 *************************************************************************/
 /* Includes
@@ -171,8 +175,8 @@
 /* Dir for temp files; may need to be a blank string                    */
 #define TEMPDIR         ""
 
-/* Square distance considered to be a hphob contact                     */
-#define HPHOBCONTDISTSQ ((REAL)25.0)          
+/* Distance considered to be a hphob contact                            */
+#define HPHOBCONTDIST   ((REAL)5.0)          
 
 /* Min number of members of a cluster when reporting unified SDR lists  */
 #define MINCLUSSIZE     5
@@ -260,6 +264,7 @@ typedef struct
 LOOPCLUS *gLoopClus = NULL;  /* Store loop name and cluster number      */
 CLUSINFO *gClusInfo = NULL;  /* Store sequence templates for clusters   */
 OOIDATA  gOoiData[MAXRES];   /* Store mean/sd Ooi data for general loops*/
+int      gOoiIndex[blMAXRESTYPE+1]; /* gOoiData entry for each res type */
 int      gMinLoopLength,
          gMaxLoopLength;
 
@@ -282,11 +287,12 @@ BOOL FindSDRs(int nclus, int nloops, BOOL KeepSA);
 void ReportSDRs(FILE *out, int nclus);
 void Report(CLUSINFO *ClusInfo, int residx, char *reason);
 void FillOoiData(void);
+int OoiIndex(PDB *res);
 BOOL IsInRange(char *resspec, char *firstres, char *lastres);
 PDB *ReadPDBAsSA(char *filename, BOOL KeepSAFile);
-void MarkPartners(CLUSINFO *ClusInfo, PDB *pdb, PDB *res, 
+void MarkPartners(CLUSINFO *ClusInfo, RESTABLE *restab, int res, 
                   char *firstres, char *lastres);
-BOOL MakeSCContact(PDB *res1, PDB *res2);
+BOOL MakeSCContact(RESTABLE *restab, int res1, int res2);
 BOOL MarkHPhob(CLUSINFO *ClusInfo, int clusnum, int nloops, 
                BOOL KeepSA);
 BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops);
@@ -302,6 +308,8 @@ BOOL IsRogue(int clus, int LargestClus);
 BOOL IsCisProline(CLUSINFO *ClusInfo, int clusnum, int resoffset, 
                   int nloops);
 static PDB *FindResidue1letter(PDB *pdb, char chain, int resnum, char insert);
+static int FindResTable1letter(RESTABLE *restab, char chain, int resnum, 
+                               char insert);
 
 
 /************************************************************************/
@@ -1072,9 +1080,13 @@ void Report(CLUSINFO *ClusInfo, int residx, char *reason)
    Sets up Ooi(6.5,resmean) data from analysis of all protein loops
 
    06.02.96 Original   By: ACRM
+   16.10.26 Also indexes the data by residue type code
 */
 void FillOoiData(void)
 {
+   int i,
+       restype;
+   
    strcpy(gOoiData[0].resnam, "ALA ");
    gOoiData[0].mean   = 47.769764;
    gOoiData[0].sd     = 12.190481;
@@ -1194,6 +1206,36 @@ void FillOoiData(void)
    gOoiData[23].mean  = 27.750000;
    gOoiData[23].sd    = 11.199888;
    gOoiData[23].hphob = FALSE;
+
+   for(i=0; i<=blMAXRESTYPE; i++)
+      gOoiIndex[i] = (-1);
+   for(i=0; i<MAXRES; i++)
+   {
+      restype = blResTypeCode(gOoiData[i].resnam);
+      if(gOoiIndex[restype] < 0)
+         gOoiIndex[restype] = i;
+   }
+}
+
+
+/************************************************************************/
+/*>int OoiIndex(PDB *res)
+   ----------------------
+   Input:   PDB   *res     Residue
+   Returns: int            Offset into gOoiData (-1 if not found)
+
+   Finds the Ooi data for a residue from its residue type code.
+
+   16.10.26 Original   By: ACRM
+*/
+int OoiIndex(PDB *res)
+{
+   int restype = RESTYPE(res);
+
+   /* Names blResTypeCode() doesn't know share the code for UNK         */
+   if((restype == RESTYPE_UNK) && strncmp(res->resnam, "UNK ", 4))
+      return(-1);
+   return(gOoiIndex[restype]);
 }
 
 
@@ -1351,12 +1393,12 @@ accessibility file %s for reading\n", safile);
 
 
 /************************************************************************/
-/*>void MarkPartners(CLUSINFO *ClusInfo, PDB *pdb, PDB *res, 
+/*>void MarkPartners(CLUSINFO *ClusInfo, RESTABLE *restab, int res, 
                      char *firstres, char *lastres)
    ---------------------------------------------------------------------
-   Given a hydrophobic buried in the loop (res), looks for other
-   hydrophobics not in the loop which might make s/c--s/c contacts 
-   with the loop one
+   Given a hydrophobic buried in the loop (residue res in the residue
+   table), looks for other hydrophobics not in the loop which might 
+   make s/c--s/c contacts with the loop one
 
    Note that this has to be done in 2 stages. First we flag those
    residues which are partners, then, at the end, we increment the
@@ -1367,14 +1409,16 @@ accessibility file %s for reading\n", safile);
 
    08.02.96 Original   By: ACRM
    09.02.96 Added flagged code
+   16.10.26 Takes a residue table rather than the PDB linked list
+            Looks up the Ooi data from the residue type code
 */
-void MarkPartners(CLUSINFO *ClusInfo, PDB *pdb, PDB *res, 
+void MarkPartners(CLUSINFO *ClusInfo, RESTABLE *restab, int res, 
                   char *firstres, char *lastres)
 {
    int  i,
-        j;
+        j,
+        partner;
    char resspec[16];
-   PDB  *partner;
 
    for(i=0; i<ClusInfo->NRes; i++)
    {
@@ -1386,30 +1430,24 @@ void MarkPartners(CLUSINFO *ClusInfo, PDB *pdb, PDB *res,
       /* If this residue is not in the loop                             */
       if(!IsInRange(resspec, firstres, lastres))
       {
-         /* Find this residue in the PDB linked list                    */
-         if((partner = FindResidue1letter(pdb, 
+         /* Find this residue in the residue table                      */
+         if((partner = FindResTable1letter(restab, 
                                    ClusInfo->chain[i],
                                    ClusInfo->resnum[i],
-                                   ClusInfo->insert[i]))!=NULL)
+                                   ClusInfo->insert[i])) >= 0)
          {
-            /* Search for this res type in the Ooi data                 */
-            for(j=0; j<MAXRES; j++)
+            /* Look up this res type in the Ooi data and see if it's 
+               hydrophobic
+            */
+            if(((j = OoiIndex(restab->res[partner].start)) >= 0) &&
+               gOoiData[j].hphob)
             {
-               /* If found...                                           */
-               if(!strncmp(partner->resnam, gOoiData[j].resnam, 4))
+               /* If they make contact, increment the PartnerCount 
+                  variable
+               */
+               if(MakeSCContact(restab, res, partner))
                {
-                  /* If it's hydrophobic                                */
-                  if(gOoiData[j].hphob)
-                  {
-                     /* If they make contact, increment the PartnerCount 
-                        variable
-                     */
-                     if(MakeSCContact(res, partner))
-                     {
-                        ClusInfo->flagged[i] = TRUE;
-                     }
-                  }
-                  break;
+                  ClusInfo->flagged[i] = TRUE;
                }
             }
          }
@@ -1419,42 +1457,19 @@ void MarkPartners(CLUSINFO *ClusInfo, PDB *pdb, PDB *res,
 
 
 /************************************************************************/
-/*>BOOL MakeSCContact(PDB *res1, PDB *res2)
-   ----------------------------------------
-   Determines whether 2 residues make a sidechain contact
+/*>BOOL MakeSCContact(RESTABLE *restab, int res1, int res2)
+   --------------------------------------------------------
+   Determines whether 2 residues in a residue table make a sidechain 
+   contact
 
    09.02.96 Original   By: ACRM
+   16.10.26 Uses the residue table so distant pairs are rejected from
+            their bounding spheres
 */
-BOOL MakeSCContact(PDB *res1, PDB *res2)
+BOOL MakeSCContact(RESTABLE *restab, int res1, int res2)
 {
-   PDB *end1,
-       *end2,
-       *p, *q;
-
-   end1 = blFindNextResidue(res1);
-   end2 = blFindNextResidue(res2);
-
-   for(p=res1; p!=end1; NEXT(p))
-   {
-      if(strncmp(p->atnam,"N   ",4) &&
-         strncmp(p->atnam,"CA  ",4) &&
-         strncmp(p->atnam,"C   ",4) &&
-         strncmp(p->atnam,"O   ",4))
-      {
-         for(q=res2; q!=end2; NEXT(q))
-         {      
-            if(strncmp(q->atnam,"N   ",4) &&
-               strncmp(q->atnam,"CA  ",4) &&
-               strncmp(q->atnam,"C   ",4) &&
-               strncmp(q->atnam,"O   ",4))
-            {
-               if(DISTSQ(p,q) <= HPHOBCONTDISTSQ)
-                  return(TRUE);
-            }
-         }
-      }
-   }
-   return(FALSE);
+   return(blResTableContact(restab, res1, res2, HPHOBCONTDIST, 
+                            TRUE, TRUE));
 }
 
 
@@ -1473,16 +1488,20 @@ BOOL MakeSCContact(PDB *res1, PDB *res2)
             Added call to MarkPartners() and support code
    09.02.96 Added code to transfer partners from the flagged array to
             the PartnerCount array
+   16.10.26 Finds residues from a residue table
+            Looks up the Ooi data from the residue type code
 */
 BOOL MarkHPhob(CLUSINFO *ClusInfo, int clusnum, int nloops, 
                BOOL KeepSA)
 {
-   PDB  *pdb,
-        *res1;
-   char resspec[16];
-   int  i, j,
-        LoopNum,
-        NRequired;
+   PDB      *pdb,
+            *res1;
+   RESTABLE *restab;
+   char     resspec[16];
+   int      i, j,
+            r1,
+            LoopNum,
+            NRequired;
 #ifdef DEBUG
    BOOL L48;
 #endif
@@ -1512,6 +1531,14 @@ accessibility file from %s\n",
             continue;
          }
 
+         /* Index the residues                                          */
+         if((restab = blBuildResTablePDB(pdb))==NULL)
+         {
+            fprintf(stderr,"No memory for residue table\n");
+            FREELIST(pdb, PDB);
+            return(FALSE);
+         }
+
 #ifdef DEBUG
          fprintf(stderr,"Marking HPhobs for %s\n",
                  gLoopClus[LoopNum].filename);
@@ -1535,52 +1562,49 @@ accessibility file from %s\n",
                          gLoopClus[LoopNum].firstres,
                          gLoopClus[LoopNum].lastres))
             {
-               /* Find this residue in the PDB linked list              */
-               if((res1 = FindResidue1letter(pdb, 
+               /* Find this residue in the residue table                */
+               if((r1 = FindResTable1letter(restab, 
                                       ClusInfo->chain[i],
                                       ClusInfo->resnum[i],
-                                      ClusInfo->insert[i]))!=NULL)
+                                      ClusInfo->insert[i])) >= 0)
                {
-                  /* Search for this res type in the Ooi data           */
-                  for(j=0; j<MAXRES; j++)
+                  res1 = restab->res[r1].start;
+
+                  /* Look up this res type in the Ooi data              */
+                  if((j = OoiIndex(res1)) >= 0)
                   {
-                     /* If found...                                     */
-                     if(!strncmp(res1->resnam, gOoiData[j].resnam, 4))
-                     {
 #ifdef DEBUG
-                        if(res1->chain[0] == 'L' && res1->resnum == 48)
-                        {
-                           fprintf(stderr,"\nIn L48:\t");
-                           L48 = TRUE;
-                        }
-                        else
-                        {
-                           L48 = FALSE;
-                        }
+                     if(res1->chain[0] == 'L' && res1->resnum == 48)
+                     {
+                        fprintf(stderr,"\nIn L48:\t");
+                        L48 = TRUE;
+                     }
+                     else
+                     {
+                        L48 = FALSE;
+                     }
 #endif
-                           
-                        /* If it's hydrophobic                          */
-                        if(gOoiData[j].hphob)
-                        {
+                        
+                     /* If it's hydrophobic                             */
+                     if(gOoiData[j].hphob)
+                     {
 #ifdef DEBUG
-                           if(L48) fprintf(stderr,"Hydrophobic\t");
+                        if(L48) fprintf(stderr,"Hydrophobic\t");
 #endif
-                           /* If the SA is < SACUT, it is buried        */
-                           if(res1->bval < SACUT)
-                           {
+                        /* If the SA is < SACUT, it is buried           */
+                        if(res1->bval < SACUT)
+                        {
 #ifdef DEBUG
-                              if(L48) fprintf(stderr,"Buried\t");
+                           if(L48) fprintf(stderr,"Buried\t");
 #endif
-                              (ClusInfo->count[i])++;
+                           (ClusInfo->count[i])++;
 #ifdef USE_HPHOB_PARTNERS
-                              /* Mark any hydrophobic partner residues  */
-                              MarkPartners(ClusInfo, pdb, res1,
-                                           gLoopClus[LoopNum].firstres,
-                                           gLoopClus[LoopNum].lastres);
+                           /* Mark any hydrophobic partner residues     */
+                           MarkPartners(ClusInfo, restab, r1,
+                                        gLoopClus[LoopNum].firstres,
+                                        gLoopClus[LoopNum].lastres);
 #endif
-                           }
                         }
-                        break;
                      }
                   }
                }
@@ -1596,7 +1620,8 @@ accessibility file from %s\n",
                (ClusInfo->PartnerCount[i])++;
          }
 
-         /* Free the PDB linked list                                    */
+         /* Free the residue table and PDB linked list                  */
+         blFreeResTablePDB(restab);
          FREELIST(pdb, PDB);
       }  /* In the correct cluster                                      */
    }  /* For each loop                                                  */
@@ -1643,21 +1668,37 @@ accessibility file from %s\n",
    09.02.96 Added code to handle S/C--B/B HBonds if both residues
             are in the loop. 
    30.01.09 Initialize some variables
+   16.10.26 Finds each template residue once per loop from a residue
+            table and rejects distant pairs from their bounding spheres
 */
 BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
 {
-   PDB  *pdb,
-        *res1 = NULL,
-        *res2 = NULL;
-   int  i, j,
-        natom,
-        LoopNum,
-        LoopResCount,
-        NRequired;
-   FILE *fp;
-   char resspec[16];
+   PDB      *pdb;
+   RESTABLE *restab;
+   int      i, j,
+            natom,
+            LoopNum,
+            LoopResCount,
+            NRequired,
+            *ResIdx,
+            *InLoop;
+   FILE     *fp;
+   char     resspec[16];
 
    NRequired = ClusInfo->NMembers;
+
+   /* Allocate arrays for the template residues' positions in the 
+      residue table and whether they are in the loop
+   */
+   ResIdx = (int *)malloc((ClusInfo->NRes+1) * sizeof(int));
+   InLoop = (int *)malloc((ClusInfo->NRes+1) * sizeof(int));
+   if((ResIdx == NULL) || (InLoop == NULL))
+   {
+      if(ResIdx != NULL) free(ResIdx);
+      if(InLoop != NULL) free(InLoop);
+      fprintf(stderr,"No memory for template residue arrays\n");
+      return(FALSE);
+   }
    
    /* Zero the counts for each residue                                  */
    for(i=0; i<ClusInfo->NRes; i++)
@@ -1690,10 +1731,40 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
             fprintf(stderr,"No atoms read from PDB file: %s\n",
                     gLoopClus[LoopNum].filename);
             fclose(fp);
+            free(ResIdx);
+            free(InLoop);
             return(FALSE);
          }
          fclose(fp);
 
+         /* Index the residues                                          */
+         if((restab = blBuildResTablePDB(pdb))==NULL)
+         {
+            fprintf(stderr,"No memory for residue table\n");
+            FREELIST(pdb, PDB);
+            free(ResIdx);
+            free(InLoop);
+            return(FALSE);
+         }
+
+         /* Find each template residue once, noting whether it is in the
+            loop
+         */
+         for(i=0; i<ClusInfo->NRes; i++)
+         {
+            sprintf(resspec,"%c%d%c", 
+                    ClusInfo->chain[i],
+                    ClusInfo->resnum[i],
+                    ClusInfo->insert[i]);
+            InLoop[i] = IsInRange(resspec,
+                                  gLoopClus[LoopNum].firstres,
+                                  gLoopClus[LoopNum].lastres) ? 1 : 0;
+            ResIdx[i] = FindResTable1letter(restab, 
+                                            ClusInfo->chain[i],
+                                            ClusInfo->resnum[i],
+                                            ClusInfo->insert[i]);
+         }
+
          /* Run through the template residues in the CLUSINFO structure,
             seeing if they make sidechain H-bonds to any other template
             residue
@@ -1705,40 +1776,9 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
                if(i!=j)
                {
                   /* Count how many of these 2 residues are in the loop */
-                  LoopResCount = 0;
-                  sprintf(resspec,"%c%d%c", 
-                          ClusInfo->chain[i],
-                          ClusInfo->resnum[i],
-                          ClusInfo->insert[i]);
-                  if(IsInRange(resspec,
-                               gLoopClus[LoopNum].firstres,
-                               gLoopClus[LoopNum].lastres))
-                     LoopResCount++;
-                  sprintf(resspec,"%c%d%c", 
-                          ClusInfo->chain[j],
-                          ClusInfo->resnum[j],
-                          ClusInfo->insert[j]);
-                  if(IsInRange(resspec,
-                               gLoopClus[LoopNum].firstres,
-                               gLoopClus[LoopNum].lastres))
-                     LoopResCount++;
-
-                  /* If at least one is in the loop, identify the 2 
-                     residues
-                  */
-                  if(LoopResCount > 0)
-                  {
-                     res1 = FindResidue1letter(pdb, 
-                                        ClusInfo->chain[i],
-                                        ClusInfo->resnum[i],
-                                        ClusInfo->insert[i]);
-                     res2 = FindResidue1letter(pdb, 
-                                        ClusInfo->chain[j],
-                                        ClusInfo->resnum[j],
-                                        ClusInfo->insert[j]);
-                  }
+                  LoopResCount = InLoop[i] + InLoop[j];
 
-                  if(res1!=NULL && res2!=NULL)
+                  if(LoopResCount > 0 && ResIdx[i] >= 0 && ResIdx[j] >= 0)
                   {
                      if(LoopResCount == 1)
                      {
@@ -1748,7 +1788,9 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
                            If the first makes a s/c HBond to the second, 
                            then increment its count
                         */
-                        if(blIsHBonded(res1, res2, HBOND_SIDECHAIN))
+                        if(blIsHBondedResTable(restab, ResIdx[i], 
+                                               ResIdx[j], 
+                                               HBOND_SIDECHAIN))
                         {
                            (ClusInfo->count[i])++;
                            /* We now break out of the inner loop to stop
@@ -1766,7 +1808,8 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
                            If the first makes a s/c HBond to the second, 
                            then increment its count
                         */
-                        if(blIsHBonded(res1, res2, HBOND_SB))
+                        if(blIsHBondedResTable(restab, ResIdx[i], 
+                                               ResIdx[j], HBOND_SB))
                         {
                            (ClusInfo->count[i])++;
                            /* We now break out of the inner loop to stop
@@ -1781,7 +1824,8 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
             }
          }
          
-         /* Free the PDB linked list                                    */
+         /* Free the residue table and PDB linked list                  */
+         blFreeResTablePDB(restab);
          FREELIST(pdb, PDB);
       }  /* In the correct cluster                                      */
    }  /* For each loop                                                  */
@@ -1803,6 +1847,8 @@ BOOL MarkHBonders(CLUSINFO *ClusInfo, int clusnum, int nloops)
       }
    }
    
+   free(ResIdx);
+   free(InLoop);
    return(TRUE);
 }
 
@@ -1837,6 +1883,7 @@ SDRLIST *InSDRList(SDRLIST *sdrlist, char chain, int resnum, char insert)
    amino acids seen at each key residue position.
 
    13.02.96 Original   By: ACRM
+   16.10.26 Uses the atom role and residue type codes
 */
 BOOL FillSDRsForCluster(SDRLIST *sdrlist, int clusnum, int nloops)
 {
@@ -1882,7 +1929,7 @@ BOOL FillSDRsForCluster(SDRLIST *sdrlist, int clusnum, int nloops)
          */
          for(p=pdb; p!=NULL; NEXT(p))
          {
-            if(!strncmp(p->atnam,"CA  ",4))
+            if(ATOMROLE(p) == ATOMROLE_CA)
             {
                /* If it is in the SDR list                              */
                if((s=InSDRList(sdrlist, p->chain[0], p->resnum, 
@@ -1891,7 +1938,7 @@ BOOL FillSDRsForCluster(SDRLIST *sdrlist, int clusnum, int nloops)
                   /* See if it's in the list of observed residues and,
                      if not, add it.
                   */
-                  res = blThrone(p->resnam);
+                  res = blResTypeOne(RESTYPE(p));
                   TESTINARRAY(s->obsres, s->nobsres, res, Found);
                   if(!Found)
                      s->obsres[(s->nobsres)++] = res;
@@ -2629,6 +2676,7 @@ BOOL IsRogue(int clus, int LargestClus)
    cluster is a cis proline.
 
    22.03.96 Original   By: ACRM
+   16.10.26 Uses the atom role and residue type codes
 */
 BOOL IsCisProline(CLUSINFO *ClusInfo, int clusnum, int resoffset, 
                   int nloops)
@@ -2701,16 +2749,16 @@ BOOL IsCisProline(CLUSINFO *ClusInfo, int clusnum, int resoffset,
          /* Find the atoms describing the omega torsion angle           */
          for(p=ResPrev; p!=ResPro; NEXT(p))
          {
-            if(!strncmp(p->atnam,"CA  ",4))
+            if(ATOMROLE(p) == ATOMROLE_CA)
                CA1 = p;
-            if(!strncmp(p->atnam,"C   ",4))
+            if(ATOMROLE(p) == ATOMROLE_C)
                C1  = p;
          }
          for(p=ResPro; p!=ResNext; NEXT(p))
          {
-            if(!strncmp(p->atnam,"N   ",4))
+            if(ATOMROLE(p) == ATOMROLE_N)
                N2  = p;
-            if(!strncmp(p->atnam,"CA  ",4))
+            if(ATOMROLE(p) == ATOMROLE_CA)
                CA2 = p;
          }
          
@@ -2756,3 +2804,25 @@ static PDB *FindResidue1letter(PDB *pdb, char chain, int resnum, char insert)
    return(blFindResidue(pdb, chain_a, resnum, insert_a));
 }
 
+
+/************************************************************************/
+/*>static int FindResTable1letter(RESTABLE *restab, char chain, 
+                                  int resnum, char insert)
+   --------------------------------------------------------------
+   As FindResidue1letter(), but finds the residue's number in a residue
+   table (-1 if not found)
+
+   16.10.26 Original   By: ACRM
+*/
+static int FindResTable1letter(RESTABLE *restab, char chain, int resnum, 
+                               char insert)
+{
+   char chain_a[2]  = " ",
+        insert_a[2] = " ";
+
+   chain_a[0]  = chain;
+   insert_a[0] = insert;
+
+   return(blFindResTableResidue(restab, chain_a, resnum, insert_a));
+}
+
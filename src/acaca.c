@@ -62,6 +62,21 @@
                   Truncated structures were causing the whole data list to
                   be freed.
    V3.6a 30.01.09 Compile cleanups
+   V3.7  16.10.26 Added approximate Ward clustering method
+                  Feature matrix is a single aligned block of FEATUREs
+                  Added the angular metric on raw torsions
+                  Angular metric compares torsions through their sin/cos
+                  points rather than 2-2cos of the difference
+                  FeatureDist2() takes expanded vectors. Added 
+                  ExpandFeatures()
+                  Stores the loop CA and CB coordinates for post-clustering
+                  Added ConvertCoor() for METRIC RMSD
+                  Added IndexLoops() and BuildClusMembers()
+                  Atom and residue tests use the atom role and residue
+                  type codes set when the PDB file is read
+                  Added the structure cache which frees the least
+                  recently used all-atom structures to keep within a
+                  memory budget
 
 *************************************************************************/
 /* Includes
@@ -75,10 +90,18 @@
 /************************************************************************/
 /* Globals
 */
+static DATALIST      *sCacheNewest = NULL,  /* Structure cache list     */
+                     *sCacheOldest = NULL;
+static unsigned long sCacheBytes   = 0,     /* Memory now cached        */
+                     sCacheBudget  = 0,     /* Limit (0 = no limit)     */
+                     sCachePeak    = 0;     /* Most ever cached         */
 
 /************************************************************************/
 /* Prototypes
 */
+static void LinkStructure(DATALIST *loop);
+static void UnlinkStructure(DATALIST *loop);
+static void TrimStructureCache(void);
 
 /************************************************************************/
 /*>BOOL SetClusterMethod(char *method)
@@ -91,6 +114,7 @@
    text.
 
    27.06.95 Original   By: ACRM
+   16.10.26 Added approximate Ward (8)
 */
 BOOL SetClusterMethod(char *method)
 {
@@ -110,6 +134,8 @@ BOOL SetClusterMethod(char *method)
       gClusterMethod = 6;
    else if(!blUpstrncmp(method,"CEN",3) || method[0] == '7')
       gClusterMethod = 7;
+   else if(!blUpstrncmp(method,"APP",3) || method[0] == '8')
+      gClusterMethod = 8;
    else
    {
       fprintf(stderr,"Unknown clustering method: %s\n",method);
@@ -120,6 +146,36 @@ BOOL SetClusterMethod(char *method)
 }
 
 
+/************************************************************************/
+/*>BOOL SetMetric(char *metric)
+   ----------------------------
+   Input:   char *metric         Metric name
+   Returns: BOOL                 Success? (FALSE if unknown metric)
+   Globals: int  gMetric         Set to specified metric
+
+   Set the clustering metric global variable based on the supplied
+   text.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL SetMetric(char *metric)
+{
+   if(!blUpstrncmp(metric,"EUC",3))
+      gMetric = METRIC_EUCLIDEAN;
+   else if(!blUpstrncmp(metric,"ANG",3))
+      gMetric = METRIC_ANGULAR;
+   else if(!blUpstrncmp(metric,"RMS",3))
+      gMetric = METRIC_RMSD;
+   else
+   {
+      fprintf(stderr,"Unknown metric: %s\n",metric);
+      return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
 /************************************************************************/
 /*>BOOL SetOutputFile(char *filename)
    ----------------------------------
@@ -422,6 +478,9 @@ BOOL FindCAResidues(PDB *pdbca, char chain1, int resnum1, char insert1,
             Truncated structures were causing the whole data list to
             be freed rather than just this entry.
    30.01.09 Initialize some variables
+   16.10.26 Also stores the loop CA and CB coordinates
+            Tests the atom role code to find CAs
+   16.10.26 Adds the structure to the structure cache
 */
 BOOL StoreTorsions(PDB *allatompdb, PDB *pdb, PDB *p_start, PDB *p_end, 
                    char *filename, char *start, char *end)
@@ -450,6 +509,10 @@ BOOL StoreTorsions(PDB *allatompdb, PDB *pdb, PDB *p_start, PDB *p_end,
       return(FALSE);
    }
 
+   p->newer    = p->older = NULL;
+   p->pdbbytes = 0;
+   p->pins     = 0;
+
    if(!gDoCritRes)
    {
       p->allatompdb  = NULL;
@@ -503,7 +566,7 @@ torsions.\n");
                              p3->x, p3->y, p3->z);
 
       /* Update loop length when p3 is a CA (i.e. for the phi angle)    */
-      if(!strncmp(p3->atnam,"CA  ",4))
+      if(ATOMROLE(p3) == ATOMROLE_CA)
          (p->length)++;
    }
 
@@ -523,7 +586,7 @@ torsions.\n");
           p1!=p_end->next && i<MAXLOOPLEN;
           NEXT(p1))
       {
-         if(!strncmp(p1->atnam,"CA  ",4))
+         if(ATOMROLE(p1) == ATOMROLE_CA)
          {
             if(FirstCA)
             {
@@ -542,11 +605,79 @@ torsions.\n");
       fprintf(stderr,"Loop length exceeded maximum of %d\n",MAXLOOPLEN);
       return(FALSE);
    }
+
+   /* Store the coordinates used to compare loops in post-clustering    */
+   if(!StoreLoopCoor(p, allatompdb))
+      fprintf(stderr,"Unable to find coordinates for loop %s\n",
+              p->loopid);
+
+   if(gDoCritRes)
+      CacheStructure(p);
    
    return(TRUE);
 }
 
 
+/************************************************************************/
+/*>BOOL StoreLoopCoor(DATALIST *loop, PDB *allatompdb)
+   ---------------------------------------------------
+   I/O:     DATALIST *loop        Loop entry with start and length set
+   Input:   PDB      *allatompdb  All-atom PDB linked list for the loop
+   Returns: BOOL                  Was the loop start found?
+
+   Copies the CA and CB coordinates of the residues of a loop into the 
+   arrays in its DATALIST entry, so that loops may be compared without
+   keeping or copying the PDB linked list. Residues without a CA are 
+   skipped; hascb[] is FALSE for glycines and residues without a CB.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL StoreLoopCoor(DATALIST *loop, PDB *allatompdb)
+{
+   PDB *res, 
+       *next, 
+       *p, 
+       *ca, 
+       *cb;
+   int nres;
+
+   loop->ncoor = 0;
+   if((res = blFindResidueSpec(allatompdb, loop->start))==NULL)
+      return(FALSE);
+
+   for(nres=0; res!=NULL && nres<loop->length; res=next, nres++)
+   {
+      next = blFindNextResidue(res);
+      ca   = cb = NULL;
+      for(p=res; p!=next; NEXT(p))
+      {
+         if((ca==NULL) && (ATOMROLE(p) == ATOMROLE_CA))
+            ca = p;
+         else if((cb==NULL) && (ATOMROLE(p) == ATOMROLE_CB))
+            cb = p;
+      }
+
+      if(ca != NULL)
+      {
+         loop->ca[loop->ncoor].x = ca->x;
+         loop->ca[loop->ncoor].y = ca->y;
+         loop->ca[loop->ncoor].z = ca->z;
+         loop->hascb[loop->ncoor] = ((cb != NULL) &&
+                                     (RESTYPE(res) != RESTYPE_GLY));
+         if(loop->hascb[loop->ncoor])
+         {
+            loop->cb[loop->ncoor].x = cb->x;
+            loop->cb[loop->ncoor].y = cb->y;
+            loop->cb[loop->ncoor].z = cb->z;
+         }
+         (loop->ncoor)++;
+      }
+   }
+
+   return(TRUE);
+}
+
+
 /************************************************************************/
 /*>BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
                        char chain2, int resnum2, char insert2,
@@ -571,6 +702,7 @@ torsions.\n");
    N.B. This assumes N,CA,C ordering within the PDB file.
 
    27.06.95 Original   By: ACRM
+   16.10.26 Tests the atom role code to find C and CA
 */
 BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
                     char chain2, int resnum2, char insert2,
@@ -584,7 +716,7 @@ BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
    /* Search for the C atom before the residue specified by ID 1        */
    for(p=pdbbb; p!=NULL; NEXT(p))
    {
-      if((!strncmp(p->atnam,"C   ",4))    &&
+      if((ATOMROLE(p) == ATOMROLE_C)      &&
          (p->next != NULL)                &&
          (p->next->resnum    == resnum1)  &&
          (p->next->chain[0]  == chain1)   &&
@@ -605,7 +737,7 @@ BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
    /* Search for the CA in the residue specified by ID 2                */
    for(p=pdbbb; p!=NULL; NEXT(p))
    {
-      if((!strncmp(p->atnam,"CA  ",4)) &&
+      if((ATOMROLE(p) == ATOMROLE_CA)  &&
          (p->resnum    == resnum2)     &&
          (p->chain[0]  == chain2)      &&
          (p->insert[0] == insert2))
@@ -627,8 +759,8 @@ BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
 
 
 /************************************************************************/
-/*>REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
-   -----------------------------------------------------------------
+/*>FEATURE **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
+   --------------------------------------------------------------------
    Input:   DATALIST *indata      Linked list of loop data structures
             BOOL     CATorsions   Do CA rather than true torsions
    Output:  int      *NData       Number of items in linked list
@@ -642,10 +774,13 @@ BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
    13.09.95 Added storage of distances
    21.09.95 Modified method to calc storage requirements & handling of
             angle data
+   16.10.26 Uses AllocFeatures() rather than blArray2D()
+   16.10.26 Stores the raw torsions for the angular metric. Layout from
+            FeatureLayout()
 */
-REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
+FEATURE **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
 {
-   REAL     **data;
+   FEATURE  **data;
    DATALIST *p;
    int      i,
             n,
@@ -653,28 +788,15 @@ REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
             pos,
             maxval,
             ArrayDim,
-            AngleOffset = 2,
-            DistOffset  = 2;
+            AngleOffset,
+            DistOffset;
 
    /* The number of array positions used per residue and offsets to
       different parts of the data
    */
-   maxval = 2;
-   if(!CATorsions) 
-   {
-      maxval      += 4;
-      AngleOffset += 4;
-      DistOffset  += 4;
-   }
-   if(gDoAngles)
-   {
-      maxval      += 1;
-      DistOffset  += 1;
-   }
-   if(gDoDistance) 
-   {
-      maxval      += 1;
-   }
+   maxval      = FeatureLayout(CATorsions);
+   AngleOffset = maxval - (gDoAngles ? 1 : 0) - (gDoDistance ? 1 : 0);
+   DistOffset  = AngleOffset + (gDoAngles ? 1 : 0);
    
    
    /* Count items in data linked list                                   */
@@ -685,7 +807,7 @@ REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
    ArrayDim = gMaxLoopLen * maxval;
 
    /* Allocate and check 2D array                                       */
-   if((data = (REAL **)blArray2D(sizeof(REAL),*NData,ArrayDim))==NULL)
+   if((data = AllocFeatures(*NData, ArrayDim))==NULL)
    {
       fprintf(stderr,"No memory for data array.\n");
       return(NULL);
@@ -710,7 +832,13 @@ REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
           (gScheme[count] <= p->length) && (count<gMaxLoopLen); 
           count++)
       {
-         if(CATorsions)
+         if(gMetric == METRIC_ANGULAR)
+         {
+            for(i=0; i<AngleOffset; i++)
+               data[n][count*maxval + i] = 
+                  p->torsions[count*AngleOffset + i];
+         }
+         else if(CATorsions)
          {
             data[n][count*maxval]     = sin(p->torsions[count]);
             data[n][count*maxval + 1] = cos(p->torsions[count]);
@@ -742,7 +870,13 @@ REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
           (gScheme[count] <= p->length) && (count>=0); 
           count--, pos--)
       {
-         if(CATorsions)
+         if(gMetric == METRIC_ANGULAR)
+         {
+            for(i=0; i<AngleOffset; i++)
+               data[n][count*maxval + i] = 
+                  p->torsions[pos*AngleOffset + i];
+         }
+         else if(CATorsions)
          {
             data[n][count*maxval]     = sin(p->torsions[pos]);
             data[n][count*maxval + 1] = cos(p->torsions[pos]);
@@ -777,17 +911,229 @@ REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
 
 
 /************************************************************************/
-/*>void PrintArray(REAL **data, int NData, int width)
-   --------------------------------------------------
-   Input:   REAL  **data         Data array for clustering
+/*>FEATURE **ConvertCoor(DATALIST *indata, int *NData, int *VecDim)
+   ----------------------------------------------------------------
+   Input:   DATALIST *indata      Linked list of loop data structures
+   Output:  int      *NData       Number of items in linked list
+            int      *VecDim      Dimension of vectors (3 x length)
+   Returns: FEATURE  **           Data array (NULL on error)
+            
+   Converts the linked list of loops into a 2D array of CA coordinates
+   for METRIC RMSD. Each row holds the x,y,z of the CAs stored by 
+   StoreLoopCoor() moved so their centre of geometry is at the origin,
+   so CoorDist2() need only find the optimal rotation. All loops must
+   have the same number of CAs.
+
+   16.10.26 Original   By: ACRM
+*/
+FEATURE **ConvertCoor(DATALIST *indata, int *NData, int *VecDim)
+{
+   FEATURE  **data;
+   DATALIST *p;
+   COOR     cg;
+   int      i,
+            n,
+            ncoor = 0;
+
+   /* Count items and check the loops all have the same length          */
+   for(p=indata, n=0; p!=NULL; NEXT(p), n++)
+   {
+      if(p==indata)
+         ncoor = p->ncoor;
+      if(p->ncoor != ncoor)
+      {
+         fprintf(stderr,"METRIC RMSD needs loops with the same number \
+of CAs. %s has %d, %s has %d\n",
+                 indata->loopid, ncoor, p->loopid, p->ncoor);
+         return(NULL);
+      }
+   }
+   if(ncoor < 3)
+   {
+      fprintf(stderr,"METRIC RMSD needs loops of at least 3 CAs\n");
+      return(NULL);
+   }
+   *NData  = n;
+   *VecDim = 3 * ncoor;
+
+   /* Allocate and check 2D array                                       */
+   if((data = AllocFeatures(*NData, *VecDim))==NULL)
+   {
+      fprintf(stderr,"No memory for data array.\n");
+      return(NULL);
+   }
+
+   /* Walk the linked list, copying in the centred coordinates          */
+   for(p=indata,n=0; p!=NULL; NEXT(p),n++)
+   {
+      cg.x = cg.y = cg.z = 0.0;
+      for(i=0; i<ncoor; i++)
+      {
+         cg.x += p->ca[i].x;
+         cg.y += p->ca[i].y;
+         cg.z += p->ca[i].z;
+      }
+      cg.x /= ncoor;
+      cg.y /= ncoor;
+      cg.z /= ncoor;
+
+      for(i=0; i<ncoor; i++)
+      {
+         data[n][3*i]     = p->ca[i].x - cg.x;
+         data[n][3*i + 1] = p->ca[i].y - cg.y;
+         data[n][3*i + 2] = p->ca[i].z - cg.z;
+      }
+   }
+
+#ifdef DEBUG
+   PrintArray(data, *NData, *VecDim);
+#endif
+
+   return(data);
+}
+
+
+/************************************************************************/
+/*>BOOL IndexLoops(void)
+   ---------------------
+   Returns: BOOL                 Success of memory allocation
+   Globals: DATALIST *gDataList  Linked list of loops
+            DATALIST **gLoopTable  Pointer to each loop in list order
+            int      gNLoops     Number of loops in gLoopTable
+            int      gLoopTableSize  Space allocated in gLoopTable
+
+   (Re)builds the table giving each loop in gDataList by its position,
+   which is also its vector number in the data array, so loops can be
+   found without walking the linked list. The table grows in steps of
+   LOOPTABLECHUNK and is kept between calls. It must be rebuilt 
+   whenever loops are added to or removed from gDataList.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL IndexLoops(void)
+{
+   DATALIST *p,
+            **table;
+   int      n;
+
+   for(p=gDataList, n=0; p!=NULL; NEXT(p), n++)
+   {
+      if(n >= gLoopTableSize)
+      {
+         if((table = (DATALIST **)realloc(gLoopTable, 
+                                          (gLoopTableSize+LOOPTABLECHUNK) *
+                                          sizeof(DATALIST *)))==NULL)
+         {
+            fprintf(stderr,"No memory for loop table\n");
+            gNLoops = 0;
+            return(FALSE);
+         }
+         gLoopTable      = table;
+         gLoopTableSize += LOOPTABLECHUNK;
+      }
+      gLoopTable[n] = p;
+   }
+   gNLoops = n;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL BuildClusMembers(int *clusters, int NVec, int NClus, 
+                         CLUSMEMBERS *cm)
+   ---------------------------------------------------------
+   Input:   int         *clusters  Cluster of each vector (from 1)
+            int         NVec       Number of vectors
+            int         NClus      Number of clusters
+   Output:  CLUSMEMBERS *cm        Members of each cluster
+   Returns: BOOL                   Success of memory allocations
+
+   Builds the list of vectors in each cluster with a counting sort, so 
+   the members of a cluster can be visited without scanning the whole
+   clustering vector. Members are listed in vector order. Vectors with
+   a cluster number outside 1..NClus are left out. Access with the 
+   NCLUSMEMBERS() and CLUSMEMBER() macros and free with 
+   FreeClusMembers().
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL BuildClusMembers(int *clusters, int NVec, int NClus, 
+                      CLUSMEMBERS *cm)
+{
+   int i, c,
+       *next;
+
+   cm->NClus  = NClus;
+   cm->start  = (int *)malloc((NClus+2) * sizeof(int));
+   cm->member = (int *)malloc(MAX(NVec,1) * sizeof(int));
+   next       = (int *)malloc((NClus+2) * sizeof(int));
+   if(cm->start==NULL || cm->member==NULL || next==NULL)
+   {
+      if(next!=NULL) free(next);
+      FreeClusMembers(cm);
+      return(FALSE);
+   }
+
+   /* Count the members of each cluster into the following slot, then
+      accumulate to give the start of each cluster
+   */
+   for(c=0; c<NClus+2; c++)
+      cm->start[c] = 0;
+   for(i=0; i<NVec; i++)
+   {
+      if((clusters[i] >= 1) && (clusters[i] <= NClus))
+         (cm->start[clusters[i]+1])++;
+   }
+   for(c=2; c<NClus+2; c++)
+      cm->start[c] += cm->start[c-1];
+
+   for(c=0; c<NClus+2; c++)
+      next[c] = cm->start[c];
+   for(i=0; i<NVec; i++)
+   {
+      if((clusters[i] >= 1) && (clusters[i] <= NClus))
+         cm->member[next[clusters[i]]++] = i;
+   }
+
+   free(next);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void FreeClusMembers(CLUSMEMBERS *cm)
+   -------------------------------------
+   I/O:     CLUSMEMBERS *cm     Members of each cluster
+
+   Frees the lists made by BuildClusMembers()
+
+   16.10.26 Original   By: ACRM
+*/
+void FreeClusMembers(CLUSMEMBERS *cm)
+{
+   if(cm->start != NULL)
+      free(cm->start);
+   if(cm->member != NULL)
+      free(cm->member);
+   cm->start  = NULL;
+   cm->member = NULL;
+}
+
+
+/************************************************************************/
+/*>void PrintArray(FEATURE **data, int NData, int width)
+   -----------------------------------------------------
+   Input:   FEATURE **data       Data array for clustering
             int   NData          Number of vectors
             int   width          Dimension of vectors
 
    Prints the 2D data array for debugging
 
    27.06.95 Original   By: ACRM
+   16.10.26 Takes FEATURE array
 */
-void PrintArray(REAL **data, int NData, int width)
+void PrintArray(FEATURE **data, int NData, int width)
 {
    int i,j;
    
@@ -802,3 +1148,447 @@ void PrintArray(REAL **data, int NData, int width)
 }
 
 
+/************************************************************************/
+/*>FEATURE **AllocFeatures(int NVec, int VecDim)
+   ---------------------------------------------
+   Input:   int     NVec         Number of vectors
+            int     VecDim       Dimension of vectors
+   Returns: FEATURE **           Row pointers into the feature matrix
+                                 (NULL if no memory)
+
+   Allocates the feature matrix as one block. The rows are contiguous,
+   start on a FEATALIGN byte boundary and are padded with zeros to a
+   multiple of FEATALIGN bytes, so the distance loops can be vectorized
+   without the rows overlapping cache lines. The row pointers live at
+   the start of the same block, so the matrix is indexed as data[i][j]
+   and freed with a single call to FreeFeatures().
+
+   16.10.26 Original   By: ACRM
+*/
+FEATURE **AllocFeatures(int NVec, int VecDim)
+{
+   FEATURE       **data,
+                 *base;
+   char          *block;
+   unsigned long stride,
+                 offset;
+   int           i;
+
+   /* Row length rounded up to a whole number of aligned units          */
+   stride = (unsigned long)VecDim * sizeof(FEATURE);
+   stride = ((stride + FEATALIGN - 1) / FEATALIGN) * FEATALIGN;
+   stride /= sizeof(FEATURE);
+
+   offset = (unsigned long)NVec * sizeof(FEATURE *);
+   if((block = (char *)calloc(offset + FEATALIGN + 
+                              (unsigned long)NVec * stride * 
+                              sizeof(FEATURE), 1))==NULL)
+      return(NULL);
+
+   data  = (FEATURE **)block;
+   block += offset;
+   block += (FEATALIGN - ((unsigned long)block % FEATALIGN)) % FEATALIGN;
+   base  = (FEATURE *)block;
+
+   for(i=0; i<NVec; i++)
+      data[i] = base + (unsigned long)i * stride;
+
+   return(data);
+}
+
+
+/************************************************************************/
+/*>void FreeFeatures(FEATURE **data)
+   ---------------------------------
+   Input:   FEATURE **data       Feature matrix from AllocFeatures()
+
+   Frees a feature matrix
+
+   16.10.26 Original   By: ACRM
+*/
+void FreeFeatures(FEATURE **data)
+{
+   if(data != NULL)
+      free(data);
+}
+
+
+/************************************************************************/
+/*>REAL FeatureDist2(FEATURE *x, FEATURE *y, int VecDim)
+   -----------------------------------------------------
+   Input:   FEATURE *x           First vector
+            FEATURE *y           Second vector
+            int     VecDim       Dimension of vectors
+   Returns: REAL                 Squared Euclidean distance
+
+   Squared distance between two feature vectors. The sum is accumulated
+   as REAL in dimension order whatever the storage type, so results do
+   not depend on how the loop is compiled. Raw torsions for the angular
+   metric must first be expanded to sin/cos pairs with ExpandFeature()
+   or ExpandFeatures(), after which the distances are the same as those
+   from DissimTile().
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Added angular metric
+   16.10.26 Torsions compared through TorsionSinCos() so distances are
+            the same as DissimTile() and the Euclidean metric
+   16.10.26 Only takes expanded vectors, so there are no sin/cos calls
+            for each pair
+*/
+REAL FeatureDist2(FEATURE *x, FEATURE *y, int VecDim)
+{
+   REAL d,
+        sum = (REAL)0.0;
+   int  k;
+
+   for(k=0; k<VecDim; k++)
+   {
+      d    = (REAL)x[k] - (REAL)y[k];
+      sum += d * d;
+   }
+
+   return(sum);
+}
+
+
+/************************************************************************/
+/*>int FeatureLayout(BOOL CATorsions)
+   ----------------------------------
+   Input:   BOOL  CATorsions     Do CA rather than true torsions
+   Returns: int                  Vector elements per residue
+   Globals: int   gResFeatures   Set to vector elements per residue
+            int   gResTorsions   Set to number of raw torsions at the 
+                                 start of each residue's elements (0
+                                 unless using the angular metric)
+
+   Works out how each residue is laid out in a feature vector. Each
+   torsion takes a sin/cos pair, or a single element for the angular
+   metric, followed by the angle and distance if these are used.
+
+   16.10.26 Original   By: ACRM
+*/
+int FeatureLayout(BOOL CATorsions)
+{
+   int NTorsions = (CATorsions ? 1 : 3);
+
+   if(gMetric == METRIC_ANGULAR)
+   {
+      gResTorsions = NTorsions;
+      gResFeatures = NTorsions;
+   }
+   else
+   {
+      gResTorsions = 0;
+      gResFeatures = 2 * NTorsions;
+   }
+   if(gDoAngles)   gResFeatures++;
+   if(gDoDistance) gResFeatures++;
+
+   return(gResFeatures);
+}
+
+
+/************************************************************************/
+/*>void TorsionSinCos(REAL t, REAL *s, REAL *c)
+   --------------------------------------------
+   Input:   REAL  t              Torsion (radians) or DUMMY
+   Output:  REAL  *s             Sine of the torsion
+            REAL  *c             Cosine of the torsion
+
+   Gives the point on the unit circle for a raw torsion stored with the
+   angular metric. A missing torsion (DUMMY) gives the point
+   (DUMMY,DUMMY) as it does in the sin/cos representation. The squared
+   distance between two such points is 2-2cos of the difference of
+   the torsions; callers expand each torsion once and use the points so
+   the distances are those of the Euclidean metric.
+
+   16.10.26 Original   By: ACRM
+*/
+void TorsionSinCos(REAL t, REAL *s, REAL *c)
+{
+   if(t == DUMMY)
+   {
+      *s = DUMMY;
+      *c = DUMMY;
+   }
+   else
+   {
+      *s = sin(t);
+      *c = cos(t);
+   }
+}
+
+
+/************************************************************************/
+/*>int ExpandFeature(FEATURE *x, int VecDim, FEATURE *out)
+   -------------------------------------------------------
+   Input:   FEATURE *x           Feature vector
+            int     VecDim       Dimension of the vector
+   Output:  FEATURE *out         Vector with sin/cos pairs in place of
+                                 raw torsions [EXPANDEDDIM(VecDim)]
+   Returns: int                  Dimension of the output vector
+
+   Gives the Euclidean coordinates of a feature vector for code which
+   works on bounding boxes or centroids rather than distances. Vectors
+   which do not hold raw torsions are copied unchanged.
+
+   16.10.26 Original   By: ACRM
+*/
+int ExpandFeature(FEATURE *x, int VecDim, FEATURE *out)
+{
+   int k, n;
+
+   for(k=0, n=0; k<VecDim; k++)
+   {
+      if(!TORSIONDIM(k))
+      {
+         out[n++] = x[k];
+      }
+      else if(x[k] == DUMMY)
+      {
+         out[n++] = DUMMY;
+         out[n++] = DUMMY;
+      }
+      else
+      {
+         out[n++] = (FEATURE)sin((REAL)x[k]);
+         out[n++] = (FEATURE)cos((REAL)x[k]);
+      }
+   }
+
+   return(n);
+}
+
+
+/************************************************************************/
+/*>FEATURE **ExpandFeatures(FEATURE **data, int NVec, int VecDim)
+   --------------------------------------------------------------
+   Input:   FEATURE **data       Feature matrix [NVec][VecDim]
+            int     NVec         Number of vectors
+            int     VecDim       Dimension of the vectors
+   Returns: FEATURE **           New feature matrix 
+                                 [NVec][EXPANDEDDIM(VecDim)] (NULL if
+                                 no memory)
+
+   Makes a copy of a feature matrix with each vector expanded by
+   ExpandFeature(), so code which compares many pairs of vectors can
+   use FeatureDist2() without taking sin and cos for every pair. Free
+   it with FreeFeatures().
+
+   16.10.26 Original   By: ACRM
+*/
+FEATURE **ExpandFeatures(FEATURE **data, int NVec, int VecDim)
+{
+   FEATURE **expanded;
+   int     i;
+
+   if((expanded = AllocFeatures(NVec, EXPANDEDDIM(VecDim)))==NULL)
+      return(NULL);
+   for(i=0; i<NVec; i++)
+      ExpandFeature(data[i], VecDim, expanded[i]);
+
+   return(expanded);
+}
+
+
+/************************************************************************/
+/*>void SetStructureCache(unsigned long budget)
+   --------------------------------------------
+   Input:   unsigned long budget  Memory (bytes) the all-atom structures
+                                  kept for critical residues may use
+                                  (0 = no limit)
+
+   Sets the memory budget for the structure cache and frees structures
+   to keep within it.
+
+   16.10.26 Original   By: ACRM
+*/
+void SetStructureCache(unsigned long budget)
+{
+   sCacheBudget = budget;
+   TrimStructureCache();
+}
+
+
+/************************************************************************/
+/*>void CacheStructure(DATALIST *loop)
+   -----------------------------------
+   I/O:     DATALIST *loop     Loop whose structure has just been read
+                               or used
+
+   Adds the all-atom and torsion PDB linked lists of a loop to the
+   structure cache, or marks them as the most recently used if they are
+   already cached. If the cache is then over budget, the least recently
+   used structures which are not pinned are freed, setting allatompdb,
+   torsionpdb and pdbloop to NULL; LoadLoop() reads them again when
+   needed. The structure just used is never freed.
+
+   16.10.26 Original   By: ACRM
+*/
+void CacheStructure(DATALIST *loop)
+{
+   PDB           *p;
+   unsigned long natoms = 0;
+
+   if(loop->pdbbytes)
+   {
+      if(loop == sCacheNewest)
+         return;
+      UnlinkStructure(loop);
+   }
+   else
+   {
+      for(p=loop->allatompdb; p!=NULL; NEXT(p))
+         natoms++;
+      for(p=loop->torsionpdb; p!=NULL; NEXT(p))
+         natoms++;
+      loop->pdbbytes = MAX(natoms, 1) * sizeof(PDB);
+      sCacheBytes   += loop->pdbbytes;
+      if(sCacheBytes > sCachePeak)
+         sCachePeak = sCacheBytes;
+   }
+
+   LinkStructure(loop);
+   TrimStructureCache();
+}
+
+
+/************************************************************************/
+/*>void UncacheStructure(DATALIST *loop)
+   -------------------------------------
+   I/O:     DATALIST *loop     Loop
+
+   Removes a loop from the structure cache without freeing its
+   structure, which then belongs to the caller.
+
+   16.10.26 Original   By: ACRM
+*/
+void UncacheStructure(DATALIST *loop)
+{
+   if(!loop->pdbbytes)
+      return;
+
+   UnlinkStructure(loop);
+   sCacheBytes    -= loop->pdbbytes;
+   loop->pdbbytes  = 0;
+}
+
+
+/************************************************************************/
+/*>void PinStructure(DATALIST *loop, BOOL pin)
+   -------------------------------------------
+   I/O:     DATALIST *loop     Loop
+   Input:   BOOL     pin       TRUE to pin, FALSE to release a pin
+
+   A pinned structure is not freed by the structure cache. Pins are
+   counted, so each pin must be released.
+
+   16.10.26 Original   By: ACRM
+*/
+void PinStructure(DATALIST *loop, BOOL pin)
+{
+   if(pin)
+   {
+      loop->pins++;
+   }
+   else if(loop->pins > 0)
+   {
+      if(--(loop->pins) == 0)
+         TrimStructureCache();
+   }
+}
+
+
+/************************************************************************/
+/*>unsigned long StructureCachePeak(void)
+   --------------------------------------
+   Returns: unsigned long      Most memory (bytes) held by the structure
+                               cache at any time
+
+   16.10.26 Original   By: ACRM
+*/
+unsigned long StructureCachePeak(void)
+{
+   return(sCachePeak);
+}
+
+
+/************************************************************************/
+/*>static void LinkStructure(DATALIST *loop)
+   -----------------------------------------
+   I/O:     DATALIST *loop     Loop
+
+   Links a loop at the most recently used end of the structure cache
+   list.
+
+   16.10.26 Original   By: ACRM
+*/
+static void LinkStructure(DATALIST *loop)
+{
+   loop->newer = NULL;
+   loop->older = sCacheNewest;
+   if(sCacheNewest != NULL)
+      sCacheNewest->newer = loop;
+   else
+      sCacheOldest = loop;
+   sCacheNewest = loop;
+}
+
+
+/************************************************************************/
+/*>static void UnlinkStructure(DATALIST *loop)
+   -------------------------------------------
+   I/O:     DATALIST *loop     Loop
+
+   Unlinks a loop from the structure cache list.
+
+   16.10.26 Original   By: ACRM
+*/
+static void UnlinkStructure(DATALIST *loop)
+{
+   if(loop->newer != NULL)
+      loop->newer->older = loop->older;
+   else
+      sCacheNewest = loop->older;
+
+   if(loop->older != NULL)
+      loop->older->newer = loop->newer;
+   else
+      sCacheOldest = loop->newer;
+
+   loop->newer = loop->older = NULL;
+}
+
+
+/************************************************************************/
+/*>static void TrimStructureCache(void)
+   ------------------------------------
+   Frees the least recently used structures which are not pinned until
+   the structure cache is within its budget. The most recently used
+   structure is always kept.
+
+   16.10.26 Original   By: ACRM
+*/
+static void TrimStructureCache(void)
+{
+   DATALIST *loop,
+            *newer;
+
+   if(!sCacheBudget)
+      return;
+
+   for(loop=sCacheOldest;
+       (loop!=NULL) && (loop!=sCacheNewest) && 
+       (sCacheBytes > sCacheBudget);
+       loop=newer)
+   {
+      newer = loop->newer;
+      if(loop->pins)
+         continue;
+
+      UncacheStructure(loop);
+      FREELIST(loop->allatompdb, PDB);
+      FREELIST(loop->torsionpdb, PDB);
+      loop->pdbloop = NULL;
+   }
+}
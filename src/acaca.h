@@ -61,6 +61,11 @@
    V3.6  09.01.96 Skipped
    V3.7  14.03.96 gPClusCut[] now 3 long rather than 2
    V3.7a 30.01.09 Increased MAXLOOPLEN and added comment
+   V3.8  16.10.26 Added FEATURE type for the aligned feature matrix
+                  Added gMetric and the feature layout globals
+                  DATALIST holds the loop CA and CB coordinates
+                  Added METRIC_RMSD
+                  Added gLoopTable index of gDataList and CLUSMEMBERS
 
 *************************************************************************/
 /* Includes
@@ -96,16 +101,53 @@
 #define DUMMY2               ((REAL)100.0) /* For non-existent dists.   */
 #define INF                  ((REAL)MAXDOUBLE)
 
+#define FEATALIGN            64   /* Byte alignment of feature rows     */
+#define LOOPTABLECHUNK       256  /* Growth of gLoopTable              */
+
+#define METRIC_EUCLIDEAN     0    /* Torsions as sin/cos pairs          */
+#define METRIC_ANGULAR       1    /* Raw torsions, expanded to sin/cos  */
+#define METRIC_RMSD          2    /* Superposed CA coordinates          */
+
+/* Number of members of cluster c and member k (from 0) of cluster c   */
+#define NCLUSMEMBERS(cm,c)   ((cm)->start[(c)+1] - (cm)->start[c])
+#define CLUSMEMBER(cm,c,k)   ((cm)->member[(cm)->start[c] + (k)])
+
+/* Is element k (from 0) of a feature vector a raw torsion?             */
+#define TORSIONDIM(k) ((gResTorsions) && \
+                       (((k) % gResFeatures) < gResTorsions))
+
+/* Length of a feature vector once torsions are expanded to sin/cos     */
+#define EXPANDEDDIM(n) ((gResTorsions) ? \
+                        ((n) + ((n) / gResFeatures) * gResTorsions) : (n))
+
+/* Storage type for the feature matrix. Build with -DFLOAT_FEATURES to
+   halve its size; distances are still accumulated as REAL
+*/
+#ifdef FLOAT_FEATURES
+typedef float FEATURE;
+#else
+typedef REAL  FEATURE;
+#endif
+
 typedef struct _datalist
 {
-   struct _datalist *next;
+   struct _datalist *next,
+                    *newer, /* Structure cache order, most              */
+                    *older; /* recently used first                      */
    PDB    *allatompdb,      /* The native PDB linked list from the file */
           *pdbloop,         /* Start of loop in pdbstart linked list    */
           *torsionpdb;      /* C-alpha or backbone atoms of whole struc */
    REAL   torsions[MAXLOOPLEN * TORPERRES],
           angles[MAXLOOPLEN],
           dist[MAXLOOPLEN];
-   int    length;
+   COOR   ca[MAXLOOPLEN],   /* CA of each loop residue for fitting      */
+          cb[MAXLOOPLEN];   /* CB of the same residues                  */
+   BOOL   hascb[MAXLOOPLEN];/* Residue has a CB (not Gly)               */
+   unsigned long pdbbytes;  /* Memory held in the structure cache
+                               (0 if not cached)                        */
+   int    length,
+          ncoor,            /* Number of residues in ca[] and cb[]      */
+          pins;             /* Users stopping the structure being freed */
    char   loopid[MAXBUFF],
           start[16],
           end[16];
@@ -117,13 +159,27 @@ typedef struct _cluster
    char   loopid[MAXLOOPID];
 }  CLUSTER;
 
+typedef struct
+{
+   int    *start,           /* Start of each cluster in member[] 
+                               [NClus+2] (from 1)                       */
+          *member,          /* Vector numbers (from 0) ordered by 
+                               cluster then by vector [NVec]            */
+          NClus;
+}  CLUSMEMBERS;
+
 /************************************************************************/
 /* Globals
 */
 #ifdef MAIN /* ------------------- Define externals ------------------- */
 int        gMaxLoopLen    = 0,
            gScheme[MAXLOOPLEN],
-           gClusterMethod = 1;
+           gClusterMethod = 1,
+           gMetric        = METRIC_EUCLIDEAN,
+           gResFeatures   = 0,        /* Vector elements per residue    */
+           gResTorsions   = 0,        /* Of which raw torsions          */
+           gNLoops        = 0,        /* Loops indexed in gLoopTable    */
+           gLoopTableSize = 0;        /* Space in gLoopTable            */
 BOOL       gDoDendogram   = FALSE,
            gDoTable       = FALSE,
            gDoData        = FALSE,
@@ -132,13 +188,19 @@ BOOL       gDoDendogram   = FALSE,
            gDoAngles      = FALSE,    /* Handle angles in clustering    */
            gCATorsions    = FALSE;    /* Do CA pseudo torsions          */
 FILE       *gOutfp        = NULL;
-DATALIST   *gDataList     = NULL;
+DATALIST   *gDataList     = NULL,
+           **gLoopTable   = NULL;     /* gDataList by position          */
 STRINGLIST *gStringList   = NULL;
 REAL       gPClusCut[3];
 #else       /* ----------------- Reference externals ------------------ */
 extern int        gMaxLoopLen,
                   gScheme[MAXLOOPLEN],
-                  gClusterMethod;
+                  gClusterMethod,
+                  gMetric,
+                  gResFeatures,
+                  gResTorsions,
+                  gNLoops,
+                  gLoopTableSize;
 extern BOOL       gDoDendogram,
                   gDoTable,
                   gDoData,
@@ -147,7 +209,8 @@ extern BOOL       gDoDendogram,
                   gDoAngles,
                   gCATorsions;
 extern FILE       *gOutfp;
-extern DATALIST   *gDataList;
+extern DATALIST   *gDataList,
+                  **gLoopTable;
 extern STRINGLIST *gStringList;
 extern REAL       gPClusCut[2];
 #endif
@@ -158,6 +221,8 @@ extern REAL       gPClusCut[2];
 
 BOOL SetClusterMethod(char *method)
 ;
+BOOL SetMetric(char *metric)
+;
 BOOL SetOutputFile(char *filename)
 ;
 BOOL HandleLoopSpec(char *filename, char *start, char *end, 
@@ -174,7 +239,42 @@ BOOL FindBBResidues(PDB *pdbbb, char chain1, int resnum1, char insert1,
                     char chain2, int resnum2, char insert2,
                     PDB **pp_start, PDB **pp_end)
 ;
-REAL **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
+BOOL StoreLoopCoor(DATALIST *loop, PDB *allatompdb)
+;
+FEATURE **ConvertData(DATALIST *indata, int *NData, BOOL CATorsions)
+;
+FEATURE **ConvertCoor(DATALIST *indata, int *NData, int *VecDim)
+;
+BOOL IndexLoops(void)
+;
+BOOL BuildClusMembers(int *clusters, int NVec, int NClus, 
+                      CLUSMEMBERS *cm)
+;
+void FreeClusMembers(CLUSMEMBERS *cm)
+;
+void PrintArray(FEATURE **data, int NData, int width)
+;
+FEATURE **AllocFeatures(int NVec, int VecDim)
+;
+void FreeFeatures(FEATURE **data)
+;
+REAL FeatureDist2(FEATURE *x, FEATURE *y, int VecDim)
+;
+int FeatureLayout(BOOL CATorsions)
+;
+void TorsionSinCos(REAL t, REAL *s, REAL *c)
+;
+int ExpandFeature(FEATURE *x, int VecDim, FEATURE *out)
+;
+FEATURE **ExpandFeatures(FEATURE **data, int NVec, int VecDim)
+;
+void SetStructureCache(unsigned long budget)
+;
+void CacheStructure(DATALIST *loop)
+;
+void UncacheStructure(DATALIST *loop)
+;
+void PinStructure(DATALIST *loop, BOOL pin)
 ;
-void PrintArray(REAL **data, int NData, int width)
+unsigned long StructureCachePeak(void)
 ;
@@ -0,0 +1,316 @@
+/*************************************************************************
+
+   Program:    benchcontact
+   File:       benchcontact.c
+
+   Version:    V1.0
+   Date:       16.10.26
+   Function:   Benchmark residue contact and H-bond tests
+
+   Copyright:  (c) Dr. Andrew C. R. Martin 2026
+   Author:     Dr. Andrew C. R. Martin
+   Address:    Biomolecular Structure & Modelling Unit,
+               Department of Biochemistry & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   EMail:      INTERNET: martin@biochem.ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads a PDB file, optionally placing several copies side by side to
+   make a large complex, and tests every pair of residues for a side
+   chain contact (as used by findsdrs for hydrophobic partners) and for
+   a side chain H-bond in two ways: finding the residue boundaries with
+   blFindNextResidue() and searching all the atom pairs, and using a
+   residue table whose bounding spheres reject distant pairs. Reports
+   the pairs per second for each and whether the results agree.
+
+**************************************************************************
+
+   Usage:
+   ======
+   benchcontact [-c copies] file.pdb
+
+   Not built by default; use 'make benchcontact'
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  16.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bioplib/SysDefs.h"
+#include "bioplib/MathType.h"
+#include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "bioplib/hbond.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define CONTACTDIST  ((REAL)5.0)  /* As findsdrs hydrophobic contacts   */
+#define COPYSPACING  ((REAL)100.0)/* Separation of copies of structure  */
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+PDB *ReadCopies(FILE *fp, int copies);
+BOOL ListSCContact(PDB *res1, PDB *res2, REAL dist);
+void Usage(void);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program for benchmarking residue contacts
+
+   16.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   FILE     *fp;
+   PDB      *pdb,
+            *p,
+            **res;
+   RESTABLE *restab;
+   int      copies = 1,
+            nres,
+            i, j,
+            count[4];
+   long     NPairs;
+   clock_t  start;
+   double   secs[4];
+
+   argc--; argv++;
+   if((argc > 1) && !strcmp(argv[0], "-c"))
+   {
+      copies = atoi(argv[1]);
+      argc -= 2; argv += 2;
+   }
+   if((argc != 1) || (copies < 1))
+   {
+      Usage();
+      return(0);
+   }
+
+   if((fp=fopen(argv[0],"r"))==NULL)
+   {
+      fprintf(stderr,"Unable to open %s\n", argv[0]);
+      return(1);
+   }
+   if((pdb = ReadCopies(fp, copies))==NULL)
+      return(1);
+   fclose(fp);
+
+   /* Residue pointers for the linked list tests                        */
+   for(p=pdb, nres=0; p!=NULL; p=blFindNextResidue(p))
+      nres++;
+   if((res = (PDB **)malloc(nres * sizeof(PDB *)))==NULL)
+   {
+      fprintf(stderr,"No memory for residue array\n");
+      return(1);
+   }
+   for(p=pdb, i=0; p!=NULL; p=blFindNextResidue(p))
+      res[i++] = p;
+   NPairs = (long)nres * (nres - 1) / 2;
+
+   /* Side chain contacts from the linked list                          */
+   start = clock();
+   for(i=0, count[0]=0; i<nres; i++)
+      for(j=i+1; j<nres; j++)
+         if(ListSCContact(res[i], res[j], CONTACTDIST))
+            count[0]++;
+   secs[0] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   /* H-bonds from the linked list                                      */
+   start = clock();
+   for(i=0, count[2]=0; i<nres; i++)
+      for(j=i+1; j<nres; j++)
+         if(blIsHBonded(res[i], res[j], HBOND_SIDECHAIN))
+            count[2]++;
+   secs[2] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   /* Both from the residue table, including the time to build it       */
+   start = clock();
+   if((restab = blBuildResTablePDB(pdb))==NULL)
+   {
+      fprintf(stderr,"No memory for residue table\n");
+      return(1);
+   }
+   for(i=0, count[1]=0; i<nres; i++)
+      for(j=i+1; j<nres; j++)
+         if(blResTableContact(restab, i, j, CONTACTDIST, TRUE, TRUE))
+            count[1]++;
+   secs[1] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   start = clock();
+   for(i=0, count[3]=0; i<nres; i++)
+      for(j=i+1; j<nres; j++)
+         if(blIsHBondedResTable(restab, i, j, HBOND_SIDECHAIN))
+            count[3]++;
+   secs[3] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   printf("Residues:                 %d\n", nres);
+   printf("Pairs:                    %ld\n", NPairs);
+   printf("Side chain contacts:      %d (table %d)%s\n", count[0],
+          count[1], (count[0]==count[1]) ? "" : " DIFFER");
+   printf("Side chain H-bonds:       %d (table %d)%s\n", count[2],
+          count[3], (count[2]==count[3]) ? "" : " DIFFER");
+   printf("Contacts, linked list:    %.0f pairs/s\n",
+          (double)NPairs / MAX(secs[0], 1.0e-6));
+   printf("Contacts, residue table:  %.0f pairs/s\n",
+          (double)NPairs / MAX(secs[1], 1.0e-6));
+   printf("H-bonds, linked list:     %.0f pairs/s\n",
+          (double)NPairs / MAX(secs[2], 1.0e-6));
+   printf("H-bonds, residue table:   %.0f pairs/s\n",
+          (double)NPairs / MAX(secs[3], 1.0e-6));
+
+   blFreeResTablePDB(restab);
+   free(res);
+   FREELIST(pdb, PDB);
+   return((count[0]==count[1] && count[2]==count[3]) ? 0 : 1);
+}
+
+
+/************************************************************************/
+/*>PDB *ReadCopies(FILE *fp, int copies)
+   -------------------------------------
+   Input:   FILE *fp       PDB file
+            int  copies    Number of copies to make
+   Returns: PDB *          PDB linked list (NULL on failure)
+
+   Reads a PDB file several times, moving each copy along x so they do
+   not overlap, and joins them into a single linked list.
+
+   16.10.26 Original   By: ACRM
+*/
+PDB *ReadCopies(FILE *fp, int copies)
+{
+   PDB  *pdb  = NULL,
+        *last = NULL,
+        *copy,
+        *p;
+   int  natom, c;
+
+   for(c=0; c<copies; c++)
+   {
+      rewind(fp);
+      if((copy = blReadPDB(fp, &natom))==NULL)
+      {
+         fprintf(stderr,"No atoms read from PDB file\n");
+         if(pdb != NULL)
+            FREELIST(pdb, PDB);
+         return(NULL);
+      }
+      if(pdb == NULL)
+         pdb = copy;
+      else
+         last->next = copy;
+      for(p=copy; p!=NULL; NEXT(p))
+      {
+         p->x += c * COPYSPACING;
+         last  = p;
+      }
+   }
+
+   return(pdb);
+}
+
+
+/************************************************************************/
+/*>BOOL ListSCContact(PDB *res1, PDB *res2, REAL dist)
+   ---------------------------------------------------
+   Input:   PDB  *res1     First residue
+            PDB  *res2     Second residue
+            REAL dist      Contact distance
+   Returns: BOOL           Side chains in contact?
+
+   The side chain contact test formerly made by MakeSCContact() in
+   findsdrs, finding the residue ends from the linked list.
+
+   16.10.26 Original based on MakeSCContact()   By: ACRM
+*/
+BOOL ListSCContact(PDB *res1, PDB *res2, REAL dist)
+{
+   PDB *end1,
+       *end2,
+       *p, *q;
+
+   dist *= dist;
+   end1  = blFindNextResidue(res1);
+   end2  = blFindNextResidue(res2);
+
+   for(p=res1; p!=end1; NEXT(p))
+   {
+      if(strncmp(p->atnam,"N   ",4) &&
+         strncmp(p->atnam,"CA  ",4) &&
+         strncmp(p->atnam,"C   ",4) &&
+         strncmp(p->atnam,"O   ",4))
+      {
+         for(q=res2; q!=end2; NEXT(q))
+         {
+            if(strncmp(q->atnam,"N   ",4) &&
+               strncmp(q->atnam,"CA  ",4) &&
+               strncmp(q->atnam,"C   ",4) &&
+               strncmp(q->atnam,"O   ",4))
+            {
+               if(DISTSQ(p,q) <= dist)
+                  return(TRUE);
+            }
+         }
+      }
+   }
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Prints a usage message
+
+   16.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nbenchcontact V1.0 (c) 2026 Dr. Andrew C.R. \
+Martin\n");
+   fprintf(stderr,"Usage: benchcontact [-c copies] file.pdb\n");
+   fprintf(stderr,"       -c  Number of copies of the structure to \
+place side by side [1]\n\n");
+   fprintf(stderr,"Tests every pair of residues for side chain contacts \
+and H-bonds using the\n");
+   fprintf(stderr,"PDB linked list and using a residue table with \
+bounding spheres and reports\n");
+   fprintf(stderr,"the pairs per second.\n\n");
+}
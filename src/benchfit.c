@@ -0,0 +1,325 @@
+/*************************************************************************
+
+   Program:    benchfit
+   File:       benchfit.c
+   
+   Version:    V1.0
+   Date:       16.10.26
+   Function:   Benchmark loop fitting for post-clustering
+   
+   Copyright:  (c) Dr. Andrew C. R. Martin 2026
+   Author:     Dr. Andrew C. R. Martin
+   Address:    Biomolecular Structure & Modelling Unit,
+               Department of Biochemistry & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   EMail:      INTERNET: martin@biochem.ucl.ac.uk
+               
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work! 
+
+   The code may not be sold commercially or included as part of a 
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads the LOOPs from a clan control file and compares every pair of
+   loops of the same length in two ways: the single-fit FitLoopCoor() 
+   used by post-clustering, and the previous route of duplicating the 
+   all-atom PDB linked lists and calling RmsCAPDB(), 
+   MaxCADeviationPDB() and MaxCBDeviationPDB(). Reports the pairs per 
+   second for each and the largest difference in the values.
+
+**************************************************************************
+
+   Usage:
+   ======
+   benchfit [-r repeats] clanfile
+
+   Not built by default; use 'make benchfit'
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  16.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#define MAIN
+#include <time.h>
+#include "acaca.h"
+#include "loopfit.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int main(int argc, char **argv);
+BOOL ReadLoops(FILE *fp);
+BOOL PDBFitLoops(DATALIST *loop1, DATALIST *loop2, REAL *rms, 
+                 REAL *CADev, REAL *CBDev);
+void Usage(void);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+   Main program for benchmarking loop fitting
+
+   16.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   FILE     *fp;
+   DATALIST **loops,
+            *p;
+   int      NLoops  = 0,
+            NPairs  = 0,
+            repeats = 1,
+            r, i, j;
+   REAL     rms[2], CADev[2], CBDev[2],
+            MaxDiff = (REAL)0.0;
+   clock_t  start;
+   double   secs[2];
+
+   argc--; argv++;
+   if((argc > 1) && !strcmp(argv[0], "-r"))
+   {
+      repeats = atoi(argv[1]);
+      argc -= 2; argv += 2;
+   }
+   if((argc != 1) || (repeats < 1))
+   {
+      Usage();
+      return(0);
+   }
+
+   if((fp=fopen(argv[0],"r"))==NULL)
+   {
+      fprintf(stderr,"Unable to open %s\n", argv[0]);
+      return(1);
+   }
+
+   /* Keep the all-atom PDB linked lists for the PDB fitting routines   */
+   gDoCritRes = TRUE;
+   if(!ReadLoops(fp))
+      return(1);
+   fclose(fp);
+
+   for(p=gDataList; p!=NULL; NEXT(p))
+      NLoops++;
+   if((loops = (DATALIST **)malloc(NLoops * sizeof(DATALIST *)))==NULL)
+   {
+      fprintf(stderr,"No memory for loop array\n");
+      return(1);
+   }
+   for(p=gDataList, i=0; p!=NULL; NEXT(p))
+      loops[i++] = p;
+
+   /* Check the two routes agree                                        */
+   for(i=0; i<NLoops; i++)
+   {
+      for(j=i+1; j<NLoops; j++)
+      {
+         if(loops[i]->length != loops[j]->length)
+            continue;
+         NPairs++;
+         rms[0] = FitLoopCoor(loops[i], loops[j], &(CADev[0]), 
+                              &(CBDev[0]));
+         PDBFitLoops(loops[i], loops[j], &(rms[1]), &(CADev[1]), 
+                     &(CBDev[1]));
+         MaxDiff = MAX(MaxDiff, ABS(rms[0]   - rms[1]));
+         MaxDiff = MAX(MaxDiff, ABS(CADev[0] - CADev[1]));
+         MaxDiff = MAX(MaxDiff, ABS(CBDev[0] - CBDev[1]));
+      }
+   }
+   if(NPairs == 0)
+   {
+      fprintf(stderr,"No pairs of loops of the same length\n");
+      return(1);
+   }
+
+   /* Time the single fit on the stored coordinates                     */
+   start = clock();
+   for(r=0; r<repeats; r++)
+   {
+      for(i=0; i<NLoops; i++)
+      {
+         for(j=i+1; j<NLoops; j++)
+         {
+            if(loops[i]->length == loops[j]->length)
+               rms[0] = FitLoopCoor(loops[i], loops[j], &(CADev[0]), 
+                                    &(CBDev[0]));
+         }
+      }
+   }
+   secs[0] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   /* Time the three fits on copies of the PDB linked lists             */
+   start = clock();
+   for(r=0; r<repeats; r++)
+   {
+      for(i=0; i<NLoops; i++)
+      {
+         for(j=i+1; j<NLoops; j++)
+         {
+            if(loops[i]->length == loops[j]->length)
+               PDBFitLoops(loops[i], loops[j], &(rms[1]), &(CADev[1]), 
+                           &(CBDev[1]));
+         }
+      }
+   }
+   secs[1] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+   printf("Loops:                    %d\n", NLoops);
+   printf("Pairs of the same length: %d (x%d)\n", NPairs, repeats);
+   printf("Max. difference:          %g\n", (double)MaxDiff);
+   printf("FitLoopCoor():            %.0f pairs/s\n", 
+          (double)NPairs * repeats / MAX(secs[0], 1.0e-6));
+   printf("PDB linked lists:         %.0f pairs/s\n", 
+          (double)NPairs * repeats / MAX(secs[1], 1.0e-6));
+
+   return(0);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadLoops(FILE *fp)
+   ------------------------
+   Input:   FILE *fp       clan control file
+   Returns: BOOL           Success?
+
+   Reads the structures for the LOOP commands in a clan control file
+   into gDataList. Loops which can't be read are skipped.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL ReadLoops(FILE *fp)
+{
+   char buffer[MAXBUFF],
+        filename[MAXBUFF],
+        start[MAXBUFF],
+        end[MAXBUFF];
+   BOOL CATorsions = FALSE;
+
+   while(fgets(buffer, MAXBUFF, fp))
+   {
+      TERMINATE(buffer);
+      if(!blUpstrncmp(buffer, "PSEUDOTORSIONS", 14))
+         CATorsions = TRUE;
+      else if(!blUpstrncmp(buffer, "TRUETORSIONS", 12))
+         CATorsions = FALSE;
+      else if(!blUpstrncmp(buffer, "LOOP", 4) &&
+              (sscanf(buffer+4, "%s %s %s", filename, start, end) == 3))
+         HandleLoopSpec(filename, start, end, CATorsions, FALSE);
+   }
+
+   if(gDataList == NULL)
+   {
+      fprintf(stderr,"No loops were read\n");
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL PDBFitLoops(DATALIST *loop1, DATALIST *loop2, REAL *rms, 
+                    REAL *CADev, REAL *CBDev)
+   --------------------------------------------------------------
+   Input:   DATALIST *loop1         First loop
+            DATALIST *loop2         Second loop
+   Output:  REAL     *rms           RMS between loops
+            REAL     *CADev         Max CA deviation between loops
+            REAL     *CBDev         Max CB deviation between loops
+   Returns: BOOL                    Were the PDB linked lists copied?
+
+   The comparison formerly made by TestMerge(): copies each loop from 
+   the all-atom PDB linked list and calls RmsCAPDB(), 
+   MaxCADeviationPDB() and MaxCBDeviationPDB() on the copies.
+
+   16.10.26 Original based on TestMerge()   By: ACRM
+*/
+BOOL PDBFitLoops(DATALIST *loop1, DATALIST *loop2, REAL *rms, 
+                 REAL *CADev, REAL *CBDev)
+{
+   PDB *dupe1 = NULL,
+       *dupe2 = NULL,
+       *p, *end;
+
+   if((p=blFindResidueSpec(loop1->allatompdb,loop1->start))!=NULL)
+   {
+      if((dupe1 = blDupePDB(p))!=NULL)
+      {
+         if((end = blTermPDB(dupe1, loop1->length + 1))!=NULL)
+            FREELIST(end,PDB);
+      }
+   }
+   if((p=blFindResidueSpec(loop2->allatompdb,loop2->start))!=NULL)
+   {
+      if((dupe2 = blDupePDB(p))!=NULL)
+      {
+         if((end = blTermPDB(dupe2, loop2->length + 1))!=NULL)
+            FREELIST(end,PDB);
+      }
+   }
+
+   if(dupe1==NULL || dupe2==NULL)
+   {
+      if(dupe1!=NULL) FREELIST(dupe1, PDB);
+      if(dupe2!=NULL) FREELIST(dupe2, PDB);
+      *rms = *CADev = *CBDev = (REAL)9999.0;
+      return(FALSE);
+   }
+
+   *rms   = RmsCAPDB(dupe1, dupe2, loop1->length);
+   *CADev = MaxCADeviationPDB(dupe1, dupe2, loop1->length);
+   *CBDev = MaxCBDeviationPDB(dupe1, dupe2, loop1->length);
+
+   FREELIST(dupe1, PDB);
+   FREELIST(dupe2, PDB);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+   Prints a usage message
+
+   16.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nbenchfit V1.0 (c) 2026 Dr. Andrew C.R. Martin\n");
+   fprintf(stderr,"Usage: benchfit [-r repeats] clanfile\n");
+   fprintf(stderr,"       -r  Number of times to repeat the timings \
+[1]\n\n");
+   fprintf(stderr,"Compares every pair of loops of the same length in \
+a clan control file\n");
+   fprintf(stderr,"using the fitting done by post-clustering and using \
+the PDB linked list\n");
+   fprintf(stderr,"fitting routines and reports the pairs per \
+second.\n\n");
+}
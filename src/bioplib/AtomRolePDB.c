@@ -0,0 +1,164 @@
+/************************************************************************/
+/**
+
+   \file       AtomRolePDB.c
+
+   \version    V1.0
+   \date       16.10.26
+   \brief      Integer residue type and atom role codes for PDB atoms
+
+   \copyright  (c) UCL / Dr. Andrew C. R. Martin 2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+
+   blAtomRole() classifies an atom name as one of the backbone atoms, 
+   CB, another side chain atom or a hydrogen. blSetAtomCodesPDB() sets
+   the restype and atomrole fields of each atom in a linked list so 
+   code that needs to know these can make an integer test rather than
+   comparing names. blDoReadPDB() calls it on every list it reads.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+   pdb.h must be included before using these routines.
+
+\code
+   blSetAtomCodesPDB(pdb);
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      if((p->atomrole == ATOMROLE_CA) && (p->restype == RESTYPE_GLY))
+         ...
+   }
+\endcode
+
+**************************************************************************
+
+   Revision History:
+   =================
+-  V1.0  16.10.26 Original
+
+*************************************************************************/
+/* Doxygen
+   -------
+   #GROUP    Handling PDB Data
+   #SUBGROUP Miscellaneous functions
+   #FUNCTION  blAtomRole()
+   Gets the atom role code for an atom name
+
+   #FUNCTION  blSetAtomCodesPDB()
+   Sets the residue type and atom role codes for a PDB linked list
+*/
+/************************************************************************/
+/* Includes
+*/
+#include <string.h>
+
+#include "SysDefs.h"
+#include "macros.h"
+#include "pdb.h"
+
+/************************************************************************/
+/* Defines
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+
+/************************************************************************/
+/* Variables global to this file only
+*/
+static char *sRoleName[] = {"N   ", "CA  ", "C   ", "O   ",
+                            "OXT ", "O1  ", "O2  ", "H   ",
+                            "CB  ", NULL};
+static int  sRoleCode[]  = {ATOMROLE_N,   ATOMROLE_CA,  ATOMROLE_C,
+                            ATOMROLE_O,   ATOMROLE_OXT, ATOMROLE_OXT,
+                            ATOMROLE_OXT, ATOMROLE_H,   ATOMROLE_CB};
+
+
+/************************************************************************/
+/*>int blAtomRole(char *atnam)
+   ---------------------------
+*//**
+
+   \param[in]     *atnam     Atom name (left justified, as in the PDB
+                             structure)
+   \return                   Atom role code (ATOMROLE_XXX)
+
+   Works out the role of an atom from its name: one of the backbone 
+   atoms (including the backbone amide H and C-terminal oxygens), CB,
+   another heavy atom or another hydrogen. Any name starting with H 
+   is taken as a hydrogen.
+
+-  16.10.26 Original   By: ACRM
+*/
+int blAtomRole(char *atnam)
+{
+   int i;
+
+   for(i=0; sRoleName[i]!=NULL; i++)
+   {
+      if(!strncmp(atnam, sRoleName[i], 4))
+         return(sRoleCode[i]);
+   }
+
+   if(atnam[0] == 'H')
+      return(ATOMROLE_HYDROGEN);
+   return(ATOMROLE_SIDECHAIN);
+}
+
+
+/************************************************************************/
+/*>void blSetAtomCodesPDB(PDB *pdb)
+   --------------------------------
+*//**
+
+   \param[in,out] *pdb       PDB linked list
+
+   Sets the restype and atomrole fields of every atom in a linked list.
+   The residue name is looked up only when it changes.
+
+-  16.10.26 Original   By: ACRM
+*/
+void blSetAtomCodesPDB(PDB *pdb)
+{
+   PDB *p,
+       *prev = NULL;
+
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      if((prev != NULL) && !strncmp(p->resnam, prev->resnam, 3))
+         p->restype = prev->restype;
+      else
+         p->restype = blResTypeCode(p->resnam);
+      p->atomrole = blAtomRole(p->atnam);
+      prev = p;
+   }
+}
@@ -0,0 +1,390 @@
+/************************************************************************/
+/**
+
+   \file       CellListPDB.c
+
+   \version    V1.1
+   \date       16.10.26
+   \brief      Uniform grid (cell list) for finding atoms near others
+
+   \copyright  (c) UCL / Dr. Andrew C. R. Martin 2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+
+   blBuildCellListPDB() sorts the atoms of a PDB linked list into the
+   cubic cells of a uniform grid covering the structure.
+   blFindCellNeighboursPDB() then finds all the atoms within a given
+   distance of a set of atoms by looking only in the cells around each
+   of them, so the work depends on the number of atoms nearby rather
+   than on the size of the structure. The grid is built once and may be
+   queried any number of times.
+
+   Atoms with NULL coordinates (9999.0) are not placed in the grid and
+   are never found.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+   pdb.h must be included before using these routines.
+
+\code
+   CELLLIST *cells;
+   int      *found,
+            nfound, i;
+
+   cells  = blBuildCellListPDB(pdb, 4.0);
+   found  = (int *)malloc(cells->natom * sizeof(int));
+   nfound = blFindCellNeighboursPDB(cells, res, nextres, 4.0, TRUE,
+                                    found);
+   for(i=0; i<nfound; i++)
+      blWritePDBRecord(stdout, cells->atom[found[i]]);
+   blFreeCellListPDB(cells);
+\endcode
+
+**************************************************************************
+
+   Revision History:
+   =================
+-  V1.0  16.10.26 Original
+-  V1.1  16.10.26 Tests the atom role code to skip backbone atoms
+
+*************************************************************************/
+/* Doxygen
+   -------
+   #GROUP    Handling PDB Data
+   #SUBGROUP Calculations
+   #FUNCTION  blBuildCellListPDB()
+   Sorts the atoms of a PDB linked list into the cells of a uniform grid
+
+   #FUNCTION  blFindCellNeighboursPDB()
+   Finds the atoms within a distance of any of a range of atoms using a
+   cell list
+
+   #FUNCTION  blFreeCellListPDB()
+   Frees a cell list
+*/
+/************************************************************************/
+/* Includes
+*/
+#include <math.h>
+#include <stdlib.h>
+
+#include "MathType.h"
+#include "SysDefs.h"
+#include "pdb.h"
+#include "macros.h"
+
+/************************************************************************/
+/* Defines
+*/
+#define MAXCELLSPERATOM 8      /* Cells are enlarged to keep the grid
+                                  from being much sparser than this    */
+#define NULLCOOR(p)     ((p)->x >= 9999.0 && (p)->y >= 9999.0 && \
+                         (p)->z >= 9999.0)
+#define BACKBONEATOM(p) ISBACKBONEROLE(ATOMROLE(p))
+
+/************************************************************************/
+/* Prototypes
+*/
+static int CellCoord(REAL x, REAL min, REAL size, int n);
+
+/************************************************************************/
+/* Variables global to this file only
+*/
+
+
+/************************************************************************/
+/*>CELLLIST *blBuildCellListPDB(PDB *pdb, REAL size)
+   -------------------------------------------------
+*//**
+
+   \param[in]     *pdb       PDB linked list
+   \param[in]     size       Edge of each cell (normally the largest
+                             distance which will be searched)
+   \return                   Cell list (NULL if unable to allocate
+                             memory)
+
+   Indexes the atoms of a PDB linked list and sorts them into the cubic
+   cells of a grid covering the structure, so the atoms near any point
+   can be found from the surrounding cells. If the grid would have many
+   more cells than atoms (e.g. for a few widely separated chains) the
+   cells are made larger.
+
+   The PDB linked list must not be changed while the cell list is in
+   use.
+
+-  16.10.26 Original   By: ACRM
+*/
+CELLLIST *blBuildCellListPDB(PDB *pdb, REAL size)
+{
+   CELLLIST *cells;
+   PDB      *p;
+   int      *cellof,
+            ncell,
+            natom,
+            i, c;
+   REAL     xmax = 0.0,
+            ymax = 0.0,
+            zmax = 0.0;
+   BOOL     first = TRUE;
+
+   if((cells = (CELLLIST *)malloc(sizeof(CELLLIST)))==NULL)
+      return(NULL);
+   cells->cellatom  = NULL;
+   cells->cellstart = NULL;
+   cells->stamp     = NULL;
+   cells->query     = 0;
+   cells->xmin      = cells->ymin = cells->zmin = 0.0;
+
+   if((cells->atom = blIndexPDB(pdb, &natom))==NULL)
+   {
+      free(cells);
+      return(NULL);
+   }
+   cells->natom = natom;
+
+   /* Find the bounds of the atoms                                      */
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      if(NULLCOOR(p))
+         continue;
+      if(first)
+      {
+         cells->xmin = xmax = p->x;
+         cells->ymin = ymax = p->y;
+         cells->zmin = zmax = p->z;
+         first = FALSE;
+      }
+      cells->xmin = MIN(cells->xmin, p->x);
+      cells->ymin = MIN(cells->ymin, p->y);
+      cells->zmin = MIN(cells->zmin, p->z);
+      xmax        = MAX(xmax, p->x);
+      ymax        = MAX(ymax, p->y);
+      zmax        = MAX(zmax, p->z);
+   }
+
+   /* Size the grid, making the cells larger if it would be sparse      */
+   if(size <= (REAL)0.0)
+      size = (REAL)1.0;
+   for(;;)
+   {
+      cells->nx = (int)((xmax - cells->xmin) / size) + 1;
+      cells->ny = (int)((ymax - cells->ymin) / size) + 1;
+      cells->nz = (int)((zmax - cells->zmin) / size) + 1;
+      if((double)cells->nx * (double)cells->ny * (double)cells->nz <=
+         (double)MAXCELLSPERATOM * (double)(natom + 1))
+         break;
+      size *= (REAL)2.0;
+   }
+   cells->size = size;
+   ncell       = cells->nx * cells->ny * cells->nz;
+
+   cells->cellatom  = (int *)malloc((natom+1) * sizeof(int));
+   cells->cellstart = (int *)calloc(ncell+1, sizeof(int));
+   cells->stamp     = (int *)calloc(natom+1, sizeof(int));
+   cellof           = (int *)malloc((natom+1) * sizeof(int));
+   if((cells->cellatom == NULL) || (cells->cellstart == NULL) ||
+      (cells->stamp == NULL) || (cellof == NULL))
+   {
+      if(cellof != NULL) free(cellof);
+      blFreeCellListPDB(cells);
+      return(NULL);
+   }
+
+   /* Counting sort of the atoms by cell                                */
+   for(i=0; i<natom; i++)
+   {
+      p = cells->atom[i];
+      if(NULLCOOR(p))
+      {
+         cellof[i] = -1;
+         continue;
+      }
+      c = CellCoord(p->x, cells->xmin, size, cells->nx) +
+          cells->nx * (CellCoord(p->y, cells->ymin, size, cells->ny) +
+                       cells->ny * CellCoord(p->z, cells->zmin, size,
+                                             cells->nz));
+      cellof[i] = c;
+      cells->cellstart[c+1]++;
+   }
+   for(c=0; c<ncell; c++)
+      cells->cellstart[c+1] += cells->cellstart[c];
+   for(i=0; i<natom; i++)
+   {
+      if((c = cellof[i]) >= 0)
+         cells->cellatom[cells->cellstart[c]++] = i;
+   }
+   for(c=ncell; c>0; c--)
+      cells->cellstart[c] = cells->cellstart[c-1];
+   cells->cellstart[0] = 0;
+
+   free(cellof);
+   return(cells);
+}
+
+
+/************************************************************************/
+/*>int blFindCellNeighboursPDB(CELLLIST *cells, PDB *start, PDB *stop,
+                               REAL dist, BOOL SideChain, int *found)
+   -------------------------------------------------------------------
+*//**
+
+   \param[in]     *cells     Cell list from blBuildCellListPDB()
+   \param[in]     *start     First atom to search around
+   \param[in]     *stop      Atom after the last to search around
+   \param[in]     dist       Distance to search
+   \param[in]     SideChain  Only find side chain atoms (not N, CA, C
+                             or O)
+   \param[out]    *found     Atoms within dist of any atom from start
+                             to stop, as numbers in the PDB linked list
+                             (from 0). Must have room for cells->natom
+   \return                   Number of atoms found
+
+   Finds every atom of the cell list within dist of at least one of the
+   atoms from start up to stop. The search atoms need not come from the
+   same structure. Each atom is listed once, in no particular order;
+   cells->atom[] gives the PDB record. The search atoms themselves are
+   found if they are in the cell list.
+
+   Only cells within dist of each search atom are examined, so the
+   work is proportional to the number of atoms nearby. Uses workspace
+   in the cell list, so two searches of the same cell list may not be
+   made at the same time.
+
+-  16.10.26 Original   By: ACRM
+*/
+int blFindCellNeighboursPDB(CELLLIST *cells, PDB *start, PDB *stop,
+                            REAL dist, BOOL SideChain, int *found)
+{
+   PDB  *p, *q;
+   REAL DistSq = dist * dist;
+   int  reach  = (int)ceil(dist / cells->size),
+        nfound = 0,
+        ix, iy, iz,
+        x, y, z,
+        x0, x1, y0, y1, z0, z1,
+        c, k, a;
+
+   cells->query++;
+
+   for(p=start; p!=stop; NEXT(p))
+   {
+      if(NULLCOOR(p))
+         continue;
+
+      /* Points outside the grid are moved to its edge; the cells
+         searched still cover everything within dist
+      */
+      ix = CellCoord(p->x, cells->xmin, cells->size, cells->nx);
+      iy = CellCoord(p->y, cells->ymin, cells->size, cells->ny);
+      iz = CellCoord(p->z, cells->zmin, cells->size, cells->nz);
+      x0 = MAX(ix - reach, 0);   x1 = MIN(ix + reach, cells->nx - 1);
+      y0 = MAX(iy - reach, 0);   y1 = MIN(iy + reach, cells->ny - 1);
+      z0 = MAX(iz - reach, 0);   z1 = MIN(iz + reach, cells->nz - 1);
+
+      for(z=z0; z<=z1; z++)
+      {
+         for(y=y0; y<=y1; y++)
+         {
+            c = x0 + cells->nx * (y + cells->ny * z);
+            for(x=x0; x<=x1; x++, c++)
+            {
+               for(k=cells->cellstart[c]; k<cells->cellstart[c+1]; k++)
+               {
+                  a = cells->cellatom[k];
+                  if(cells->stamp[a] == cells->query)
+                     continue;
+                  q = cells->atom[a];
+                  if(SideChain && BACKBONEATOM(q))
+                     continue;
+                  if(DISTSQ(p,q) <= DistSq)
+                  {
+                     cells->stamp[a] = cells->query;
+                     found[nfound++] = a;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   return(nfound);
+}
+
+
+/************************************************************************/
+/*>void blFreeCellListPDB(CELLLIST *cells)
+   ---------------------------------------
+*//**
+
+   \param[in]     *cells     Cell list from blBuildCellListPDB()
+
+   Frees a cell list. The PDB linked list is not affected.
+
+-  16.10.26 Original   By: ACRM
+*/
+void blFreeCellListPDB(CELLLIST *cells)
+{
+   if(cells == NULL)
+      return;
+   if(cells->atom      != NULL) free(cells->atom);
+   if(cells->cellatom  != NULL) free(cells->cellatom);
+   if(cells->cellstart != NULL) free(cells->cellstart);
+   if(cells->stamp     != NULL) free(cells->stamp);
+   free(cells);
+}
+
+
+/************************************************************************/
+/*>static int CellCoord(REAL x, REAL min, REAL size, int n)
+   --------------------------------------------------------
+*//**
+
+   \param[in]     x          Coordinate
+   \param[in]     min        Lowest coordinate of the grid
+   \param[in]     size       Edge of a cell
+   \param[in]     n          Number of cells along this axis
+   \return                   Cell (from 0) along this axis containing x,
+                             or the nearest cell if x is outside
+
+   Finds the cell containing a coordinate along one axis of the grid.
+
+-  16.10.26 Original   By: ACRM
+*/
+static int CellCoord(REAL x, REAL min, REAL size, int n)
+{
+   REAL c = floor((x - min) / size);
+
+   if(c < (REAL)0.0)
+      return(0);
+   if(c >= (REAL)n)
+      return(n-1);
+   return((int)c);
+}
@@ -3,11 +3,11 @@
 
    \file       ReadPDB.c
    
-   \version    V3.13
-   \date       11.12.20
+   \version    V3.14
+   \date       16.10.26
    \brief      Read coordinates from a PDB file 
    
-   \copyright  (c) UCL / Dr. Andrew C. R. Martin 1988-2020
+   \copyright  (c) UCL / Dr. Andrew C. R. Martin 1988-2026
    \author     Dr. Andrew C. R. Martin
    \par
                Institute of Structural & Molecular Biology,
@@ -240,6 +240,8 @@ BUGS:  25.01.05 Note the multiple occupancy code won't work properly for
 -  V3.12 07.08.18 Increased text buffer sizes to silence gcc 7.3.1 
                   with -O2 By: ACRM
 -  V3.13 11.12.20 More checks before popen() prototype
+-  V3.14 16.10.26 blDoReadPDB() and blDoReadPDBML() set the residue type
+                  and atom role codes   By: ACRM
 
 *************************************************************************/
 /* Doxygen
@@ -731,6 +733,7 @@ PDB *blReadPDBAtomsOccRank(FILE *fp, int *natom, int OccRank)
 -  28.04.15 V3.5  Removed rewind. Call to blDoReadPDBML() returns WHOLEPDB
                   instead of PDB.  By: CTP
 -  21.07.15       Changed atomType to atomInfo   By: ACRM
+-  16.10.26 V3.14 Sets the restype and atomrole codes   By: ACRM
 
    We need to deal with freeing wpdb if we are returning null.
    Also need to deal with some sort of error code
@@ -1147,6 +1150,9 @@ WHOLEPDB *blDoReadPDB(FILE *fpin,
 
    if(cmd[0]) unlink(cmd);
 
+   /* 16.10.26 Set the integer residue type and atom role codes         */
+   blSetAtomCodesPDB(wpdb->pdb);
+
    /* Return pointer to start of linked list                            */
    return(wpdb);
 }
@@ -1651,6 +1657,7 @@ pointer\n");
             flag - fixes bug where auth_seq_id = 0.  By: CTP
 -  01.07.15 Replaced ParseHeaderPDBML() with ParseHeaderRecordsPDBML()
             By: CTP
+-  16.10.26 Sets the restype and atomrole codes   By: ACRM
 */
 WHOLEPDB *blDoReadPDBML(FILE *fpin,
                         BOOL AllAtoms,
@@ -2139,6 +2146,9 @@ WHOLEPDB *blDoReadPDBML(FILE *fpin,
    /* 25.02.15 Renumber atoms since we don't use the atom site IDs      */
    blRenumAtomsPDB(wpdb->pdb, 1);
 
+   /* 16.10.26 Set the integer residue type and atom role codes         */
+   blSetAtomCodesPDB(wpdb->pdb);
+
 
    /* Parse header data and CONECT nodes for whole pdb                  */
    if(DoWhole)
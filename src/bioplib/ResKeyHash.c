@@ -0,0 +1,360 @@
+/************************************************************************/
+/**
+
+   \file       ResKeyHash.c
+
+   \version    V1.1
+   \date       16.10.26
+   \brief      Packed residue identity keys and a hash map indexed by
+               them
+
+   \copyright  (c) UCL / Dr. Andrew C. R. Martin 2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+
+   blPackResKey() packs a single-character chain label, residue number
+   and single-character insert code into a RESKEY of two unsigned longs
+   so residue identities can be compared with two integer tests.
+
+   A RESKEYHASH maps RESKEYs to non-negative integers (normally indexes
+   into the caller's arrays) using open addressing with linear probing.
+   It grows as needed, so lookups and insertions take constant time on
+   average and matching the residues of two lists takes time linear in
+   their length.
+
+   Slots are found with 32-bit arithmetic and keys are compared in full,
+   so the code does not depend on the size of a long.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+   pdb.h must be included before using these routines.
+
+\code
+   RESKEYHASH *hash;
+
+   hash = blCreateResKeyHash(nres);
+   for(i=0; i<nres; i++)
+      blSetResKeyHash(hash, blPackResKey(chain[i], resnum[i], insert[i]),
+                      i);
+   i = blGetResKeyHash(hash, blPackResKey('L', 48, ' '));
+   blFreeResKeyHash(hash);
+\endcode
+
+**************************************************************************
+
+   Revision History:
+   =================
+-  V1.0  16.10.26 Original
+-  V1.1  16.10.26 RESKEY is a structure of two unsigned longs rather
+                  than one 64-bit long. Slots use 32-bit Fibonacci
+                  hashing
+
+*************************************************************************/
+/* Doxygen
+   -------
+   #GROUP    Handling PDB Data
+   #SUBGROUP Miscellaneous functions
+   #FUNCTION  blPackResKey()
+   Packs a chain label, residue number and insert code into a RESKEY
+
+   #FUNCTION  blCreateResKeyHash()
+   Creates an empty hash map indexed by RESKEYs
+
+   #FUNCTION  blSetResKeyHash()
+   Sets the value for a RESKEY in a hash map
+
+   #FUNCTION  blGetResKeyHash()
+   Gets the value for a RESKEY from a hash map
+
+   #FUNCTION  blFreeResKeyHash()
+   Frees a RESKEY hash map
+*/
+/************************************************************************/
+/* Includes
+*/
+#include <stdlib.h>
+
+#include "SysDefs.h"
+#include "pdb.h"
+
+/************************************************************************/
+/* Defines
+*/
+#define MINHASHSIZE 16
+
+#define MASK32      0xFFFFFFFFUL
+
+/* Fibonacci hashing - 2^32 divided by the golden ratio. The arithmetic
+   is masked to 32 bits so the slot is the same whatever the size of a
+   long
+*/
+#define HASHSLOT(hash, key) \
+   ((int)((((((key).resnum + ((key).label << 16)) & MASK32) * \
+            0x9E3779B9UL) & MASK32) >> (32 - (hash)->bits)))
+
+#define KEYSEQUAL(a, b) \
+   (((a).resnum == (b).resnum) && ((a).label == (b).label))
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL GrowResKeyHash(RESKEYHASH *hash);
+
+/************************************************************************/
+/* Variables global to this file only
+*/
+
+
+/************************************************************************/
+/*>RESKEY blPackResKey(char chain, int resnum, char insert)
+   -------------------------------------------------------
+*//**
+
+   \param[in]     chain      Chain label
+   \param[in]     resnum     Residue number
+   \param[in]     insert     Insert code
+   \return                   Packed key
+
+   Packs a residue identity into a key: the residue number in one 
+   unsigned long and the chain (bits 8-15) and insert code (bits 0-7) 
+   in the other. Keys are equal only if all three parts are equal.
+
+-  16.10.26 Original   By: ACRM
+-  16.10.26 Packs into a RESKEY structure
+*/
+RESKEY blPackResKey(char chain, int resnum, char insert)
+{
+   RESKEY key;
+
+   key.resnum = (unsigned long)resnum;
+   key.label  = ((unsigned long)(unsigned char)chain << 8) |
+                (unsigned long)(unsigned char)insert;
+   return(key);
+}
+
+
+/************************************************************************/
+/*>RESKEYHASH *blCreateResKeyHash(int nexpected)
+   ---------------------------------------------
+*//**
+
+   \param[in]     nexpected  Expected number of keys (the map grows if
+                             more are added)
+   \return                   Empty hash map (NULL if unable to allocate
+                             memory)
+
+   Creates a hash map with room for at least nexpected keys before it
+   needs to grow.
+
+-  16.10.26 Original   By: ACRM
+*/
+RESKEYHASH *blCreateResKeyHash(int nexpected)
+{
+   RESKEYHASH *hash;
+   int        i;
+
+   if((hash = (RESKEYHASH *)malloc(sizeof(RESKEYHASH)))==NULL)
+      return(NULL);
+
+   /* Keep the table no more than half full                             */
+   hash->bits = 4;
+   hash->size = MINHASHSIZE;
+   while(hash->size < 2 * nexpected)
+   {
+      hash->bits++;
+      hash->size *= 2;
+   }
+   hash->nkeys = 0;
+
+   hash->key   = (RESKEY *)malloc(hash->size * sizeof(RESKEY));
+   hash->value = (int *)malloc(hash->size * sizeof(int));
+   if((hash->key == NULL) || (hash->value == NULL))
+   {
+      blFreeResKeyHash(hash);
+      return(NULL);
+   }
+   for(i=0; i<hash->size; i++)
+      hash->value[i] = (-1);
+
+   return(hash);
+}
+
+
+/************************************************************************/
+/*>BOOL blSetResKeyHash(RESKEYHASH *hash, RESKEY key, int value)
+   -------------------------------------------------------------
+*//**
+
+   \param[in,out] *hash      Hash map
+   \param[in]     key        Residue key from blPackResKey()
+   \param[in]     value      Value to store (must be >= 0)
+   \return                   Success? (FALSE if value is negative or
+                             memory could not be allocated to grow the
+                             map)
+
+   Stores a value for a key, replacing any value already stored.
+
+-  16.10.26 Original   By: ACRM
+-  16.10.26 Compares all fields of the key
+*/
+BOOL blSetResKeyHash(RESKEYHASH *hash, RESKEY key, int value)
+{
+   int slot;
+
+   if(value < 0)
+      return(FALSE);
+
+   if(2 * (hash->nkeys + 1) > hash->size)
+   {
+      if(!GrowResKeyHash(hash))
+         return(FALSE);
+   }
+
+   for(slot=HASHSLOT(hash, key);
+       hash->value[slot] >= 0;
+       slot=(slot+1) & (hash->size-1))
+   {
+      if(KEYSEQUAL(hash->key[slot], key))
+      {
+         hash->value[slot] = value;
+         return(TRUE);
+      }
+   }
+
+   hash->key[slot]   = key;
+   hash->value[slot] = value;
+   hash->nkeys++;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>int blGetResKeyHash(RESKEYHASH *hash, RESKEY key)
+   -------------------------------------------------
+*//**
+
+   \param[in]     *hash      Hash map
+   \param[in]     key        Residue key from blPackResKey()
+   \return                   Value stored for key (-1 if none)
+
+   Looks up the value stored for a key.
+
+-  16.10.26 Original   By: ACRM
+-  16.10.26 Compares all fields of the key
+*/
+int blGetResKeyHash(RESKEYHASH *hash, RESKEY key)
+{
+   int slot;
+
+   for(slot=HASHSLOT(hash, key);
+       hash->value[slot] >= 0;
+       slot=(slot+1) & (hash->size-1))
+   {
+      if(KEYSEQUAL(hash->key[slot], key))
+         return(hash->value[slot]);
+   }
+
+   return(-1);
+}
+
+
+/************************************************************************/
+/*>void blFreeResKeyHash(RESKEYHASH *hash)
+   ---------------------------------------
+*//**
+
+   \param[in]     *hash      Hash map
+
+   Frees a hash map.
+
+-  16.10.26 Original   By: ACRM
+*/
+void blFreeResKeyHash(RESKEYHASH *hash)
+{
+   if(hash == NULL)
+      return;
+   if(hash->key   != NULL) free(hash->key);
+   if(hash->value != NULL) free(hash->value);
+   free(hash);
+}
+
+
+/************************************************************************/
+/*>static BOOL GrowResKeyHash(RESKEYHASH *hash)
+   --------------------------------------------
+*//**
+
+   \param[in,out] *hash      Hash map
+   \return                   Success of memory allocation
+
+   Doubles the size of a hash map and reinserts the keys. The map is
+   unchanged if memory cannot be allocated.
+
+-  16.10.26 Original   By: ACRM
+*/
+static BOOL GrowResKeyHash(RESKEYHASH *hash)
+{
+   RESKEY *OldKey   = hash->key;
+   int    *OldValue = hash->value,
+          OldSize   = hash->size,
+          i, slot;
+
+   hash->key   = (RESKEY *)malloc(2 * OldSize * sizeof(RESKEY));
+   hash->value = (int *)malloc(2 * OldSize * sizeof(int));
+   if((hash->key == NULL) || (hash->value == NULL))
+   {
+      if(hash->key   != NULL) free(hash->key);
+      if(hash->value != NULL) free(hash->value);
+      hash->key   = OldKey;
+      hash->value = OldValue;
+      return(FALSE);
+   }
+
+   hash->size *= 2;
+   hash->bits++;
+   for(i=0; i<hash->size; i++)
+      hash->value[i] = (-1);
+
+   for(i=0; i<OldSize; i++)
+   {
+      if(OldValue[i] < 0)
+         continue;
+      for(slot=HASHSLOT(hash, OldKey[i]);
+          hash->value[slot] >= 0;
+          slot=(slot+1) & (hash->size-1));
+      hash->key[slot]   = OldKey[i];
+      hash->value[slot] = OldValue[i];
+   }
+
+   free(OldKey);
+   free(OldValue);
+   return(TRUE);
+}
@@ -0,0 +1,433 @@
+/************************************************************************/
+/**
+
+   \file       ResTablePDB.c
+
+   \version    V1.1
+   \date       16.10.26
+   \brief      Residue table with atom ranges and bounding spheres
+
+   \copyright  (c) UCL / Dr. Andrew C. R. Martin 2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+
+   blBuildResTablePDB() walks a PDB linked list once and records, for
+   each residue, the range of its atoms in an atom index together with
+   spheres enclosing all its atoms and just its side chain atoms (those
+   other than N, CA, C and O). Residue-pair contact tests can then
+   reject most pairs with a single distance test on the spheres rather
+   than finding the residue boundaries with blFindNextResidue() and
+   testing every pair of atoms.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+   pdb.h must be included before using these routines.
+
+\code
+   RESTABLE *table;
+   int      i, j;
+
+   table = blBuildResTablePDB(pdb);
+   i = blFindResTableResidue(table, "L", 48, " ");
+   j = blFindResTableResidue(table, "H", 100, "A");
+   if((i >= 0) && (j >= 0) &&
+      blResTableContact(table, i, j, 5.0, TRUE, TRUE))
+      printf("Side chains are in contact\n");
+   blFreeResTablePDB(table);
+\endcode
+
+**************************************************************************
+
+   Revision History:
+   =================
+-  V1.0  16.10.26 Original
+-  V1.1  16.10.26 Tests the atom role code to skip backbone atoms
+
+*************************************************************************/
+/* Doxygen
+   -------
+   #GROUP    Handling PDB Data
+   #SUBGROUP Calculations
+   #FUNCTION  blBuildResTablePDB()
+   Builds a table of residue atom ranges and bounding spheres
+
+   #FUNCTION  blFindResTableResidue()
+   Finds a residue in a residue table from its chain, number and insert
+
+   #FUNCTION  blResTableMayContact()
+   Tests whether the bounding spheres of two residues allow a contact
+
+   #FUNCTION  blResTableContact()
+   Tests whether two residues make a contact
+
+   #FUNCTION  blFreeResTablePDB()
+   Frees a residue table
+*/
+/************************************************************************/
+/* Includes
+*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MathType.h"
+#include "SysDefs.h"
+#include "pdb.h"
+#include "macros.h"
+
+/************************************************************************/
+/* Defines
+*/
+#define BACKBONEATOM(p) ISBACKBONEROLE(ATOMROLE(p))
+
+/************************************************************************/
+/* Prototypes
+*/
+static void BoundingSphere(PDB **atom, int first, int last,
+                           BOOL SideChain, REAL *x, REAL *y, REAL *z,
+                           REAL *radius);
+
+/************************************************************************/
+/* Variables global to this file only
+*/
+
+
+/************************************************************************/
+/*>RESTABLE *blBuildResTablePDB(PDB *pdb)
+   --------------------------------------
+*//**
+
+   \param[in]     *pdb       PDB linked list
+   \return                   Residue table (NULL if unable to allocate
+                             memory)
+
+   Indexes the atoms of a PDB linked list and records the atom range of
+   each residue (as defined by blFindNextResidue()) with the centre and
+   radius of a sphere enclosing all its atoms and of one enclosing its
+   side chain atoms. Residues with no side chain atoms have a side chain
+   radius of -1.
+
+   The spheres are centred on the mean position of the atoms, so they
+   are not the smallest possible but are quick to find and never miss
+   an atom.
+
+   The PDB linked list must not be changed while the table is in use.
+
+-  16.10.26 Original   By: ACRM
+*/
+RESTABLE *blBuildResTablePDB(PDB *pdb)
+{
+   RESTABLE *table;
+   RESENTRY *res;
+   PDB      *p, *next;
+   int      natom, nres, i;
+
+   if((table = (RESTABLE *)malloc(sizeof(RESTABLE)))==NULL)
+      return(NULL);
+   table->res = NULL;
+
+   if((table->atom = blIndexPDB(pdb, &natom))==NULL)
+   {
+      free(table);
+      return(NULL);
+   }
+   table->natom = natom;
+
+   /* Count the residues                                                */
+   for(p=pdb, nres=0; p!=NULL; p=blFindNextResidue(p))
+      nres++;
+   table->nres = nres;
+
+   if((table->res = (RESENTRY *)malloc((nres+1) * sizeof(RESENTRY)))
+      ==NULL)
+   {
+      blFreeResTablePDB(table);
+      return(NULL);
+   }
+
+   /* Record the atom range and bounding spheres of each residue        */
+   for(p=pdb, i=0, nres=0; p!=NULL; p=next, nres++)
+   {
+      next       = blFindNextResidue(p);
+      res        = table->res + nres;
+      res->start = p;
+      res->stop  = next;
+      res->first = i;
+      while(p!=next)
+      {
+         i++;
+         NEXT(p);
+      }
+      res->last  = i - 1;
+
+      BoundingSphere(table->atom, res->first, res->last, FALSE,
+                     &(res->x), &(res->y), &(res->z), &(res->radius));
+      BoundingSphere(table->atom, res->first, res->last, TRUE,
+                     &(res->scx), &(res->scy), &(res->scz),
+                     &(res->scradius));
+   }
+
+   return(table);
+}
+
+
+/************************************************************************/
+/*>int blFindResTableResidue(RESTABLE *table, char *chain, int resnum,
+                             char *insert)
+   -------------------------------------------------------------------
+*//**
+
+   \param[in]     *table     Residue table from blBuildResTablePDB()
+   \param[in]     *chain     Chain label
+   \param[in]     resnum     Residue number
+   \param[in]     *insert    Insert code
+   \return                   Number of the residue in the table (from
+                             0) or -1 if not found
+
+   Finds a residue in the table. Only the first atom of each residue is
+   examined, so this is several times quicker than blFindResidue() on
+   the PDB linked list.
+
+-  16.10.26 Original   By: ACRM
+*/
+int blFindResTableResidue(RESTABLE *table, char *chain, int resnum,
+                          char *insert)
+{
+   PDB *p;
+   int i;
+
+   for(i=0; i<table->nres; i++)
+   {
+      p = table->res[i].start;
+      if((p->resnum == resnum) &&
+         !strcmp(p->insert, insert) &&
+         CHAINMATCH(p->chain, chain))
+         return(i);
+   }
+
+   return(-1);
+}
+
+
+/************************************************************************/
+/*>BOOL blResTableMayContact(RESTABLE *table, int res1, int res2,
+                             REAL dist, BOOL SideChain1,
+                             BOOL SideChain2)
+   --------------------------------------------------------------
+*//**
+
+   \param[in]     *table     Residue table from blBuildResTablePDB()
+   \param[in]     res1       First residue number in the table
+   \param[in]     res2       Second residue number in the table
+   \param[in]     dist       Contact distance
+   \param[in]     SideChain1 Only consider side chain atoms of res1
+   \param[in]     SideChain2 Only consider side chain atoms of res2
+   \return                   Could any atoms be within dist?
+
+   Tests the bounding spheres of two residues. If this returns FALSE,
+   no atom of one residue is within dist of any atom of the other; if
+   TRUE, they may be.
+
+-  16.10.26 Original   By: ACRM
+*/
+BOOL blResTableMayContact(RESTABLE *table, int res1, int res2,
+                          REAL dist, BOOL SideChain1, BOOL SideChain2)
+{
+   RESENTRY *r1 = table->res + res1,
+            *r2 = table->res + res2;
+   REAL     x1, y1, z1, rad1,
+            x2, y2, z2, rad2,
+            reach;
+
+   if(SideChain1)
+   {
+      x1 = r1->scx;  y1 = r1->scy;  z1 = r1->scz;  rad1 = r1->scradius;
+   }
+   else
+   {
+      x1 = r1->x;    y1 = r1->y;    z1 = r1->z;    rad1 = r1->radius;
+   }
+   if(SideChain2)
+   {
+      x2 = r2->scx;  y2 = r2->scy;  z2 = r2->scz;  rad2 = r2->scradius;
+   }
+   else
+   {
+      x2 = r2->x;    y2 = r2->y;    z2 = r2->z;    rad2 = r2->radius;
+   }
+
+   /* No atoms to make the contact                                      */
+   if((rad1 < (REAL)0.0) || (rad2 < (REAL)0.0))
+      return(FALSE);
+
+   reach = rad1 + rad2 + dist;
+   return(((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2) + (z1-z2)*(z1-z2)) <=
+          reach * reach);
+}
+
+
+/************************************************************************/
+/*>BOOL blResTableContact(RESTABLE *table, int res1, int res2,
+                          REAL dist, BOOL SideChain1, BOOL SideChain2)
+   -------------------------------------------------------------------
+*//**
+
+   \param[in]     *table     Residue table from blBuildResTablePDB()
+   \param[in]     res1       First residue number in the table
+   \param[in]     res2       Second residue number in the table
+   \param[in]     dist       Contact distance
+   \param[in]     SideChain1 Only consider side chain atoms of res1
+   \param[in]     SideChain2 Only consider side chain atoms of res2
+   \return                   Is any atom of res1 within dist of an atom
+                             of res2?
+
+   Determines whether two residues make a contact of <= dist Angstroms,
+   optionally considering only side chain atoms (other than N, CA, C
+   and O) of either. Pairs whose bounding spheres are too far apart are
+   rejected without looking at the atoms.
+
+-  16.10.26 Original   By: ACRM
+*/
+BOOL blResTableContact(RESTABLE *table, int res1, int res2, REAL dist,
+                       BOOL SideChain1, BOOL SideChain2)
+{
+   PDB  *p, *q;
+   REAL DistSq = dist * dist;
+   int  i, j;
+
+   if(!blResTableMayContact(table, res1, res2, dist, SideChain1,
+                            SideChain2))
+      return(FALSE);
+
+   for(i=table->res[res1].first; i<=table->res[res1].last; i++)
+   {
+      p = table->atom[i];
+      if(SideChain1 && BACKBONEATOM(p))
+         continue;
+      for(j=table->res[res2].first; j<=table->res[res2].last; j++)
+      {
+         q = table->atom[j];
+         if(SideChain2 && BACKBONEATOM(q))
+            continue;
+         if(DISTSQ(p,q) <= DistSq)
+            return(TRUE);
+      }
+   }
+
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>void blFreeResTablePDB(RESTABLE *table)
+   ---------------------------------------
+*//**
+
+   \param[in]     *table     Residue table from blBuildResTablePDB()
+
+   Frees a residue table. The PDB linked list is not affected.
+
+-  16.10.26 Original   By: ACRM
+*/
+void blFreeResTablePDB(RESTABLE *table)
+{
+   if(table == NULL)
+      return;
+   if(table->atom != NULL) free(table->atom);
+   if(table->res  != NULL) free(table->res);
+   free(table);
+}
+
+
+/************************************************************************/
+/*>static void BoundingSphere(PDB **atom, int first, int last,
+                              BOOL SideChain, REAL *x, REAL *y, REAL *z,
+                              REAL *radius)
+   ----------------------------------------------------------------------
+*//**
+
+   \param[in]     **atom     Atom index
+   \param[in]     first      First atom of the residue
+   \param[in]     last       Last atom of the residue
+   \param[in]     SideChain  Only include side chain atoms
+   \param[out]    *x         Centre of the sphere
+   \param[out]    *y         Centre of the sphere
+   \param[out]    *z         Centre of the sphere
+   \param[out]    *radius    Radius of the sphere (-1 if no atoms)
+
+   Finds a sphere centred on the mean position of a range of atoms which
+   encloses all of them.
+
+-  16.10.26 Original   By: ACRM
+*/
+static void BoundingSphere(PDB **atom, int first, int last,
+                           BOOL SideChain, REAL *x, REAL *y, REAL *z,
+                           REAL *radius)
+{
+   PDB  *p;
+   REAL d;
+   int  i,
+        n = 0;
+
+   *x = *y = *z = (REAL)0.0;
+   *radius = (REAL)(-1.0);
+
+   for(i=first; i<=last; i++)
+   {
+      p = atom[i];
+      if(SideChain && BACKBONEATOM(p))
+         continue;
+      *x += p->x;
+      *y += p->y;
+      *z += p->z;
+      n++;
+   }
+   if(n == 0)
+      return;
+
+   *x /= n;
+   *y /= n;
+   *z /= n;
+   *radius = (REAL)0.0;
+   for(i=first; i<=last; i++)
+   {
+      p = atom[i];
+      if(SideChain && BACKBONEATOM(p))
+         continue;
+      d = (p->x - *x) * (p->x - *x) +
+          (p->y - *y) * (p->y - *y) +
+          (p->z - *z) * (p->z - *z);
+      *radius = MAX(*radius, d);
+   }
+
+   /* Allow for rounding in later distance tests                        */
+   *radius = (REAL)sqrt(*radius) * (REAL)1.0001 + (REAL)0.0001;
+}
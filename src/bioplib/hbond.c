@@ -4,8 +4,8 @@
 
    \file       hbond.c
    
-   \version    V1.9
-   \date       14.08.18
+   \version    V1.11
+   \date       16.10.26
    \brief      Report whether two residues are H-bonded using
                Baker & Hubbard criteria
    
@@ -46,7 +46,8 @@
    NOTE, explicit hydrogens must be added to the PDB linked list before
    calling this routine.
 
-   The only external entry points are blIsHBonded() and blValidHBond()
+   The only external entry points are blIsHBonded(), 
+   blIsHBondedResTable() and blValidHBond()
 
 **************************************************************************
 
@@ -68,6 +69,9 @@
 -  V1.9  14.08.18 Fixed blListAllHBonds() such that it correctly returns
                   a list of HBonds rather than just the first one it
                   finds.
+-  V1.10 16.10.26 Added blIsHBondedResTable()
+-  V1.11 16.10.26 Donor and acceptor atoms found from the atom role and
+                  residue type codes rather than by name
 
 *************************************************************************/
 /* Doxygen
@@ -77,6 +81,9 @@
    #FUNCTION  blIsHBonded()
    Determines whether 2 residues are H-bonded
 
+   #FUNCTION  blIsHBondedResTable()
+   Determines whether 2 residues in a residue table are H-bonded
+
    #FUNCTION  blValidHBond()
    Determines whether a set of atoms form a valid H-bond
 
@@ -294,6 +301,36 @@ int blIsHBonded(PDB *res1, PDB *res2, int type)
 }
 
 
+/************************************************************************/
+/*>int blIsHBondedResTable(RESTABLE *table, int res1, int res2, int type)
+   ----------------------------------------------------------------------
+*//**
+
+   \param[in]     *table    Residue table from blBuildResTablePDB()
+   \param[in]     res1      First residue number in the table
+   \param[in]     res2      Second residue number in the table
+   \param[in]     type      HBond type to search for
+   \return                  HBond type found or 0 if none
+
+   As blIsHBonded(), but first uses the bounding spheres in a residue 
+   table to reject residues which are too far apart for any donor or
+   hydrogen to reach an acceptor, without searching their atoms.
+
+-  16.10.26 Original    By: ACRM
+*/
+int blIsHBondedResTable(RESTABLE *table, int res1, int res2, int type)
+{
+   REAL reach = (REAL)sqrt((double)sDADistSq);
+
+   reach = MAX(reach, (REAL)HADIST);
+   if(!blResTableMayContact(table, res1, res2, reach, FALSE, FALSE))
+      return(0);
+   
+   return(blIsHBonded(table->res[res1].start, table->res[res2].start,
+                      type));
+}
+
+
 /************************************************************************/
 /*>BOOL blValidHBond(PDB *AtomH, PDB *AtomD, PDB *AtomA, PDB *AtomP)
    -----------------------------------------------------------------
@@ -390,11 +427,13 @@ BOOL blValidHBond(PDB *AtomH, PDB *AtomD, PDB *AtomA, PDB *AtomP)
 
 -  25.01.96 Original    By: ACRM
 -  07.07.14 Use bl prefix for functions By: CTP
+-  16.10.26 Uses the atom role and residue type codes   By: ACRM
 */
 static BOOL FindBackboneAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
 {
    PDB *p,
        *NextRes;
+   int role;
 
    if(res == NULL)
    {
@@ -407,12 +446,10 @@ static BOOL FindBackboneAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
    NextRes = blFindNextResidue(res);
    for(p=res; p!=NextRes; NEXT(p))
    {
-      if(!strncmp(p->atnam,"O   ",4) ||
-         !strncmp(p->atnam,"OXT ",4) ||
-         !strncmp(p->atnam,"O1  ",4) ||
-         !strncmp(p->atnam,"O2  ",4))
+      role = ATOMROLE(p);
+      if((role == ATOMROLE_O) || (role == ATOMROLE_OXT))
          *AtomA = p;
-      if(!strncmp(p->atnam,"C   ",4))
+      if(role == ATOMROLE_C)
          *AtomP = p;
    }
 
@@ -438,13 +475,15 @@ static BOOL FindBackboneAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
 -  25.01.96 Original    By: ACRM
 -  03.01.06 Returns FALSE if this is a proline
 -  07.07.14 Use bl prefix for functions By: CTP
+-  16.10.26 Uses the atom role and residue type codes   By: ACRM
 */
 static BOOL FindBackboneDonor(PDB *res, PDB **AtomH, PDB **AtomD)
 {
    PDB *p,
        *NextRes;
+   int role;
 
-   if((res == NULL) || (!strncmp(res->resnam, "PRO", 3)))
+   if((res == NULL) || (RESTYPE(res) == RESTYPE_PRO))
    {
       return(FALSE);
    }
@@ -455,9 +494,10 @@ static BOOL FindBackboneDonor(PDB *res, PDB **AtomH, PDB **AtomD)
    NextRes = blFindNextResidue(res);
    for(p=res; p!=NextRes; NEXT(p))
    {
-      if(!strncmp(p->atnam,"H   ",4))
+      role = ATOMROLE(p);
+      if(role == ATOMROLE_H)
          *AtomH = p;
-      if(!strncmp(p->atnam,"N   ",4))
+      if(role == ATOMROLE_N)
          *AtomD = p;
    }
 
@@ -489,6 +529,7 @@ static BOOL FindBackboneDonor(PDB *res, PDB **AtomH, PDB **AtomD)
             the antecedent for the NE2 and ND2 atoms respectively, it
             would find OE1/OD1 rather than CD/CG. (See pprev code)
 -  07.07.14 Use bl prefix for functions By: CTP
+-  16.10.26 Uses the atom role and residue type codes   By: ACRM
 */
 static BOOL FindSidechainAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
 {
@@ -518,14 +559,12 @@ static BOOL FindSidechainAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
 
    for( ; p!=NextRes; NEXT(p))
    {
-      if((p->atnam[0] == 'O' && strncmp(p->atnam, "O   ", 4)
-                             && strncmp(p->atnam, "O1  ", 4)
-                             && strncmp(p->atnam, "O2  ", 4)
-                             && strncmp(p->atnam, "OXT ", 4)) ||
+      if((ATOMROLE(p) == ATOMROLE_SIDECHAIN) &&
+         ((p->atnam[0] == 'O') ||
 #ifdef ALLOW_AXN
-         (p->atnam[0] == 'A') ||
+          (p->atnam[0] == 'A') ||
 #endif
-         (p->atnam[0] == 'N' && strncmp(p->atnam, "N   ", 4)))
+          (p->atnam[0] == 'N')))
       {
          *AtomA = p;
          *AtomP = prev;
@@ -577,6 +616,7 @@ static BOOL FindSidechainAcceptor(PDB *res, PDB **AtomA, PDB **AtomP)
             Also fixed a bug where a lone residue occurs which appears
             to have just a hydrogen.
 -  07.07.14 Use bl prefix for functions By: CTP
+-  16.10.26 Uses the atom role and residue type codes   By: ACRM
 */
 static BOOL FindSidechainDonor(PDB *res, PDB **AtomH, PDB **AtomD)
 {
@@ -614,7 +654,7 @@ static BOOL FindSidechainDonor(PDB *res, PDB **AtomH, PDB **AtomD)
          return(TRUE);
       }
 #endif
-      if(p->atnam[0] == 'H' && strncmp(p->atnam, "H   ", 4))
+      if(ATOMROLE(p) == ATOMROLE_HYDROGEN)
       {
          *AtomH = p;
          *AtomD = prev;
@@ -623,7 +663,7 @@ static BOOL FindSidechainDonor(PDB *res, PDB **AtomH, PDB **AtomD)
             continue;
          
          /* Step over any multiple hydrogens                            */
-         while((p!=NULL) && (p!=NextRes) && (p->atnam[0] == 'H'))
+         while((p!=NULL) && (p!=NextRes) && ISHYDROGENROLE(ATOMROLE(p)))
          {
             prev = p;
             NEXT(p);
@@ -635,7 +675,7 @@ static BOOL FindSidechainDonor(PDB *res, PDB **AtomH, PDB **AtomD)
          */
          if( (*AtomD)->atnam[0] == 'O' || 
             ((*AtomD)->atnam[0] == 'N' && 
-             !strncmp((*AtomD)->resnam,"LYS",3)))
+             RESTYPE(*AtomD) == RESTYPE_LYS))
          {
             *AtomH = NULL;
          }
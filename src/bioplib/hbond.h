@@ -3,8 +3,8 @@
 
    \file       hbond.h
    
-   \version    V1.4
-   \date       20.07.15
+   \version    V1.5
+   \date       16.10.26
    \brief      Header file for hbond determining code
    
    \copyright  (c) UCL / Dr. Andrew C. R. Martin 1996-2015
@@ -53,6 +53,7 @@
 -  V1.3  14.08.14 Moved deprecated function prototypes to deprecated.h 
                   By: CTP
 -  V1.4  20.07.15 Added blListAllHBonds()  By: ACRM
+-  V1.5  16.10.26 Added blIsHBondedResTable()  By: ACRM
 
 *************************************************************************/
 #ifndef _hbond_h
@@ -87,6 +88,7 @@ typedef struct _hblist
 /* Prototypes
 */
 int  blIsHBonded(PDB *res1, PDB *res2, int type);
+int  blIsHBondedResTable(RESTABLE *table, int res1, int res2, int type);
 BOOL blValidHBond(PDB *AtomH, PDB *AtomD, PDB *AtomA, PDB *AtomP);
 int blIsMCDonorHBonded(PDB *res1, PDB *res2, int type);
 int blIsMCAcceptorHBonded(PDB *res1, PDB *res2, int type);
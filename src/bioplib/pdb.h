@@ -225,6 +225,19 @@
                   blForceExtractNotZoneSpecPDBAsCopy()
 -  V1.98 17.11.21 Added blFixSequence(), blRenumResiduesPDB(), 
                   blCreateSEQRES(), blReplacePDBHeader()
+-  V1.99 16.10.26 Added CELLLIST, blBuildCellListPDB(), 
+                  blFindCellNeighboursPDB() and blFreeCellListPDB()
+-  V2.0  16.10.26 Added RESENTRY, RESTABLE, blBuildResTablePDB(), 
+                  blFindResTableResidue(), blResTableMayContact(), 
+                  blResTableContact() and blFreeResTablePDB()
+-  V2.1  16.10.26 Added RESKEY, RESKEYHASH, blPackResKey(), 
+                  blCreateResKeyHash(), blSetResKeyHash(), 
+                  blGetResKeyHash() and blFreeResKeyHash()
+-  V2.2  16.10.26 Added restype and atomrole to PDB, RESTYPE_XXX, 
+                  ATOMROLE_XXX, RESTYPE(), ATOMROLE(), blResTypeCode(),
+                  blResTypeOne(), blAtomRole() and blSetAtomCodesPDB()
+-  V2.3  16.10.26 RESKEY is a structure so it does not need a 64-bit
+                  long
 
 
 *************************************************************************/
@@ -317,6 +330,8 @@ typedef struct pdb_entry
    int  nConect;             /* Number of conections                    */
    int  entity_id;           /* Entity ID - used in XML files           */
    int  atomtype;            /* See ATOMTYPE_XXXX                       */
+   int  restype;             /* See RESTYPE_XXX - set when read         */
+   int  atomrole;            /* See ATOMROLE_XXX - set when read        */
    char record_type[8];      /* ATOM / HETATM                  [MIN 7]  */
    char atnam[8];            /* Atom name, left justified      [MIN 6]  */
    char atnam_raw[8];        /* Atom name as it appears in the PDB file
@@ -432,6 +447,54 @@ typedef struct _biomolecule
    BIOMT               *biomt;
 }  BIOMOLECULE;
 
+typedef struct _celllist
+{
+   PDB  **atom;                /* Atoms in linked list order            */
+   int  *cellatom,             /* Atom numbers ordered by cell          */
+        *cellstart,            /* Start of each cell in cellatom[]      */
+        *stamp,                /* Last search to find each atom         */
+        natom,
+        nx, ny, nz,            /* Cells along each axis                 */
+        query;                 /* Number of the current search          */
+   REAL xmin, ymin, zmin,      /* Low corner of the grid                */
+        size;                  /* Edge of a cell                        */
+}  CELLLIST;
+
+typedef struct
+{
+   PDB  *start,                /* First atom of the residue             */
+        *stop;                 /* First atom of the next residue        */
+   int  first,                 /* Range of atoms in RESTABLE atom[]     */
+        last;
+   REAL x, y, z,               /* Sphere enclosing all atoms            */
+        radius,
+        scx, scy, scz,         /* Sphere enclosing side chain atoms     */
+        scradius;              /* (-1 if there are none)                */
+}  RESENTRY;
+
+typedef struct _restable
+{
+   PDB      **atom;            /* Atoms in linked list order            */
+   RESENTRY *res;              /* Residues in linked list order         */
+   int      natom,
+            nres;
+}  RESTABLE;
+
+typedef struct _reskey
+{
+   unsigned long resnum,       /* Residue number                        */
+                 label;        /* Chain in bits 8-15, insert in 0-7     */
+}  RESKEY;
+
+typedef struct _reskeyhash
+{
+   RESKEY *key;
+   int    *value,              /* -1 for an empty slot                  */
+          size,                /* Slots (a power of 2)                  */
+          bits,                /* log2(size)                            */
+          nkeys;
+}  RESKEYHASH;
+
 
 /* This is designed to cause an error message which prints this line
    It has been tested with gcc and Irix cc and does as required in
@@ -485,6 +548,8 @@ typedef struct
                      p->nConect = 0;                     \
                      p->atomInfo = NULL;                 \
                      p->atomtype = 0;                    \
+                     p->restype = RESTYPE_UNDEF;         \
+                     p->atomrole = ATOMROLE_UNDEF;       \
                      p->secstr = ' ';                    \
                      p->entity_id = 0;
  
@@ -610,6 +675,60 @@ typedef struct
 #define ATOMTYPE_BOUNDHET     (10 | ATOMTYPE_NONRESIDUE)
 #define ATOMTYPE_BOUNDPOLYHET (11 | ATOMTYPE_NONRESIDUE)
 
+/* Residue types. These are set by blDoReadPDB() and are positions in 
+   the blThrone() table, so further codes up to RESTYPE_UNK exist for
+   other residues it knows
+*/
+#define RESTYPE_UNDEF          0
+#define RESTYPE_ALA            1
+#define RESTYPE_CYS            2
+#define RESTYPE_ASP            3
+#define RESTYPE_GLU            4
+#define RESTYPE_PHE            5
+#define RESTYPE_GLY            6
+#define RESTYPE_HIS            7
+#define RESTYPE_ILE            8
+#define RESTYPE_LYS            9
+#define RESTYPE_LEU           10
+#define RESTYPE_MET           11
+#define RESTYPE_ASN           12
+#define RESTYPE_PRO           13
+#define RESTYPE_GLN           14
+#define RESTYPE_ARG           15
+#define RESTYPE_SER           16
+#define RESTYPE_THR           17
+#define RESTYPE_VAL           18
+#define RESTYPE_TRP           19
+#define RESTYPE_TYR           20
+#define RESTYPE_UNK           39  /* Also used for unknown names        */
+#define blMAXRESTYPE          RESTYPE_UNK
+
+/* Atom roles. These are set by blDoReadPDB() from the atom name alone,
+   so any atom whose name starts with H is a hydrogen
+*/
+#define ATOMROLE_UNDEF         0
+#define ATOMROLE_N             1
+#define ATOMROLE_CA            2
+#define ATOMROLE_C             3
+#define ATOMROLE_O             4
+#define ATOMROLE_OXT           5  /* C-terminal OXT, O1 or O2           */
+#define ATOMROLE_H             6  /* Backbone amide H                   */
+#define ATOMROLE_CB            7
+#define ATOMROLE_SIDECHAIN     8  /* Any other heavy atom               */
+#define ATOMROLE_HYDROGEN      9  /* Any other hydrogen                 */
+
+/* Get the residue type or atom role of an atom, working it out if the
+   record was not made by blDoReadPDB(). If you change resnam or atnam,
+   reset restype or atomrole to 0
+*/
+#define RESTYPE(p)  ((p)->restype ? (p)->restype :                     \
+                     ((p)->restype = blResTypeCode((p)->resnam)))
+#define ATOMROLE(p) ((p)->atomrole ? (p)->atomrole :                   \
+                     ((p)->atomrole = blAtomRole((p)->atnam)))
+#define ISBACKBONEROLE(r) (((r) >= ATOMROLE_N) && ((r) <= ATOMROLE_O))
+#define ISHYDROGENROLE(r) (((r) == ATOMROLE_H) ||                      \
+                           ((r) == ATOMROLE_HYDROGEN))
+
 
 /************************************************************************/
 /* Globals
@@ -853,6 +972,27 @@ void blRenumResiduesPDB(PDB *pdb, int offset);
 STRINGLIST *blCreateSEQRES(PDB *pdb);
 void blReplacePDBHeader(WHOLEPDB *wpdb, char *recordType,
                         STRINGLIST *replacement);
+CELLLIST *blBuildCellListPDB(PDB *pdb, REAL size);
+int blFindCellNeighboursPDB(CELLLIST *cells, PDB *start, PDB *stop,
+                            REAL dist, BOOL SideChain, int *found);
+void blFreeCellListPDB(CELLLIST *cells);
+RESTABLE *blBuildResTablePDB(PDB *pdb);
+int blFindResTableResidue(RESTABLE *table, char *chain, int resnum,
+                          char *insert);
+BOOL blResTableMayContact(RESTABLE *table, int res1, int res2,
+                          REAL dist, BOOL SideChain1, BOOL SideChain2);
+BOOL blResTableContact(RESTABLE *table, int res1, int res2, REAL dist,
+                       BOOL SideChain1, BOOL SideChain2);
+void blFreeResTablePDB(RESTABLE *table);
+RESKEY blPackResKey(char chain, int resnum, char insert);
+RESKEYHASH *blCreateResKeyHash(int nexpected);
+BOOL blSetResKeyHash(RESKEYHASH *hash, RESKEY key, int value);
+int blGetResKeyHash(RESKEYHASH *hash, RESKEY key);
+void blFreeResKeyHash(RESKEYHASH *hash);
+int blResTypeCode(char *three);
+char blResTypeOne(int restype);
+int blAtomRole(char *atnam);
+void blSetAtomCodesPDB(PDB *pdb);
 
 /************************************************************************/
 /* Include deprecated functions                                         */
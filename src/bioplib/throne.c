@@ -3,8 +3,8 @@
 
    \file       throne.c
    
-   \version    V1.9
-   \date       07.07.14
+   \version    V1.10
+   \date       16.10.26
    \brief      Convert between 1 and 3 letter aa codes
    
    \copyright  (c) UCL / Dr. Andrew C. R. Martin 1993-2014
@@ -69,6 +69,7 @@
                   table. By: CTP
                   PYL translates to O, SEC translates to U.
 -  V1.9  07.07.14 Use bl prefix for functions By: CTP
+-  V1.10 16.10.26 Added blResTypeCode() and blResTypeOne()   By: ACRM
 
 *************************************************************************/
 /* Doxygen
@@ -85,12 +86,20 @@
 
    #FUNCTION  blOnethr()
    Converts 1-letter code to 3-letter code (actually as 4 chars).
+
+   #FUNCTION  blResTypeCode()
+   Converts 3-letter code to an integer residue type code.
+
+   #FUNCTION  blResTypeOne()
+   Converts an integer residue type code to 1-letter code.
+   Handles ASX and GLX as X
 */
 /************************************************************************/
 /* Includes
 */
 #include <string.h>
 #include "SysDefs.h"
+#include "pdb.h"
 
 /************************************************************************/
 /* Defines and macros
@@ -104,6 +113,9 @@
 /* N.B. The order in sTab1[] and sTab3[] must be the same and they must
    end with X/UNK.
    Also, nucleic acids must come *after* amino acids.
+   The residue type codes used in the PDB structure are positions in
+   this table counting from 1, so the first 20 entries must match the
+   RESTYPE_XXX values in pdb.h and NUMAAKNOWN must match RESTYPE_UNK.
 */
 /* Don't forget to fix NUMAAKNOWN if adding to this table!              */
 static char sTab1[]    = {'A','C','D','E','F',
@@ -239,3 +251,52 @@ char *blOnethr(char one)
    return(sTab3[NUMAAKNOWN-1]);
 }
 
+
+/************************************************************************/
+/*>int blResTypeCode(char *three)
+   ------------------------------
+*//**
+
+   \param[in]     *three    Three letter code
+   \return                  Residue type code (RESTYPE_UNK if the code
+                            is not known)
+
+   Converts 3-letter code to the integer residue type code stored in
+   the restype field of the PDB structure. Unlike blThrone(), this does
+   not set gBioplibSeqNucleicAcid.
+
+-  16.10.26 Original    By: ACRM
+*/
+int blResTypeCode(char *three)
+{
+   int j;
+   
+   for(j=0;j<NUMAAKNOWN;j++)
+      if(!strncmp(sTab3[j],three,3)) return(j+1);
+
+   /* Only get here if the three letter code was not found              */
+   return(RESTYPE_UNK);
+}
+
+
+/************************************************************************/
+/*>char blResTypeOne(int restype)
+   ------------------------------
+*//**
+
+   \param[in]     restype   Residue type code from blResTypeCode()
+   \return                  One letter code
+
+   Converts a residue type code to 1-letter code, giving the same result
+   as blThrone() on the original 3-letter code. Handles ASX and GLX as X
+
+-  16.10.26 Original    By: ACRM
+*/
+char blResTypeOne(int restype)
+{
+   if((restype < 1) || (restype > NUMAAKNOWN))
+      return('X');
+   if(sTab3[restype-1][2] == 'X')
+      return('X');
+   return(sTab1[restype-1]);
+}
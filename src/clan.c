@@ -74,14 +74,74 @@
    V3.7  14.03.96 Cluster merging now considers CB as well
    V3.7a 30.01.09 Compile cleanups
    V3.8  16.01.23 Fixed some bugs running under Linux
+   V3.9  16.10.26 Nearest-neighbour chain agglomeration for the reducible
+                  methods. Fixed dissimilarity update which skipped the
+                  last vector
+                  Dissimilarity matrix built in cache-sized tiles by
+                  multiple threads. Added THREADS keyword and -j flag
+                  Single linkage done from a minimum spanning tree 
+                  without storing the dissimilarity matrix
+                  Added DISSIMSTORE keyword to hold the dissimilarity
+                  matrix as floats or in a memory-mapped file
+                  Cluster assignments found from the merge history
+                  rather than an NVec x NVec table
+                  Added approximate Ward method (8) which clusters
+                  micro-clusters. Added MICROCLUSTERS keyword
+                  Added UPDATE keyword to add loops to a previous run
+                  Feature data held in an aligned FEATURE matrix
+                  Added METRIC keyword for the angular metric on raw
+                  torsions
+                  Added COLLAPSE keyword to cluster duplicate vectors 
+                  once as weighted items
+                  Post-clustering fits loop coordinates stored with
+                  each loop rather than copies of the PDB linked lists
+                  Loop fitting moved to loopfit.c
+                  Post-clustering tests pairs of clusters in parallel
+                  Added METRIC RMSD to cluster same-length loops on
+                  their superposed CA coordinates
+                  Medians of all clusters found together in two 
+                  threaded passes
+                  Loops found from gLoopTable and the members of each
+                  cluster from CLUSMEMBERS lists rather than by walking
+                  the linked list
+                  Added REPRESENTATIVE keyword for exact (or sampled)
+                  medoids found in parallel
+                  Added SWEEP keyword to cut the tree and post-cluster
+                  with several settings from one clustering
+                  HierClus() made reentrant. Added BOOTSTRAP keyword for
+                  the stability of clusters over resampled loops or
+                  columns, clustered in parallel
+                  Added CHECKPOINT keyword to save the vectors, tree and
+                  loop coordinates and RESUME to map them back and
+                  redo only post-clustering and later steps
+                  Conserved residues list for critical residues is
+                  searched through a hash of packed residue keys
+                  Added STRUCTURECACHE keyword to limit the memory used
+                  by structures kept for critical residues
+                  METRIC angular expands each torsion once per tile row
+                  and column so the distance loop vectorises
+                  Post-clustering threads no longer read loops
+                  Single linkage and medoids expand raw torsions once
+                  into a copy of the data
+                  DISSIMSTORE MMAP holds the matrix in blocks and may
+                  hold floats
 
 *************************************************************************/
 /* Includes
 */
 #define MAIN
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include "acaca.h"
+#include "bioplib/hash.h"
 #include "decr.h"
 #include "decr2.h"
+#include "loopfit.h"
+#include "medoid.h"
 #include "clan.h"
 
 
@@ -106,7 +166,19 @@
 #define KEY_TRUETORSIONS     15
 #define KEY_PSEUDOTORSIONS   16
 #define KEY_EXCLUDE          17
-#define PARSER_NCOMM         18
+#define KEY_THREADS          18
+#define KEY_DISSIMSTORE      19
+#define KEY_MICROCLUSTERS    20
+#define KEY_UPDATE           21
+#define KEY_METRIC           22
+#define KEY_COLLAPSE         23
+#define KEY_REPRESENTATIVE   24
+#define KEY_SWEEP            25
+#define KEY_BOOTSTRAP        26
+#define KEY_CHECKPOINT       27
+#define KEY_RESUME           28
+#define KEY_STRUCTCACHE      29
+#define PARSER_NCOMM         30
 #define PARSER_MAXSTRPARAM   3
 #define PARSER_MAXSTRLEN     80
 #define PARSER_MAXREALPARAM  MAXLOOPLEN
@@ -118,7 +190,325 @@
 /*  Map row I and column J of upper half diagonal symmetric matrix 
     onto vector.
 */
-#define IOFFSET(n,i,j) (j+(i-1)*n-(i*(i+1))/2)
+#define IOFFSET(n,i,j) ((long)(j)+((long)(i)-1)*(long)(n)-\
+                        ((long)(i)*((long)(i)+1))/2)
+
+/*  As IOFFSET, but row and column may be given in either order         */
+#define TRIOFFSET(n,i,j) (((i)<(j)) ? IOFFSET((n),(i),(j)) : \
+                                       IOFFSET((n),(j),(i)))
+
+/*  Methods (Ward, single, complete, average, McQuitty) whose
+    Lance-Williams update satisfies the reducibility property so they
+    can be clustered with a nearest-neighbour chain
+*/
+#define REDUCIBLE(m) ((m)>=1 && (m)<=5)
+
+/*  Number by which cluster c is known at every level where it exists,
+    given the merge levels from ClusterAssign() (counting from 1). 
+    Clusters are numbered in the order in which they split off going
+    down from the top of the hierarchy
+*/
+#define CLUSLABEL(merged,n,c) ((n)+1-(merged)[c])
+
+#define DISSIMTILEBYTES 16384  /* Target size of a transposed tile     */
+#define DISSIMPANEL     8      /* Tiles per thread's share with raw
+                                  torsions                             */
+
+/* Storage for the dissimilarity matrix                                 */
+#define DISSIM_DOUBLE   0      /* REAL in memory                        */
+#define DISSIM_FLOAT    1      /* float in memory                       */
+#define DISSIM_MMAP     2      /* REAL in a memory-mapped file          */
+#define DISSIM_MMAPFLOAT 3     /* float in a memory-mapped file         */
+
+/*  Memory-mapped stores are held as square blocks of the upper half 
+    diagonal, each DISSIMBLOCK elements on a side and contiguous in the
+    file, so the row and column touched by a merge lie in a few blocks
+*/
+#define DISSIMBLOCK     32     /* Elements on a side of a block         */
+
+/*  Offset of row I and column J (I<J) of a DISSIMSTORE, or in either 
+    order for DISSIMTRIOFFSET
+*/
+#define DISSIMOFFSET(s,n,i,j) ((s)->blocked ? BlockOffset((n),(i),(j)) \
+                                            : IOFFSET((n),(i),(j)))
+#define DISSIMTRIOFFSET(s,n,i,j) (((i)<(j)) ? DISSIMOFFSET((s),(n),(i),(j)) \
+                                            : DISSIMOFFSET((s),(n),(j),(i)))
+
+/*  Get and set an element of a DISSIMSTORE                             */
+#define GETDISSIM(s,i)   (((s)->f != NULL) ? (REAL)((s)->f[i]) : (s)->d[i])
+#define SETDISSIM(s,i,v) (((s)->f != NULL) ? ((s)->f[i] = (float)(v)) : \
+                                             ((s)->d[i] = (v)))
+#define MSTMINPERTHREAD 1024   /* Min. vectors per thread for the MST   */
+#define MEDIANMINPERTHREAD 1024 /* Min. vectors per thread for medians  */
+
+/* Micro-clustering for the approximate Ward method                     */
+#define DEFMICROCLUSTERS 1000  /* Default number of micro-clusters      */
+#define MICROSAMPLE     8      /* Sample for seeding per micro-cluster  */
+#define MICROBATCH      1024   /* Vectors in each mini-batch            */
+#define MICROITER       100    /* Number of mini-batches                */
+
+#define PREVBUFF        3600   /* Line buffer for a previous output     */
+
+/* Cluster representatives                                              */
+#define DEFMEDOIDMAX    2000   /* Largest cluster with an exact medoid  */
+
+/* Cutting the tree                                                     */
+#define CLUSCUT         0.06   /* Critical value per dimension at which
+                                  clusters are distinct                 */
+#define MAXSWEEP        100    /* Max. settings in a SWEEP              */
+
+/* Bootstrap stability of clusters                                      */
+#define BOOTRECOVERED   0.75   /* Jaccard at which a cluster is found   */
+#define BOOTDISSOLVED   0.5    /* Jaccard below which it has dissolved  */
+
+/* Checkpoint files. Each section starts on a FEATALIGN boundary so the
+   feature rows may be used where they are mapped
+*/
+#define CHECKMAGIC      "CLANCKP1"
+#define CHECKALIGN(n)   ((((unsigned long)(n) + FEATALIGN - 1) / \
+                          FEATALIGN) * FEATALIGN)
+
+/* Collapsing of duplicate vectors                                      */
+#define COLLAPSEGRID    1.0e-6 /* Grid used to hash exact duplicates    */
+#define QUANTISE(x,t)   ((long)floor((double)(x)/(double)(t) + 0.5))
+
+typedef struct
+{
+   REAL          *d;           /* REAL storage (from 1) or NULL         */
+   float         *f;           /* float storage (from 1) or NULL        */
+   unsigned long nbytes;       /* Size of the storage                   */
+   int           type;         /* DISSIM_DOUBLE, _FLOAT, _MMAP or 
+                                  _MMAPFLOAT                            */
+   BOOL          blocked;      /* Held as blocks (see BlockOffset())    */
+}  DISSIMSTORE;
+
+typedef struct
+{
+   FEATURE         **data;     /* Data to cluster (from 1)              */
+   REAL            *weights;   /* Vector weights (from 1) or NULL       */
+   DISSIMSTORE     *store;     /* Dissimilarities to fill in            */
+   int             NVec,
+                   VecDim,
+                   ClusterMethod,
+                   TileSize,   /* Columns compared with a row at a time */
+                   PanelSize,  /* Columns in a tile taken by a thread   */
+                   *NextTile;  /* Shared count of tiles left to do      */
+   pthread_mutex_t *mutex;     /* Protects NextTile                     */
+   BOOL            ok;         /* Set FALSE if allocation fails         */
+}  DISSIMJOB;
+
+typedef struct
+{
+   FEATURE **data,             /* Data to cluster (from 0)              */
+           **centres;          /* Micro-cluster centres (from 0)        */
+   int     *micro,             /* Nearest centre to each vector         */
+           VecDim,
+           NCentre,            /* Number of centres                     */
+           first,              /* First vector handled by this job      */
+           last;               /* One past the last vector handled      */
+}  MICROJOB;
+
+typedef struct
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t  cond;
+   int             NThreads,   /* Threads which must arrive             */
+                   NWaiting,   /* Threads which have arrived            */
+                   cycle;      /* Incremented each time all arrive      */
+}  BARRIER;
+
+typedef struct
+{
+   FEATURE **data;             /* Data to cluster (from 0)              */
+   REAL    *MinDist;           /* Distance of each vector to the tree   */
+   int     *MinFrom,           /* Tree vector giving that distance      */
+           *newest,            /* Vector most recently added to tree    */
+           VecDim,
+           first,              /* First vector handled by this job      */
+           last,               /* One past the last vector handled      */
+           best;               /* Nearest vector in range not in tree   */
+   BOOL    *InTree,            /* Vectors already in the tree           */
+           *done;              /* Set when the tree is complete         */
+   BARRIER *barrier;
+}  MSTJOB;
+
+typedef struct
+{
+   FEATURE **data,             /* Data which is clustered (from 0)      */
+           *minval,            /* Bounds of each cluster in the range   */
+           *maxval,            /*    of vectors [NClus][ExpDim]         */
+           *medval,            /* Shared medians [NClus][ExpDim]        */
+           *vec;               /* Workspace for an expanded vector      */
+   REAL    *BestDist;          /* Distance of best to the median        */
+   int     *clusters,          /* Cluster of each vector (from 1)       */
+           *NMemb,             /* Members of each cluster in the range  */
+           *best,              /* Vector closest to each median or -1   */
+           VecDim,
+           ExpDim,             /* Dimension from ExpandFeature()        */
+           NClus,
+           first,              /* First vector handled by this job      */
+           last,               /* One past the last vector handled      */
+           pass;               /* 1: bounds, 2: closest to the median   */
+}  MEDIANJOB;
+
+typedef struct
+{
+   int  i,                     /* Lowest member of first cluster        */
+        j,                     /* Lowest member of second cluster       */
+        order;                 /* Order in which the merge was made     */
+   REAL crit;                  /* Criterion value                       */
+}  MERGE;
+
+typedef struct
+{
+   int  i,                     /* Raw clusters merged by post-clustering*/
+        j;
+   REAL rms,                   /* Values printed for the merge          */
+        CADev,
+        CBDev;
+}  PREVMERGE;
+
+typedef struct
+{
+   FEATURE         **data;     /* Data which is clustered (from 0)      */
+   FEATURE         **scaled;   /* Data with resampled columns or NULL   */
+   DISSIMSTORE     *master;    /* Dissimilarities of all the data or 
+                                  NULL if resampling columns            */
+   DISSIMSTORE     work;       /* Dissimilarities of a replicate        */
+   CLUSMEMBERS     *cm;        /* Members of each original cluster      */
+   REAL            *jaccard,   /* Best Jaccard of each cluster in each 
+                                  replicate, -1 if absent [NBoot*NClus] */
+                   *crit;
+   int             *ia,
+                   *ib,
+                   *count,     /* Times each loop or column is drawn    */
+                   *sample,    /* Loops in the replicate                */
+                   *pos,       /* Position of each loop in sample or -1 */
+                   *RepClus,   /* Cluster of each loop in the replicate */
+                   *RepSize,   /* Size of each replicate cluster        */
+                   *overlap,   /* Members shared with each of them      */
+                   *touched,   /* Replicate clusters with an overlap    */
+                   NVec,
+                   VecDim,
+                   Method,
+                   NClus,
+                   *NextRep;   /* Shared count of replicates left to do */
+   pthread_mutex_t *mutex;     /* Protects NextRep                      */
+   BOOL            ok;         /* Set FALSE if allocation fails         */
+}  BOOTJOB;
+
+typedef struct
+{
+   REAL cutoff,                /* Critical value per dimension          */
+        PClusCut[3];           /* Post-clustering cutoffs (<0 to use the
+                                  POSTCLUSTER value)                    */
+}  SWEEP;
+
+typedef struct
+{
+   REAL rms,                   /* Mean values over the loops tested     */
+        CADev,
+        CBDev;
+   BOOL merge;                 /* Should the clusters be merged?        */
+}  PAIRTEST;
+
+typedef struct
+{
+   PAIRTEST        *table;     /* Decision for each pair (TRIOFFSET)    */
+   DATALIST        **tests;    /* Loops tested for each cluster [2*NClus]
+                                  second is NULL unless 2 members       */
+   BOOL            *usable;    /* Cluster's loops could be found        */
+   int             *OldRaw,    /* Unchanged from previous run (or NULL) */
+                   NClus,
+                   *NextRow;   /* Shared count of rows left to do       */
+   pthread_mutex_t *mutex;     /* Protects NextRow                      */
+}  POSTJOB;
+
+typedef struct
+{
+   FEATURE   **data;           /* Stored DATA vectors (from 0)          */
+   REAL      PClusCut[3];      /* Post-clustering cutoffs used          */
+   char      **loopid,         /* Loop identifiers (from 0)             */
+             **CritRes;        /* Each post-cluster's CRITICALRESIDUES
+                                  block after the cluster number (from 1)
+                               */
+   int       *raw,             /* Raw cluster of each loop (from 1)     */
+             *post,            /* Post-cluster of each loop (from 1)    */
+             NLoops,
+             VecDim,
+             NRaw,             /* Number of raw clusters                */
+             NPost,            /* Number of post-clusters               */
+             NMerge,           /* Number of post-clustering merges      */
+             NCritRes,         /* Number of clusters in CritRes         */
+             Method,
+             Metric,
+             MaxLen,
+             Scheme[MAXLOOPLEN];
+   BOOL      Distance,
+             Angles,
+             CATorsions,
+             Medoids;          /* Representatives were medoids          */
+   PREVMERGE *merges;          /* Merges made by post-clustering        */
+   HASHTABLE *index;           /* Position of each loop id (from 1)     */
+}  PREVCLAN;
+
+typedef struct
+{
+   char          magic[8];     /* CHECKMAGIC                            */
+   int           FeatureSize,  /* sizeof(FEATURE) when written          */
+                 RealSize,     /* sizeof(REAL) when written             */
+                 BuffSize,     /* MAXBUFF when written                  */
+                 MaxLoopLen,   /* MAXLOOPLEN when written               */
+                 NVec,
+                 NItems,       /* Items clustered                       */
+                 VecDim,
+                 Method,
+                 Metric,
+                 MaxLen,
+                 Scheme[MAXLOOPLEN],
+                 NCollapsed,
+                 Distance,
+                 Angles,
+                 CATorsions,
+                 HasMicro;     /* Item of each vector is stored         */
+   unsigned long stride,       /* FEATUREs in each stored row           */
+                 ncoor,        /* Total CA (and CB) coordinates         */
+                 DataOffset,   /* Byte offset of each section           */
+                 IAOffset,
+                 IBOffset,
+                 CritOffset,
+                 MicroOffset,
+                 LoopOffset,
+                 CAOffset,
+                 CBOffset,
+                 HasCBOffset,
+                 size;         /* Size of the file                      */
+}  CHECKHEAD;
+
+typedef struct
+{
+   char          loopid[MAXBUFF],
+                 start[16],
+                 end[16];
+   int           length,
+                 ncoor;
+   unsigned long coor;         /* First of its coordinates in the packed
+                                  CA, CB and HasCB sections             */
+}  CHECKLOOP;
+
+typedef struct
+{
+   CHECKHEAD     *head;        /* The mapped file                       */
+   FEATURE       *data;        /* Rows of head->stride FEATUREs         */
+   REAL          *crit;
+   int           *ia,
+                 *ib,
+                 *micro;       /* Item of each vector or NULL           */
+   CHECKLOOP     *loops;
+   COOR          *ca,
+                 *cb;
+   BOOL          *hascb;
+}  CHECKPOINT;
 
 
 /************************************************************************/
@@ -128,11 +518,60 @@ static MKeyWd sKeyWords[PARSER_NCOMM];         /* Parser keywords       */
 static char   *sStrParam[PARSER_MAXSTRPARAM];  /* Parser string params  */
 static REAL   sRealParam[PARSER_MAXREALPARAM]; /* Parser real params    */
 static int    sInfoLevel = 0;                  /* Info level            */
+static int    sNThreads  = 0;                  /* Threads (0 = not set) */
+static int    sDissimStore = DISSIM_DOUBLE;    /* Dissimilarity storage */
+static char   sDissimFile[MAXBUFF];            /* File for DISSIM_MMAP  */
+static int    sNMicro    = DEFMICROCLUSTERS;   /* Micro-clusters        */
+static PREVCLAN *sPrev   = NULL;               /* Run being updated     */
+static BOOL   sCollapse  = FALSE;              /* Collapse duplicates   */
+static REAL   sCollapseTol = (REAL)0.0;        /* Grid for near dups.   */
+static int    sNCollapsed = -1;                /* Vectors collapsed     */
+static BOOL   sMedoids   = FALSE;              /* Medoid representatives*/
+static int    sMedoidMax = DEFMEDOIDMAX;       /* Largest exact medoid  */
+static SWEEP  sSweep[MAXSWEEP];                /* SWEEP settings        */
+static int    sNSweep    = 0;                  /* Number of settings    */
+static int    sNBoot     = 0;                  /* Bootstrap replicates  */
+static BOOL   sBootColumns = FALSE;            /* Resample columns      */
+static char   sCheckFile[MAXBUFF];             /* Checkpoint to write   */
+static CHECKPOINT *sResume = NULL;             /* Checkpoint resumed    */
+static unsigned long sCacheHits  = 0,          /* Structures found and  */
+                     sCacheReads = 0;          /* read by LoadLoop()    */
 
 
 /************************************************************************/
 /* Prototypes
 */
+BOOL BuildDissim(int NVec, int VecDim, int ClusterMethod, 
+                 FEATURE **data, REAL *weights, DISSIMSTORE *store,
+                 int NThreads);
+BOOL AgglomerateStore(int NVec, int ClusterMethod, DISSIMSTORE *store,
+                      REAL *weights, int *ia, int *ib, REAL *crit);
+void DissimTile(FEATURE **data, REAL *weights, DISSIMSTORE *store, 
+                int NVec, int VecDim, int ClusterMethod, int j0, int j1, 
+                int TileSize, FEATURE *tile, REAL *acc, FEATURE *xrow);
+void NNListCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                   REAL *membr, BOOL *Flag, int *NearNeighb, 
+                   REAL *DissimNearNeighb, int *ia, int *ib, REAL *crit);
+BOOL NNChainCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                    REAL *membr, BOOL *Flag, int *chain, int *ia, 
+                    int *ib, REAL *crit);
+BOOL AllocDissimStore(DISSIMSTORE *store, int NVec, int type, 
+                      char *filename);
+void FreeDissimStore(DISSIMSTORE *store);
+unsigned long DissimElems(int NVec, BOOL blocked);
+long BlockOffset(int NVec, int i, int j);
+void MSTUpdate(MSTJOB *job);
+void PostTestRow(POSTJOB *job, int i);
+BOOL AllocBootJob(BOOTJOB *job, DISSIMSTORE *master);
+void FreeBootJob(BOOTJOB *job);
+BOOL BootReplicate(BOOTJOB *job, int rep);
+void WaitBarrier(BARRIER *barrier);
+PREVCLAN *ReadPrevClan(char *filename);
+BOOL ReadPrevSection(FILE *fp, char *buffer, PREVCLAN *prev);
+void FreePrevClan(PREVCLAN *prev);
+CHECKPOINT *ReadCheckpoint(char *filename);
+FEATURE **ResumeLoops(CHECKPOINT *ckp, int *NData, int *VecDim);
+void FreeCheckpoint(CHECKPOINT *ckp);
 
 
 /************************************************************************/
@@ -202,10 +641,13 @@ int main(int argc, char **argv)
                                 torsions.
    Returns: BOOL                Success?
 
+   Globals: int    sNThreads    Number of threads (set by -j)
+
    Parse the command line
    
    26.06.95 Original    By: ACRM
    05.07.95 Added -t
+   16.10.26 Added -j
 */
 BOOL ParseCmdLine(int argc, char **argv, char *infile, BOOL *CATorsions)
 {
@@ -222,6 +664,12 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, BOOL *CATorsions)
       case 't':
          *CATorsions = FALSE;
          break;
+      case 'j':
+         argc--;
+         argv++;
+         if(!argc || !sscanf(argv[0],"%d",&sNThreads) || sNThreads < 1)
+            return(FALSE);
+         break;
       default:
          return(FALSE);
          break;
@@ -281,6 +729,10 @@ BOOL ReadInputFile(FILE *fp, BOOL CATorsions)
    13.09.95 Added nodistance
    21.09.95 Added angle/noangle
    06.11.95 Added exclude
+   16.10.26 Added threads, dissimstore and microclusters
+   16.10.26 Added collapse
+   16.10.26 Added checkpoint and resume
+   16.10.26 Added structurecache
 */
 BOOL SetupParser(void)
 {
@@ -325,6 +777,18 @@ BOOL SetupParser(void)
    MAKEMKEY(sKeyWords[KEY_PSEUDOTORSIONS],"PSEUDOTORSIONS",  STRING,0,0);
 
    MAKEMKEY(sKeyWords[KEY_EXCLUDE],       "EXCLUDE",         STRING,1,1);
+   MAKEMKEY(sKeyWords[KEY_THREADS],       "THREADS",         NUMBER,1,1);
+   MAKEMKEY(sKeyWords[KEY_DISSIMSTORE],   "DISSIMSTORE",     STRING,1,3);
+   MAKEMKEY(sKeyWords[KEY_MICROCLUSTERS], "MICROCLUSTERS",   NUMBER,1,1);
+   MAKEMKEY(sKeyWords[KEY_UPDATE],        "UPDATE",          STRING,1,1);
+   MAKEMKEY(sKeyWords[KEY_METRIC],        "METRIC",          STRING,1,1);
+   MAKEMKEY(sKeyWords[KEY_COLLAPSE],      "COLLAPSE",        NUMBER,0,1);
+   MAKEMKEY(sKeyWords[KEY_REPRESENTATIVE],"REPRESENTATIVE",  STRING,1,2);
+   MAKEMKEY(sKeyWords[KEY_SWEEP],         "SWEEP",           NUMBER,1,4);
+   MAKEMKEY(sKeyWords[KEY_BOOTSTRAP],     "BOOTSTRAP",       STRING,1,2);
+   MAKEMKEY(sKeyWords[KEY_CHECKPOINT],    "CHECKPOINT",      STRING,1,1);
+   MAKEMKEY(sKeyWords[KEY_RESUME],        "RESUME",          STRING,1,1);
+   MAKEMKEY(sKeyWords[KEY_STRUCTCACHE],   "STRUCTURECACHE",  NUMBER,1,1);
    
    /* Check all allocations OK                                          */
    for(i=0; i<PARSER_NCOMM; i++)
@@ -357,6 +821,19 @@ BOOL SetupParser(void)
    21.09.95 Added distance, angle, noangle
    26.09.95 Added truetorsions/pseudotorsions and GotLoop checking
    06.11.95 Added exclude
+   16.10.26 Added threads. A -j on the command line takes precedence
+   16.10.26 Added dissimstore and microclusters
+   16.10.26 Added update. Loops already in the previous output are not
+            read again
+   16.10.26 Added metric
+   16.10.26 Added collapse
+   16.10.26 Added representative
+   16.10.26 Added sweep
+   16.10.26 Added bootstrap
+   16.10.26 Added checkpoint and resume. Loops are not read when 
+            resuming
+   16.10.26 Added structurecache
+   16.10.26 Rejects fewer than 1 thread
 */
 BOOL DoCmdLoop(FILE *fp, BOOL CATorsions)
 {
@@ -365,7 +842,8 @@ BOOL DoCmdLoop(FILE *fp, BOOL CATorsions)
    int  NParams,
         i,
         key;
-   BOOL GotLoop = FALSE;
+   BOOL GotLoop        = FALSE,
+        CmdLineThreads = (sNThreads != 0);
    
    while(fgets(buffer,MAXBUFF,fp))
    {
@@ -390,6 +868,19 @@ BOOL DoCmdLoop(FILE *fp, BOOL CATorsions)
          break;
       case KEY_LOOP:
          GotLoop = TRUE;
+         /* When resuming, the loops are those in the checkpoint        */
+         if(sResume != NULL)
+            break;
+         /* When updating, loops which were clustered before are taken
+            from the previous output rather than being read again
+         */
+         if(sPrev != NULL)
+         {
+            sprintf(loopid,"%s-%s-%s",
+                    sStrParam[0],sStrParam[1],sStrParam[2]);
+            if(blHashKeyDefined(sPrev->index, loopid))
+               break;
+         }
          if(!HandleLoopSpec(sStrParam[0], sStrParam[1], sStrParam[2],
                             CATorsions, TRUE))
             fprintf(stderr,"Loop skipped!\n");
@@ -516,6 +1007,109 @@ before all LOOP commands\n",sKeyWords[key].name);
             return(FALSE);
          }
          break;
+      case KEY_THREADS:
+         if(sRealParam[0] < (REAL)1.0)
+         {
+            fprintf(stderr,"Error: at least 1 thread needed\n");
+            return(FALSE);
+         }
+         if(!CmdLineThreads)
+            sNThreads = (int)sRealParam[0];
+         break;
+      case KEY_DISSIMSTORE:
+         if(!SetDissimStore(sStrParam[0], 
+                            ((NParams > 1) ? sStrParam[1] : NULL),
+                            ((NParams > 2) ? sStrParam[2] : NULL)))
+            return(FALSE);
+         break;
+      case KEY_MICROCLUSTERS:
+         if((sNMicro = (int)sRealParam[0]) < 2)
+         {
+            fprintf(stderr,"Error: at least 2 micro-clusters needed\n");
+            return(FALSE);
+         }
+         break;
+      case KEY_UPDATE:
+         if(GotLoop)
+         {
+            fprintf(stderr,"Error: %s command must appear \
+before all LOOP commands\n",sKeyWords[key].name);
+            return(FALSE);
+         }
+         if(sPrev != NULL)
+            FreePrevClan(sPrev);
+         if((sPrev = ReadPrevClan(sStrParam[0]))==NULL)
+            return(FALSE);
+         break;
+      case KEY_METRIC:
+         if(!SetMetric(sStrParam[0]))
+            return(FALSE);
+         break;
+      case KEY_COLLAPSE:
+         sCollapse    = TRUE;
+         sCollapseTol = (NParams > 0) ? sRealParam[0] : (REAL)0.0;
+         if(sCollapseTol < (REAL)0.0)
+         {
+            fprintf(stderr,"Error: COLLAPSE tolerance must not be \
+negative\n");
+            return(FALSE);
+         }
+         break;
+      case KEY_REPRESENTATIVE:
+         if(!SetRepresentative(sStrParam[0], 
+                               ((NParams > 1) ? sStrParam[1] : NULL)))
+            return(FALSE);
+         break;
+      case KEY_SWEEP:
+         if(sNSweep >= MAXSWEEP)
+         {
+            fprintf(stderr,"Error: no more than %d SWEEP settings\n",
+                    MAXSWEEP);
+            return(FALSE);
+         }
+         if(sRealParam[0] < (REAL)0.0)
+         {
+            fprintf(stderr,"Error: SWEEP cutoff must not be negative\n");
+            return(FALSE);
+         }
+         sSweep[sNSweep].cutoff = sRealParam[0];
+         for(i=0; i<3; i++)
+         {
+            sSweep[sNSweep].PClusCut[i] = 
+               (NParams > i+1) ? sRealParam[i+1] : (REAL)(-1.0);
+         }
+         sNSweep++;
+         break;
+      case KEY_BOOTSTRAP:
+         if(!SetBootstrap(sStrParam[0], 
+                          ((NParams > 1) ? sStrParam[1] : NULL)))
+            return(FALSE);
+         break;
+      case KEY_CHECKPOINT:
+         strncpy(sCheckFile, sStrParam[0], MAXBUFF-1);
+         sCheckFile[MAXBUFF-1] = '\0';
+         break;
+      case KEY_RESUME:
+         if(GotLoop)
+         {
+            fprintf(stderr,"Error: %s command must appear \
+before all LOOP commands\n",sKeyWords[key].name);
+            return(FALSE);
+         }
+         if(sResume != NULL)
+            FreeCheckpoint(sResume);
+         if((sResume = ReadCheckpoint(sStrParam[0]))==NULL)
+            return(FALSE);
+         break;
+      case KEY_STRUCTCACHE:
+         if(sRealParam[0] < (REAL)0.0)
+         {
+            fprintf(stderr,"Error: %s must not be negative\n",
+                    sKeyWords[key].name);
+            return(FALSE);
+         }
+         SetStructureCache((unsigned long)(sRealParam[0] * 1048576.0));
+         break;
       default:
          break;
       }
@@ -526,183 +1120,2131 @@ before all LOOP commands\n",sKeyWords[key].name);
 
 
 /************************************************************************/
-/*>BOOL ShowClusters(FILE *fp, REAL **data, int NVec, int VecDim, 
-                     int Method, BOOL ShowTable, BOOL ShowDendogram)
-   -----------------------------------------------------------------
-   Input:   FILE *fp              Output file pointer
-            REAL **data           2D array of data to cluster
-            int  NVec             Number of vectors to cluster
-            int  VecDim           Dimension of the vectors
-            int  Method           Clustering method (1--7)
-            BOOL ShowTable        Display clustering table?
-            BOOL ShowDendogram    Display clustering dendogram?
-   Returns: BOOL                  Success of memory allocations (local,
-                                  in clustering or in critical residue
-                                  definition)
-
-   Allocate temporary arrays, call clustering, post-clustering, 
-   data-writing and critical residue code and free the temporary arrays.
-
-   21.06.95 Original    By: ACRM
-   29.06.95 Initialise all pointers to NULL
-   06.07.95 Added PostCluster() call
-   24.07.95 Added WriteClusData() call
-   08.08.95 Added DefineCriticalResidues() call
-   15.08.95 Modified to use a single array to store the clusters at the
-            clustering level of ineterest rather than always looking in
-            the 2D clusters array
-   16.08.95 PostCluster() now returns the new number of clusters
-   25.09.95 Passes VecDim to ClusterDendogram if Method==1 (else passes
-            1.0)
+/*>BOOL SetDissimStore(char *type, char *filename, char *element)
+   ---------------------------------------------------------------
+   Input:   char *type           Storage type (DOUBLE, FLOAT or MMAP)
+            char *filename       File to map for MMAP (or NULL)
+            char *element        Element type for MMAP (DOUBLE or 
+                                 FLOAT) or NULL for DOUBLE
+   Returns: BOOL                 Success? (FALSE if unknown type or no
+                                 file given for MMAP)
+   Globals: int  sDissimStore    Set to specified storage type
+            char sDissimFile[]   Set to the file name for MMAP
+
+   Set the type of storage used for the dissimilarity matrix based on 
+   the supplied text.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Added element for floats in a memory-mapped file
 */
-BOOL ShowClusters(FILE *fp, REAL **data, int NVec, int VecDim, 
-                  int Method, BOOL ShowTable, BOOL ShowDendogram)
+BOOL SetDissimStore(char *type, char *filename, char *element)
 {
-   int  *ia          = NULL,
-        *ib          = NULL,
-        lev          = NVec,
-        *iorder      = NULL,
-        *height      = NULL,
-        **clusters   = NULL,
-        *TheClusters = NULL,
-        NClus,
-        OldNClus;
-   REAL *crit        = NULL,
-        *critval     = NULL;
-   BOOL ok           = TRUE;
-   char **out        = NULL;
-
-   ia          = (int *)malloc(NVec * sizeof(int));
-   ib          = (int *)malloc(NVec * sizeof(int));
-   crit        = (REAL *)malloc(NVec * sizeof(REAL));
-   TheClusters = (int *)malloc(NVec * sizeof(int));
-
-   iorder      = (int *)malloc(lev * sizeof(int));
-   height      = (int *)malloc(lev * sizeof(int));
-   critval     = (REAL *)malloc(lev * sizeof(REAL));
-
-   if(ia==NULL      ||
-      ib==NULL      ||
-      crit==NULL    ||
-      critval==NULL ||
-      iorder==NULL  ||
-      height==NULL  ||
-      TheClusters==NULL)
+   if(!blUpstrncmp(type,"DOU",3))
    {
-      if(ia          != NULL) free(ia);
-      if(ib          != NULL) free(ib);
-      if(iorder      != NULL) free(iorder);
-      if(height      != NULL) free(height);
-      if(crit        != NULL) free(crit);
-      if(critval     != NULL) free(critval);
-      if(TheClusters != NULL) free(TheClusters);
+      sDissimStore = DISSIM_DOUBLE;
+   }
+   else if(!blUpstrncmp(type,"FLO",3))
+   {
+      sDissimStore = DISSIM_FLOAT;
+   }
+   else if(!blUpstrncmp(type,"MMA",3))
+   {
+      if(filename == NULL)
+      {
+         fprintf(stderr,"DISSIMSTORE MMAP requires a file name\n");
+         return(FALSE);
+      }
+      if((element == NULL) || !blUpstrncmp(element,"DOU",3))
+      {
+         sDissimStore = DISSIM_MMAP;
+      }
+      else if(!blUpstrncmp(element,"FLO",3))
+      {
+         sDissimStore = DISSIM_MMAPFLOAT;
+      }
+      else
+      {
+         fprintf(stderr,"Unknown dissimilarity element type: %s\n",
+                 element);
+         return(FALSE);
+      }
+      strncpy(sDissimFile, filename, MAXBUFF-1);
+      sDissimFile[MAXBUFF-1] = '\0';
+   }
+   else
+   {
+      fprintf(stderr,"Unknown dissimilarity storage: %s\n",type);
       return(FALSE);
    }
 
-   /* Write a header for the clustering                                 */
-   WriteHeader(fp,Method,NVec,VecDim,gScheme);
+   return(TRUE);
+}
 
-   /* Write the raw cluster data                                        */
-   if(gDoData)
-      WriteClusData(fp,NVec,VecDim,data);
-   
-   /* Do the clustering                                                 */
-   if(HierClus(NVec,VecDim,Method,data,ia,ib,crit))
+
+/************************************************************************/
+/*>BOOL SetRepresentative(char *type, char *maxexact)
+   --------------------------------------------------
+   Input:   char *type           Representative (MEDIAN or MEDOID)
+            char *maxexact       Largest cluster given an exact medoid
+                                 (or NULL)
+   Returns: BOOL                 Success? (FALSE if unknown type or bad
+                                 size)
+   Globals: BOOL sMedoids        Set if medoids are used
+            int  sMedoidMax      Set to the largest exact medoid
+
+   Set the type of representative written for each cluster in the
+   MEDIANS section.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL SetRepresentative(char *type, char *maxexact)
+{
+   if(!blUpstrncmp(type,"MEDI",4))
    {
-      /* Assign data to clusters                                        */
-      if((clusters = ClusterAssign((ShowTable?fp:NULL),NVec,ia,ib,crit,
-                                   lev,iorder,critval,height))!=NULL)
+      sMedoids = FALSE;
+   }
+   else if(!blUpstrncmp(type,"MEDO",4))
+   {
+      sMedoids = TRUE;
+      if(maxexact != NULL)
       {
-         /* Print the dendogram                                         */
-         if(ShowDendogram)
+         if(!sscanf(maxexact,"%d",&sMedoidMax) || (sMedoidMax < 2))
          {
-            if((out = ClusterDendogram(fp,lev,iorder,height,critval,
-                                       ((Method==1)?VecDim:1.0)))
-               ==NULL)
-               ok = FALSE;
+            fprintf(stderr,"Error: REPRESENTATIVE MEDOID needs an \
+exact size of at least 2\n");
+            return(FALSE);
          }
+      }
+   }
+   else
+   {
+      fprintf(stderr,"Unknown cluster representative: %s\n",type);
+      return(FALSE);
+   }
 
+   return(TRUE);
+}
 
-         /* Find number of distinct clusters                            */
-         NClus = FindNumTrueClusters(crit, lev, VecDim);
 
-         /* Setup the TheClusters array with these values               */
-         FillClusterArray(clusters, NVec, NClus, TheClusters);
+/************************************************************************/
+/*>BOOL SetBootstrap(char *count, char *mode)
+   ------------------------------------------
+   Input:   char *count          Number of replicates
+            char *mode           What to resample (LOOPS or COLUMNS) or
+                                 NULL for loops
+   Returns: BOOL                 Success? (FALSE if unknown mode or bad
+                                 count)
+   Globals: int  sNBoot          Set to the number of replicates
+            BOOL sBootColumns    Set if columns are resampled
 
-         WriteResults(fp, TheClusters, NClus, data, NVec, VecDim, crit, 
-                      FALSE);
-         OldNClus = NClus;
-         if((NClus = PostCluster(fp, TheClusters, data, NVec, VecDim, 
-                                 crit, NClus))==0)
-         {
-            ok = FALSE;
-         }
-         else
-         {
-            WriteResults(fp, TheClusters, NClus, data, NVec, VecDim, 
-                         crit, TRUE);
-            if(gDoCritRes)
-            {
-               if(!DefineCriticalResidues(fp,TheClusters,data,NVec,VecDim,
-                                          crit, NClus))
-                  ok = FALSE;
-            }
-         }
-      }
-      else
-      {
-         ok = FALSE;
-      }
+   Sets up the bootstrap analysis of cluster stability.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL SetBootstrap(char *count, char *mode)
+{
+   if(!sscanf(count,"%d",&sNBoot) || (sNBoot < 1))
+   {
+      fprintf(stderr,"Error: BOOTSTRAP needs at least 1 replicate\n");
+      return(FALSE);
+   }
+
+   if((mode == NULL) || !blUpstrncmp(mode,"LOOP",4))
+   {
+      sBootColumns = FALSE;
+   }
+   else if(!blUpstrncmp(mode,"COL",3))
+   {
+      sBootColumns = TRUE;
    }
    else
    {
-      ok = FALSE;
+      fprintf(stderr,"Unknown BOOTSTRAP resampling: %s\n",mode);
+      return(FALSE);
    }
 
-   /* Free allocated memory                                             */
-   if(clusters != NULL) blFreeArray2D((char **)clusters,NVec,VecDim);
-   if(out      != NULL) blFreeArray2D((char **)out,lev*3,lev*3);
-   if(ia       != NULL) free(ia);
-   if(ib       != NULL) free(ib);
-   if(iorder   != NULL) free(iorder);
-   if(height   != NULL) free(height);
-   if(crit     != NULL) free(crit);
-   if(critval  != NULL) free(critval);
-   
-   return(ok);
+   return(TRUE);
 }
 
 
 /************************************************************************/
-/*>BOOL HierClus(int NVec, int VecDim, int ClusterMethod, REAL **data, 
-                 int *ia, int *ib, REAL *crit)
-   -------------------------------------------------------------------
-   Input:   int  NVec                 Number of vectors to cluster
-            int  VecDim               Dimension of each vector
-            REAL data[NVec][VecDim]   Input data matrix
-            int  ClusterMethod        Clustering criterion to be used
-   Output:  int  ia[NVec]             \
-                 ib[NVec]             | History of allomerations
-            REAL crit[NVec]           /
-   Returns: BOOL                      Success of memory allocations
-
-   Hierarchical clustering using user-specified criterion. 
-                                                             
-   20.06.95 Original By: ACRM
-            Based on FORTRAN code by F. Murtagh, ESA/ESO/STECF, Garching,
-            February 1986 available in STATLIB.
-   26.06.95 Fixed frees on error
-   29.06.95 Fix the pointers in the data array when finished
-   30.01.09 Initialize some variables
+/*>PREVCLAN *ReadPrevClan(char *filename)
+   --------------------------------------
+   Input:   char     *filename    Output file from a previous run
+   Returns: PREVCLAN *            The previous run (NULL if the file 
+                                  could not be read or lacks the
+                                  required sections)
+
+   Reads the parts of a previous clan output file needed to add new 
+   loops to its clustering: the header, the vectors from the DATA 
+   section, the raw and post-clustered assignments, the merges made in
+   post-clustering and the critical residues of each cluster. The DATA
+   section is only written if the DATA keyword was used.
+
+   16.10.26 Original   By: ACRM
 */
-BOOL HierClus(int NVec, int VecDim, int ClusterMethod, REAL **data, 
-              int *ia, int *ib, REAL *crit)
+PREVCLAN *ReadPrevClan(char *filename)
 {
-   int  ind, 
-        ind1, 
-        ind2, 
-        ind3, 
-        NClusters, 
+   FILE     *fp;
+   PREVCLAN *prev;
+   char     buffer[PREVBUFF];
+   int      *NMembers,
+            i;
+   BOOL     ok = TRUE;
+
+   if((fp=fopen(filename,"r"))==NULL)
+   {
+      fprintf(stderr,"Unable to open previous output file: %s\n",
+              filename);
+      return(NULL);
+   }
+
+   if((prev=(PREVCLAN *)malloc(sizeof(PREVCLAN)))==NULL)
+   {
+      fprintf(stderr,"No memory for previous output\n");
+      fclose(fp);
+      return(NULL);
+   }
+   prev->data        = NULL;
+   prev->loopid      = NULL;
+   prev->CritRes     = NULL;
+   prev->raw         = NULL;
+   prev->post        = NULL;
+   prev->merges      = NULL;
+   prev->index       = NULL;
+   prev->NLoops      = 0;
+   prev->VecDim      = 0;
+   prev->NRaw        = 0;
+   prev->NPost       = 0;
+   prev->NMerge      = 0;
+   prev->NCritRes    = 0;
+   prev->Method      = 0;
+   prev->Metric      = METRIC_EUCLIDEAN;
+   prev->MaxLen      = 0;
+   prev->Distance    = FALSE;
+   prev->Angles      = FALSE;
+   prev->CATorsions  = FALSE;
+   prev->Medoids     = FALSE;
+   prev->PClusCut[0] = prev->PClusCut[1] = prev->PClusCut[2] = 0.0;
+
+   /* Read each section in turn                                         */
+   while(ok && fgets(buffer,PREVBUFF,fp))
+   {
+      TERMINATE(buffer);
+      if(!strncmp(buffer,"BEGIN ",6))
+         ok = ReadPrevSection(fp, buffer+6, prev);
+   }
+   fclose(fp);
+
+   /* Check we have everything needed                                   */
+   if(ok)
+   {
+      if(prev->data == NULL)
+      {
+         fprintf(stderr,"No DATA section in %s. The previous run must \
+use the DATA keyword\n", filename);
+         ok = FALSE;
+      }
+      else if((prev->raw == NULL) || (prev->NRaw == 0) ||
+              (prev->post == NULL) || (prev->NPost == 0))
+      {
+         fprintf(stderr,"No RAWASSIGNMENTS or ASSIGNMENTS section in \
+%s\n", filename);
+         ok = FALSE;
+      }
+   }
+
+   /* Check every raw cluster has members                               */
+   if(ok)
+   {
+      if((NMembers = (int *)malloc((prev->NRaw+1) * sizeof(int)))==NULL)
+      {
+         fprintf(stderr,"No memory for previous output\n");
+         ok = FALSE;
+      }
+      else
+      {
+         for(i=0; i<=prev->NRaw; i++)
+            NMembers[i] = 0;
+         for(i=0; i<prev->NLoops; i++)
+            NMembers[prev->raw[i]]++;
+         for(i=1; i<=prev->NRaw; i++)
+         {
+            if(NMembers[i] == 0)
+            {
+               fprintf(stderr,"Raw cluster %d has no members in %s\n",
+                       i, filename);
+               ok = FALSE;
+               break;
+            }
+         }
+         free(NMembers);
+      }
+   }
+
+   if(!ok)
+   {
+      FreePrevClan(prev);
+      return(NULL);
+   }
+
+   return(prev);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadPrevSection(FILE *fp, char *section, PREVCLAN *prev)
+   -------------------------------------------------------------
+   Input:   FILE     *fp          Previous output file
+            char     *section    Text following BEGIN
+   I/O:     PREVCLAN *prev       Previous run being read
+   Returns: BOOL                 Success? (FALSE if the section is 
+                                 malformed or allocations fail)
+
+   Reads one section of a previous output file up to its END line. 
+   Sections which are not needed are skipped.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Reads REPRESENTATIVE from the header
+*/
+BOOL ReadPrevSection(FILE *fp, char *section, PREVCLAN *prev)
+{
+   char      buffer[PREVBUFF],
+             name[MAXBUFF],
+             word[MAXBUFF],
+             loopid[MAXBUFF],
+             *chp;
+   int       n     = 0,
+             count = 0,
+             clusnum,
+             i, j;
+   double    val;
+   PREVMERGE *merges;
+
+   name[0] = '\0';
+   sscanf(section,"%s %d",name,&n);
+
+   /* Vectors are read directly since the lines are long                */
+   if(!strcmp(name,"DATA"))
+   {
+      if(prev->NLoops == 0)
+      {
+         fprintf(stderr,"DATA section before HEADER\n");
+         return(FALSE);
+      }
+      if((prev->data = AllocFeatures(prev->NLoops, prev->VecDim))==NULL)
+      {
+         fprintf(stderr,"No memory for previous DATA\n");
+         return(FALSE);
+      }
+      for(i=0; i<prev->NLoops; i++)
+      {
+         for(j=0; j<prev->VecDim; j++)
+         {
+            if(fscanf(fp,"%lf",&val) != 1)
+            {
+               fprintf(stderr,"DATA section is shorter than expected\n");
+               return(FALSE);
+            }
+            prev->data[i][j] = (FEATURE)val;
+         }
+      }
+   }
+   else if(!strcmp(name,"CRITICALRESIDUES"))
+   {
+      if((prev->CritRes = (char **)malloc((n+1) * sizeof(char *)))==NULL)
+      {
+         fprintf(stderr,"No memory for previous CRITICALRESIDUES\n");
+         return(FALSE);
+      }
+      for(i=0; i<=n; i++)
+         prev->CritRes[i] = NULL;
+      prev->NCritRes = n;
+   }
+
+   clusnum = 0;
+   while(fgets(buffer,PREVBUFF,fp))
+   {
+      TERMINATE(buffer);
+      if(!strncmp(buffer,"END ",4))
+         break;
+
+      if(!strcmp(name,"HEADER"))
+      {
+         word[0] = '\0';
+         sscanf(buffer,"%s",word);
+         if(!strcmp(word,"METHOD"))
+         {
+            sscanf(buffer,"%s %d",word,&(prev->Method));
+         }
+         else if(!strcmp(word,"NLOOPS"))
+         {
+            sscanf(buffer,"%s %d",word,&(prev->NLoops));
+         }
+         else if(!strcmp(word,"MAXLENGTH"))
+         {
+            sscanf(buffer,"%s %d",word,&(prev->MaxLen));
+         }
+         else if(!strcmp(word,"POSTCLUSTER"))
+         {
+            sscanf(buffer,"%s %lf %lf %lf",word,&(prev->PClusCut[0]),
+                   &(prev->PClusCut[1]),&(prev->PClusCut[2]));
+         }
+         else if(!strcmp(word,"SCHEME"))
+         {
+            chp = strstr(buffer,"SCHEME") + 6;
+            for(i=0; i<MAXLOOPLEN; i++)
+            {
+               chp = blGetWord(chp,word,MAXBUFF);
+               if(word[0] == '\0')
+                  break;
+               sscanf(word,"%d",&(prev->Scheme[i]));
+            }
+         }
+         else if(!strcmp(word,"DISTANCE"))
+         {
+            prev->Distance = TRUE;
+         }
+         else if(!strcmp(word,"ANGLES"))
+         {
+            prev->Angles = TRUE;
+         }
+         else if(!strcmp(word,"PSEUDOTORSIONS"))
+         {
+            prev->CATorsions = TRUE;
+         }
+         else if(!strcmp(word,"METRIC"))
+         {
+            if(strstr(buffer,"ANGULAR") != NULL)
+               prev->Metric = METRIC_ANGULAR;
+            else if(strstr(buffer,"RMSD") != NULL)
+               prev->Metric = METRIC_RMSD;
+         }
+         else if(!strcmp(word,"REPRESENTATIVE"))
+         {
+            prev->Medoids = (strstr(buffer,"MEDOID") != NULL);
+         }
+      }
+      else if(!strcmp(name,"RAWASSIGNMENTS") || 
+              !strcmp(name,"ASSIGNMENTS"))
+      {
+         if(sscanf(buffer,"%d %s",&clusnum,loopid) != 2)
+            continue;
+         if((count >= prev->NLoops) || (clusnum < 1))
+         {
+            fprintf(stderr,"%s section does not match HEADER\n",name);
+            return(FALSE);
+         }
+         
+         if(!strcmp(name,"RAWASSIGNMENTS"))
+         {
+            strcpy(prev->loopid[count], loopid);
+            prev->raw[count] = clusnum;
+            if(!blSetHashValueInt(prev->index, loopid, count+1))
+            {
+               fprintf(stderr,"No memory for loop index\n");
+               return(FALSE);
+            }
+            if(clusnum > prev->NRaw)
+               prev->NRaw = clusnum;
+         }
+         else
+         {
+            if(strcmp(prev->loopid[count], loopid))
+            {
+               fprintf(stderr,"ASSIGNMENTS and RAWASSIGNMENTS list \
+different loops\n");
+               return(FALSE);
+            }
+            prev->post[count] = clusnum;
+            if(clusnum > prev->NPost)
+               prev->NPost = clusnum;
+         }
+         count++;
+      }
+      else if(!strcmp(name,"POSTCLUSTER"))
+      {
+         if(!strncmp(buffer,"MERGED",6))
+         {
+            if((merges = (PREVMERGE *)realloc(prev->merges,
+                             (prev->NMerge+1) * sizeof(PREVMERGE)))==NULL)
+            {
+               fprintf(stderr,"No memory for previous POSTCLUSTER\n");
+               return(FALSE);
+            }
+            prev->merges = merges;
+            merges += prev->NMerge;
+            if(sscanf(buffer,"MERGED cluster %d (%*[^)]) with %d \
+(%*[^)]), rmsd = %lf, max CA deviation = %lf, max CB deviation = %lf",
+                      &(merges->i), &(merges->j), &(merges->rms), 
+                      &(merges->CADev), &(merges->CBDev)) != 5)
+            {
+               fprintf(stderr,"Unable to read POSTCLUSTER line: %s\n",
+                       buffer);
+               return(FALSE);
+            }
+            (prev->NMerge)++;
+         }
+      }
+      else if(!strcmp(name,"CRITICALRESIDUES"))
+      {
+         /* Each cluster is a CLUSTER line followed by the residues and
+            a blank line. The text after the cluster number is kept
+         */
+         if(!strncmp(buffer,"CLUSTER ",8))
+         {
+            sscanf(buffer+8,"%d",&clusnum);
+            if((clusnum < 1) || (clusnum > n))
+            {
+               fprintf(stderr,"Cluster %d out of range in \
+CRITICALRESIDUES\n", clusnum);
+               return(FALSE);
+            }
+            if((chp = strchr(buffer+8,' '))==NULL)
+               chp = buffer + strlen(buffer);
+            strcpy(word, chp);
+            strcpy(buffer, word);
+         }
+         if(clusnum)
+         {
+            strcat(buffer,"\n");
+            if((prev->CritRes[clusnum] = 
+                blStrcatalloc(prev->CritRes[clusnum], buffer))==NULL)
+            {
+               fprintf(stderr,"No memory for previous \
+CRITICALRESIDUES\n");
+               return(FALSE);
+            }
+         }
+      }
+   }
+
+   /* Once the header is read, allocate the storage for each loop       */
+   if(!strcmp(name,"HEADER"))
+   {
+      if((prev->NLoops < 1) || (prev->MaxLen < 1))
+      {
+         fprintf(stderr,"Previous output HEADER has no loops\n");
+         return(FALSE);
+      }
+      prev->VecDim = 2;
+      if(!prev->CATorsions) prev->VecDim += 4;
+      if(prev->Metric == METRIC_ANGULAR) prev->VecDim /= 2;
+      if(prev->Angles)      prev->VecDim += 1;
+      if(prev->Distance)    prev->VecDim += 1;
+      prev->VecDim *= prev->MaxLen;
+
+      prev->loopid = (char **)blArray2D(sizeof(char), prev->NLoops, 
+                                        MAXBUFF);
+      prev->raw    = (int *)malloc(prev->NLoops * sizeof(int));
+      prev->post   = (int *)malloc(prev->NLoops * sizeof(int));
+      prev->index  = blInitializeHash((ULONG)prev->NLoops);
+      if((prev->loopid == NULL) || (prev->raw == NULL) ||
+         (prev->post == NULL) || (prev->index == NULL))
+      {
+         fprintf(stderr,"No memory for previous output\n");
+         return(FALSE);
+      }
+   }
+   else if((!strcmp(name,"RAWASSIGNMENTS") || 
+            !strcmp(name,"ASSIGNMENTS")) && (count != prev->NLoops))
+   {
+      fprintf(stderr,"%s section does not match HEADER\n",name);
+      return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void FreePrevClan(PREVCLAN *prev)
+   ---------------------------------
+   Input:   PREVCLAN *prev        Previous run to free
+
+   Frees the data read from a previous output file.
+
+   16.10.26 Original   By: ACRM
+*/
+void FreePrevClan(PREVCLAN *prev)
+{
+   int i;
+
+   if(prev->data != NULL)
+      FreeFeatures(prev->data);
+   if(prev->loopid != NULL)
+      blFreeArray2D((char **)prev->loopid, prev->NLoops, MAXBUFF);
+   if(prev->CritRes != NULL)
+   {
+      for(i=0; i<=prev->NCritRes; i++)
+      {
+         if(prev->CritRes[i] != NULL)
+            free(prev->CritRes[i]);
+      }
+      free(prev->CritRes);
+   }
+   if(prev->raw    != NULL) free(prev->raw);
+   if(prev->post   != NULL) free(prev->post);
+   if(prev->merges != NULL) free(prev->merges);
+   if(prev->index  != NULL) blFreeHash(prev->index);
+   free(prev);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteCheckpoint(char *filename, FEATURE **data, int NVec, 
+                        int VecDim, int NItems, int Method, int *ia, 
+                        int *ib, REAL *crit, int *micro)
+   ----------------------------------------------------------------
+   Input:   char    *filename     Checkpoint file to write
+            FEATURE **data        Data which was clustered
+            int     NVec          Number of vectors
+            int     VecDim        Vector dimension
+            int     NItems        Number of items clustered
+            int     Method        Clustering method
+            int     *ia           \
+            int     *ib           | Merge history from HierClus()
+            REAL    *crit         /
+            int     *micro        Item of each vector (or NULL)
+   Returns: BOOL                  Success?
+   Globals: DATALIST **gLoopTable Loop of each vector
+
+   Writes everything which post-clustering and the later steps need to
+   a binary file which RESUME can map back in: the settings which 
+   determine the vectors, the vectors themselves, the merge history, 
+   the item standing for each vector (for approximate Ward or COLLAPSE)
+   and the identifier, length and CA/CB coordinates of each loop. The
+   coordinates of all the loops are packed one after another.
+
+   The file is only meant to be read by the same build of clan on the
+   same machine, so everything is written as it is held in memory. Each
+   section starts on a FEATALIGN boundary and the rows of vectors are 
+   padded as in AllocFeatures(), so the vectors may be used in place.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL WriteCheckpoint(char *filename, FEATURE **data, int NVec, 
+                     int VecDim, int NItems, int Method, int *ia, 
+                     int *ib, REAL *crit, int *micro)
+{
+   FILE          *fp;
+   CHECKHEAD     head;
+   CHECKLOOP     loop;
+   DATALIST      *p;
+   unsigned long off,
+                 coor;
+   int           i;
+   BOOL          ok = TRUE;
+
+   memset(&head, 0, sizeof(CHECKHEAD));
+   memcpy(head.magic, CHECKMAGIC, 8);
+   head.FeatureSize = sizeof(FEATURE);
+   head.RealSize    = sizeof(REAL);
+   head.BuffSize    = MAXBUFF;
+   head.MaxLoopLen  = MAXLOOPLEN;
+   head.NVec        = NVec;
+   head.NItems      = NItems;
+   head.VecDim      = VecDim;
+   head.Method      = Method;
+   head.Metric      = gMetric;
+   head.MaxLen      = gMaxLoopLen;
+   head.NCollapsed  = sNCollapsed;
+   head.Distance    = gDoDistance;
+   head.Angles      = gDoAngles;
+   head.CATorsions  = gCATorsions;
+   head.HasMicro    = (micro != NULL);
+   for(i=0; i<gMaxLoopLen; i++)
+      head.Scheme[i] = gScheme[i];
+   head.stride      = CHECKALIGN(VecDim * sizeof(FEATURE)) / 
+                      sizeof(FEATURE);
+   for(i=0; i<NVec; i++)
+      head.ncoor += gLoopTable[i]->ncoor;
+
+   /* Lay out the sections                                              */
+   off              = CHECKALIGN(sizeof(CHECKHEAD));
+   head.DataOffset  = off;
+   off             += (unsigned long)NVec * head.stride * sizeof(FEATURE);
+   head.IAOffset    = off;
+   off             += CHECKALIGN(NItems * sizeof(int));
+   head.IBOffset    = off;
+   off             += CHECKALIGN(NItems * sizeof(int));
+   head.CritOffset  = off;
+   off             += CHECKALIGN(NItems * sizeof(REAL));
+   head.MicroOffset = off;
+   if(micro != NULL)
+      off          += CHECKALIGN(NVec * sizeof(int));
+   head.LoopOffset  = off;
+   off             += CHECKALIGN(NVec * sizeof(CHECKLOOP));
+   head.CAOffset    = off;
+   off             += CHECKALIGN(head.ncoor * sizeof(COOR));
+   head.CBOffset    = off;
+   off             += CHECKALIGN(head.ncoor * sizeof(COOR));
+   head.HasCBOffset = off;
+   off             += CHECKALIGN(head.ncoor * sizeof(BOOL));
+   head.size        = off;
+
+   if((fp=fopen(filename,"wb"))==NULL)
+   {
+      fprintf(stderr,"Warning: Unable to open checkpoint file: %s\n",
+              filename);
+      return(FALSE);
+   }
+
+   ok = (fwrite(&head, sizeof(CHECKHEAD), 1, fp) == 1) &&
+        PadCheckpoint(fp, sizeof(CHECKHEAD));
+   for(i=0; ok && i<NVec; i++)
+   {
+      ok = (fwrite(data[i], sizeof(FEATURE), VecDim, fp) == VecDim) &&
+           PadCheckpoint(fp, VecDim * sizeof(FEATURE));
+   }
+   if(ok)
+   {
+      ok = (fwrite(ia,   sizeof(int),  NItems, fp) == NItems) &&
+           PadCheckpoint(fp, NItems * sizeof(int)) &&
+           (fwrite(ib,   sizeof(int),  NItems, fp) == NItems) &&
+           PadCheckpoint(fp, NItems * sizeof(int)) &&
+           (fwrite(crit, sizeof(REAL), NItems, fp) == NItems) &&
+           PadCheckpoint(fp, NItems * sizeof(REAL));
+   }
+   if(ok && (micro != NULL))
+   {
+      ok = (fwrite(micro, sizeof(int), NVec, fp) == NVec) &&
+           PadCheckpoint(fp, NVec * sizeof(int));
+   }
+
+   /* The loops and their packed coordinates                            */
+   for(i=0, coor=0; ok && i<NVec; i++)
+   {
+      p = gLoopTable[i];
+      memset(&loop, 0, sizeof(CHECKLOOP));
+      strcpy(loop.loopid, p->loopid);
+      strcpy(loop.start,  p->start);
+      strcpy(loop.end,    p->end);
+      loop.length = p->length;
+      loop.ncoor  = p->ncoor;
+      loop.coor   = coor;
+      coor       += p->ncoor;
+      ok = (fwrite(&loop, sizeof(CHECKLOOP), 1, fp) == 1);
+   }
+   if(ok)
+      ok = PadCheckpoint(fp, NVec * sizeof(CHECKLOOP));
+   for(i=0; ok && i<NVec; i++)
+   {
+      p  = gLoopTable[i];
+      ok = (fwrite(p->ca, sizeof(COOR), p->ncoor, fp) == p->ncoor);
+   }
+   if(ok)
+      ok = PadCheckpoint(fp, head.ncoor * sizeof(COOR));
+   for(i=0; ok && i<NVec; i++)
+   {
+      p  = gLoopTable[i];
+      ok = (fwrite(p->cb, sizeof(COOR), p->ncoor, fp) == p->ncoor);
+   }
+   if(ok)
+      ok = PadCheckpoint(fp, head.ncoor * sizeof(COOR));
+   for(i=0; ok && i<NVec; i++)
+   {
+      p  = gLoopTable[i];
+      ok = (fwrite(p->hascb, sizeof(BOOL), p->ncoor, fp) == p->ncoor);
+   }
+   if(ok)
+      ok = PadCheckpoint(fp, head.ncoor * sizeof(BOOL));
+
+   if(fclose(fp) != 0)
+      ok = FALSE;
+   if(!ok)
+   {
+      fprintf(stderr,"Warning: Unable to write checkpoint file: %s\n",
+              filename);
+      unlink(filename);
+   }
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL PadCheckpoint(FILE *fp, unsigned long nbytes)
+   --------------------------------------------------
+   Input:   FILE          *fp      Checkpoint file
+            unsigned long nbytes   Size of the section just written
+   Returns: BOOL                   Success?
+
+   Writes zeros to take a section of a checkpoint file to the next 
+   FEATALIGN boundary.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL PadCheckpoint(FILE *fp, unsigned long nbytes)
+{
+   static char zeros[FEATALIGN];
+   size_t      pad = CHECKALIGN(nbytes) - nbytes;
+
+   return((pad == 0) || (fwrite(zeros, 1, pad, fp) == pad));
+}
+
+
+/************************************************************************/
+/*>CHECKPOINT *ReadCheckpoint(char *filename)
+   ------------------------------------------
+   Input:   char       *filename  Checkpoint from WriteCheckpoint()
+   Returns: CHECKPOINT *          The mapped checkpoint (NULL if the 
+                                  file could not be mapped or was 
+                                  written by a different build)
+
+   Maps a checkpoint file and finds its sections. The mapping is 
+   private, so the vectors may be used (and even changed) in place 
+   without touching the file.
+
+   16.10.26 Original   By: ACRM
+*/
+CHECKPOINT *ReadCheckpoint(char *filename)
+{
+   CHECKPOINT  *ckp;
+   CHECKHEAD   *head;
+   struct stat st;
+   void        *mem;
+   char        *base;
+   int         fd;
+
+   if((fd = open(filename, O_RDONLY)) < 0)
+   {
+      fprintf(stderr,"Unable to open checkpoint file: %s\n",filename);
+      return(NULL);
+   }
+   if((fstat(fd, &st) != 0) || 
+      ((unsigned long)st.st_size < sizeof(CHECKHEAD)))
+   {
+      fprintf(stderr,"Not a checkpoint file: %s\n",filename);
+      close(fd);
+      return(NULL);
+   }
+
+   mem = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE, 
+              MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(mem == MAP_FAILED)
+   {
+      fprintf(stderr,"Unable to map checkpoint file: %s\n",filename);
+      return(NULL);
+   }
+
+   /* Check it came from this build and is complete                     */
+   head = (CHECKHEAD *)mem;
+   if(memcmp(head->magic, CHECKMAGIC, 8) ||
+      (head->FeatureSize != sizeof(FEATURE)) ||
+      (head->RealSize    != sizeof(REAL))    ||
+      (head->BuffSize    != MAXBUFF)         ||
+      (head->MaxLoopLen  != MAXLOOPLEN)      ||
+      (head->size        != (unsigned long)st.st_size))
+   {
+      fprintf(stderr,"Checkpoint file %s is incomplete or was written \
+by a different build\n", filename);
+      munmap(mem, (size_t)st.st_size);
+      return(NULL);
+   }
+
+   if((ckp = (CHECKPOINT *)malloc(sizeof(CHECKPOINT)))==NULL)
+   {
+      fprintf(stderr,"No memory for checkpoint\n");
+      munmap(mem, (size_t)st.st_size);
+      return(NULL);
+   }
+
+   base        = (char *)mem;
+   ckp->head   = head;
+   ckp->data   = (FEATURE *)(base + head->DataOffset);
+   ckp->ia     = (int *)(base + head->IAOffset);
+   ckp->ib     = (int *)(base + head->IBOffset);
+   ckp->crit   = (REAL *)(base + head->CritOffset);
+   ckp->micro  = (head->HasMicro) ? (int *)(base + head->MicroOffset) 
+                                  : NULL;
+   ckp->loops  = (CHECKLOOP *)(base + head->LoopOffset);
+   ckp->ca     = (COOR *)(base + head->CAOffset);
+   ckp->cb     = (COOR *)(base + head->CBOffset);
+   ckp->hascb  = (BOOL *)(base + head->HasCBOffset);
+
+   return(ckp);
+}
+
+
+/************************************************************************/
+/*>FEATURE **ResumeLoops(CHECKPOINT *ckp, int *NData, int *VecDim)
+   ---------------------------------------------------------------
+   Input:   CHECKPOINT *ckp       Checkpoint being resumed
+   Output:  int        *NData     Number of vectors
+            int        *VecDim    Vector dimension
+   Returns: FEATURE    **         Vectors (NULL if allocations fail)
+   Globals: DATALIST   *gDataList Set to the loops in the checkpoint
+
+   Restores the settings which determined the vectors and builds the 
+   data linked list from the loops in the checkpoint. Their coordinates
+   are copied in for post-clustering; the structures are only read by 
+   LoadLoop() if critical residues are wanted.
+
+   The vectors are used where they are mapped. Only the array of row 
+   pointers is allocated, so it is still freed with FreeFeatures().
+
+   16.10.26 Original   By: ACRM
+*/
+FEATURE **ResumeLoops(CHECKPOINT *ckp, int *NData, int *VecDim)
+{
+   CHECKHEAD *head = ckp->head;
+   CHECKLOOP *loop;
+   DATALIST  *list = NULL,
+             *p    = NULL;
+   FEATURE   **data;
+   int       i;
+
+   gClusterMethod = head->Method;
+   gMetric        = head->Metric;
+   gMaxLoopLen    = head->MaxLen;
+   gDoDistance    = head->Distance;
+   gDoAngles      = head->Angles;
+   gCATorsions    = head->CATorsions;
+   sNCollapsed    = head->NCollapsed;
+   for(i=0; i<gMaxLoopLen; i++)
+      gScheme[i] = head->Scheme[i];
+   if(gMetric != METRIC_RMSD)
+      FeatureLayout(gCATorsions);
+
+   if((data = (FEATURE **)malloc(head->NVec * sizeof(FEATURE *)))==NULL)
+   {
+      fprintf(stderr,"No memory for data array.\n");
+      return(NULL);
+   }
+   for(i=0; i<head->NVec; i++)
+      data[i] = ckp->data + (unsigned long)i * head->stride;
+
+   for(i=0; i<head->NVec; i++)
+   {
+      if(list == NULL)
+      {
+         INIT(list, DATALIST);
+         p = list;
+      }
+      else
+      {
+         ALLOCNEXT(p, DATALIST);
+      }
+      if(p == NULL)
+      {
+         FREELIST(list, DATALIST);
+         free(data);
+         fprintf(stderr,"No memory for loops from checkpoint\n");
+         return(NULL);
+      }
+
+      loop          = ckp->loops + i;
+      p->allatompdb = NULL;
+      p->pdbloop    = NULL;
+      p->torsionpdb = NULL;
+      p->newer      = p->older = NULL;
+      p->pdbbytes   = 0;
+      p->pins       = 0;
+      p->length     = loop->length;
+      p->ncoor      = loop->ncoor;
+      strcpy(p->loopid, loop->loopid);
+      strcpy(p->start,  loop->start);
+      strcpy(p->end,    loop->end);
+      memcpy(p->ca,    ckp->ca    + loop->coor, loop->ncoor * sizeof(COOR));
+      memcpy(p->cb,    ckp->cb    + loop->coor, loop->ncoor * sizeof(COOR));
+      memcpy(p->hascb, ckp->hascb + loop->coor, loop->ncoor * sizeof(BOOL));
+   }
+
+   gDataList = list;
+   *NData    = head->NVec;
+   *VecDim   = head->VecDim;
+
+   return(data);
+}
+
+
+/************************************************************************/
+/*>void FreeCheckpoint(CHECKPOINT *ckp)
+   ------------------------------------
+   Input:   CHECKPOINT *ckp       Checkpoint to free
+
+   Unmaps a checkpoint file read by ReadCheckpoint().
+
+   16.10.26 Original   By: ACRM
+*/
+void FreeCheckpoint(CHECKPOINT *ckp)
+{
+   munmap((void *)(ckp->head), (size_t)(ckp->head->size));
+   free(ckp);
+}
+
+
+/************************************************************************/
+/*>BOOL ShowClusters(FILE *fp, FEATURE **data, int NVec, int VecDim, 
+                     int Method, BOOL ShowTable, BOOL ShowDendogram)
+   --------------------------------------------------------------------
+   Input:   FILE    *fp           Output file pointer
+            FEATURE **data        2D array of data to cluster
+            int  NVec             Number of vectors to cluster
+            int  VecDim           Dimension of the vectors
+            int  Method           Clustering method (1--7)
+            BOOL ShowTable        Display clustering table?
+            BOOL ShowDendogram    Display clustering dendogram?
+   Returns: BOOL                  Success of memory allocations (local,
+                                  in clustering or in critical residue
+                                  definition)
+
+   Allocate temporary arrays, call clustering, post-clustering, 
+   data-writing and critical residue code and free the temporary arrays.
+
+   21.06.95 Original    By: ACRM
+   29.06.95 Initialise all pointers to NULL
+   06.07.95 Added PostCluster() call
+   24.07.95 Added WriteClusData() call
+   08.08.95 Added DefineCriticalResidues() call
+   15.08.95 Modified to use a single array to store the clusters at the
+            clustering level of ineterest rather than always looking in
+            the 2D clusters array
+   16.08.95 PostCluster() now returns the new number of clusters
+   25.09.95 Passes VecDim to ClusterDendogram if Method==1 (else passes
+            1.0)
+   16.10.26 ClusterAssign() returns merge levels rather than a 2D array
+            of assignments. Only works out the dendrogram ordering if 
+            the dendrogram is wanted
+   16.10.26 Approximate Ward (Method 8) clusters micro-clusters from 
+            MicroCluster() and maps each vector back through its
+            micro-cluster. Frees TheClusters
+   16.10.26 When updating a previous run, clusters its raw clusters
+            with the new loops. Post-clustering and critical residues
+            are only redone for clusters which have changed
+   16.10.26 Data and centres are FEATURE arrays from AllocFeatures()
+   16.10.26 Criterion scaled by the sin/cos dimension for the angular
+            metric
+   16.10.26 With COLLAPSE, duplicate vectors are clustered once as
+            weighted items and mapped back like micro-clusters
+   16.10.26 Tree cut by CutTree(). Added SWEEP
+   16.10.26 Added BOOTSTRAP
+   16.10.26 Writes a CHECKPOINT once the tree is built. When resuming,
+            takes the tree from the checkpoint instead
+*/
+BOOL ShowClusters(FILE *fp, FEATURE **data, int NVec, int VecDim, 
+                  int Method, BOOL ShowTable, BOOL ShowDendogram)
+{
+   int  *ia           = NULL,
+        *ib           = NULL,
+        lev           = NVec,
+        *iorder       = NULL,
+        *height       = NULL,
+        *merged       = NULL,
+        *TheClusters  = NULL,
+        *micro        = NULL,
+        *ItemClusters = NULL,
+        *OldRaw       = NULL,
+        *RawClusters  = NULL,
+        NItems        = NVec,
+        NCentres      = 0,
+        NClus,
+        OldNClus;
+   REAL    *crit      = NULL,
+           *critval   = NULL,
+           *weights   = NULL;
+   FEATURE **items    = data,
+           **centres  = NULL;
+   BOOL    ok         = TRUE;
+   char    **out      = NULL,
+           **CritCopy = NULL;
+
+   ia          = (int *)malloc(NVec * sizeof(int));
+   ib          = (int *)malloc(NVec * sizeof(int));
+   crit        = (REAL *)malloc(NVec * sizeof(REAL));
+   TheClusters = (int *)malloc(NVec * sizeof(int));
+
+   iorder      = (int *)malloc(lev * sizeof(int));
+   height      = (int *)malloc(lev * sizeof(int));
+   critval     = (REAL *)malloc(lev * sizeof(REAL));
+
+   if(ia==NULL      ||
+      ib==NULL      ||
+      crit==NULL    ||
+      critval==NULL ||
+      iorder==NULL  ||
+      height==NULL  ||
+      TheClusters==NULL)
+   {
+      if(ia          != NULL) free(ia);
+      if(ib          != NULL) free(ib);
+      if(iorder      != NULL) free(iorder);
+      if(height      != NULL) free(height);
+      if(crit        != NULL) free(crit);
+      if(critval     != NULL) free(critval);
+      if(TheClusters != NULL) free(TheClusters);
+      return(FALSE);
+   }
+
+   /* When updating a previous run, its raw clusters and the new loops
+      are clustered in place of the original vectors. For approximate 
+      Ward, compress the data into micro-clusters which are clustered
+      instead. Otherwise duplicate vectors may be collapsed into single
+      weighted items. When resuming, the vectors are mapped to items as
+      in the run which was checkpointed.
+   */
+   if(sResume != NULL)
+      NCentres = (sResume->micro != NULL) ? sResume->head->NItems : 0;
+   else if(sPrev != NULL)
+      NCentres = sPrev->NRaw + NVec - sPrev->NLoops;
+   else if((Method == 8) && (NVec > sNMicro))
+      NCentres = sNMicro;
+   else if(sCollapse)
+      NCentres = NVec;
+
+   if(NCentres)
+   {
+      micro        = (int *)malloc(NVec * sizeof(int));
+      ItemClusters = (int *)malloc(NCentres * sizeof(int));
+      if(sResume == NULL)
+      {
+         centres   = AllocFeatures(NCentres, VecDim);
+         weights   = (REAL *)malloc(NCentres * sizeof(REAL));
+      }
+
+      NItems = 0;
+      if((sResume != NULL) && micro!=NULL && ItemClusters!=NULL)
+      {
+         memcpy(micro, sResume->micro, NVec * sizeof(int));
+         NItems = NCentres;
+      }
+      else if(centres!=NULL && weights!=NULL && micro!=NULL && 
+              ItemClusters!=NULL)
+      {
+         if(sPrev != NULL)
+            NItems = PrevClanItems(data, NVec, VecDim, centres, weights,
+                                   micro);
+         else if((Method == 8) && (NVec > sNMicro))
+            NItems = MicroCluster(data, NVec, VecDim, sNMicro, centres,
+                                  weights, micro);
+         else
+            NItems = CollapseDuplicates(data, NVec, VecDim, 
+                                        sCollapseTol, centres, weights,
+                                        micro);
+      }
+
+      if(NItems == 0)
+      {
+         if(centres      != NULL) FreeFeatures(centres);
+         if(weights      != NULL) free(weights);
+         if(micro        != NULL) free(micro);
+         if(ItemClusters != NULL) free(ItemClusters);
+         free(ia);
+         free(ib);
+         free(iorder);
+         free(height);
+         free(crit);
+         free(critval);
+         free(TheClusters);
+         return(FALSE);
+      }
+      items = centres;
+      lev   = NItems;
+   }
+
+   /* Write a header for the clustering                                 */
+   WriteHeader(fp,Method,NVec,NItems,VecDim,gScheme);
+
+   /* Write the raw cluster data                                        */
+   if(gDoData)
+      WriteClusData(fp,NVec,VecDim,data);
+   
+   /* Do the clustering, or take the tree from the checkpoint, and
+      save a checkpoint if required. Failing to write the checkpoint
+      does not stop the run
+   */
+   if(sResume != NULL)
+   {
+      memcpy(ia,   sResume->ia,   NItems * sizeof(int));
+      memcpy(ib,   sResume->ib,   NItems * sizeof(int));
+      memcpy(crit, sResume->crit, NItems * sizeof(REAL));
+   }
+   else if(!HierClus(NItems,VecDim,((Method==8)?1:Method),items,weights,
+                     sNThreads,sDissimStore,sDissimFile,ia,ib,crit))
+   {
+      ok = FALSE;
+   }
+   else if(sCheckFile[0] != '\0')
+   {
+      WriteCheckpoint(sCheckFile, data, NVec, VecDim, NItems, Method,
+                      ia, ib, crit, micro);
+   }
+
+   if(ok)
+   {
+      /* Assign data to clusters                                        */
+      if((merged = ClusterAssign((ShowTable?fp:NULL),NItems,ia,ib,lev,
+                                 NVec,micro))
+         !=NULL)
+      {
+         /* Print the dendogram                                         */
+         if(ShowDendogram)
+         {
+            DendogramOrder(NItems,ia,ib,crit,merged,lev,iorder,critval,
+                           height);
+            if((out = ClusterDendogram(fp,lev,iorder,height,critval,
+                                       ((Method==1 || Method==8)?
+                                        EXPANDEDDIM(VecDim):1.0)))
+               ==NULL)
+               ok = FALSE;
+         }
+
+
+         /* Find number of distinct clusters. The cutoff is per 
+            dimension of the sin/cos vectors whatever the metric
+         */
+         NClus = FindNumTrueClusters(crit, lev, EXPANDEDDIM(VecDim),
+                                     (REAL)CLUSCUT);
+
+         /* Setup the TheClusters array with these values               */
+         CutTree(NVec, NItems, ia, ib, merged, NClus, micro, 
+                 ItemClusters, TheClusters);
+
+         /* When updating, find the clusters which have not changed so
+            their post-clustering need not be repeated. If this fails,
+            everything is simply done again
+         */
+         if(sPrev != NULL)
+            OldRaw = UnchangedClusters(ItemClusters, NItems, NClus);
+
+         WriteResults(fp, TheClusters, NClus, data, NVec, VecDim, crit, 
+                      FALSE);
+         OldNClus = NClus;
+
+         /* Keep the raw clusters for the bootstrap                     */
+         if(sNBoot && (NCentres == 0))
+         {
+            if((RawClusters = (int *)malloc(NVec * sizeof(int)))==NULL)
+               ok = FALSE;
+            else
+               memcpy(RawClusters, TheClusters, NVec * sizeof(int));
+         }
+         else if(sNBoot)
+         {
+            fprintf(stderr,"Note: BOOTSTRAP is not done with METHOD \
+approximate, COLLAPSE or UPDATE\n");
+         }
+
+         if((NClus = PostCluster(fp, TheClusters, data, NVec, VecDim, 
+                                 crit, NClus, OldRaw))==0)
+         {
+            ok = FALSE;
+         }
+         else
+         {
+            WriteResults(fp, TheClusters, NClus, data, NVec, VecDim, 
+                         crit, TRUE);
+            if(gDoCritRes)
+            {
+               if(sPrev != NULL)
+                  CritCopy = PrevCritRes(TheClusters, NVec, NClus);
+               if(!DefineCriticalResidues(fp,TheClusters,data,NVec,VecDim,
+                                          crit, NClus, CritCopy))
+                  ok = FALSE;
+            }
+
+            /* Try the other settings on the same tree                  */
+            if(ok && sNSweep)
+               ok = SweepClusters(fp, data, NVec, VecDim, NItems, ia, ib,
+                                  merged, crit, lev, micro);
+
+            /* Stability of the raw clusters                            */
+            if(ok && (RawClusters != NULL))
+               ok = Bootstrap(fp, data, NVec, VecDim, 
+                              ((Method==8)?1:Method), RawClusters, 
+                              OldNClus, TheClusters);
+         }
+      }
+      else
+      {
+         ok = FALSE;
+      }
+   }
+
+   /* Free allocated memory                                             */
+   if(merged   != NULL) free(merged);
+   if(out      != NULL) blFreeArray2D((char **)out,lev*3,lev*3);
+   if(ia       != NULL) free(ia);
+   if(ib       != NULL) free(ib);
+   if(iorder   != NULL) free(iorder);
+   if(height   != NULL) free(height);
+   if(crit     != NULL) free(crit);
+   if(critval  != NULL) free(critval);
+   if(centres  != NULL) FreeFeatures(centres);
+   if(weights  != NULL) free(weights);
+   if(micro    != NULL) free(micro);
+   if(ItemClusters != NULL) free(ItemClusters);
+   if(OldRaw   != NULL) free(OldRaw);
+   if(CritCopy != NULL) free(CritCopy);
+   if(RawClusters != NULL) free(RawClusters);
+   free(TheClusters);
+   
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL HierClus(int NVec, int VecDim, int ClusterMethod, 
+                 FEATURE **data, REAL *weights, int NThreads, 
+                 int StoreType, char *StoreFile, int *ia, int *ib, 
+                 REAL *crit)
+   -------------------------------------------------------------------
+   Input:   int     NVec              Number of vectors to cluster
+            int     VecDim            Dimension of each vector
+            FEATURE **data            Input data matrix [NVec][VecDim]
+            int     ClusterMethod     Clustering criterion to be used
+            REAL    weights[NVec]     Number of objects represented by
+                                      each vector (or NULL for 1)
+            int     NThreads          Number of threads to use
+            int     StoreType         Dissimilarity storage 
+                                      (DISSIM_DOUBLE, _FLOAT, _MMAP or
+                                      _MMAPFLOAT)
+            char    *StoreFile        File to map (or NULL)
+   Output:  int     ia[NVec]          \
+                    ib[NVec]          | History of allomerations
+            REAL    crit[NVec]        /
+   Returns: BOOL                      Success of memory allocations
+
+   Hierarchical clustering using user-specified criterion. 
+   Each vector may stand for a group of objects (e.g. a micro-cluster
+   with its centroid as the vector), in which case the cluster
+   cardinalities start from the weights. For Ward's method the initial
+   dissimilarities are also scaled by the weights so they are the 
+   increase in variance from merging the groups.
+
+   Everything is passed in and the data matrix is only read (through a
+   local array of row pointers counting from 1), so several threads 
+   may cluster at once, e.g. for BOOTSTRAP.
+                                                             
+   20.06.95 Original By: ACRM
+            Based on FORTRAN code by F. Murtagh, ESA/ESO/STECF, Garching,
+            February 1986 available in STATLIB.
+   26.06.95 Fixed frees on error
+   29.06.95 Fix the pointers in the data array when finished
+   30.01.09 Initialize some variables
+   16.10.26 Agglomeration split out into NNListCluster() and 
+            NNChainCluster(); the latter is used for the reducible 
+            methods (Ward, single, complete, average, McQuitty)
+   16.10.26 Single linkage handed to MSTCluster() unless METRIC RMSD
+   16.10.26 Dissimilarities held in a DISSIMSTORE
+   16.10.26 Added weights
+   16.10.26 Data are a FEATURE array
+   16.10.26 Added NThreads, StoreType and StoreFile so there is no
+            global state. Data no longer modified. Agglomeration moved
+            to AgglomerateStore()
+*/
+BOOL HierClus(int NVec, int VecDim, int ClusterMethod, FEATURE **data, 
+              REAL *weights, int NThreads, int StoreType, char *StoreFile,
+              int *ia, int *ib, REAL *crit)
+{
+   int         i;
+   FEATURE     **rows;
+   BOOL        ok     = TRUE;
+   DISSIMSTORE store;
+
+   /* Single linkage is read off the minimum spanning tree, so there is
+      no need to store the dissimilarity matrix
+   */
+   if((ClusterMethod == 2) && (gMetric != METRIC_RMSD))
+      return(MSTCluster(NVec, VecDim, data, ia, ib, crit, NThreads));
+
+   /* Rows counting FORTRAN-style from 1                                */
+   if((rows = (FEATURE **)malloc((NVec+1) * sizeof(FEATURE *)))==NULL)
+      return(FALSE);
+   for(i=0; i<NVec; i++)
+      rows[i+1] = data[i] - 1;
+
+   /* Stores dissimilarities in lower half diagonal (counting from 1)   */
+   if(!AllocDissimStore(&store, NVec, StoreType, StoreFile))
+   {
+      free(rows);
+      return(FALSE);
+   }
+
+   /* Construct dissimilarity matrix and carry out the agglomeration    */
+   if(BuildDissim(NVec, VecDim, ClusterMethod, rows, 
+                  ((weights==NULL) ? NULL : weights-1), &store, NThreads))
+      ok = AgglomerateStore(NVec, ClusterMethod, &store, weights, 
+                            ia, ib, crit);
+   else
+      ok = FALSE;
+
+   FreeDissimStore(&store);
+   free(rows);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL AgglomerateStore(int NVec, int ClusterMethod, 
+                         DISSIMSTORE *store, REAL *weights, int *ia, 
+                         int *ib, REAL *crit)
+   -------------------------------------------------------------------
+   Input:   int         NVec           Number of vectors to cluster
+            int         ClusterMethod  Clustering criterion to be used
+            REAL        weights[NVec]  Number of objects represented by
+                                       each vector (or NULL for 1)
+   I/O:     DISSIMSTORE *store         Dissimilarities (from 1). These
+                                       are overwritten
+   Output:  int         ia[NVec]       \
+                        ib[NVec]       | History of allomerations
+                        REAL crit[NVec]/
+   Returns: BOOL                       Success of memory allocations
+
+   Carries out the agglomeration given the dissimilarity matrix. The 
+   reducible methods can use a nearest-neighbour chain which is O(N^2);
+   the others must keep a list of near neighbours for every cluster.
+
+   16.10.26 Original, taken out of HierClus()   By: ACRM
+*/
+BOOL AgglomerateStore(int NVec, int ClusterMethod, DISSIMSTORE *store,
+                      REAL *weights, int *ia, int *ib, REAL *crit)
+{
+   int  i, 
+        *NearNeighb = NULL;
+   REAL *DissimNearNeighb = NULL,
+        *membr = NULL;
+   BOOL *Flag = NULL,
+        ok    = TRUE;
+
+   /* Indicate agglomerable object/clusters                             */
+   Flag  = (BOOL *)malloc(NVec * sizeof(BOOL));
+   /* Current nearest neighbour storage                                 */
+   NearNeighb    = (int  *)malloc(NVec * sizeof(int));
+   /* Cluster cardinalities                                             */
+   membr = (REAL *)malloc(NVec * sizeof(REAL));
+   /* Dissimilarity of nearest neighbour                                */
+   DissimNearNeighb = (REAL *)malloc(NVec * sizeof(REAL));
+
+   /* Check allocations                                                 */
+   if(Flag             == NULL || 
+      NearNeighb       == NULL || 
+      membr            == NULL || 
+      DissimNearNeighb == NULL)
+   {
+      if(Flag!=NULL)             free(Flag);
+      if(NearNeighb!=NULL)       free(NearNeighb);
+      if(membr!=NULL)            free(membr);
+      if(DissimNearNeighb!=NULL) free(DissimNearNeighb);
+
+      return(FALSE);
+   }
+
+   /* For all arrays, move pointer back one so we count FORTRAN-style
+      from 1 rather than from 0
+   */
+   Flag--;                  /* Local arrays                             */
+   NearNeighb--;
+   membr--;
+   DissimNearNeighb--;
+
+   crit--;                  /* Passed parameter arrays                  */
+   ib--;
+   ia--;
+   
+   /* Initializations                                                   */
+   for(i=1; i<=NVec; i++) 
+   {
+      membr[i] = (weights==NULL) ? (REAL)1.0 : weights[i-1];
+      Flag[i]  = TRUE;
+   }
+   
+   if(REDUCIBLE(ClusterMethod))
+      ok = NNChainCluster(NVec, ClusterMethod, store, membr, Flag,
+                          NearNeighb, ia, ib, crit);
+   else
+      NNListCluster(NVec, ClusterMethod, store, membr, Flag,
+                    NearNeighb, DissimNearNeighb, ia, ib, crit);
+
+   free(++DissimNearNeighb);
+   free(++membr);
+   free(++NearNeighb);
+   free(++Flag);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>unsigned long DissimStoreBytes(int NVec, int ClusterMethod)
+   -----------------------------------------------------------
+   Input:   int  NVec            Number of vectors to cluster
+            int  ClusterMethod   Clustering criterion to be used
+   Returns: unsigned long        Bytes needed for the dissimilarity 
+                                 matrix
+   Globals: int  sDissimStore    Storage type
+
+   Works out the size of the dissimilarity matrix which HierClus() will
+   allocate. Single linkage does not need one except with METRIC RMSD.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Allows for the blocked layout and floats with DISSIM_MMAP
+*/
+unsigned long DissimStoreBytes(int NVec, int ClusterMethod)
+{
+   unsigned long NElem;
+
+   if((ClusterMethod == 2) && (gMetric != METRIC_RMSD))
+      return(0);
+   NElem = DissimElems(NVec, ((sDissimStore == DISSIM_MMAP) ||
+                              (sDissimStore == DISSIM_MMAPFLOAT)));
+   if((sDissimStore == DISSIM_FLOAT) || (sDissimStore == DISSIM_MMAPFLOAT))
+      return(NElem * sizeof(float));
+   return(NElem * sizeof(REAL));
+}
+
+
+/************************************************************************/
+/*>unsigned long DissimElems(int NVec, BOOL blocked)
+   -------------------------------------------------
+   Input:   int  NVec            Number of vectors to cluster
+            BOOL blocked         Use the blocked layout
+   Returns: unsigned long        Elements in the dissimilarity matrix
+
+   Works out how many elements the dissimilarity matrix holds. The 
+   blocked layout stores whole DISSIMBLOCK x DISSIMBLOCK blocks on and 
+   above the diagonal, so includes the unused lower half of the
+   diagonal blocks and the padding of the last row of blocks.
+
+   16.10.26 Original   By: ACRM
+*/
+unsigned long DissimElems(int NVec, BOOL blocked)
+{
+   unsigned long nb;
+
+   if(!blocked)
+      return((unsigned long)NVec * (NVec-1) / 2);
+
+   nb = ((unsigned long)NVec + DISSIMBLOCK - 1) / DISSIMBLOCK;
+   return(nb * (nb+1) / 2 * DISSIMBLOCK * DISSIMBLOCK);
+}
+
+
+/************************************************************************/
+/*>long BlockOffset(int NVec, int i, int j)
+   ----------------------------------------
+   Input:   int  NVec            Number of vectors to cluster
+            int  i               First vector (from 1)
+            int  j               Second vector (from 1, j>i)
+   Returns: long                 Offset (from 1) into a blocked matrix
+
+   Equivalent of IOFFSET() for the blocked layout used with DISSIM_MMAP.
+   The upper triangle of blocks is stored row of blocks by row of 
+   blocks, and each block is stored row by row.
+
+   16.10.26 Original   By: ACRM
+*/
+long BlockOffset(int NVec, int i, int j)
+{
+   long bi = (i-1) / DISSIMBLOCK,
+        bj = (j-1) / DISSIMBLOCK,
+        nb = ((long)NVec + DISSIMBLOCK - 1) / DISSIMBLOCK;
+
+   return(((bi*nb - bi*(bi-1)/2 + (bj-bi)) * DISSIMBLOCK + 
+           (i-1) % DISSIMBLOCK) * DISSIMBLOCK + (j-1) % DISSIMBLOCK + 1);
+}
+
+
+/************************************************************************/
+/*>BOOL AllocDissimStore(DISSIMSTORE *store, int NVec, int type,
+                         char *filename)
+   ---------------------------------------------------------------
+   Input:   int         NVec            Number of vectors to cluster
+            int         type            Storage type
+            char        *filename       File to map (or NULL)
+   Output:  DISSIMSTORE *store          The storage
+   Returns: BOOL                        Success of allocation
+
+   Allocates the lower half diagonal dissimilarity matrix as REALs or 
+   floats in memory, or in a memory-mapped file. The file is extended
+   to the right size and unlinked once it is mapped so that it 
+   disappears when the clustering is finished. The storage pointers are 
+   moved back one so that they count from 1.
+
+   Each merge reads and updates the whole row and column of the merged
+   cluster. Stored row by row, the column touches one element in each 
+   row and so a different page for nearly every cluster, which for a
+   memory-mapped matrix larger than the page cache means re-reading 
+   the file for almost every merge. The mapped file is therefore held 
+   in DISSIMBLOCK x DISSIMBLOCK blocks (see BlockOffset()) so that a 
+   row or column comes from one block in each block row, about 
+   NVec/DISSIMBLOCK contiguous 8KB (4KB for floats) reads.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Storage type and file passed in rather than global
+   16.10.26 Reports the size and storage type if memory allocation 
+            fails
+   16.10.26 Mapped file is blocked and may hold floats
+*/
+BOOL AllocDissimStore(DISSIMSTORE *store, int NVec, int type, 
+                      char *filename)
+{
+   void *mem = NULL;
+   int  fd;
+   BOOL mapped = ((type == DISSIM_MMAP) || (type == DISSIM_MMAPFLOAT)),
+        single = ((type == DISSIM_FLOAT) || (type == DISSIM_MMAPFLOAT));
+
+   store->type    = type;
+   store->blocked = mapped;
+   store->nbytes  = DissimElems(NVec, mapped) *
+                    (single ? sizeof(float) : sizeof(REAL));
+   store->d       = NULL;
+   store->f       = NULL;
+
+   /* Make sure we always have something to map or allocate            */
+   if(store->nbytes == 0)
+      store->nbytes = sizeof(REAL);
+
+   if(mapped)
+   {
+      if((fd = open(filename, O_RDWR|O_CREAT|O_TRUNC, 0600)) < 0)
+      {
+         fprintf(stderr,"Unable to create dissimilarity file: %s\n",
+                 filename);
+         return(FALSE);
+      }
+
+      if((lseek(fd, (off_t)(store->nbytes-1), SEEK_SET) < 0) ||
+         (write(fd, "", 1) != 1))
+      {
+         fprintf(stderr,"Unable to extend dissimilarity file: %s\n",
+                 filename);
+         close(fd);
+         unlink(filename);
+         return(FALSE);
+      }
+
+      mem = mmap(NULL, store->nbytes, PROT_READ|PROT_WRITE, MAP_SHARED,
+                 fd, 0);
+      close(fd);
+      unlink(filename);
+
+      if(mem == MAP_FAILED)
+      {
+         fprintf(stderr,"Unable to map dissimilarity file: %s\n",
+                 filename);
+         return(FALSE);
+      }
+   }
+   else
+   {
+      if((mem = malloc(store->nbytes)) == NULL)
+      {
+         fprintf(stderr,"Unable to allocate %lu bytes for the \
+dissimilarity matrix (DISSIMSTORE %s)\n", store->nbytes,
+                 ((type == DISSIM_FLOAT) ? "FLOAT" : "DOUBLE"));
+         fprintf(stderr,"Try %sDISSIMSTORE MMAP <file>%s to keep it in a \
+scratch file\n", ((type == DISSIM_FLOAT) ? "" : 
+                   "DISSIMSTORE FLOAT to halve it, or "),
+                 ((type == DISSIM_FLOAT) ? " FLOAT" : ""));
+         return(FALSE);
+      }
+   }
+
+   if(single)
+      store->f = (float *)mem - 1;
+   else
+      store->d = (REAL *)mem - 1;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void FreeDissimStore(DISSIMSTORE *store)
+   ----------------------------------------
+   I/O:     DISSIMSTORE *store     The storage
+
+   Frees or unmaps storage allocated by AllocDissimStore()
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Unmaps both memory-mapped types
+*/
+void FreeDissimStore(DISSIMSTORE *store)
+{
+   void *mem = (store->f != NULL) ? (void *)(store->f + 1) : 
+                                    (void *)(store->d + 1);
+
+   if(store->blocked)
+      munmap(mem, store->nbytes);
+   else
+      free(mem);
+
+   store->d = NULL;
+   store->f = NULL;
+}
+
+
+/************************************************************************/
+/*>BOOL BuildDissim(int NVec, int VecDim, int ClusterMethod, 
+                    FEATURE **data, REAL *weights, DISSIMSTORE *store,
+                    int NThreads)
+   ----------------------------------------------------------------------
+   Input:   int         NVec               Number of vectors to cluster
+            int         VecDim             Dimension of each vector
+            int         ClusterMethod      Clustering criterion to be used
+            FEATURE     data[NVec][VecDim] Input data matrix
+            REAL        weights[NVec]      Vector weights (or NULL)
+            int         NThreads           Number of threads to use
+   Output:  DISSIMSTORE *store             Lower half diagonal 
+                                           dissimilarities
+   Returns: BOOL                           Success of memory allocations
+
+   Fills in the squared Euclidean distances between each pair of 
+   vectors (halved for Ward's method, or scaled by ni*nj/(ni+nj) if
+   there are weights). The upper triangle is split into
+   tiles of columns; each tile is transposed into a small buffer which
+   fits in cache so that the innermost loop runs over adjacent columns
+   and can be vectorized by the compiler. Each distance is still summed 
+   over the dimensions in order, so the results are identical to a 
+   simple double loop whatever the number of threads. Tiles are handed
+   out to NThreads threads, largest first.
+   data, weights and the store count FORTRAN-style from 1 as set up by
+   HierClus()
+   For METRIC RMSD the dissimilarity is the sum of squared deviations
+   after superposing the pair and the rate is reported on stderr.
+
+   16.10.26 Original, taken out of HierClus()   By: ACRM
+   16.10.26 Added RMSD metric with pairs/s reported
+   16.10.26 Added NThreads
+   16.10.26 Tile width allows for raw torsions expanded to sin/cos.
+            Threads take panels of several tiles with raw torsions
+*/
+BOOL BuildDissim(int NVec, int VecDim, int ClusterMethod, 
+                 FEATURE **data, REAL *weights, DISSIMSTORE *store,
+                 int NThreads)
+{
+   DISSIMJOB       *jobs;
+   pthread_t       *threads;
+   pthread_mutex_t mutex;
+   int             TileSize,
+                   PanelSize,
+                   NextTile,
+                   i;
+   BOOL            ok = TRUE;
+   struct timeval  t0, t1;
+   double          secs;
+   long            NPairs;
+
+   gettimeofday(&t0, NULL);
+   NThreads = MAX(NThreads, 1);
+
+   /* Choose a tile width so the transposed tile fits in L1 cache       */
+   TileSize = DISSIMTILEBYTES / (EXPANDEDDIM(VecDim) * sizeof(FEATURE));
+   TileSize = MAX(8, TileSize - TileSize%8);
+
+   /* Raw torsions are expanded for each row of a tile, so threads take
+      wider tiles to share this between more columns
+   */
+   PanelSize = (gResTorsions) ? TileSize * DISSIMPANEL : TileSize;
+   NextTile  = (NVec - 2) / PanelSize;
+   NThreads = MIN(NThreads, NextTile+1);
+
+   jobs    = (DISSIMJOB *)malloc(NThreads * sizeof(DISSIMJOB));
+   threads = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+   if(jobs==NULL || threads==NULL)
+   {
+      if(jobs!=NULL)    free(jobs);
+      if(threads!=NULL) free(threads);
+      return(FALSE);
+   }
+
+   pthread_mutex_init(&mutex, NULL);
+   for(i=0; i<NThreads; i++)
+   {
+      jobs[i].data          = data;
+      jobs[i].weights       = weights;
+      jobs[i].store         = store;
+      jobs[i].NVec          = NVec;
+      jobs[i].VecDim        = VecDim;
+      jobs[i].ClusterMethod = ClusterMethod;
+      jobs[i].TileSize      = TileSize;
+      jobs[i].PanelSize     = PanelSize;
+      jobs[i].NextTile      = &NextTile;
+      jobs[i].mutex         = &mutex;
+      jobs[i].ok            = TRUE;
+   }
+
+   /* Start the extra threads; the calling thread does a share too      */
+   for(i=1; i<NThreads; i++)
+   {
+      if(pthread_create(&(threads[i]), NULL, DissimWorker, &(jobs[i])))
+      {
+         NThreads = i;
+         break;
+      }
+   }
+   DissimWorker(&(jobs[0]));
+
+   for(i=1; i<NThreads; i++)
+      pthread_join(threads[i], NULL);
+   for(i=0; i<NThreads; i++)
+   {
+      if(!jobs[i].ok)
+         ok = FALSE;
+   }
+
+   pthread_mutex_destroy(&mutex);
+   free(jobs);
+   free(threads);
+
+   /* Superposition is the costly part of METRIC RMSD so report the 
+      rate achieved
+   */
+   if(ok && (gMetric == METRIC_RMSD))
+   {
+      gettimeofday(&t1, NULL);
+      secs   = (double)(t1.tv_sec - t0.tv_sec) + 
+               (double)(t1.tv_usec - t0.tv_usec) / 1.0e6;
+      NPairs = (long)NVec * (long)(NVec - 1) / 2;
+      fprintf(stderr,"Note: RMSD matrix of %ld pairs in %.2fs with %d \
+thread%s (%.0f pairs/s)\n", NPairs, secs, NThreads, 
+              ((NThreads==1) ? "" : "s"),
+              ((secs > 0.0) ? (double)NPairs / secs : 0.0));
+   }
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>void *DissimWorker(void *arg)
+   -----------------------------
+   Input:   void  *arg      Pointer to a DISSIMJOB
+   Returns: void  *         NULL
+
+   Thread routine for BuildDissim(). Takes tiles off the shared counter
+   until there are none left. Sets the ok flag in the job to FALSE if
+   the tile buffers could not be allocated.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Tiles are PanelSize wide with room for raw torsions 
+            expanded to sin/cos
+*/
+void *DissimWorker(void *arg)
+{
+   DISSIMJOB *job = (DISSIMJOB *)arg;
+   FEATURE   *tile,
+             *xrow;
+   REAL      *acc;
+   int       t, j0, j1;
+
+   tile = (FEATURE *)malloc(job->PanelSize * EXPANDEDDIM(job->VecDim) * 
+                            sizeof(FEATURE));
+   xrow = (FEATURE *)malloc(EXPANDEDDIM(job->VecDim) * sizeof(FEATURE));
+   acc  = (REAL *)malloc(job->PanelSize * sizeof(REAL));
+   if(tile==NULL || xrow==NULL || acc==NULL)
+   {
+      if(tile!=NULL) free(tile);
+      if(xrow!=NULL) free(xrow);
+      if(acc!=NULL)  free(acc);
+      job->ok = FALSE;
+      return(NULL);
+   }
+
+   for(;;)
+   {
+      pthread_mutex_lock(job->mutex);
+      t = (*(job->NextTile))--;
+      pthread_mutex_unlock(job->mutex);
+      if(t < 0)
+         break;
+
+      /* Columns start from 2 since the first row has no partner before
+         it
+      */
+      j0 = 2 + t * job->PanelSize;
+      j1 = MIN(j0 + job->PanelSize, job->NVec + 1);
+      DissimTile(job->data, job->weights, job->store, job->NVec, 
+                 job->VecDim, job->ClusterMethod, j0, j1, job->TileSize,
+                 tile, acc, xrow);
+   }
+
+   free(tile);
+   free(xrow);
+   free(acc);
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>void DissimTile(FEATURE **data, REAL *weights, DISSIMSTORE *store, 
+                   int NVec, int VecDim, int ClusterMethod, int j0, 
+                   int j1, int TileSize, FEATURE *tile, REAL *acc, 
+                   FEATURE *xrow)
+   --------------------------------------------------------------------
+   Input:   FEATURE     **data          Input data matrix (from 1)
+            REAL        *weights        Vector weights (from 1) or NULL
+            int         NVec            Number of vectors
+            int         VecDim          Dimension of each vector
+            int         ClusterMethod   Clustering criterion to be used
+            int         j0              First column in the tile
+            int         j1              One past the last column
+            int         TileSize        Columns compared with a row at
+                                        a time
+            FEATURE     *tile           Workspace 
+                                        [EXPANDEDDIM(VecDim)][j1-j0]
+            REAL        *acc            Workspace [j1-j0]
+            FEATURE     *xrow           Workspace [EXPANDEDDIM(VecDim)]
+   Output:  DISSIMSTORE *store          Dissimilarities for all rows 
+                                        i<j in columns j0..j1-1
+
+   Computes one tile of columns of the dissimilarity matrix. Each row's
+   distances to the tile's columns are built up dimension by dimension
+   so that the loop over columns is contiguous, TileSize columns at a
+   time so that those columns stay in L1 cache.
+
+   Raw torsions for the angular metric are expanded to their sin/cos 
+   points from TorsionSinCos() once per column as the tile is 
+   transposed and once per row into xrow, so the loop over columns is
+   the same multiply-add as for the Euclidean metric and the distances
+   are identical. BuildDissim() makes these tiles several times 
+   TileSize wide so the cost of expanding each row is shared between
+   many columns.
+
+   For METRIC RMSD the rows are centred coordinates and CoorDist2() 
+   gives the sum of squared deviations after superposition.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Added angular metric
+   16.10.26 Added RMSD metric
+   16.10.26 Angular metric expands torsions once per row and column
+            rather than taking a cosine for every pair. Added TileSize
+            and xrow
+   16.10.26 Writes the blocked layout of a memory-mapped store
+*/
+void DissimTile(FEATURE **data, REAL *weights, DISSIMSTORE *store, 
+                int NVec, int VecDim, int ClusterMethod, int j0, int j1, 
+                int TileSize, FEATURE *tile, REAL *acc, FEATURE *xrow)
+{
+   int     NCol = j1 - j0,
+           NDim = EXPANDEDDIM(VecDim),
+           i, k, c, c0, cb, c1, e;
+   long    ind;
+   REAL    xi, d, s, co;
+   FEATURE *col,
+           *x;
+
+   /* Transpose the tile so each dimension is contiguous, expanding any
+      raw torsions to their sin/cos points
+   */
+   if(gMetric != METRIC_RMSD)
+   {
+      for(c=0; c<NCol; c++)
+      {
+         for(k=1, e=0; k<=VecDim; k++)
+         {
+            if(TORSIONDIM(k-1))
+            {
+               TorsionSinCos((REAL)data[j0+c][k], &s, &co);
+               tile[(e++)*NCol + c] = (FEATURE)s;
+               tile[(e++)*NCol + c] = (FEATURE)co;
+            }
+            else
+            {
+               tile[(e++)*NCol + c] = data[j0+c][k];
+            }
+         }
+      }
+   }
+
+   for(i=1; i<j1-1; i++)
+   {
+      c0 = MAX(0, i+1-j0);
+
+      /* Coordinates are superposed pair by pair. The tile of columns
+         is still small enough to stay in cache while each row is 
+         compared with it
+      */
+      if(gMetric == METRIC_RMSD)
+      {
+         for(c=c0; c<NCol; c++)
+            acc[c] = CoorDist2(data[i]+1, data[j0+c]+1, VecDim);
+      }
+      else
+      {
+         for(c=c0; c<NCol; c++)
+            acc[c] = (REAL)0.0;
+
+         /* Expand the row's raw torsions once for the whole tile       */
+         x = data[i]+1;
+         if(gResTorsions)
+         {
+            for(k=1, e=0; k<=VecDim; k++)
+            {
+               if(TORSIONDIM(k-1))
+               {
+                  TorsionSinCos((REAL)data[i][k], &s, &co);
+                  xrow[e++] = (FEATURE)s;
+                  xrow[e++] = (FEATURE)co;
+               }
+               else
+               {
+                  xrow[e++] = data[i][k];
+               }
+            }
+            x = xrow;
+         }
+
+         for(cb=c0; cb<NCol; cb+=TileSize)
+         {
+            c1 = MIN(cb+TileSize, NCol);
+            for(e=0; e<NDim; e++)
+            {
+               xi  = x[e];
+               col = tile + e*NCol;
+               for(c=cb; c<c1; c++)
+               {
+                  d       = xi - col[c];
+                  acc[c] += d * d;
+               }
+            }
+         }
+      }
+
+      /* For the case of the min. var. method where merging criteria 
+         are defined in terms of variances rather than distances. 
+      */
+      if(ClusterMethod == 1)
+      {
+         if(weights == NULL)
+         {
+            for(c=c0; c<NCol; c++)
+               acc[c] /= (REAL)2.0;
+         }
+         else
+         {
+            for(c=c0; c<NCol; c++)
+               acc[c] *= weights[i] * weights[j0+c] / 
+                         (weights[i] + weights[j0+c]);
+         }
+      }
+
+      if(store->blocked)
+      {
+         for(c=c0; c<NCol; c++)
+            SETDISSIM(store, BlockOffset(NVec, i, j0+c), acc[c]);
+      }
+      else if(store->f != NULL)
+      {
+         ind = IOFFSET(NVec, i, j0+c0);
+         for(c=c0; c<NCol; c++)
+            store->f[ind++] = (float)acc[c];
+      }
+      else
+      {
+         ind = IOFFSET(NVec, i, j0+c0);
+         for(c=c0; c<NCol; c++)
+            store->d[ind++] = acc[c];
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>REAL LanceWilliams(int ClusterMethod, REAL dik, REAL djk, REAL dij,
+                      REAL ni, REAL nj, REAL nk)
+   -------------------------------------------------------------------
+   Input:   int  ClusterMethod   Clustering criterion to be used
+            REAL dik             Dissimilarity of cluster i to cluster k
+            REAL djk             Dissimilarity of cluster j to cluster k
+            REAL dij             Dissimilarity of cluster i to cluster j
+            REAL ni              Cardinality of cluster i
+            REAL nj              Cardinality of cluster j
+            REAL nk              Cardinality of cluster k
+   Returns: REAL                 Dissimilarity of cluster k to the
+                                 cluster formed by merging i and j
+
+   Lance-Williams dissimilarity update for each of the clustering
+   methods.
+
+   16.10.26 Original, taken out of HierClus()   By: ACRM
+*/
+REAL LanceWilliams(int ClusterMethod, REAL dik, REAL djk, REAL dij,
+                   REAL ni, REAL nj, REAL nk)
+{
+   REAL d = (REAL)0.0;
+   
+   switch(ClusterMethod)
+   {
+   case 1:
+      /*  Ward's minimum variance method                                */
+      d  = (ni + nk) * dik + (nj + nk) * djk - nk * dij;
+      d /= ni + nj + nk;
+      break;
+   case 2:
+      /*  Single link method                                            */
+      d = MIN(dik, djk);
+      break;
+   case 3:
+      /*  Complete link method                                          */
+      d = MAX(dik, djk);
+      break;
+   case 4:
+      /*  Average link (or group average) method                        */
+      d = (ni * dik + nj * djk) / (ni + nj);
+      break;
+   case 5:
+      /*  McQuitty's method                                             */
+      d = dik * (REAL).5 + djk * (REAL).5;
+      break;
+   case 6:
+      /*  Median (Gower's) method                                       */
+      d = dik * (REAL).5 + djk * (REAL).5 - dij * (REAL).25;
+      break;
+   case 7:
+      /*  Centroid method                                               */
+      d = (ni * dik + nj * djk - ni * nj * dij / (ni + nj)) / (ni + nj);
+      break;
+   }
+
+   return(d);
+}
+
+
+/************************************************************************/
+/*>void NNListCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                      REAL *membr, BOOL *Flag, int *NearNeighb, 
+                      REAL *DissimNearNeighb, int *ia, int *ib, 
+                      REAL *crit)
+   ------------------------------------------------------------------
+   Input:   int  NVec                 Number of vectors to cluster
+            int  ClusterMethod        Clustering criterion to be used
+   I/O:     DISSIMSTORE *store        Lower half diagonal dissimilarities
+            REAL membr[NVec]          Cluster cardinalities
+            BOOL Flag[NVec]           Agglomerable clusters
+   Output:  int  NearNeighb[NVec]     Workspace for nearest neighbours
+            REAL DissimNearNeighb[NVec]  Workspace for their 
+                                      dissimilarities
+            int  ia[NVec]             \
+                 ib[NVec]             | History of allomerations
+            REAL crit[NVec]           /
+
+   Agglomeration by maintaining a list of the nearest neighbour of
+   each cluster and rescanning when a nearest neighbour is merged. Used
+   for the methods which are not reducible (median and centroid).
+   All arrays count FORTRAN-style from 1 as set up by HierClus()
+
+   20.06.95 Original By: ACRM
+            Based on FORTRAN code by F. Murtagh, ESA/ESO/STECF, Garching,
+            February 1986 available in STATLIB.
+   16.10.26 Moved out of HierClus(). The dissimilarity update loop now
+            includes the last vector as in Murtagh's original code
+   16.10.26 Dissimilarities held in a DISSIMSTORE
+   16.10.26 Uses DISSIMOFFSET() for the blocked layout
+*/
+void NNListCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                   REAL *membr, BOOL *Flag, int *NearNeighb, 
+                   REAL *DissimNearNeighb, int *ia, int *ib, REAL *crit)
+{
+   long ind, 
+        ind1, 
+        ind2, 
+        ind3;
+   int  NClusters = NVec, 
         i, 
         j, 
         k, 
@@ -710,267 +3252,929 @@ BOOL HierClus(int NVec, int VecDim, int ClusterMethod, REAL **data,
         j2, 
         jj = 0, 
         im = 0, 
-        jm = 0,
-        *NearNeighb = NULL;
+        jm = 0;
    REAL DMin, 
-        x, 
-        xx,
-        *DissimNearNeighb = NULL,
-        *LDDissim = NULL,
-        *membr = NULL;
-   BOOL *Flag = NULL;
+        xx;
 
-   /* Indicate agglomerable object/clusters                             */
-   Flag  = (BOOL *)malloc(NVec * sizeof(BOOL));
-   /* Current nearest neighbour storage                                 */
-   NearNeighb    = (int  *)malloc(NVec * sizeof(int));
-   /* Cluster cardinalities                                             */
-   membr = (REAL *)malloc(NVec * sizeof(REAL));
-   /* Dissimilarity of nearest neighbour                                */
-   DissimNearNeighb = (REAL *)malloc(NVec * sizeof(REAL));
-   /* Stores dissimilarities in lower half diagonal                     */
-   LDDissim  = (REAL *)malloc(NVec*(NVec-1)/2 * sizeof(REAL));
+   /* Carry out an agglomeration - first create list of near neighbours */
+   for(i=1; i<=NVec-1; i++) 
+   {
+      DMin = INF;
+      for(j=i+1; j<=NVec; j++) 
+      {
+         ind = DISSIMOFFSET(store, NVec, i, j);
+         if (GETDISSIM(store, ind) < DMin) 
+         {
+            DMin = GETDISSIM(store, ind);
+            jm = j;
+         }
+      }
+      NearNeighb[i] = jm;
+      DissimNearNeighb[i] = DMin;
+   }
+   
+   /* Next, determine least dissimilar using list of near neighbours    */
+   do
+   {
+      DMin = INF;
+      for(i=1; i<=NVec-1; i++) 
+      {
+         if(Flag[i] && (DissimNearNeighb[i] < DMin))
+         {
+            DMin = DissimNearNeighb[i];
+            im   = i;
+            jm   = NearNeighb[i];
+         }
+      }
+      NClusters--;
+      
+      /* This allows an agglomeration to be carried out                 */
+      i2 = MIN(im,jm);
+      j2 = MAX(im,jm);
+      ia[NVec   - NClusters] = i2;
+      ib[NVec   - NClusters] = j2;
+      crit[NVec - NClusters] = DMin;
+      
+      /* Update dissimilarities from new cluster                        */
+      Flag[j2] = FALSE;
+      DMin     = INF;
+      for(k=1; k<=NVec; k++) 
+      {
+         if(Flag[k] && (k != i2))
+         {
+            if (i2 < k) 
+               ind1 = DISSIMOFFSET(store, NVec, i2, k);
+            else 
+               ind1 = DISSIMOFFSET(store, NVec, k, i2);
+            
+            if (j2 < k)
+               ind2 = DISSIMOFFSET(store, NVec, j2, k);
+            else
+               ind2 = DISSIMOFFSET(store, NVec, k, j2);
+            
+            ind3 = DISSIMOFFSET(store, NVec, i2, j2);
+            xx   = GETDISSIM(store, ind3);
+            
+            SETDISSIM(store, ind1, 
+                      LanceWilliams(ClusterMethod, GETDISSIM(store, ind1),
+                                    GETDISSIM(store, ind2), xx, 
+                                    membr[i2], membr[j2], membr[k]));
+            
+            if((i2 <= k) && (GETDISSIM(store, ind1) < DMin))
+            {
+               DMin = GETDISSIM(store, ind1);
+               jj = k;
+            }
+         }
+      }
+      
+      membr[i2] += membr[j2];
+      DissimNearNeighb[i2] = DMin;
+      NearNeighb[i2] = jj;
+      
+      /* Update list of nearest neighbours as required.                 */
+      for(i=1; i<=NVec-1; i++) 
+      {
+         if(Flag[i]) 
+         {
+            if(NearNeighb[i]==i2 || NearNeighb[i]==j2) 
+            {
+               /* Redetermine nearest neighbour of I                    */
+               DMin = INF;
+               for(j=i+1; j<=NVec; j++) 
+               {
+                  ind = DISSIMOFFSET(store, NVec, i, j);
+                  if(Flag[j] && (i!=j) && (GETDISSIM(store, ind) < DMin))
+                  {
+                     DMin = GETDISSIM(store, ind);
+                     jj = j;
+                  }
+               }
+               NearNeighb[i] = jj;
+               DissimNearNeighb[i] = DMin;
+            }
+         }
+      }
+   }  while(NClusters>1);
+   /* Repeat previous steps until N-1 agglomerations carried out.       */
+}
 
-   /* Check allocations                                                 */
-   if(Flag             == NULL || 
-      NearNeighb       == NULL || 
-      membr            == NULL || 
-      DissimNearNeighb == NULL || 
-      LDDissim         == NULL)
+
+/************************************************************************/
+/*>BOOL NNChainCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                       REAL *membr, BOOL *Flag, int *chain, int *ia,
+                       int *ib, REAL *crit)
+   ----------------------------------------------------------------
+   Input:   int  NVec                 Number of vectors to cluster
+            int  ClusterMethod        Clustering criterion to be used
+   I/O:     DISSIMSTORE *store        Lower half diagonal dissimilarities
+            REAL membr[NVec]          Cluster cardinalities
+            BOOL Flag[NVec]           Agglomerable clusters
+   Output:  int  chain[NVec]          Workspace for the chain
+            int  ia[NVec]             \
+                 ib[NVec]             | History of allomerations
+            REAL crit[NVec]           /
+   Returns: BOOL                      Success of memory allocations
+
+   Agglomeration using a nearest-neighbour chain. Starting from any
+   cluster, the chain is grown by following nearest neighbours until
+   two clusters are reciprocal nearest neighbours; these are merged 
+   and the chain continues from what is left. For the reducible
+   methods (Ward, single, complete, average, McQuitty) this gives the
+   same hierarchy as always merging the globally closest pair, but
+   in O(N^2) time.
+
+   The merges are not found in order of increasing dissimilarity, so
+   they are sorted before being stored in ia/ib/crit. As elsewhere a
+   cluster is identified by its lowest numbered member.
+   All arrays count FORTRAN-style from 1 as set up by HierClus()
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Uses DISSIMTRIOFFSET() for the blocked layout
+*/
+BOOL NNChainCluster(int NVec, int ClusterMethod, DISSIMSTORE *store, 
+                    REAL *membr, BOOL *Flag, int *chain, int *ia, 
+                    int *ib, REAL *crit)
+{
+   long  ind1, 
+         ind2, 
+         ind3;
+   int   NChain = 0,
+         NMerge = 0,
+         a, b, k,
+         prev,
+         i2, j2;
+   REAL  DMin,
+         xx;
+   MERGE *merges;
+
+   if((merges = (MERGE *)malloc(NVec * sizeof(MERGE)))==NULL)
+      return(FALSE);
+
+   while(NMerge < NVec-1)
+   {
+      /* Start a new chain from the first agglomerable cluster          */
+      if(NChain == 0)
+      {
+         for(a=1; !Flag[a]; a++);
+         chain[++NChain] = a;
+      }
+
+      /* Find the nearest neighbour of the cluster at the end of the 
+         chain. On a tie, the previous cluster in the chain is kept so
+         the chain is guaranteed to end.
+      */
+      a    = chain[NChain];
+      prev = (NChain > 1) ? chain[NChain-1] : 0;
+      b    = prev;
+      DMin = (prev) ? 
+             GETDISSIM(store, DISSIMTRIOFFSET(store, NVec, a, prev)) : INF;
+      
+      for(k=1; k<=NVec; k++)
+      {
+         if(Flag[k] && (k != a))
+         {
+            xx = GETDISSIM(store, DISSIMTRIOFFSET(store, NVec, a, k));
+            if(xx < DMin)
+            {
+               DMin = xx;
+               b    = k;
+            }
+         }
+      }
+
+      if(b != prev)
+      {
+         /* Not yet reciprocal; extend the chain                        */
+         chain[++NChain] = b;
+         continue;
+      }
+
+      /* a and b are reciprocal nearest neighbours, so merge them and
+         pop both off the chain
+      */
+      NChain -= 2;
+      i2 = MIN(a,b);
+      j2 = MAX(a,b);
+      merges[NMerge].i     = i2;
+      merges[NMerge].j     = j2;
+      merges[NMerge].crit  = DMin;
+      merges[NMerge].order = NMerge;
+      NMerge++;
+
+      /* Update dissimilarities from new cluster                        */
+      Flag[j2] = FALSE;
+      ind3     = DISSIMOFFSET(store, NVec, i2, j2);
+      xx       = GETDISSIM(store, ind3);
+      for(k=1; k<=NVec; k++) 
+      {
+         if(Flag[k] && (k != i2))
+         {
+            ind1 = DISSIMTRIOFFSET(store, NVec, i2, k);
+            ind2 = DISSIMTRIOFFSET(store, NVec, j2, k);
+            SETDISSIM(store, ind1, 
+                      LanceWilliams(ClusterMethod, GETDISSIM(store, ind1),
+                                    GETDISSIM(store, ind2), xx, 
+                                    membr[i2], membr[j2], membr[k]));
+         }
+      }
+      membr[i2] += membr[j2];
+   }
+
+   /* Put the merges into order of increasing criterion value; merges
+      with equal values stay in the order they were made so a cluster
+      is always formed before it is used
+   */
+   qsort(merges, NMerge, sizeof(MERGE), CompareMerges);
+   for(k=0; k<NMerge; k++)
+   {
+      ia[k+1]   = merges[k].i;
+      ib[k+1]   = merges[k].j;
+      crit[k+1] = merges[k].crit;
+   }
+
+   free(merges);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>int CompareMerges(const void *m1, const void *m2)
+   -------------------------------------------------
+   Input:   const void *m1    Pointer to first MERGE
+            const void *m2    Pointer to second MERGE
+   Returns: int               -1, 0 or 1 for qsort()
+
+   Compares two merges by criterion value and then by the order in which
+   they were made.
+
+   16.10.26 Original   By: ACRM
+*/
+int CompareMerges(const void *m1, const void *m2)
+{
+   const MERGE *a = (const MERGE *)m1,
+               *b = (const MERGE *)m2;
+
+   if(a->crit < b->crit)   return(-1);
+   if(a->crit > b->crit)   return(1);
+   if(a->order < b->order) return(-1);
+   if(a->order > b->order) return(1);
+   return(0);
+}
+
+
+/************************************************************************/
+/*>BOOL MSTCluster(int NVec, int VecDim, FEATURE **data, int *ia, 
+                   int *ib, REAL *crit, int NThreads)
+   --------------------------------------------------------------------
+   Input:   int     NVec              Number of vectors to cluster
+            int     VecDim            Dimension of each vector
+            FEATURE **data            Input data matrix [NVec][VecDim]
+            int     NThreads          Number of threads to use
+   Output:  int     ia[NVec]          \
+                    ib[NVec]          | History of allomerations
+            REAL    crit[NVec]        /
+   Returns: BOOL                      Success of memory allocations
+
+   Single linkage clustering from the minimum spanning tree. The tree
+   is grown with Prim's algorithm: each vector not yet in the tree 
+   keeps its squared distance to the nearest vector in the tree and,
+   at each step, the nearest is added and the distances are updated 
+   against it. Distances are calculated as they are needed, so memory
+   use is O(NVec) rather than O(NVec^2). The vectors are divided
+   between NThreads threads for the update.
+
+   Sorting the tree edges by length and joining the clusters at their
+   ends gives the single linkage hierarchy with the same criterion 
+   values as HierClus() would have found from the full matrix. Unlike
+   HierClus(), all arrays count from 0 (though the cluster numbers
+   stored in ia and ib count from 1 as usual). Raw torsions for the 
+   angular metric are expanded into a copy of the data first, so each
+   distance is a plain FeatureDist2().
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Added NThreads
+   16.10.26 Works on a copy of the data from ExpandFeatures() with raw
+            torsions
+*/
+BOOL MSTCluster(int NVec, int VecDim, FEATURE **data, int *ia, int *ib, 
+                REAL *crit, int NThreads)
+{
+   MSTJOB    *jobs    = NULL;
+   pthread_t *threads = NULL;
+   MERGE     *merges  = NULL;
+   FEATURE   **expanded = NULL;
+   REAL      *MinDist = NULL;
+   int       *MinFrom = NULL,
+             *root,
+             NStarted,
+             newest = 0,
+             best,
+             a, b, i, t;
+   BOOL      *InTree  = NULL,
+             done     = FALSE;
+   BARRIER   barrier;
+
+   /* Only use threads if each has a reasonable number of vectors      */
+   NThreads = MIN(MAX(NThreads, 1), NVec / MSTMINPERTHREAD);
+   NThreads = MAX(NThreads, 1);
+
+   MinDist = (REAL *)malloc(NVec * sizeof(REAL));
+   MinFrom = (int *)malloc(NVec * sizeof(int));
+   InTree  = (BOOL *)malloc(NVec * sizeof(BOOL));
+   merges  = (MERGE *)malloc(NVec * sizeof(MERGE));
+   jobs    = (MSTJOB *)malloc(NThreads * sizeof(MSTJOB));
+   threads = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+
+   /* Expand raw torsions once rather than for every pair               */
+   if(gResTorsions)
+   {
+      if((expanded = ExpandFeatures(data, NVec, VecDim))!=NULL)
+      {
+         data   = expanded;
+         VecDim = EXPANDEDDIM(VecDim);
+      }
+   }
+
+   if(MinDist == NULL ||
+      MinFrom == NULL ||
+      InTree  == NULL ||
+      merges  == NULL ||
+      jobs    == NULL ||
+      threads == NULL ||
+      (gResTorsions && (expanded == NULL)))
+   {
+      if(MinDist!=NULL) free(MinDist);
+      if(MinFrom!=NULL) free(MinFrom);
+      if(InTree!=NULL)  free(InTree);
+      if(merges!=NULL)  free(merges);
+      if(jobs!=NULL)    free(jobs);
+      if(threads!=NULL) free(threads);
+      FreeFeatures(expanded);
+      return(FALSE);
+   }
+
+   for(i=0; i<NVec; i++)
+   {
+      MinDist[i] = INF;
+      MinFrom[i] = 0;
+      InTree[i]  = FALSE;
+   }
+   InTree[newest] = TRUE;
+
+   pthread_mutex_init(&(barrier.mutex), NULL);
+   pthread_cond_init(&(barrier.cond), NULL);
+   barrier.NThreads = NThreads;
+   barrier.NWaiting = 0;
+   barrier.cycle    = 0;
+
+   for(t=0; t<NThreads; t++)
+   {
+      jobs[t].data    = data;
+      jobs[t].MinDist = MinDist;
+      jobs[t].MinFrom = MinFrom;
+      jobs[t].newest  = &newest;
+      jobs[t].VecDim  = VecDim;
+      jobs[t].first   = (int)((long)t * NVec / NThreads);
+      jobs[t].last    = (int)((long)(t+1) * NVec / NThreads);
+      jobs[t].best    = (-1);
+      jobs[t].InTree  = InTree;
+      jobs[t].done    = &done;
+      jobs[t].barrier = &barrier;
+   }
+
+   /* Start the extra threads. If one cannot be started, the calling
+      thread does its share as well as its own
+   */
+   for(NStarted=1; NStarted<NThreads; NStarted++)
+   {
+      if(pthread_create(&(threads[NStarted]), NULL, MSTWorker, 
+                        &(jobs[NStarted])))
+         break;
+   }
+   pthread_mutex_lock(&(barrier.mutex));
+   barrier.NThreads = NStarted;
+   pthread_mutex_unlock(&(barrier.mutex));
+
+   /* Add the vectors to the tree one at a time                         */
+   for(i=0; i<NVec-1; i++)
+   {
+      WaitBarrier(&barrier);        /* Release the workers              */
+      MSTUpdate(&(jobs[0]));
+      for(t=NStarted; t<NThreads; t++)
+         MSTUpdate(&(jobs[t]));
+      WaitBarrier(&barrier);        /* Wait for them to finish          */
+
+      /* Nearest vector over all the jobs; on a tie the lowest numbered
+         is taken so the result does not depend on the thread count
+      */
+      best = (-1);
+      for(t=0; t<NThreads; t++)
+      {
+         if((jobs[t].best >= 0) &&
+            ((best < 0) || (MinDist[jobs[t].best] < MinDist[best])))
+            best = jobs[t].best;
+      }
+
+      InTree[best]     = TRUE;
+      merges[i].i      = MinFrom[best];
+      merges[i].j      = best;
+      merges[i].crit   = MinDist[best];
+      merges[i].order  = i;
+      newest           = best;
+   }
+
+   done = TRUE;
+   WaitBarrier(&barrier);
+   for(t=1; t<NStarted; t++)
+      pthread_join(threads[t], NULL);
+   pthread_cond_destroy(&(barrier.cond));
+   pthread_mutex_destroy(&(barrier.mutex));
+
+   /* Join clusters along the tree edges in order of increasing length.
+      MinFrom is no longer needed so holds the union-find forest; the
+      root of each tree is kept as its lowest member, which is also the
+      number by which the cluster is known
+   */
+   qsort(merges, NVec-1, sizeof(MERGE), CompareMerges);
+   root = MinFrom;
+   for(i=0; i<NVec; i++)
+      root[i] = i;
+
+   for(i=0; i<NVec-1; i++)
+   {
+      for(a=merges[i].i; root[a]!=a; a=root[a])
+         root[a] = root[root[a]];
+      for(b=merges[i].j; root[b]!=b; b=root[b])
+         root[b] = root[root[b]];
+
+      ia[i]   = MIN(a,b) + 1;
+      ib[i]   = MAX(a,b) + 1;
+      crit[i] = merges[i].crit;
+      root[MAX(a,b)] = MIN(a,b);
+   }
+
+   free(MinDist);
+   free(MinFrom);
+   free(InTree);
+   free(merges);
+   free(jobs);
+   free(threads);
+   FreeFeatures(expanded);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void *MSTWorker(void *arg)
+   --------------------------
+   Input:   void  *arg      Pointer to an MSTJOB
+   Returns: void  *         NULL
+
+   Thread routine for MSTCluster(). Updates the job's range of vectors 
+   each time a vector is added to the tree, until the tree is complete.
+
+   16.10.26 Original   By: ACRM
+*/
+void *MSTWorker(void *arg)
+{
+   MSTJOB *job = (MSTJOB *)arg;
+
+   for(;;)
+   {
+      WaitBarrier(job->barrier);
+      if(*(job->done))
+         break;
+      MSTUpdate(job);
+      WaitBarrier(job->barrier);
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>void MSTUpdate(MSTJOB *job)
+   ---------------------------
+   I/O:     MSTJOB *job     Job describing a range of vectors
+
+   Updates the distance to the tree of each vector in the job's range 
+   which is not yet in the tree, using the vector most recently added. 
+   The squared distance from FeatureDist2() on the expanded vectors is
+   summed over the dimensions in the same order as DissimTile() so the
+   values are identical. Sets job->best to the nearest of these vectors
+   (the lowest numbered on a tie) or -1 if all are in the tree.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Raw torsions are expanded by MSTCluster() first
+*/
+void MSTUpdate(MSTJOB *job)
+{
+   FEATURE *x = job->data[*(job->newest)];
+   REAL    dist,
+           BestDist = INF;
+   int     v;
+
+   job->best = (-1);
+   for(v=job->first; v<job->last; v++)
+   {
+      if(job->InTree[v])
+         continue;
+
+      dist = FeatureDist2(x, job->data[v], job->VecDim);
+      if(dist < job->MinDist[v])
+      {
+         job->MinDist[v] = dist;
+         job->MinFrom[v] = *(job->newest);
+      }
+      if((job->best < 0) || (job->MinDist[v] < BestDist))
+      {
+         BestDist  = job->MinDist[v];
+         job->best = v;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>void WaitBarrier(BARRIER *barrier)
+   ----------------------------------
+   I/O:     BARRIER *barrier   The barrier
+
+   Blocks until barrier->NThreads threads have called this routine,
+   then releases them all. The barrier may then be used again.
+
+   16.10.26 Original   By: ACRM
+*/
+void WaitBarrier(BARRIER *barrier)
+{
+   int cycle;
+
+   pthread_mutex_lock(&(barrier->mutex));
+   cycle = barrier->cycle;
+   if(++(barrier->NWaiting) == barrier->NThreads)
+   {
+      barrier->NWaiting = 0;
+      barrier->cycle++;
+      pthread_cond_broadcast(&(barrier->cond));
+   }
+   else
+   {
+      while(cycle == barrier->cycle)
+         pthread_cond_wait(&(barrier->cond), &(barrier->mutex));
+   }
+   pthread_mutex_unlock(&(barrier->mutex));
+}
+
+
+/************************************************************************/
+/*>int MicroCluster(FEATURE **data, int NVec, int VecDim, int NMicro, 
+                    FEATURE **centres, REAL *weights, int *micro)
+   ----------------------------------------------------------------
+   Input:   FEATURE **data           Data to cluster [NVec][VecDim]
+            int     NVec             Number of vectors
+            int     VecDim           Dimension of each vector
+            int     NMicro           Maximum number of micro-clusters
+   Output:  FEATURE **centres        Micro-cluster centroids 
+                                     [NMicro][VecDim]
+            REAL    *weights         Size of each micro-cluster [NMicro]
+            int     *micro           Micro-cluster of each vector [NVec]
+   Returns: int                      Number of micro-clusters (0 if 
+                                     allocation failed)
+   Globals: int  sNThreads           Number of threads to use
+
+   Compresses the vectors into at most NMicro micro-clusters for the 
+   approximate Ward method, using mini-batch k-means. The centres are 
+   seeded by farthest-first traversal of an evenly spaced sample of 
+   the vectors, which makes sure outlying groups get a micro-cluster 
+   of their own, and are then refined from MICROITER random batches. 
+   Every vector is then assigned to its nearest centre (in parallel) 
+   and each centre replaced by the centroid of its members. Empty 
+   micro-clusters are dropped. A fixed random number sequence is used
+   so the results are reproducible.
+
+   16.10.26 Original   By: ACRM
+*/
+int MicroCluster(FEATURE **data, int NVec, int VecDim, int NMicro, 
+                 FEATURE **centres, REAL *weights, int *micro)
+{
+   MICROJOB      *jobs     = NULL;
+   pthread_t     *threads  = NULL;
+   REAL          *MinDist  = NULL,
+                 dist, eta;
+   int           *batch    = NULL,
+                 *nearest  = NULL,
+                 *renum    = NULL,
+                 NSample, NThreads, NStarted,
+                 i, k, c, t, far, NCentre;
+   unsigned long seed = 1;
+
+   NSample  = MIN(NVec, MICROSAMPLE * NMicro);
+   NThreads = MAX(sNThreads, 1);
+
+   MinDist = (REAL *)malloc(NSample * sizeof(REAL));
+   batch   = (int *)malloc(MICROBATCH * sizeof(int));
+   nearest = (int *)malloc(MICROBATCH * sizeof(int));
+   renum   = (int *)malloc(NMicro * sizeof(int));
+   jobs    = (MICROJOB *)malloc(NThreads * sizeof(MICROJOB));
+   threads = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+
+   if(MinDist == NULL ||
+      batch   == NULL ||
+      nearest == NULL ||
+      renum   == NULL ||
+      jobs    == NULL ||
+      threads == NULL)
    {
-      if(Flag!=NULL)             free(Flag);
-      if(NearNeighb!=NULL)       free(NearNeighb);
-      if(membr!=NULL)            free(membr);
-      if(DissimNearNeighb!=NULL) free(DissimNearNeighb);
-      if(LDDissim!=NULL)         free(LDDissim);
+      if(MinDist!=NULL) free(MinDist);
+      if(batch!=NULL)   free(batch);
+      if(nearest!=NULL) free(nearest);
+      if(renum!=NULL)   free(renum);
+      if(jobs!=NULL)    free(jobs);
+      if(threads!=NULL) free(threads);
+      return(0);
+   }
 
-      return(FALSE);
+   /* Seed the centres by farthest-first traversal of the sample        */
+   for(i=0; i<NSample; i++)
+      MinDist[i] = INF;
+   for(k=0; k<VecDim; k++)
+      centres[0][k] = data[0][k];
+   for(c=1; c<NMicro; c++)
+   {
+      far = 0;
+      for(i=0; i<NSample; i++)
+      {
+         dist = FeatureDist2(data[(int)((long)i * NVec / NSample)],
+                             centres[c-1], VecDim);
+         if(dist < MinDist[i])
+            MinDist[i] = dist;
+         if(MinDist[i] > MinDist[far])
+            far = i;
+      }
+      for(k=0; k<VecDim; k++)
+         centres[c][k] = data[(int)((long)far * NVec / NSample)][k];
    }
 
-   /* For all arrays, move pointer back one so we count FORTRAN-style
-      from 1 rather than from 0
+   /* Refine with mini-batch k-means. Each centre moves towards the 
+      vectors assigned to it by an amount which falls as it collects
+      more of them
    */
-   Flag--;                  /* Local arrays                             */
-   NearNeighb--;
-   membr--;
-   DissimNearNeighb--;
-   LDDissim--;
+   for(c=0; c<NMicro; c++)
+      weights[c] = (REAL)0.0;
+   for(t=0; t<MICROITER; t++)
+   {
+      for(i=0; i<MICROBATCH; i++)
+      {
+         seed       = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+         batch[i]   = (int)(seed % NVec);
+         nearest[i] = NearestCentre(data[batch[i]], centres, NMicro, 
+                                    VecDim);
+      }
+      for(i=0; i<MICROBATCH; i++)
+      {
+         c           = nearest[i];
+         weights[c] += (REAL)1.0;
+         eta         = (REAL)1.0 / weights[c];
+         for(k=0; k<VecDim; k++)
+            centres[c][k] += eta * (data[batch[i]][k] - centres[c][k]);
+      }
+   }
 
-   crit--;                  /* Passed parameter arrays                  */
-   ib--;
-   ia--;
+   /* Assign every vector to its nearest centre                         */
+   for(t=0; t<NThreads; t++)
+   {
+      jobs[t].data    = data;
+      jobs[t].centres = centres;
+      jobs[t].micro   = micro;
+      jobs[t].VecDim  = VecDim;
+      jobs[t].NCentre = NMicro;
+      jobs[t].first   = (int)((long)t * NVec / NThreads);
+      jobs[t].last    = (int)((long)(t+1) * NVec / NThreads);
+   }
+   for(NStarted=1; NStarted<NThreads; NStarted++)
+   {
+      if(pthread_create(&(threads[NStarted]), NULL, MicroWorker, 
+                        &(jobs[NStarted])))
+         break;
+   }
+   MicroWorker(&(jobs[0]));
+   for(t=NStarted; t<NThreads; t++)
+      MicroWorker(&(jobs[t]));
+   for(t=1; t<NStarted; t++)
+      pthread_join(threads[t], NULL);
+
+   /* Replace the centres by the centroids of their members            */
+   for(c=0; c<NMicro; c++)
+   {
+      weights[c] = (REAL)0.0;
+      for(k=0; k<VecDim; k++)
+         centres[c][k] = (REAL)0.0;
+   }
    for(i=0; i<NVec; i++)
-      (data[i])--;
-   data--;
-   
-   /* Initializations                                                   */
-   for(i=1; i<=NVec; i++) 
    {
-      membr[i] = (REAL)1.0;
-      Flag[i]  = TRUE;
+      c = micro[i];
+      weights[c] += (REAL)1.0;
+      for(k=0; k<VecDim; k++)
+         centres[c][k] += data[i][k];
    }
-   NClusters = NVec;
-   
-   /* Construct dissimilarity matrix                                    */
-   for(i=1; i<=NVec-1; i++) 
+
+   /* Drop the empty micro-clusters                                     */
+   for(c=0, NCentre=0; c<NMicro; c++)
    {
-      for(j=i+1; j<=NVec; j++) 
+      if(weights[c] > (REAL)0.0)
       {
-         ind = IOFFSET(NVec, i, j);
-         LDDissim[ind] = (REAL)0.0;
-         for(k=1; k<=VecDim; k++) 
-         {
-            LDDissim[ind] += (data[i][k] - data[j][k]) * 
-                             (data[i][k] - data[j][k]);
-         }
-         
-         /* For the case of the min. var. method where merging criteria 
-            are defined in terms of variances rather than distances. 
-         */
-         if (ClusterMethod == 1) 
-         {
-            LDDissim[ind] /= (REAL)2.0;
-         }
+         for(k=0; k<VecDim; k++)
+            centres[NCentre][k] = centres[c][k] / weights[c];
+         weights[NCentre] = weights[c];
+         renum[c]         = NCentre++;
       }
    }
-   
-   /* Carry out an agglomeration - first create list of near neighbours */
-   for(i=1; i<=NVec-1; i++) 
+   for(i=0; i<NVec; i++)
+      micro[i] = renum[micro[i]];
+
+   free(MinDist);
+   free(batch);
+   free(nearest);
+   free(renum);
+   free(jobs);
+   free(threads);
+
+   return(NCentre);
+}
+
+
+/************************************************************************/
+/*>void *MicroWorker(void *arg)
+   ----------------------------
+   Input:   void  *arg      Pointer to a MICROJOB
+   Returns: void  *         NULL
+
+   Thread routine for MicroCluster(). Finds the nearest centre to each
+   vector in the job's range.
+
+   16.10.26 Original   By: ACRM
+*/
+void *MicroWorker(void *arg)
+{
+   MICROJOB *job = (MICROJOB *)arg;
+   int      i;
+
+   for(i=job->first; i<job->last; i++)
+      job->micro[i] = NearestCentre(job->data[i], job->centres, 
+                                    job->NCentre, job->VecDim);
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>int NearestCentre(FEATURE *x, FEATURE **centres, int NCentre, 
+                      int VecDim)
+   -----------------------------------------------------------------
+   Input:   FEATURE *x        Vector
+            FEATURE **centres Centres [NCentre][VecDim]
+            int     NCentre   Number of centres
+            int     VecDim    Dimension of each vector
+   Returns: int               Index of nearest centre (the first if 
+                              there is a tie)
+
+   Finds the centre nearest to a vector.
+
+   16.10.26 Original   By: ACRM
+*/
+int NearestCentre(FEATURE *x, FEATURE **centres, int NCentre, 
+                  int VecDim)
+{
+   REAL dist, 
+        best = INF;
+   int  c, 
+        nearest = 0;
+
+   for(c=0; c<NCentre; c++)
    {
-      DMin = INF;
-      for(j=i+1; j<=NVec; j++) 
+      dist = FeatureDist2(x, centres[c], VecDim);
+      if(dist < best)
       {
-         ind = IOFFSET(NVec, i, j);
-         if (LDDissim[ind] < DMin) 
-         {
-            DMin = LDDissim[ind];
-            jm = j;
-         }
+         best    = dist;
+         nearest = c;
       }
-      NearNeighb[i] = jm;
-      DissimNearNeighb[i] = DMin;
    }
-   
-   /* Next, determine least dissimilar using list of near neighbours    */
-   do
+
+   return(nearest);
+}
+
+
+/************************************************************************/
+/*>int CollapseDuplicates(FEATURE **data, int NVec, int VecDim, REAL tol,
+                          FEATURE **centres, REAL *weights, int *items)
+   ----------------------------------------------------------------------
+   Input:   FEATURE **data        Data to cluster
+            int     NVec          Number of vectors
+            int     VecDim        Dimension of the vectors
+            REAL    tol           Grid spacing for near duplicates (0
+                                  for exact duplicates only)
+   Output:  FEATURE **centres     Distinct vectors [NVec][VecDim]
+            REAL    *weights      Number of vectors each one stands for
+            int     *items        Item (from 0) standing for each vector
+   Returns: int                   Number of items (0 if allocation 
+                                  failed)
+   Globals: int     sNCollapsed   Set to the number of vectors collapsed
+
+   Collapses duplicate vectors (e.g. several chains of one structure) 
+   into single items weighted by the number of copies, so they are 
+   clustered once. Vectors are hashed on their elements rounded onto a 
+   grid of spacing tol; those landing in the same grid cell are 
+   collapsed onto the first of them. With tol of zero only identical
+   vectors are collapsed. Items are numbered in order of their first 
+   vector so the cluster numbering is unchanged.
+
+   Since identical vectors are merged first at zero dissimilarity, 
+   clustering the weighted items gives the same hierarchy above that
+   level for all the methods.
+
+   16.10.26 Original   By: ACRM
+*/
+int CollapseDuplicates(FEATURE **data, int NVec, int VecDim, REAL tol,
+                       FEATURE **centres, REAL *weights, int *items)
+{
+   int           i, j, k,
+                 *table,
+                 NItems = 0;
+   unsigned long hash,
+                 mask;
+   REAL          grid = ((tol > (REAL)0.0) ? tol : COLLAPSEGRID);
+   BOOL          same;
+
+   /* Open-addressed hash table of item numbers at least twice the size
+      of the data
+   */
+   for(mask=1; mask < 2*(unsigned long)NVec; mask <<= 1);
+   if((table = (int *)malloc(mask * sizeof(int)))==NULL)
+      return(0);
+   for(hash=0; hash<mask; hash++)
+      table[hash] = (-1);
+   mask--;
+
+   for(i=0; i<NVec; i++)
    {
-      DMin = INF;
-      for(i=1; i<=NVec-1; i++) 
-      {
-         if(Flag[i] && (DissimNearNeighb[i] < DMin))
-         {
-            DMin = DissimNearNeighb[i];
-            im   = i;
-            jm   = NearNeighb[i];
-         }
-      }
-      NClusters--;
-      
-      /* This allows an agglomeration to be carried out                 */
-      i2 = MIN(im,jm);
-      j2 = MAX(im,jm);
-      ia[NVec   - NClusters] = i2;
-      ib[NVec   - NClusters] = j2;
-      crit[NVec - NClusters] = DMin;
-      
-      /* Update dissimilarities from new cluster                        */
-      Flag[j2] = FALSE;
-      DMin     = INF;
-      for(k=1; k<=NVec-1; k++) 
+      hash = 5381;
+      for(k=0; k<VecDim; k++)
+         hash = (hash * 33) ^ (unsigned long)QUANTISE(data[i][k], grid);
+
+      /* Look for a matching item, stopping at an empty slot            */
+      for(hash &= mask; (j = table[hash]) != (-1); hash = (hash+1) & mask)
       {
-         if(Flag[k] && (k != i2))
+         same = TRUE;
+         for(k=0; k<VecDim && same; k++)
          {
-            x = membr[i2] + membr[j2] + membr[k];
-            
-            if (i2 < k) 
-               ind1 = IOFFSET(NVec, i2, k);
-            else 
-               ind1 = IOFFSET(NVec, k, i2);
-            
-            if (j2 < k)
-               ind2 = IOFFSET(NVec, j2, k);
+            if(tol > (REAL)0.0)
+               same = (QUANTISE(data[i][k], tol) == 
+                       QUANTISE(centres[j][k], tol));
             else
-               ind2 = IOFFSET(NVec, k, j2);
-            
-            ind3 = IOFFSET(NVec, i2, j2);
-            xx   = LDDissim[ind3];
-            
-            switch(ClusterMethod)
-            {
-            case 1:
-               /*  Ward's minimum variance method                       */
-               LDDissim[ind1] = (membr[i2] + membr[k]) * LDDissim[ind1] + 
-                                (membr[j2] + membr[k]) * LDDissim[ind2] -
-                                membr[k] * xx;
-               LDDissim[ind1] /= x;
-               break;
-            case 2:
-               /*  Single link method                                   */
-               LDDissim[ind1] = MIN(LDDissim[ind1], LDDissim[ind2]);
-               break;
-            case 3:
-               /*  Complete link method                                 */
-               LDDissim[ind1] = MAX(LDDissim[ind1], LDDissim[ind2]);
-               break;
-            case 4:
-               /*  Average link (or group average) method               */
-               LDDissim[ind1] = (membr[i2] * LDDissim[ind1] + 
-                                 membr[j2] * LDDissim[ind2]) / 
-                                (membr[i2] + membr[j2]);
-               break;
-            case 5:
-               /*  McQuitty's method                                    */
-               LDDissim[ind1] = LDDissim[ind1] * (REAL).5 + 
-                                LDDissim[ind2] * (REAL).5;
-               break;
-            case 6:
-               /*  Median (Gower's) method                              */
-               LDDissim[ind1] = LDDissim[ind1] * (REAL).5 + 
-                                LDDissim[ind2] * (REAL).5 - 
-                                xx         * (REAL).25;
-               break;
-            case 7:
-               /*  Centroid method                                      */
-               LDDissim[ind1] = (membr[i2] * LDDissim[ind1] + 
-                                 membr[j2] * LDDissim[ind2] - 
-                                 membr[i2] * membr[j2]  * xx / 
-                                 (membr[i2] + membr[j2])) / 
-                                (membr[i2] + membr[j2]);
-               break;
-            }
-            
-            if((i2 <= k) && (LDDissim[ind1] < DMin))
-            {
-               DMin = LDDissim[ind1];
-               jj = k;
-            }
+               same = (data[i][k] == centres[j][k]);
          }
+         if(same)
+            break;
       }
-      
-      membr[i2] += membr[j2];
-      DissimNearNeighb[i2] = DMin;
-      NearNeighb[i2] = jj;
-      
-      /* Update list of nearest neighbours as required.                 */
-      for(i=1; i<=NVec-1; i++) 
+
+      if(j == (-1))
       {
-         if(Flag[i]) 
-         {
-            if(NearNeighb[i]==i2 || NearNeighb[i]==j2) 
-            {
-               /* Redetermine nearest neighbour of I                    */
-               DMin = INF;
-               for(j=i+1; j<=NVec; j++) 
-               {
-                  ind = IOFFSET(NVec, i, j);
-                  if(Flag[j] && (i!=j) && (LDDissim[ind] < DMin))
-                  {
-                     DMin = LDDissim[ind];
-                     jj = j;
-                  }
-               }
-               NearNeighb[i] = jj;
-               DissimNearNeighb[i] = DMin;
-            }
-         }
+         j = table[hash] = NItems++;
+         weights[j] = (REAL)0.0;
+         for(k=0; k<VecDim; k++)
+            centres[j][k] = data[i][k];
       }
-   }  while(NClusters>1);
-   /* Repeat previous steps until N-1 agglomerations carried out.       */
-
-   if(++DissimNearNeighb != NULL) free(DissimNearNeighb);
-   if(++LDDissim != NULL) free(LDDissim);
-   if(++membr != NULL) free(membr);
-   if(++NearNeighb != NULL) free(NearNeighb);
-   if(++Flag != NULL) free(Flag);
-
-   data++;
-   for(i=0; i<NVec; i++)
-      (data[i])++;
+      weights[j] += (REAL)1.0;
+      items[i]    = j;
+   }
 
-   return(TRUE);
+   free(table);
+   sNCollapsed = NVec - NItems;
+   return(NItems);
 }
 
 
 /************************************************************************/
-/*>int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit, 
-                       int lev, int *iorder, REAL *critval, int *height)
-   ---------------------------------------------------------------------
+/*>int *ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, int lev,
+                       int NLoops, int *micro)
+   ------------------------------------------------------------------
    Input:   FILE *fp          File for output (or NULL)
             int  NVec         Number of vectors
-            int  ia[NVec]     \
-                 ib[NVec]     | History of allomerations
-            REAL crit[NVec]   /
+            int  ia[NVec]     \ History of allomerations
+                 ib[NVec]     /
             int  lev          Number of clusters in largest partition
-   Output:  int  iorder[lev]  \
-            REAL critval[lev] | vectors describing the dendrogram
-            int  height[lev]  /
-   Returns: int  **           NVec X lev array describing clusters
+            int  NLoops       Number of loops in the cluster table
+            int  micro[NLoops] Vector (from 0) standing for each loop, or
+                              NULL if the vectors are the loops
+   Returns: int  *            NVec array giving the agglomeration at
+                              which each cluster disappears 
+                              (NULL if allocation failed)
 
    Given a HIERARCHIC CLUSTERING, described as a sequence of    
    agglomerations, derive the assignments into clusters for the 
    top LEV-1 levels of the hierarchy.                           
-   Prepare also the required data for representing the          
-   dendrogram of this top part of the hierarchy.                
 
    Pick out the clusters which the N objects belong to, 
    at levels N-2, N-3, ... N-LEV+1 of the hierarchy. 
@@ -979,124 +4183,65 @@ BOOL HierClus(int NVec, int VecDim, int ClusterMethod, REAL **data,
    There are 2, 3, ... LEV clusters, respectively, for the 
    above levels of the hierarchy. 
 
+   Rather than storing the cluster of every object at every level, the
+   returned array records, for each cluster, the agglomeration at which
+   it is merged into another (NVec for cluster 1 which never is). This
+   is all that is needed to find the clusters at any level; see 
+   CLUSLABEL(), FillClusterArray() and DendogramOrder(). The cluster 
+   table is printed a row at a time by following each object up the
+   hierarchy. When micro-clusters have been clustered, the row for each
+   loop is that of its micro-cluster.
+
    20.06.95 Original By: ACRM
             Based on FORTRAN code by F. Murtagh, ESA/ESO/STECF, Garching,
             February 1986 available in STATLIB.     
    22.06.95 Size of hvals array should be [lev+2], not [lev]
    26.06.95 Fixed potential off-bottom of array accesses
    24.07.95 Added code to print loop identifiers
+   16.10.26 Returns the agglomeration at which each cluster is merged
+            rather than an NVec x lev table of assignments. Dendrogram
+            ordering moved to DendogramOrder()
+   16.10.26 Added NLoops and micro
+   16.10.26 Loops taken from gLoopTable
 */
-int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit, 
-                    int lev, int *iorder, REAL *critval, int *height)
+int *ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, int lev,
+                   int NLoops, int *micro)
 {
-   int      ilev, 
-            i, 
+   int      i, 
             j, 
-            k, 
-            level, 
             icl, 
-            NClusters, 
-            loc,
-            *hvals = NULL,
-            **clusters = NULL;
-   BOOL     BreakOut;
+            level, 
+            *merged = NULL,
+            *row    = NULL;
    DATALIST *p;
    char     *loopid;
 
    /* Allocate memory                                                   */
-   clusters = (int **)blArray2D(sizeof(int),NVec,lev);
-   hvals  = (int *)malloc((2+lev) * sizeof(int));
+   merged = (int *)malloc(NVec * sizeof(int));
+   row    = (int *)malloc(lev * sizeof(int));
 
    /* Check allocations; free and return if failed                      */
-   if(clusters==NULL || hvals==NULL)
+   if(merged==NULL || row==NULL)
    {
-      if(clusters!=NULL)
-         blFreeArray2D((char **)clusters, NVec, lev);
-      if(hvals!=NULL)
-         free(hvals);
+      if(merged!=NULL)
+         free(merged);
+      if(row!=NULL)
+         free(row);
       return(NULL);
    }
 
    /* For all arrays, move pointer back one so we count FORTRAN-style
       from 1 rather than from 0
    */
-   crit--;
    ia--;
    ib--;
-   height--;
-   critval--;
-   iorder--;
-   hvals--;
-   for(i=0; i<NVec; i++)
-      (clusters[i])--;
-   clusters--;
-
-
-   hvals[1] = 1;
-   hvals[2] = ib[NVec - 1];
-   loc = 3;
-   for(i=NVec-2; i>=NVec-lev && i>0; i--) 
-   {
-      for(j=1,BreakOut=FALSE; j<=loc-1; j++) 
-      {
-         if(ia[i] == hvals[j]) 
-         {
-            BreakOut=TRUE;
-            break;
-         }
-      }
-      if(!BreakOut)
-      {
-         hvals[loc] = ia[i];
-         loc++;
-      }
-      
-      for(j=1,BreakOut=FALSE; j<=loc-1; j++) 
-      {
-         if(ib[i]==hvals[j]) 
-         {
-            BreakOut=TRUE;
-            break;
-         }
-      }
-      if(!BreakOut)
-      {
-         hvals[loc] = ib[i];
-         loc++;
-      }
-   }
-
-   for(level=NVec-lev; level<=NVec-2; level++) 
-   {
-      for(i=1; i<=NVec; i++) 
-      {
-         icl = i;
-         for(ilev=1; ilev<=level; ilev++) 
-         {
-            if(ib[ilev] == icl) 
-            {
-               icl = ia[ilev];
-            }
-         }
-         NClusters = NVec-level;
-         clusters[i][NClusters-1] = icl;
-      }
-   }
+   merged--;
 
-   for(i=1; i<=NVec; i++) 
-   {
-      for(j=1; j<=lev-1; j++) 
-      {
-         for(k=2; k<=lev; k++) 
-         {
-            if(clusters[i][j] == hvals[k]) 
-            {
-               clusters[i][j] = k;
-               break;
-            }
-         }
-      }
-   }
+   /* Record where each cluster is merged into another                  */
+   for(i=1; i<=NVec; i++)
+      merged[i] = NVec;
+   for(level=1; level<=NVec-1; level++)
+      merged[ib[level]] = level;
 
    if(fp!=NULL)
    {
@@ -1104,8 +4249,9 @@ int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit,
       
       fprintf(fp,"     SEQ NOS 2CL 3CL 4CL 5CL 6CL 7CL 8CL 9CL\n");
       fprintf(fp,"     ------- --- --- --- --- --- --- --- --- ----\n");
-      for(i=1,p=gDataList; i<=NVec && p!=NULL; i++, NEXT(p))
+      for(i=1; i<=NLoops && i<=gNLoops; i++)
       {
+         p      = gLoopTable[i-1];
          loopid = blFNam2PDB(p->loopid);
          
          if(loopid==NULL)
@@ -1113,24 +4259,85 @@ int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit,
          else
             fprintf(fp,"   %4s%4d",loopid,i);
 
-         for(j=1; j<=lev-1; j++)
-         {
-            fprintf(fp,"%4d",clusters[i][j]);
-         }
-         fprintf(fp,"\n");
-      }
-      fprintf(fp, "END CLUSTABLE\n");
-   }
-   
+         /* Follow this object up the hierarchy from the level with lev
+            clusters to the level with 2
+         */
+         icl = (micro==NULL) ? i : micro[i-1]+1;
+         for(j=lev-1; j>=1; j--)
+         {
+            level = NVec-j-1;
+            while(merged[icl] <= level)
+               icl = ia[merged[icl]];
+            row[j] = CLUSLABEL(merged, NVec, icl);
+         }
+
+         for(j=1; j<=lev-1; j++)
+         {
+            fprintf(fp,"%4d",row[j]);
+         }
+         fprintf(fp,"\n");
+      }
+      fprintf(fp, "END CLUSTABLE\n");
+   }
+   
+   free(row);
+
+   /* Return the merge levels                                           */
+   return(++merged);
+}
+
+
+/************************************************************************/
+/*>void DendogramOrder(int NVec, int *ia, int *ib, REAL *crit, 
+                       int *merged, int lev, int *iorder, 
+                       REAL *critval, int *height)
+   --------------------------------------------------------------
+   Input:   int  NVec         Number of vectors
+            int  ia[NVec]     \
+                 ib[NVec]     | History of allomerations
+            REAL crit[NVec]   /
+            int  merged[NVec] Merge levels from ClusterAssign()
+            int  lev          Number of clusters in largest partition
+   Output:  int  iorder[lev]  \
+            REAL critval[lev] | vectors describing the dendrogram
+            int  height[lev]  /
+
+   Prepare the required data for representing the dendrogram of the 
+   top part of the hierarchy. Only needed when the dendrogram is to be
+   displayed.
+
+   20.06.95 Original By: ACRM
+            Based on FORTRAN code by F. Murtagh, ESA/ESO/STECF, Garching,
+            February 1986 available in STATLIB.     
+   16.10.26 Taken out of ClusterAssign(). The parent of each new 
+            cluster is found from the merge levels rather than by
+            searching the table of assignments
+*/
+void DendogramOrder(int NVec, int *ia, int *ib, REAL *crit, int *merged,
+                    int lev, int *iorder, REAL *critval, int *height)
+{
+   int i, 
+       j, 
+       k, 
+       loc;
+
+   /* For all arrays, move pointer back one so we count FORTRAN-style
+      from 1 rather than from 0
+   */
+   crit--;
+   ia--;
+   ib--;
+   height--;
+   critval--;
+   iorder--;
+   merged--;
+
    /* Determine an ordering of the LEV clusters (at level LEV-1) 
       for later representation of the dendrogram. 
-      These are stored in IORDER. 
       Determine the associated ordering of the criterion values 
       for the vertical lines in the dendrogram. 
       The ordinal values of these criterion values may be used in 
       preference, and these are stored in HEIGHT. 
-      Finally, note that the LEV clusters are renamed so that they 
-      have seq. nos. 1 to LEV.
    */ 
    iorder[1] = ia[NVec - 1];
    iorder[2] = ib[NVec - 1];
@@ -1160,55 +4367,19 @@ int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit,
       }
    }
 
-   for(i=1; i<=lev; i++) 
-   {
-      for(j=1; j<=lev; j++) 
-      {
-         if(hvals[i]==iorder[j]) 
-         {
-            iorder[j] = i;
-            break;
-         }
-      }
-   }
-
-
-   /* Fix iorder[] array to give the correct numbers along the bottom   */
+   /* Fix iorder[] array to give the correct numbers along the bottom.
+      The clusters are renamed so that they have seq. nos. 1 to LEV.
+      Cluster j+1 first appears when cluster ib[NVec-j] is split off 
+      from ia[NVec-j], so it goes to the right of that cluster
+   */
    iorder[1] = 1;
    iorder[2] = 2;
    
    for(j=2; j<=lev-1; j++)
    {
-      int parent;
-      
-      for(i=1; i<=NVec; i++)
-      {
-         if(clusters[i][j] == j+1)
-         {
-            /* This is the new cluster; see what it's parent was        */
-            parent = clusters[i][j-1];
-
-            /* Insert this cluster number to the right of the parent in 
-               iorder
-            */
-            InsertIorder(iorder,lev,j+1,parent);
-            
-            break;
-         }
-      }
-      
+      InsertIorder(iorder, lev, j+1, 
+                   CLUSLABEL(merged, NVec, ia[NVec-j]));
    }
-
-   /* Fix pointers into arrays                                          */
-   clusters++;
-   for(i=0; i<NVec; i++)
-      (clusters[i])++;
-
-   /* Free temporary storage                                            */
-   free(++hvals);
-
-   /* Return cluster array                                              */
-   return(clusters);
 }
 
 
@@ -1351,31 +4522,541 @@ HIERARCHY).\n");
    13.09.95 Corrected dimensionality of vectors (was 2*gMaxLoopLen: 
             wrong when doing true torsions) and account for distances.
    21.09.95 Modified calculation of VecDim
+   16.10.26 When updating, adds the loops from the previous run with
+            their stored vectors
+   16.10.26 Data are freed with FreeFeatures()
+   16.10.26 VecDim from FeatureLayout(). Approximate Ward is refused 
+            with the angular metric
+   16.10.26 METRIC RMSD clusters the CA coordinates from ConvertCoor()
+   16.10.26 Builds gLoopTable with IndexLoops()
+   16.10.26 Takes the loops and vectors from a checkpoint when resuming
 */
 BOOL DoClustering(BOOL CATorsions)
 {
-   REAL **data;
-   int  NData,
-        VecDim;
-   BOOL retval;
+   FEATURE **data;
+   int     NData,
+           VecDim,
+           i, j;
+   BOOL    retval;
+
+   /* Micro-clusters are centroids so need the sin/cos coordinates      */
+   if((sResume == NULL) &&
+      (gMetric != METRIC_EUCLIDEAN) && (gClusterMethod == 8))
+   {
+      fprintf(stderr,"Error: METHOD approximate requires METRIC \
+Euclidean\n");
+      return(FALSE);
+   }
+
+   if((sPrev != NULL) && 
+      ((sResume != NULL) || (sCheckFile[0] != '\0')))
+   {
+      fprintf(stderr,"Error: UPDATE cannot be used with CHECKPOINT or \
+RESUME\n");
+      return(FALSE);
+   }
+
+   /* Superposed coordinates have no vectors to store in the output     */
+   if(sResume != NULL)
+   {
+      if((data = ResumeLoops(sResume, &NData, &VecDim))==NULL)
+         return(FALSE);
+   }
+   else if(gMetric == METRIC_RMSD)
+   {
+      if(sPrev != NULL)
+      {
+         fprintf(stderr,"Error: UPDATE requires METRIC Euclidean\n");
+         return(FALSE);
+      }
+      if((data = ConvertCoor(gDataList, &NData, &VecDim))==NULL)
+         return(FALSE);
+   }
+   else
+   {
+      VecDim = FeatureLayout(CATorsions) * gMaxLoopLen;
 
-   VecDim = 2;
-   if(!CATorsions) VecDim += 4;
-   if(gDoAngles)   VecDim += 1;
-   if(gDoDistance) VecDim += 1;
-   VecDim *= gMaxLoopLen;
+      if(sPrev != NULL)
+      {
+         if(!CheckPrevClan(VecDim) || !AddPrevLoops())
+            return(FALSE);
+      }
+
+      if((data = ConvertData(gDataList, &NData, CATorsions))==NULL)
+         return(FALSE);
+   }
 
-   if((data = ConvertData(gDataList, &NData, CATorsions))==NULL)
+   /* Index the loops, including any from a previous run, by vector    */
+   if(!IndexLoops())
+   {
+      FreeFeatures(data);
       return(FALSE);
+   }
+
+   /* Loops from a previous run take the vectors stored in its output   */
+   if(sPrev != NULL)
+   {
+      for(i=0; i<sPrev->NLoops; i++)
+      {
+         for(j=0; j<VecDim; j++)
+            data[i][j] = sPrev->data[i][j];
+      }
+   }
 
    retval = ShowClusters(gOutfp, data, NData, VecDim, 
                          gClusterMethod, gDoTable, gDoDendogram);
-   blFreeArray2D((char **)data, NData, VecDim);
+   FreeFeatures(data);
 
    return(retval);
 }
 
 
+/************************************************************************/
+/*>BOOL CheckPrevClan(int VecDim)
+   ------------------------------
+   Input:   int      VecDim       Dimension of the vectors
+   Returns: BOOL                  Can the previous run be updated with
+                                  the current settings?
+   Globals: PREVCLAN *sPrev       The previous run
+
+   Checks that the previous run being updated used the same clustering
+   method and vector settings as the current run. Only Ward's method 
+   (and the approximate version of it) is supported since only there 
+   does clustering the previous clusters as weighted centroids give the
+   same upper levels of the hierarchy. For the same reason, the angular
+   metric cannot be used. The representatives must be of the same type
+   as they decide which clusters post-clustering merges.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Checks REPRESENTATIVE
+*/
+BOOL CheckPrevClan(int VecDim)
+{
+   int  i;
+   BOOL ok = TRUE;
+
+   if((gClusterMethod != 1) && (gClusterMethod != 8))
+   {
+      fprintf(stderr,"Error: UPDATE requires Ward's method\n");
+      return(FALSE);
+   }
+   if(gMetric != METRIC_EUCLIDEAN)
+   {
+      fprintf(stderr,"Error: UPDATE requires METRIC Euclidean\n");
+      return(FALSE);
+   }
+
+   if((sPrev->Method != gClusterMethod) || (sPrev->Metric != gMetric))
+      ok = FALSE;
+   if((sPrev->VecDim != VecDim) || (sPrev->MaxLen != gMaxLoopLen) ||
+      (sPrev->Distance != gDoDistance) || (sPrev->Angles != gDoAngles) ||
+      (sPrev->CATorsions != gCATorsions) || (sPrev->Medoids != sMedoids))
+      ok = FALSE;
+   for(i=0; ok && i<gMaxLoopLen; i++)
+   {
+      if(sPrev->Scheme[i] != gScheme[i])
+         ok = FALSE;
+   }
+   for(i=0; ok && i<3; i++)
+   {
+      if(ABS(sPrev->PClusCut[i] - gPClusCut[i]) > (REAL)0.000001)
+         ok = FALSE;
+   }
+
+   if(!ok)
+   {
+      fprintf(stderr,"Error: UPDATE requires the same METHOD, \
+MAXLENGTH, SCHEME, POSTCLUSTER, REPRESENTATIVE\n       and ");
+      fprintf(stderr,"torsion, angle and distance settings as the \
+previous run\n");
+   }
+   
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL AddPrevLoops(void)
+   -----------------------
+   Returns: BOOL                  Success of memory allocations
+   Globals: PREVCLAN *sPrev       The previous run
+            DATALIST *gDataList   Loops from the previous run are added
+                                  at the start
+
+   Adds an entry to the start of the data linked list for each loop in 
+   the previous run. Only the loop identifier is filled in; the
+   structure is read by LoadLoop() if it is needed for post-clustering
+   or critical residue analysis.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Zeros ncoor
+*/
+BOOL AddPrevLoops(void)
+{
+   DATALIST *list = NULL,
+            *p    = NULL;
+   char     *start,
+            *end;
+   int      i;
+
+   for(i=0; i<sPrev->NLoops; i++)
+   {
+      if(list == NULL)
+      {
+         INIT(list, DATALIST);
+         p = list;
+      }
+      else
+      {
+         ALLOCNEXT(p, DATALIST);
+      }
+      if(p == NULL)
+      {
+         FREELIST(list, DATALIST);
+         fprintf(stderr,"No memory for loops from previous run\n");
+         return(FALSE);
+      }
+
+      p->allatompdb = NULL;
+      p->pdbloop    = NULL;
+      p->torsionpdb = NULL;
+      p->newer      = p->older = NULL;
+      p->pdbbytes   = 0;
+      p->pins       = 0;
+      p->length     = 0;
+      p->ncoor      = 0;
+      strcpy(p->loopid, sPrev->loopid[i]);
+
+      /* The loop identifier is filename-start-end                      */
+      p->start[0] = p->end[0] = '\0';
+      if(((end = strrchr(p->loopid,'-')) != NULL) && (end > p->loopid))
+      {
+         for(start=end-1; start>p->loopid && *start!='-'; start--);
+         strncpy(p->end, end+1, 15);
+         p->end[15] = '\0';
+         if(*start == '-')
+         {
+            strncpy(p->start, start+1, MIN(end-start-1, 15));
+            p->start[MIN(end-start-1, 15)] = '\0';
+         }
+      }
+   }
+
+   if(p != NULL)
+   {
+      p->next   = gDataList;
+      gDataList = list;
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL LoadLoop(DATALIST *loop, BOOL Structure)
+   ----------------------------------------------
+   I/O:     DATALIST *loop        Loop entry to complete
+   Input:   BOOL     Structure    The PDB structure is needed, not just
+                                  the loop coordinates
+   Returns: BOOL                  Success?
+
+   Reads the structure for a loop added by AddPrevLoops() or 
+   ResumeLoops(), or freed by the structure cache. Does nothing if the
+   structure is still held (marking it as recently used), or if only
+   the loop coordinates are needed and these are already stored.
+   Changes gDataList and the structure cache, so must not be called by
+   more than one thread at once.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Added Structure
+   16.10.26 Re-reads structures freed by the structure cache
+*/
+BOOL LoadLoop(DATALIST *loop, BOOL Structure)
+{
+   DATALIST *list = gDataList;
+   char     filename[MAXBUFF];
+   int      len;
+   BOOL     ok;
+
+   if(Structure && (loop->allatompdb != NULL))
+   {
+      sCacheHits++;
+      CacheStructure(loop);
+      return(TRUE);
+   }
+   if(!Structure && ((loop->pdbloop != NULL) || (loop->ncoor > 0)))
+      return(TRUE);
+
+   len = strlen(loop->loopid) - strlen(loop->start) - 
+         strlen(loop->end) - 2;
+   if(len < 1)
+   {
+      fprintf(stderr,"Unable to find file name in %s\n",loop->loopid);
+      return(FALSE);
+   }
+   strncpy(filename, loop->loopid, len);
+   filename[len] = '\0';
+
+   /* HandleLoopSpec() stores the loop as the start of a new list       */
+   gDataList = NULL;
+   ok = HandleLoopSpec(filename, loop->start, loop->end, gCATorsions,
+                       (sInfoLevel > 0));
+   if(ok && (gDataList != NULL))
+   {
+      if(Structure)
+         sCacheReads++;
+      UncacheStructure(gDataList);
+      loop->allatompdb = gDataList->allatompdb;
+      loop->torsionpdb = gDataList->torsionpdb;
+      loop->pdbloop    = gDataList->pdbloop;
+      loop->length     = gDataList->length;
+      loop->ncoor      = gDataList->ncoor;
+      memcpy(loop->ca,    gDataList->ca,    MAXLOOPLEN * sizeof(COOR));
+      memcpy(loop->cb,    gDataList->cb,    MAXLOOPLEN * sizeof(COOR));
+      memcpy(loop->hascb, gDataList->hascb, MAXLOOPLEN * sizeof(BOOL));
+      free(gDataList);
+      if(gDoCritRes)
+         CacheStructure(loop);
+   }
+   else
+   {
+      fprintf(stderr,"Unable to read loop %s\n",loop->loopid);
+      ok = FALSE;
+   }
+   gDataList = list;
+   
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>int PrevClanItems(FEATURE **data, int NVec, int VecDim, 
+                     FEATURE **centres, REAL *weights, int *items)
+   --------------------------------------------------------------------
+   Input:   FEATURE **data        Data to cluster. Loops from the 
+                                  previous run come first
+            int     NVec          Number of vectors
+            int     VecDim        Dimension of the vectors
+   Output:  FEATURE **centres     Items to cluster
+            REAL    *weights      Number of vectors in each item
+            int     *items        Item (from 0) standing for each vector
+   Returns: int                   Number of items
+   Globals: PREVCLAN *sPrev       The previous run
+
+   Each raw cluster of the previous run becomes a single item at the
+   centroid of its members, weighted by their number, and each new loop
+   becomes an item on its own. Clustering these re-runs only the levels
+   of the hierarchy above the previous raw clusters. With Ward's method
+   the merge criterion between weighted centroids is that between the
+   clusters they stand for.
+
+   16.10.26 Original   By: ACRM
+*/
+int PrevClanItems(FEATURE **data, int NVec, int VecDim, 
+                  FEATURE **centres, REAL *weights, int *items)
+{
+   int i, j, k,
+       NItems = sPrev->NRaw + NVec - sPrev->NLoops;
+
+   for(k=0; k<sPrev->NRaw; k++)
+   {
+      weights[k] = (REAL)0.0;
+      for(j=0; j<VecDim; j++)
+         centres[k][j] = (REAL)0.0;
+   }
+
+   for(i=0; i<sPrev->NLoops; i++)
+   {
+      k = sPrev->raw[i] - 1;
+      weights[k] += (REAL)1.0;
+      for(j=0; j<VecDim; j++)
+         centres[k][j] += data[i][j];
+      items[i] = k;
+   }
+   for(k=0; k<sPrev->NRaw; k++)
+   {
+      for(j=0; j<VecDim; j++)
+         centres[k][j] /= weights[k];
+   }
+
+   for(i=sPrev->NLoops, k=sPrev->NRaw; i<NVec; i++, k++)
+   {
+      weights[k] = (REAL)1.0;
+      for(j=0; j<VecDim; j++)
+         centres[k][j] = data[i][j];
+      items[i] = k;
+   }
+
+   return(NItems);
+}
+
+
+/************************************************************************/
+/*>int *UnchangedClusters(int *ItemClusters, int NItems, int NClus)
+   ----------------------------------------------------------------
+   Input:   int  *ItemClusters    Cluster of each item from 
+                                  PrevClanItems()
+            int  NItems           Number of items
+            int  NClus            Number of clusters
+   Returns: int  *                For each cluster (from 0), the raw 
+                                  cluster (from 1) of the previous run
+                                  which it is identical to, or 0 if it
+                                  has changed. NULL if allocation failed
+   Globals: PREVCLAN *sPrev       The previous run
+
+   Finds the clusters which are the same as a raw cluster from the 
+   previous run; they contain one of the previous clusters and no new
+   loops.
+
+   16.10.26 Original   By: ACRM
+*/
+int *UnchangedClusters(int *ItemClusters, int NItems, int NClus)
+{
+   int *OldRaw,
+       i, c;
+
+   if((OldRaw = (int *)malloc(NClus * sizeof(int)))==NULL)
+      return(NULL);
+   for(c=0; c<NClus; c++)
+      OldRaw[c] = 0;
+
+   /* Items from 0 to NRaw-1 are the previous clusters                  */
+   for(i=0; i<NItems; i++)
+   {
+      c = ItemClusters[i] - 1;
+      if((i >= sPrev->NRaw) || (OldRaw[c] != 0))
+         OldRaw[c] = (-1);
+      else
+         OldRaw[c] = i+1;
+   }
+
+   for(c=0; c<NClus; c++)
+   {
+      if(OldRaw[c] < 0)
+         OldRaw[c] = 0;
+   }
+   
+   return(OldRaw);
+}
+
+
+/************************************************************************/
+/*>BOOL PrevMerge(int i, int j, REAL *rms, REAL *CADev, REAL *CBDev)
+   ------------------------------------------------------------------
+   Input:   int  i, j            Raw clusters of the previous run
+   Output:  REAL *rms            RMS between the clusters
+            REAL *CADev          Max CA deviation between the clusters
+            REAL *CBDev          Max CB deviation between the clusters
+   Returns: BOOL                 Were the clusters merged?
+   Globals: PREVCLAN *sPrev      The previous run
+
+   Looks up whether post-clustering in the previous run merged two raw
+   clusters.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL PrevMerge(int i, int j, REAL *rms, REAL *CADev, REAL *CBDev)
+{
+   int k,
+       lo = MIN(i, j),
+       hi = MAX(i, j);
+
+   for(k=0; k<sPrev->NMerge; k++)
+   {
+      if((sPrev->merges[k].i == lo) && (sPrev->merges[k].j == hi))
+      {
+         *rms   = sPrev->merges[k].rms;
+         *CADev = sPrev->merges[k].CADev;
+         *CBDev = sPrev->merges[k].CBDev;
+         return(TRUE);
+      }
+   }
+
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>char **PrevCritRes(int *clusters, int NVec, int NClus)
+   ------------------------------------------------------
+   Input:   int  *clusters        Post-clustered cluster of each loop
+            int  NVec             Number of loops
+            int  NClus            Number of clusters
+   Returns: char **               For each cluster (from 0), its 
+                                  CRITICALRESIDUES text from the previous
+                                  run or NULL if it must be worked out.
+                                  NULL if allocation failed.
+   Globals: PREVCLAN *sPrev       The previous run
+
+   Finds the critical residue text for clusters which have exactly the
+   same members as a cluster in the previous run. The strings belong to
+   sPrev and only the returned array should be freed.
+
+   16.10.26 Original   By: ACRM
+*/
+char **PrevCritRes(int *clusters, int NVec, int NClus)
+{
+   char **CritCopy;
+   int  *PrevPost,
+        *NMembers,
+        *NPrevMembers,
+        i, c;
+
+   CritCopy     = (char **)malloc(NClus * sizeof(char *));
+   PrevPost     = (int *)malloc(NClus * sizeof(int));
+   NMembers     = (int *)malloc(NClus * sizeof(int));
+   NPrevMembers = (int *)malloc((sPrev->NPost+1) * sizeof(int));
+   if((CritCopy == NULL) || (PrevPost == NULL) || (NMembers == NULL) ||
+      (NPrevMembers == NULL))
+   {
+      if(CritCopy     != NULL) free(CritCopy);
+      if(PrevPost     != NULL) free(PrevPost);
+      if(NMembers     != NULL) free(NMembers);
+      if(NPrevMembers != NULL) free(NPrevMembers);
+      return(NULL);
+   }
+
+   for(c=0; c<NClus; c++)
+   {
+      CritCopy[c] = NULL;
+      PrevPost[c] = 0;
+      NMembers[c] = 0;
+   }
+   for(c=0; c<=sPrev->NPost; c++)
+      NPrevMembers[c] = 0;
+   for(i=0; i<sPrev->NLoops; i++)
+      NPrevMembers[sPrev->post[i]]++;
+
+   /* Find the previous cluster of each cluster's members (-1 if they
+      are new or from different clusters)
+   */
+   for(i=0; i<NVec; i++)
+   {
+      c = clusters[i] - 1;
+      NMembers[c]++;
+      if(i >= sPrev->NLoops)
+         PrevPost[c] = (-1);
+      else if(PrevPost[c] == 0)
+         PrevPost[c] = sPrev->post[i];
+      else if(PrevPost[c] != sPrev->post[i])
+         PrevPost[c] = (-1);
+   }
+
+   for(c=0; c<NClus; c++)
+   {
+      if((PrevPost[c] > 0) && (PrevPost[c] <= sPrev->NCritRes) &&
+         (NMembers[c] == NPrevMembers[PrevPost[c]]))
+         CritCopy[c] = sPrev->CritRes[PrevPost[c]];
+   }
+
+   free(PrevPost);
+   free(NMembers);
+   free(NPrevMembers);
+   
+   return(CritCopy);
+}
+
+
 /************************************************************************/
 /*>void Usage(void)
    ----------------
@@ -1390,13 +5071,15 @@ BOOL DoClustering(BOOL CATorsions)
    10.10.95 V3.4
    06.11.95 V3.5
    09.01.96 V3.6
+   16.10.26 Added -j
 */
 void Usage(void)
 {
    fprintf(stderr,"\nCLAN V3.6 (c) 1995, Dr. Andrew C.R. Martin, UCL\n");
 
-   fprintf(stderr,"\nUsage: clan [-t] <datafile>\n");
+   fprintf(stderr,"\nUsage: clan [-t] [-j nthreads] <datafile>\n");
    fprintf(stderr,"       -t Do true torsions\n");
+   fprintf(stderr,"       -j Number of threads to use [1]\n");
 
    fprintf(stderr,"\nCLAN (CLuster ANalysis of Loops) performs cluster \
 analysis to examine\n");
@@ -1481,12 +5164,14 @@ BOOL InsertIorder(int *iorder, int lev, int cluster, int parent)
 
 
 /************************************************************************/
-/*>void WriteHeader(FILE *fp, int Method, int NVec, int VecDim, 
-                    int *Scheme)
+/*>void WriteHeader(FILE *fp, int Method, int NVec, int NItems, 
+                    int VecDim, int *Scheme)
    ------------------------------------------------------------
    Input:   FILE    *fp           Output file pointer
-            int     Method        Clustering method (1--7)
+            int     Method        Clustering method (1--8)
             int     NVec          Number of vectors to cluster
+            int     NItems        Number of micro-clusters actually 
+                                  clustered (NVec if none)
             int     VecDim        Vector dimension
             int    *Scheme        Loop insertion scheme
 
@@ -1498,8 +5183,17 @@ BOOL InsertIorder(int *iorder, int lev, int cluster, int parent)
    21.09.95 Also print DISTANCE and now does (NO)ANGLE as well
    26.09.95 Added TRUETORSIONS/PSEUDOTORSION
    14.03.96 Added gPClusCut[2] to POSTCLUSTER
+   16.10.26 Added DISSIMSTORE with the memory used by the dissimilarity
+            matrix
+   16.10.26 Added NItems and MICROCLUSTERS
+   16.10.26 Added METRIC when not Euclidean
+   16.10.26 Added COLLAPSED with the number of duplicate vectors
+   16.10.26 Added METRIC RMSD
+   16.10.26 Added REPRESENTATIVE MEDOID
+   16.10.26 Added DISSIMSTORE MMAPFLOAT
 */
-void WriteHeader(FILE *fp, int Method, int NVec, int VecDim, int *Scheme)
+void WriteHeader(FILE *fp, int Method, int NVec, int NItems, int VecDim,
+                 int *Scheme)
 {
    int i;
    
@@ -1518,19 +5212,36 @@ void WriteHeader(FILE *fp, int Method, int NVec, int VecDim, int *Scheme)
    fprintf(fp,"   %s\n", (gDoAngles)   ? "ANGLES"   : "NOANGLES");
    fprintf(fp,"   %s\n", (gCATorsions) ? 
                           "PSEUDOTORSIONS" : "TRUETORSIONS");
+   if(gMetric == METRIC_ANGULAR)
+      fprintf(fp,"   METRIC ANGULAR\n");
+   else if(gMetric == METRIC_RMSD)
+      fprintf(fp,"   METRIC RMSD\n");
+   if(Method == 8)
+      fprintf(fp,"   MICROCLUSTERS %d\n", NItems);
+   if(sNCollapsed >= 0)
+      fprintf(fp,"   COLLAPSED %d\n", sNCollapsed);
+   if(sMedoids || (gMetric == METRIC_RMSD))
+      fprintf(fp,"   REPRESENTATIVE MEDOID %d\n", sMedoidMax);
+   fprintf(fp,"   DISSIMSTORE %s %lu\n", 
+           (((Method == 2) && (gMetric != METRIC_RMSD)) ? "NONE" : 
+            ((sDissimStore == DISSIM_FLOAT) ? "FLOAT" :
+             ((sDissimStore == DISSIM_MMAP) ? "MMAP" : 
+              ((sDissimStore == DISSIM_MMAPFLOAT) ? "MMAPFLOAT" 
+                                                  : "DOUBLE")))),
+           DissimStoreBytes(NItems, Method));
    
    fprintf(fp,"END HEADER\n");
 }
 
 
 /************************************************************************/
-/*>BOOL WriteResults(FILE *fp, int *clusters, int NClus, REAL **data, 
+/*>BOOL WriteResults(FILE *fp, int *clusters, int NClus, FEATURE **data, 
                      int NVec, int VecDim, REAL *crit, BOOL PostClus)
    ------------------------------------------------------------------
    Input:   FILE     *fp          output file pointer
             int      *clusters    Cluster array
             int      NClus        Number of clusters
-            REAL     **data       Data which is clustered
+            FEATURE  **data       Data which is clustered
             int      NVec         Number of vectors
             int      VecDim       Vector dimension
             REAL     *crit        Critical values for clustering
@@ -1547,67 +5258,81 @@ void WriteHeader(FILE *fp, int Method, int NVec, int VecDim, int *Scheme)
             whole clustering matrix
    17.08.95 Added postcluster handling
    12.09.95 Added nmemb parameter to FindMedian
+   16.10.26 Medians of all clusters from ClusterMedians(). Loops taken
+            from gLoopTable
 */
-BOOL WriteResults(FILE *fp, int *clusters, int NClus, REAL **data, 
+BOOL WriteResults(FILE *fp, int *clusters, int NClus, FEATURE **data, 
                   int NVec, int VecDim, REAL *crit, BOOL PostClus)
 {
    int      i,
-            nmemb;
-   DATALIST *repres;
+            *nmemb;
+   DATALIST **medians;
    
    /* Write the cluster assignment for each loop                        */
    fprintf(fp,"\nBEGIN %sASSIGNMENTS\n",(PostClus?"":"RAW"));
-   for(repres=gDataList,i=0; repres!=NULL; NEXT(repres),i++)
-   {
-      fprintf(fp,"%3d %s\n", clusters[i], repres->loopid);
-   }
+   for(i=0; i<NVec && i<gNLoops; i++)
+      fprintf(fp,"%3d %s\n", clusters[i], gLoopTable[i]->loopid);
    fprintf(fp,"END %sASSIGNMENTS\n",(PostClus?"":"RAW"));
    
 
    /* For each of the clusters, find a representitive                   */
    fprintf(fp,"\nBEGIN %sMEDIANS %d\n",(PostClus?"":"RAW"), NClus);
+   medians = (DATALIST **)malloc(NClus * sizeof(DATALIST *));
+   nmemb   = (int *)malloc(NClus * sizeof(int));
+   if((medians == NULL) || (nmemb == NULL) ||
+      !ClusterMedians(clusters,data,NVec,VecDim,NClus,medians,nmemb))
+   {
+      if(medians != NULL) free(medians);
+      if(nmemb   != NULL) free(nmemb);
+      fprintf(fp,"END %sMEDIANS (failed!)\n",(PostClus?"":"RAW"));
+      fprintf(stderr,"ClusterMedians() failed\n");
+      return(FALSE);
+   }
    for(i=1; i<=NClus; i++)
    {
-      if((repres = FindMedian(clusters,data,NVec,VecDim,i,&nmemb))==NULL)
-      {
-         fprintf(fp,"END %sMEDIANS (failed!)\n",(PostClus?"":"RAW"));
-         fprintf(stderr,"FindMedian() failed\n");
-         return(FALSE);
-      }
-      if(repres != (DATALIST *)(-1))
-         fprintf(fp,"%3d %s\n",i, repres->loopid);
+      if(medians[i-1] != (DATALIST *)(-1))
+         fprintf(fp,"%3d %s\n",i, medians[i-1]->loopid);
    }
    fprintf(fp,"END %sMEDIANS\n",(PostClus?"":"RAW"));
 
+   free(medians);
+   free(nmemb);
+
    return(TRUE);
 }
 
 
 /************************************************************************/
-/*>int FindNumTrueClusters(REAL *crit, int lev, int VecDim)
-   --------------------------------------------------------
+/*>int FindNumTrueClusters(REAL *crit, int lev, int VecDim, REAL cutoff)
+   ---------------------------------------------------------------------
    Input:   REAL   *crit    Array of critical values in clustering
             int    lev      Number of clustering levels (length of crit[]
                             array)
             int    VecDim   Number of dimensions in vector
+            REAL   cutoff   Critical value per dimension above which
+                            clusters are distinct
    Returns: int             Number of truely different clusters
 
    Finds the number of really different clusters. 
 
    This is currently done by dividing the critical value by the Vector
-   dimensionality and selecting values greater than 0.06 which seems
-   to work well for Ward's minimum variance method.
+   dimensionality and selecting values greater than cutoff. CLUSCUT
+   (0.06) seems to work well for Ward's minimum variance method; other
+   values may be tried with SWEEP. With METRIC RMSD VecDim is 3 times 
+   the number of CAs so this is the variance per coordinate in square 
+   Angstroms.
 
    03.07.95 Original    By: ACRM
    25.09.95 Added VecDim parameter and modified code to use it
+   16.10.26 Added cutoff parameter
 */
-int FindNumTrueClusters(REAL *crit, int lev, int VecDim)
+int FindNumTrueClusters(REAL *crit, int lev, int VecDim, REAL cutoff)
 {
    int i;
    
    for(i=0; i<lev-1; i++)
    {
-      if(crit[i]/(REAL)VecDim > (REAL)0.06)
+      if(crit[i]/(REAL)VecDim > cutoff)
          return(lev-i);
    }
    
@@ -1623,10 +5348,26 @@ int FindNumTrueClusters(REAL *crit, int lev, int VecDim)
 
    06.07.95 Original   By: ACRM
    08.08.95 Added freeing of truestart linked list
+   16.10.26 Frees any previous run being updated
+   16.10.26 Frees gLoopTable
+   16.10.26 Unmaps any checkpoint being resumed
 */
 void CleanUp(void)
 {
    DATALIST *p;
+
+   if(sPrev != NULL)
+   {
+      FreePrevClan(sPrev);
+      sPrev = NULL;
+   }
+
+   if(sResume != NULL)
+   {
+      FreeCheckpoint(sResume);
+      sResume = NULL;
+   }
+
    for(p=gDataList; p!=NULL; NEXT(p))
    {
       if(p->torsionpdb != NULL)
@@ -1635,23 +5376,29 @@ void CleanUp(void)
          FREELIST(p->allatompdb, PDB);
    }
    FREELIST(gDataList, DATALIST);
+
+   if(gLoopTable != NULL)
+      free(gLoopTable);
+   gLoopTable     = NULL;
+   gNLoops        = 0;
+   gLoopTableSize = 0;
 }
 
 
 /************************************************************************/
-/*>void WriteClusData(FILE *fp, int NVec, int VecDim, REAL **data)
+/*>void WriteClusData(FILE *fp, int NVec, int VecDim, FEATURE **data)
    ---------------------------------------------------------------
    Input:   FILE  *fp           Output file pointer
             int   NVec          Number of vectors
             int   VecDim        Dimension of vectors
-            REAL  **data        Data for clustering
+            FEATURE **data      Data for clustering
 
    Writes the raw clustering data to the output file
 
    24.07.95 Original    By: ACRM
    26.07.95 Corrected inner loop to count to VecDim not NVec!
 */
-void WriteClusData(FILE *fp, int NVec, int VecDim, REAL **data)
+void WriteClusData(FILE *fp, int NVec, int VecDim, FEATURE **data)
 {
    int i, j;
    
@@ -1670,24 +5417,39 @@ void WriteClusData(FILE *fp, int NVec, int VecDim, REAL **data)
 
 
 /************************************************************************/
-/*>DATALIST *FindMedian(int *clusters, REAL **data, int NVec, 
-                        int VecDim, int ClusNum, int *NMemb)
-   ----------------------------------------------------------
-   Input:   int   *clusters     Clustring vector
-            REAL  **data        Data which is clustered
-            int   NVec          Number of vectors
-            int   VecDim        Dimension of vectors
-            int   ClusNum       The cluster number we are interested in
-   Output:  int   *NMemb        Number of members of this cluster
-   Returns: DATALIST *          Pointer to median for this cluster.
-                                NULL on memory error
-                                (-1) if no members of this cluster
-
-   Calculates the median of cluster ClusNum out of NClus clusters. Then
-   finds the vector closest to the median and returns a DATALIST
-   pointer to the associated loop identifier.
-
-   03.07.95 Original    By: ACRM
+/*>BOOL ClusterMedians(int *clusters, FEATURE **data, int NVec, 
+                       int VecDim, int NClus, DATALIST **repres, 
+                       int *NMemb)
+   -------------------------------------------------------------------
+   Input:   int      *clusters  Clustering vector
+            FEATURE  **data     Data which is clustered
+            int      NVec       Number of vectors
+            int      VecDim     Dimension of vectors
+            int      NClus      Number of clusters
+   Output:  DATALIST **repres   Median of each cluster [NClus], (-1) if
+                                the cluster has no members
+            int      *NMemb     Number of members of each cluster 
+                                [NClus]
+   Returns: BOOL                Success of memory allocations
+   Globals: int  sNThreads      Number of threads to use
+            BOOL sMedoids       Use medoids rather than medians
+            int  sMedoidMax     Largest cluster with an exact medoid
+
+   Finds the representative of every cluster at once. The range of
+   each cluster in each dimension is found in one pass over the 
+   vectors and the member closest to the middle of the range is found
+   in a second. Both passes are split between sNThreads threads by 
+   ranges of vectors, each with its own bounds and nearest members 
+   which are then combined in order, so the result is the same as
+   scanning the vectors for each cluster in turn. The vectors from 
+   ExpandFeature() are used so raw torsions for the angular metric are
+   handled as sin/cos. The loops are then picked out of gLoopTable 
+   rather than by walking the linked list for each one. With 
+   REPRESENTATIVE MEDOID, or METRIC RMSD where a median of coordinates
+   means nothing until they are superposed, each cluster's 
+   representative is its medoid from FindMedoids().
+
+   03.07.95 Original (FindMedian())    By: ACRM
    06.07.95 Changed to return DATALIST pointer rather than the actual
             loopid string
    02.08.95 Added code to handle NClus==1. Fixed array access code
@@ -1695,457 +5457,980 @@ void WriteClusData(FILE *fp, int NVec, int VecDim, REAL **data)
    15.08.95 Uses 1D cluster vector rather than the 2D matrix
    12.09.95 Added NMemb output parameter
    30.01.09 Initialize some variables
+   16.10.26 Median is a FEATURE vector. Works on the vectors from
+            ExpandFeature() so raw torsions for the angular metric are
+            handled as sin/cos. Frees the arrays if there are no members
+   16.10.26 Uses FindMedoid() for METRIC RMSD
+   16.10.26 Rewritten to find all the clusters' medians in two threaded
+            passes
+   16.10.26 Medoids from FindMedoids() for REPRESENTATIVE MEDOID
+   16.10.26 Medoids are found on a copy of the data from 
+            ExpandFeatures() with raw torsions
 */
-DATALIST *FindMedian(int *clusters, REAL **data, int NVec, int VecDim, 
-                     int ClusNum, int *NMemb)
+BOOL ClusterMedians(int *clusters, FEATURE **data, int NVec, int VecDim,
+                    int NClus, DATALIST **repres, int *NMemb)
 {
-   DATALIST *p;
-   int      i, j,
-            best = 0;
-   REAL     *minval, 
-            *maxval,
-            *medval,
-            mindist = 10000.0,
-            dist;
-   BOOL     Done = FALSE;
-
-   *NMemb = 0;
-
-   /* Allocate arrays to store min and max values in each dimension     */
-   if((minval=(REAL *)malloc(VecDim*sizeof(REAL)))==NULL)
-      return(NULL);
-   if((maxval=(REAL *)malloc(VecDim*sizeof(REAL)))==NULL)
+   MEDIANJOB   *jobs     = NULL;
+   pthread_t   *threads  = NULL;
+   CLUSMEMBERS cm;
+   FEATURE     *bounds   = NULL,
+               *medval   = NULL,
+               *vecs     = NULL,
+               *min0, *max0, *min1, *max1;
+   FEATURE     **expanded = NULL;
+   REAL        *BestDist = NULL;
+   int         *counts   = NULL,
+               *best     = NULL,
+               ExpDim, NThreads, NStarted,
+               i, j, c, t, pass;
+   BOOL        ok        = TRUE;
+
+   /* Superposed coordinates have no meaningful median                  */
+   if(sMedoids || (gMetric == METRIC_RMSD))
    {
-      free(minval);
-      return(NULL);
+      if(!BuildClusMembers(clusters, NVec, NClus, &cm))
+         return(FALSE);
+      /* Expand raw torsions once rather than for every pair            */
+      if(gResTorsions && 
+         ((expanded = ExpandFeatures(data, NVec, VecDim))==NULL))
+      {
+         FreeClusMembers(&cm);
+         return(FALSE);
+      }
+      if((best = (int *)malloc(MAX(NClus,1) * sizeof(int)))==NULL)
+      {
+         FreeClusMembers(&cm);
+         FreeFeatures(expanded);
+         return(FALSE);
+      }
+      if((ok = FindMedoids(((expanded != NULL) ? expanded : data), 
+                           ((expanded != NULL) ? EXPANDEDDIM(VecDim) 
+                                               : VecDim), 
+                           &cm, sMedoidMax, 
+                           MAX(sNThreads, 1),
+                           ((gMetric == METRIC_RMSD) ? CoorDist2 
+                                                     : FeatureDist2),
+                           best)))
+      {
+         for(c=0; c<NClus; c++)
+         {
+            NMemb[c]  = NCLUSMEMBERS(&cm, c+1);
+            repres[c] = (best[c] < 0) ? (DATALIST *)(-1) 
+                                      : gLoopTable[best[c]];
+         }
+      }
+      free(best);
+      FreeClusMembers(&cm);
+      FreeFeatures(expanded);
+      return(ok);
    }
 
-   /* We just use the same storage space for the median values          */
-   medval = minval;
-
-   /* Find the min and max values in each dimension                     */
-   for(i=0; i<NVec; i++)
+   ExpDim   = EXPANDEDDIM(VecDim);
+   NThreads = MAX(sNThreads, 1);
+   NThreads = MIN(NThreads, 1 + NVec/MEDIANMINPERTHREAD);
+
+   /* Each job has its own bounds, member counts and nearest members    */
+   jobs     = (MEDIANJOB *)malloc(NThreads * sizeof(MEDIANJOB));
+   threads  = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+   bounds   = (FEATURE *)malloc((unsigned long)NThreads * 2 * NClus * 
+                                ExpDim * sizeof(FEATURE));
+   medval   = (FEATURE *)malloc((unsigned long)NClus * ExpDim * 
+                                sizeof(FEATURE));
+   vecs     = (FEATURE *)malloc(NThreads * ExpDim * sizeof(FEATURE));
+   BestDist = (REAL *)malloc(NThreads * NClus * sizeof(REAL));
+   counts   = (int *)malloc(NThreads * NClus * sizeof(int));
+   best     = (int *)malloc(NThreads * NClus * sizeof(int));
+
+   if(jobs     == NULL ||
+      threads  == NULL ||
+      bounds   == NULL ||
+      medval   == NULL ||
+      vecs     == NULL ||
+      BestDist == NULL ||
+      counts   == NULL ||
+      best     == NULL)
+   {
+      ok = FALSE;
+   }
+   else
    {
-      if(clusters[i]==ClusNum)
+      for(t=0; t<NThreads; t++)
       {
-         /* On first item, just copy in the data                        */
-         if((*NMemb) == 0)
+         jobs[t].data     = data;
+         jobs[t].clusters = clusters;
+         jobs[t].minval   = bounds + (unsigned long)2 * t * NClus * ExpDim;
+         jobs[t].maxval   = jobs[t].minval + (unsigned long)NClus * ExpDim;
+         jobs[t].medval   = medval;
+         jobs[t].vec      = vecs + t * ExpDim;
+         jobs[t].BestDist = BestDist + t * NClus;
+         jobs[t].NMemb    = counts + t * NClus;
+         jobs[t].best     = best + t * NClus;
+         jobs[t].VecDim   = VecDim;
+         jobs[t].ExpDim   = ExpDim;
+         jobs[t].NClus    = NClus;
+         jobs[t].first    = (int)((long)t * NVec / NThreads);
+         jobs[t].last     = (int)((long)(t+1) * NVec / NThreads);
+         for(c=0; c<NClus; c++)
+            jobs[t].NMemb[c] = 0;
+      }
+
+      for(pass=1; pass<=2; pass++)
+      {
+         for(t=0; t<NThreads; t++)
+            jobs[t].pass = pass;
+
+         for(NStarted=1; NStarted<NThreads; NStarted++)
          {
-            for(j=0; j<VecDim; j++)
-               minval[j] = maxval[j] = data[i][j];
+            if(pthread_create(&(threads[NStarted]), NULL, MedianWorker, 
+                              &(jobs[NStarted])))
+               break;
          }
-         else
+         MedianWorker(&(jobs[0]));
+         for(t=NStarted; t<NThreads; t++)
+            MedianWorker(&(jobs[t]));
+         for(t=1; t<NStarted; t++)
+            pthread_join(threads[t], NULL);
+
+         if(pass == 1)
          {
-            for(j=0; j<VecDim; j++)
+            /* Combine the bounds into the first job's and store the 
+               median values
+            */
+            for(c=0; c<NClus; c++)
             {
-               if(data[i][j] < minval[j])
-                  minval[j] = data[i][j];
-               if(data[i][j] > maxval[j])
-                  maxval[j] = data[i][j];
+               min0 = jobs[0].minval + (unsigned long)c * ExpDim;
+               max0 = jobs[0].maxval + (unsigned long)c * ExpDim;
+               for(t=1; t<NThreads; t++)
+               {
+                  if(jobs[t].NMemb[c] == 0)
+                     continue;
+                  min1 = jobs[t].minval + (unsigned long)c * ExpDim;
+                  max1 = jobs[t].maxval + (unsigned long)c * ExpDim;
+                  if(jobs[0].NMemb[c] == 0)
+                  {
+                     for(j=0; j<ExpDim; j++)
+                     {
+                        min0[j] = min1[j];
+                        max0[j] = max1[j];
+                     }
+                  }
+                  else
+                  {
+                     for(j=0; j<ExpDim; j++)
+                     {
+                        if(min1[j] < min0[j])
+                           min0[j] = min1[j];
+                        if(max1[j] > max0[j])
+                           max0[j] = max1[j];
+                     }
+                  }
+                  jobs[0].NMemb[c] += jobs[t].NMemb[c];
+               }
+
+               for(j=0; (jobs[0].NMemb[c] > 0) && (j<ExpDim); j++)
+                  medval[(unsigned long)c * ExpDim + j] = 
+                     (min0[j] + max0[j]) / (FEATURE)2.0;
             }
          }
-
-         /* Increment member count                                      */
-         (*NMemb)++;
       }
-   }
-
-   /* If nothing found in this cluster, return NULL                     */
-   if(*NMemb == 0)
-      return((DATALIST *)(-1));
 
-   /* Now store the median values                                       */
-   for(j=0; j<VecDim; j++)
-      medval[j] = (minval[j] + maxval[j]) / (REAL)2.0;
-      
-   /* Now run through again and find which is closest to the medval     */
-   for(i=0, Done=FALSE; i<NVec; i++)
-   {
-      if(clusters[i]==ClusNum)
+      /* Take the nearest member to each median from the earliest job
+         which has the smallest distance
+      */
+      for(c=0; c<NClus; c++)
       {
-         if(!Done)
-         {
-            best    = i;
-            mindist = (REAL)0.0;
-            for(j=0; j<VecDim; j++)
-               mindist += (data[i][j] - medval[j]) *
-                          (data[i][j] - medval[j]);
-            
-            Done = TRUE;
-         }
-         else
+         NMemb[c]  = jobs[0].NMemb[c];
+         repres[c] = (DATALIST *)(-1);
+         if(NMemb[c] == 0)
+            continue;
+
+         i = -1;
+         for(t=0; t<NThreads; t++)
          {
-            dist = (REAL)0.0;
-            for(j=0; j<VecDim; j++)
-               dist += (data[i][j] - medval[j]) *
-                       (data[i][j] - medval[j]);
-            if(dist < mindist)
-            {
-               mindist = dist;
-               best    = i;
-            }
+            if(jobs[t].best[c] < 0)
+               continue;
+            if((i < 0) || (jobs[t].BestDist[c] < jobs[i].BestDist[c]))
+               i = t;
          }
+         repres[c] = gLoopTable[jobs[i].best[c]];
       }
    }
 
-   /* Now run through the global data linked list to find the `best'
-      example's loop pointer
-   */
-   for(p=gDataList, i=0; p!=NULL && i<best; NEXT(p), i++) ;
-
-   /* Free up the arrays                                                */
-   free(minval);
-   free(maxval);
+   if(jobs     != NULL) free(jobs);
+   if(threads  != NULL) free(threads);
+   if(bounds   != NULL) free(bounds);
+   if(medval   != NULL) free(medval);
+   if(vecs     != NULL) free(vecs);
+   if(BestDist != NULL) free(BestDist);
+   if(counts   != NULL) free(counts);
+   if(best     != NULL) free(best);
 
-   /* Return the loop pointer                                           */
-   return(p);
+   return(ok);
 }
 
 
 /************************************************************************/
-/*>void FillClusterArray(int **clusters, int NVec, int NClus,
-                         int *TheClusters)
-   ----------------------------------------------------------
-   Fills in the `TheClusters' array with the column corresponding to NClus
-   from the clusters matrix.
+/*>void *MedianWorker(void *arg)
+   -----------------------------
+   Input:   void  *arg      Pointer to a MEDIANJOB
+   Returns: void  *         NULL
 
-   15.08.95 Original    By: ACRM
+   Thread routine for ClusterMedians(). On the first pass, counts the 
+   members of each cluster in the job's range of vectors and finds 
+   their bounds in each dimension. On the second pass, finds the 
+   first vector in the range which is closest to its cluster's median.
+
+   16.10.26 Original   By: ACRM
 */
-void FillClusterArray(int **clusters, int NVec, int NClus,
-                      int *TheClusters)
+void *MedianWorker(void *arg)
 {
-   int i;
-   
-   if(NClus > 1)
+   MEDIANJOB *job = (MEDIANJOB *)arg;
+   FEATURE   *minval, 
+             *maxval,
+             *medval;
+   REAL      dist,
+             d;
+   int       i, j, c;
+
+   if(job->pass == 1)
    {
-      for(i=0; i<NVec; i++)
+      for(i=job->first; i<job->last; i++)
       {
-         TheClusters[i] = clusters[i][NClus-2];
+         c = job->clusters[i] - 1;
+         if((c < 0) || (c >= job->NClus))
+            continue;
+
+         ExpandFeature(job->data[i], job->VecDim, job->vec);
+         minval = job->minval + (unsigned long)c * job->ExpDim;
+         maxval = job->maxval + (unsigned long)c * job->ExpDim;
+
+         /* On first item, just copy in the data                        */
+         if(job->NMemb[c] == 0)
+         {
+            for(j=0; j<job->ExpDim; j++)
+               minval[j] = maxval[j] = job->vec[j];
+         }
+         else
+         {
+            for(j=0; j<job->ExpDim; j++)
+            {
+               if(job->vec[j] < minval[j])
+                  minval[j] = job->vec[j];
+               if(job->vec[j] > maxval[j])
+                  maxval[j] = job->vec[j];
+            }
+         }
+         (job->NMemb[c])++;
       }
    }
    else
    {
-      for(i=0; i<NVec; i++)
+      for(c=0; c<job->NClus; c++)
+         job->best[c] = -1;
+
+      for(i=job->first; i<job->last; i++)
       {
-         TheClusters[i] = 1;
+         c = job->clusters[i] - 1;
+         if((c < 0) || (c >= job->NClus))
+            continue;
+
+         ExpandFeature(job->data[i], job->VecDim, job->vec);
+         medval = job->medval + (unsigned long)c * job->ExpDim;
+         dist   = (REAL)0.0;
+         for(j=0; j<job->ExpDim; j++)
+         {
+            d     = (REAL)job->vec[j] - (REAL)medval[j];
+            dist += d * d;
+         }
+
+         if((job->best[c] < 0) || (dist < job->BestDist[c]))
+         {
+            job->BestDist[c] = dist;
+            job->best[c]     = i;
+         }
       }
    }
+
+   return(NULL);
 }
 
 
 /************************************************************************/
-/*>REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
-   ---------------------------------------------
-   Input:   PDB   *pdb1        Reference PDB linked list
-            int   length       Number of residues to fit
-   I/O:     PDB   *pdb2        Mobile PDB linked list
-                               Note that this will be moved in space
-   Returns: REAL               RMS deviation
+/*>void FillClusterArray(int NVec, int *ia, int *ib, int *merged, 
+                         int NClus, int *TheClusters)
+   ---------------------------------------------------------------
+   Input:   int  NVec              Number of vectors
+            int  ia[NVec]          \ History of allomerations
+                 ib[NVec]          /
+            int  merged[NVec]      Merge levels from ClusterAssign()
+            int  NClus             Number of clusters required
+   Output:  int  TheClusters[NVec] Cluster number for each vector
 
-   Returns the RMS over length residues of the two PDB linked lists.
-   If length is zero, all residues will be used.
+   Fills in the `TheClusters' array with the cluster assignments at the
+   level with NClus clusters.
 
-   Note that pdb2 will be moved in space at the end of this.
+   The first NVec-NClus agglomerations are replayed into a disjoint set
+   forest held in TheClusters itself. Since a cluster is identified by 
+   its lowest member, that member is always the root of its tree. The 
+   roots are then converted to cluster numbers.
 
-   06.07.95 Original    By: ACRM
-   26.09.95 If FitPDB() returned an error, the lists weren't being
-            reassembled
-   30.01.09 Initialize some variables
+   15.08.95 Original    By: ACRM
+   16.10.26 Replays the agglomerations rather than reading a column of
+            the NVec x lev clusters matrix
 */
-REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
+void FillClusterArray(int NVec, int *ia, int *ib, int *merged, 
+                      int NClus, int *TheClusters)
 {
-   PDB  *end1 = NULL, 
-        *end2 = NULL, 
-        *p;
-   REAL rms = 0.0;
-   BOOL ok = TRUE;
-  
-   if(length)
-   {
-      /* Terminate each PDB linked list after length residues           */
-      end1 = blTermPDB(pdb1, length);
-      end2 = blTermPDB(pdb2, length);
-   }
+   int i, 
+       r;
    
-   if(blFitPDB(pdb1, pdb2, NULL))
-   {
-      rms = blCalcRMSPDB(pdb1, pdb2);
-   }
-   else
-   {
-      ok = FALSE;
-   }
+   /* Count from 1 so array positions and cluster identifiers match    */
+   ia--;
+   ib--;
+   merged--;
+   TheClusters--;
 
-   if(length)
+   for(i=1; i<=NVec; i++)
+      TheClusters[i] = i;
+   for(i=1; i<=NVec-NClus; i++)
+      TheClusters[ib[i]] = ia[i];
+
+   /* Find the root of each vector, halving the path as we go           */
+   for(i=1; i<=NVec; i++)
    {
-      /* Rejoin PDB linked lists                                        */
-      p=pdb1;
-      LAST(p);
-      p->next = end1;
-      p=pdb2;
-      LAST(p);
-      p->next = end2;
+      for(r=i; TheClusters[r]!=r; r=TheClusters[r])
+         TheClusters[r] = TheClusters[TheClusters[r]];
+      TheClusters[i] = r;
    }
 
-   return((ok)?rms:(REAL)9999.0);
+   for(i=1; i<=NVec; i++)
+      TheClusters[i] = CLUSLABEL(merged, NVec, TheClusters[i]);
 }
 
 
 /************************************************************************/
-/*>REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
-   -----------------------------------------------
-   Input:   PDB   *pdb1        Reference PDB linked list
-            int   length       Number of residues to fit
-   I/O:     PDB   *pdb2        Mobile PDB linked list
-                               Note that this will be moved in space
-   Returns: REAL               RMS deviation
+/*>void CutTree(int NVec, int NItems, int *ia, int *ib, int *merged,
+                int NClus, int *micro, int *ItemClusters, 
+                int *TheClusters)
+   -----------------------------------------------------------------
+   Input:   int  NVec              Number of vectors
+            int  NItems            Number of items clustered
+            int  ia[NItems]        \ History of allomerations
+                 ib[NItems]        /
+            int  merged[NItems]    Merge levels from ClusterAssign()
+            int  NClus             Number of clusters required
+            int  *micro            Item for each vector, or NULL if the
+                                   vectors were clustered directly
+   Output:  int  *ItemClusters     Cluster of each item (used only with
+                                   micro)
+            int  TheClusters[NVec] Cluster number for each vector
+
+   Cuts the tree at the level with NClus clusters. For micro-clusters
+   (or other weighted items), each vector takes the cluster of its 
+   item.
+
+   16.10.26 Original, taken out of ShowClusters()   By: ACRM
+*/
+void CutTree(int NVec, int NItems, int *ia, int *ib, int *merged,
+             int NClus, int *micro, int *ItemClusters, int *TheClusters)
+{
+   int i;
 
-   Returns the CA-RMS over length residues of the two PDB linked lists.
-   If length is zero, all residues will be used.
+   if(micro == NULL)
+   {
+      FillClusterArray(NVec, ia, ib, merged, NClus, TheClusters);
+   }
+   else
+   {
+      FillClusterArray(NItems, ia, ib, merged, NClus, ItemClusters);
+      for(i=0; i<NVec; i++)
+         TheClusters[i] = ItemClusters[micro[i]];
+   }
+}
 
-   Note that pdb2 will be moved in space at the end of this.
 
-   26.09.95 Original based on RmsPDB   By: ACRM
-   30.01.09 Initialize some variables
+/************************************************************************/
+/*>BOOL SweepClusters(FILE *fp, FEATURE **data, int NVec, int VecDim,
+                      int NItems, int *ia, int *ib, int *merged,
+                      REAL *crit, int lev, int *micro)
+   -------------------------------------------------------------------
+   Input:   FILE    *fp          Output file pointer
+            FEATURE **data       Data which is clustered
+            int     NVec         Number of vectors
+            int     VecDim       Vector dimension
+            int     NItems       Number of items clustered
+            int     *ia          \ History of agglomerations
+            int     *ib          /
+            int     *merged      Merge levels from ClusterAssign()
+            REAL    *crit        Critical values
+            int     lev          Number of clustering levels
+            int     *micro       Item for each vector, or NULL
+   Returns: BOOL                 Success of memory allocations
+   Globals: SWEEP   sSweep[]     Settings to try
+            int     sNSweep      Number of settings
+            REAL    gPClusCut[]  Restored after use
+
+   Writes a SWEEP section with one line for each setting given with
+   the SWEEP keyword. The tree made for the main results is cut with
+   the setting's cutoff and the clusters are post-clustered with its
+   cutoffs (or those from POSTCLUSTER for any not given). The numbers
+   of raw and post-clustered clusters, the merges, the largest cluster
+   and the number of singletons are listed. Each post-clustering tests
+   its pairs of clusters with sNThreads threads. Results from a 
+   previous run being updated are not reused since they depend on the
+   cutoffs.
+
+   16.10.26 Original   By: ACRM
 */
-REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
+BOOL SweepClusters(FILE *fp, FEATURE **data, int NVec, int VecDim,
+                   int NItems, int *ia, int *ib, int *merged,
+                   REAL *crit, int lev, int *micro)
 {
-   PDB  *end1 = NULL, 
-        *end2 = NULL, 
-        *p,
-        *pdbca1 = NULL,
-        *pdbca2 = NULL;
-   REAL rms = (REAL)9999.0;
-   int  natoms;
-   BOOL ok = TRUE;
-   char *sel[2];
-
-   SELECT(sel[0], "CA  ");
-   if(sel[0]==NULL)
-      return((REAL)9999.0);
-  
-   if(length)
+   int  *clusters     = NULL,
+        *ItemClusters = NULL,
+        *sizes        = NULL,
+        NClus,
+        NPost,
+        largest,
+        singles,
+        i, k;
+   REAL PClusCut[3];
+   BOOL ok            = TRUE;
+
+   clusters = (int *)malloc(NVec * sizeof(int));
+   sizes    = (int *)malloc((NVec+1) * sizeof(int));
+   if(micro != NULL)
+      ItemClusters = (int *)malloc(NItems * sizeof(int));
+   if(clusters==NULL || sizes==NULL || 
+      ((micro != NULL) && (ItemClusters==NULL)))
    {
-      /* Terminate each PDB linked list after length residues           */
-      end1 = blTermPDB(pdb1, length);
-      end2 = blTermPDB(pdb2, length);
+      if(clusters     != NULL) free(clusters);
+      if(sizes        != NULL) free(sizes);
+      if(ItemClusters != NULL) free(ItemClusters);
+      return(FALSE);
    }
 
-   if((pdbca1 = blSelectAtomsPDBAsCopy(pdb1, 1, sel, &natoms))==NULL)
-      ok = FALSE;
-   if((pdbca2 = blSelectAtomsPDBAsCopy(pdb2, 1, sel, &natoms))==NULL)
-      ok = FALSE;
-   free(sel[0]);
+   for(i=0; i<3; i++)
+      PClusCut[i] = gPClusCut[i];
 
-   if(ok)
+   fprintf(fp,"\nBEGIN SWEEP\n");
+   fprintf(fp,"#  CUTOFF  RMSCUT   MAXCA   MAXCB     RAW    POST  MERGES \
+LARGEST SINGLES\n");
+   for(k=0; ok && k<sNSweep; k++)
    {
-      if(!blFitPDB(pdbca1, pdbca2, NULL))
+      for(i=0; i<3; i++)
+      {
+         gPClusCut[i] = (sSweep[k].PClusCut[i] < (REAL)0.0) ? 
+                        PClusCut[i] : sSweep[k].PClusCut[i];
+      }
+
+      NClus = FindNumTrueClusters(crit, lev, EXPANDEDDIM(VecDim),
+                                  sSweep[k].cutoff);
+      CutTree(NVec, NItems, ia, ib, merged, NClus, micro, 
+              ItemClusters, clusters);
+
+      if((NPost = PostCluster(NULL, clusters, data, NVec, VecDim, crit,
+                              NClus, NULL))==0)
+      {
          ok = FALSE;
-   }
+         break;
+      }
 
-   if(ok)
-      rms = blCalcRMSPDB(pdbca1, pdbca2);
+      /* Sizes of the post-clustered clusters                           */
+      for(i=0; i<=NPost; i++)
+         sizes[i] = 0;
+      for(i=0; i<NVec; i++)
+      {
+         if((clusters[i] >= 1) && (clusters[i] <= NPost))
+            sizes[clusters[i]]++;
+      }
+      for(i=1, largest=0, singles=0; i<=NPost; i++)
+      {
+         if(sizes[i] > largest)
+            largest = sizes[i];
+         if(sizes[i] == 1)
+            singles++;
+      }
 
-   if(length)
-   {
-      /* Rejoin PDB linked lists                                        */
-      p=pdb1;
-      LAST(p);
-      p->next = end1;
-      p=pdb2;
-      LAST(p);
-      p->next = end2;
+      fprintf(fp,"%9.4f %7.3f %7.3f %7.3f %7d %7d %7d %7d %7d\n",
+              sSweep[k].cutoff, gPClusCut[0], gPClusCut[1], gPClusCut[2],
+              NClus, NPost, NClus-NPost, largest, singles);
    }
+   fprintf(fp,"END SWEEP\n");
+
+   for(i=0; i<3; i++)
+      gPClusCut[i] = PClusCut[i];
 
-   if(pdbca1 != NULL)
-      FREELIST(pdbca1,PDB);
-   if(pdbca2 != NULL)
-      FREELIST(pdbca2,PDB);
+   free(clusters);
+   free(sizes);
+   if(ItemClusters != NULL) free(ItemClusters);
 
-   return((ok)?rms:(REAL)9999.000);
+   return(ok);
 }
 
 
 /************************************************************************/
-/*>REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
-   --------------------------------------------------------
-   Input:   PDB   *pdb1        Reference PDB linked list
-            int   length       Number of residues to fit
-   I/O:     PDB   *pdb2        Mobile PDB linked list
-                               Note that this will be moved in space
-   Returns: REAL               RMS deviation
-
-   Returns the max CA-CA deviation over length residues of the two PDB 
-   linked lists.
-   If length is zero, all residues will be used.
-
-   Note that pdb2 will be moved in space at the end of this.
-
-   06.07.95 Original    By: ACRM
-   26.09.95 Modified so fitting is done on CAs only
-            If FitPDB() returned an error, the lists weren't being
-            reassembled
-   14.03.96 Changed to use FitCaPDB() which fits the complete PDB linked
-            lists on CAs.
-   30.01.09 Removed redundant variables
-   30.01.09 Initialize some variables
+/*>BOOL Bootstrap(FILE *fp, FEATURE **data, int NVec, int VecDim, 
+                  int Method, int *clusters, int NClus, int *post)
+   -----------------------------------------------------------------
+   Input:   FILE    *fp          Output file pointer
+            FEATURE **data       Data which is clustered
+            int     NVec         Number of vectors
+            int     VecDim       Vector dimension
+            int     Method       Clustering method (1--7)
+            int     *clusters    Raw cluster of each vector
+            int     NClus        Number of raw clusters
+            int     *post        Post-cluster of each vector
+   Returns: BOOL                 Success of memory allocations
+   Globals: int     sNBoot       Number of replicates
+            BOOL    sBootColumns Resample columns rather than loops
+            int     sNThreads    Number of threads to use
+
+   Writes a BOOTSTRAP section giving the stability of each raw cluster
+   as in Hennig's clusterboot. Each replicate draws NVec loops (or 
+   VecDim columns) with replacement and is clustered with the same 
+   method and cut with the same cutoff as the full data. For each 
+   cluster, the best Jaccard similarity to a cluster of the replicate
+   is found over the loops which the replicate contains. The mean over
+   the replicates is listed with the number of times the cluster was 
+   recovered (Jaccard >= 0.75) and dissolved (< 0.5).
+
+   Resampled loops are used once however often they are drawn. Their 
+   dissimilarities are then just a subset of those of the full data, 
+   so these are found once (with sNThreads threads) and each replicate
+   copies out its own part rather than recalculating them. Resampling
+   columns weights each dimension by the number of times it is drawn;
+   this needs the Euclidean metric.
+
+   The replicates are shared between sNThreads threads, each with its
+   own workspace, clustering with HierClus() or AgglomerateStore(). The
+   Jaccard values are stored by replicate and summed in order so the
+   results do not depend on the number of threads.
+
+   16.10.26 Original   By: ACRM
 */
-REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+BOOL Bootstrap(FILE *fp, FEATURE **data, int NVec, int VecDim, 
+               int Method, int *clusters, int NClus, int *post)
 {
-   PDB  *end1 = NULL, 
-        *end2 = NULL, 
-        *p,   *q;
-   REAL dev,
-        maxdev = (REAL)0.0;
-   BOOL ok = TRUE;
+   BOOTJOB         *jobs    = NULL;
+   pthread_t       *threads = NULL;
+   pthread_mutex_t mutex;
+   DISSIMSTORE     master;
+   CLUSMEMBERS     cm;
+   FEATURE         **rows   = NULL;
+   REAL            *jaccard = NULL,
+                   sum, j;
+   int             NThreads,
+                   NextRep,
+                   NFound, NRecovered, NDissolved,
+                   i, c, r, t;
+   BOOL            ok       = TRUE,
+                   columns  = sBootColumns,
+                   GotMaster = FALSE;
+
+   if(columns && (gMetric != METRIC_EUCLIDEAN))
+   {
+      fprintf(stderr,"Note: BOOTSTRAP COLUMNS needs METRIC Euclidean; \
+resampling loops instead\n");
+      columns = FALSE;
+   }
+
+   NThreads = MIN(MAX(sNThreads, 1), sNBoot);
+   jaccard  = (REAL *)malloc((unsigned long)sNBoot * NClus * sizeof(REAL));
+   jobs     = (BOOTJOB *)malloc(NThreads * sizeof(BOOTJOB));
+   threads  = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+   if(jaccard==NULL || jobs==NULL || threads==NULL ||
+      !BuildClusMembers(clusters, NVec, NClus, &cm))
+   {
+      if(jaccard != NULL) free(jaccard);
+      if(jobs    != NULL) free(jobs);
+      if(threads != NULL) free(threads);
+      return(FALSE);
+   }
 
-   if(length)
+   /* Resampled loops take their dissimilarities from those of all the
+      loops
+   */
+   if(!columns)
    {
-      /* Terminate each PDB linked list after length residues           */
-      end1 = blTermPDB(pdb1, length);
-      end2 = blTermPDB(pdb2, length);
+      rows = (FEATURE **)malloc((NVec+1) * sizeof(FEATURE *));
+      if((rows != NULL) &&
+         AllocDissimStore(&master, NVec, sDissimStore, sDissimFile))
+      {
+         GotMaster = TRUE;
+         for(i=0; i<NVec; i++)
+            rows[i+1] = data[i] - 1;
+         ok = BuildDissim(NVec, VecDim, Method, rows, NULL, &master, 
+                          sNThreads);
+      }
+      else
+      {
+         ok = FALSE;
+      }
+   }
+
+   /* Set up a workspace for each thread, using fewer threads if they
+      can't all be allocated
+   */
+   for(t=0; ok && t<NThreads; t++)
+   {
+      jobs[t].data    = data;
+      jobs[t].cm      = &cm;
+      jobs[t].jaccard = jaccard;
+      jobs[t].NVec    = NVec;
+      jobs[t].VecDim  = VecDim;
+      jobs[t].Method  = Method;
+      jobs[t].NClus   = NClus;
+      jobs[t].NextRep = &NextRep;
+      jobs[t].mutex   = &mutex;
+      jobs[t].ok      = TRUE;
+      if(!AllocBootJob(&(jobs[t]), (columns ? NULL : &master)))
+      {
+         if(t == 0)
+            ok = FALSE;
+         NThreads = t;
+      }
    }
-   
-   if(!blFitCaPDB(pdb1, pdb2, NULL))
-      ok = FALSE;
 
-   /* Check max CA deviation                                            */
    if(ok)
    {
-      for(p=pdb1, q=pdb2; p!=NULL; NEXT(p))
+      /* Start the extra threads; the calling thread does a share too   */
+      NextRep = sNBoot - 1;
+      pthread_mutex_init(&mutex, NULL);
+      for(t=1; t<NThreads; t++)
       {
-         if(!strncmp(p->atnam,"CA  ",4))
+         if(pthread_create(&(threads[t]), NULL, BootWorker, &(jobs[t])))
          {
-            /* Step q, until we hit a CA                                */
-            while((q!=NULL) && (strncmp(q->atnam,"CA  ",4))) NEXT(q);
-            
-            if(q!=NULL)
-            {
-               dev = DISTSQ(p,q);
-               if(dev > maxdev)
-                  maxdev = dev;
-
-               /* Step q on by one                                      */
-               NEXT(q);
-            }
-            else
-            {
-               fprintf(stderr,"MaxCADeviationPDB(): second list \
-expired!\n");
-               ok=FALSE;
-               break;
-            }
+            for(r=t; r<NThreads; r++)
+               FreeBootJob(&(jobs[r]));
+            NThreads = t;
+            break;
          }
       }
+      BootWorker(&(jobs[0]));
+      for(t=1; t<NThreads; t++)
+         pthread_join(threads[t], NULL);
+      pthread_mutex_destroy(&mutex);
+
+      for(t=0; t<NThreads; t++)
+      {
+         if(!jobs[t].ok)
+            ok = FALSE;
+         FreeBootJob(&(jobs[t]));
+      }
    }
-   
-   if(length)
+
+   if(ok)
    {
-      /* Rejoin PDB linked lists                                        */
-      p=pdb1;
-      LAST(p);
-      p->next = end1;
-      p=pdb2;
-      LAST(p);
-      p->next = end2;
+      fprintf(fp,"\nBEGIN BOOTSTRAP\n");
+      fprintf(fp,"#  %d replicates resampling %s\n", sNBoot,
+              (columns ? "columns" : "loops"));
+      fprintf(fp,"#  CLUSTER    SIZE    POST JACCARD   FOUND \
+RECOVERED DISSOLVED\n");
+      for(c=1; c<=NClus; c++)
+      {
+         sum = (REAL)0.0;
+         NFound = NRecovered = NDissolved = 0;
+         for(r=0; r<sNBoot; r++)
+         {
+            if((j = jaccard[(unsigned long)r * NClus + c-1]) < (REAL)0.0)
+               continue;
+            NFound++;
+            sum += j;
+            if(j >= (REAL)BOOTRECOVERED)
+               NRecovered++;
+            else if(j < (REAL)BOOTDISSOLVED)
+               NDissolved++;
+         }
+
+         fprintf(fp,"%9d %7d %7d %7.3f %7d %9d %9d\n", c, 
+                 NCLUSMEMBERS(&cm, c),
+                 ((NCLUSMEMBERS(&cm, c) > 0) ? 
+                  post[CLUSMEMBER(&cm, c, 0)] : 0),
+                 ((NFound > 0) ? sum / (REAL)NFound : (REAL)0.0),
+                 NFound, NRecovered, NDissolved);
+      }
+      fprintf(fp,"END BOOTSTRAP\n");
    }
 
-   return((ok)?(REAL)sqrt((double)maxdev):(REAL)9999.0);
+   if(GotMaster)    FreeDissimStore(&master);
+   if(rows != NULL) free(rows);
+   FreeClusMembers(&cm);
+   free(jaccard);
+   free(jobs);
+   free(threads);
+
+   return(ok);
 }
 
 
 /************************************************************************/
-/*>REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
-   --------------------------------------------------------
-   Input:   PDB   *pdb1        Reference PDB linked list
-            int   length       Number of residues to fit
-   I/O:     PDB   *pdb2        Mobile PDB linked list
-                               Note that this will be moved in space
-   Returns: REAL               RMS deviation
+/*>void *BootWorker(void *arg)
+   ---------------------------
+   Input:   void  *arg      Pointer to a BOOTJOB
+   Returns: void  *         NULL
 
-   Returns the max CB-CB deviation over length residues of the two PDB 
-   linked lists.
-   If length is zero, all residues will be used.
+   Thread routine for Bootstrap(). Takes replicates off the shared 
+   counter until there are none left. Sets the ok flag in the job to
+   FALSE if a replicate could not be clustered.
 
-   Note that pdb2 will be moved in space at the end of this.
-
-   14.03.96 Original based on MaxCADeviationPDB()   By: ACRM
-   30.01.09 Removed redundant variables
-   30.01.09 Initialize some variables
+   16.10.26 Original   By: ACRM
 */
-REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+void *BootWorker(void *arg)
 {
-   PDB  *end1 = NULL, 
-        *end2 = NULL, 
-        *p,   *q,
-        *pcb, *qcb;
-   REAL dev,
-        maxdev = (REAL)0.0;
-   BOOL ok = TRUE;
+   BOOTJOB *job = (BOOTJOB *)arg;
+   int     r;
 
-   if(length)
+   for(;;)
    {
-      /* Terminate each PDB linked list after length residues           */
-      end1 = blTermPDB(pdb1, length);
-      end2 = blTermPDB(pdb2, length);
+      pthread_mutex_lock(job->mutex);
+      r = (*(job->NextRep))--;
+      pthread_mutex_unlock(job->mutex);
+      if(r < 0)
+         break;
+
+      if(!BootReplicate(job, r))
+         job->ok = FALSE;
    }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>BOOL AllocBootJob(BOOTJOB *job, DISSIMSTORE *master)
+   ----------------------------------------------------
+   I/O:     BOOTJOB     *job      Job with NVec and VecDim set
+   Input:   DISSIMSTORE *master   Dissimilarities of all the data, or
+                                  NULL if resampling columns
+   Returns: BOOL                  Success of memory allocations
+
+   Allocates the workspace for one bootstrap thread. Resampling loops
+   needs a dissimilarity matrix (in memory) to hold each replicate's 
+   share of the master; resampling columns needs a copy of the data.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL AllocBootJob(BOOTJOB *job, DISSIMSTORE *master)
+{
+   int  n = job->NVec;
+   BOOL ok;
+
+   job->master  = master;
+   job->scaled  = NULL;
+   job->work.d  = NULL;
+   job->work.f  = NULL;
+   job->crit    = (REAL *)malloc(n * sizeof(REAL));
+   job->ia      = (int *)malloc(n * sizeof(int));
+   job->ib      = (int *)malloc(n * sizeof(int));
+   job->count   = (int *)malloc(MAX(n, job->VecDim) * sizeof(int));
+   job->sample  = (int *)malloc(n * sizeof(int));
+   job->pos     = (int *)malloc(n * sizeof(int));
+   job->RepClus = (int *)malloc(n * sizeof(int));
+   job->RepSize = (int *)malloc((n+1) * sizeof(int));
+   job->overlap = (int *)malloc((n+1) * sizeof(int));
+   job->touched = (int *)malloc(n * sizeof(int));
+
+   ok = (job->crit    != NULL && 
+         job->ia      != NULL && 
+         job->ib      != NULL &&
+         job->count   != NULL && 
+         job->sample  != NULL && 
+         job->pos     != NULL &&
+         job->RepClus != NULL && 
+         job->RepSize != NULL && 
+         job->overlap != NULL &&
+         job->touched != NULL);
+
+   if(ok && (master != NULL))
+      ok = AllocDissimStore(&(job->work), n, 
+                            ((master->f != NULL) ? DISSIM_FLOAT 
+                                                 : DISSIM_DOUBLE), NULL);
+   else if(ok)
+      ok = ((job->scaled = AllocFeatures(n, job->VecDim)) != NULL);
+
+   if(!ok)
+      FreeBootJob(job);
    
-   if(!blFitCaPDB(pdb1, pdb2, NULL))
-      ok = FALSE;
+   return(ok);
+}
 
-   /* Check max CB deviation                                            */
-   if(ok)
+
+/************************************************************************/
+/*>void FreeBootJob(BOOTJOB *job)
+   ------------------------------
+   I/O:     BOOTJOB  *job     Job whose workspace is freed
+
+   Frees the workspace allocated by AllocBootJob()
+
+   16.10.26 Original   By: ACRM
+*/
+void FreeBootJob(BOOTJOB *job)
+{
+   if(job->crit    != NULL) free(job->crit);
+   if(job->ia      != NULL) free(job->ia);
+   if(job->ib      != NULL) free(job->ib);
+   if(job->count   != NULL) free(job->count);
+   if(job->sample  != NULL) free(job->sample);
+   if(job->pos     != NULL) free(job->pos);
+   if(job->RepClus != NULL) free(job->RepClus);
+   if(job->RepSize != NULL) free(job->RepSize);
+   if(job->overlap != NULL) free(job->overlap);
+   if(job->touched != NULL) free(job->touched);
+   if(job->scaled  != NULL) FreeFeatures(job->scaled);
+   if((job->work.d != NULL) || (job->work.f != NULL))
+      FreeDissimStore(&(job->work));
+
+   job->crit    = NULL;
+   job->ia      = job->ib = job->count = job->sample = job->pos = NULL;
+   job->RepClus = job->RepSize = job->overlap = job->touched = NULL;
+   job->scaled  = NULL;
+}
+
+
+/************************************************************************/
+/*>BOOL BootReplicate(BOOTJOB *job, int rep)
+   -----------------------------------------
+   I/O:     BOOTJOB  *job     Job with workspace from AllocBootJob()
+   Input:   int      rep      Replicate number (from 0)
+   Returns: BOOL              Success of memory allocations
+
+   Draws, clusters and scores one bootstrap replicate, storing the best
+   Jaccard similarity of each original cluster in job->jaccard. Each 
+   replicate has its own random number sequence (that of 
+   MicroCluster()) so it is the same whichever thread does it.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Uses DISSIMOFFSET() for a blocked master store
+*/
+BOOL BootReplicate(BOOTJOB *job, int rep)
+{
+   unsigned long seed = ((unsigned long)rep * 2654435761UL + 1UL) & 
+                        0x7fffffffUL;
+   int           NVec = job->NVec,
+                 m    = 0,
+                 *merged,
+                 NRep,
+                 nc, nt, d, a, b, i, k, c;
+   long          src;
+   REAL          *jac = job->jaccard + (unsigned long)rep * job->NClus,
+                 best, jv;
+   BOOL          ok   = TRUE;
+
+   if(job->master != NULL)
    {
-      for(p=pdb1, q=pdb2; p!=NULL; NEXT(p))
+      /* Draw loops and keep each one drawn once, in order              */
+      for(i=0; i<NVec; i++)
+         job->count[i] = 0;
+      for(i=0; i<NVec; i++)
       {
-         if(!strncmp(p->atnam,"N   ",4))
+         seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+         job->count[seed % NVec]++;
+      }
+      for(i=0; i<NVec; i++)
+      {
+         job->pos[i] = -1;
+         if(job->count[i])
          {
-            /* Step q, until we hit a N                                 */
-            while((q!=NULL) && (strncmp(q->atnam,"N   ",4))) NEXT(q);
-            
-            if(q!=NULL)
-            {
-               /* Now check CB                                          */
-               if(strncmp(p->resnam,"GLY ",4) && 
-                  strncmp(q->resnam,"GLY ",4))
-               {
-                  pcb=blFindAtomInRes(p,"CB  ");
-                  qcb=blFindAtomInRes(q,"CB  ");
+            job->pos[i]       = m;
+            job->sample[m++]  = i;
+         }
+      }
 
-                  if(pcb!=NULL && qcb!=NULL)
-                  {
-                     dev = DISTSQ(pcb,qcb);
-                     if(dev > maxdev)
-                        maxdev = dev;
-                  }
-               }
-               
-               /* Step q on by one                                      */
-               NEXT(q);
-            }
-            else
-            {
-               fprintf(stderr,"MaxCBDeviationPDB(): second list \
-expired!\n");
-               ok=FALSE;
-               break;
-            }
+      /* Copy out their dissimilarities                                 */
+      for(a=0; a<m-1; a++)
+      {
+         for(b=a+1; b<m; b++)
+         {
+            src = DISSIMOFFSET(job->master, NVec, job->sample[a]+1, 
+                               job->sample[b]+1);
+            SETDISSIM(&(job->work), 
+                      DISSIMOFFSET(&(job->work), m, a+1, b+1), 
+                      GETDISSIM(job->master, src));
          }
       }
+      if(m > 1)
+         ok = AgglomerateStore(m, job->Method, &(job->work), NULL,
+                               job->ia, job->ib, job->crit);
+   }
+   else
+   {
+      /* Draw columns and weight each by the number of times drawn      */
+      for(k=0; k<job->VecDim; k++)
+         job->count[k] = 0;
+      for(k=0; k<job->VecDim; k++)
+      {
+         seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+         job->count[seed % job->VecDim]++;
+      }
+      for(i=0; i<NVec; i++)
+      {
+         for(k=0; k<job->VecDim; k++)
+            job->scaled[i][k] = (FEATURE)(sqrt((double)job->count[k]) *
+                                          (double)job->data[i][k]);
+         job->pos[i]    = i;
+         job->sample[i] = i;
+      }
+      m  = NVec;
+      ok = HierClus(m, job->VecDim, job->Method, job->scaled, NULL, 1, 
+                    DISSIM_DOUBLE, NULL, job->ia, job->ib, job->crit);
+   }
+   if(!ok)
+      return(FALSE);
+
+   /* Cut the replicate's tree as for the full data                     */
+   if(m > 1)
+   {
+      if((merged = ClusterAssign(NULL, m, job->ia, job->ib, m, m, NULL))
+         ==NULL)
+         return(FALSE);
+      NRep = FindNumTrueClusters(job->crit, m, EXPANDEDDIM(job->VecDim),
+                                 (REAL)CLUSCUT);
+      FillClusterArray(m, job->ia, job->ib, merged, NRep, job->RepClus);
+      free(merged);
+   }
+   else
+   {
+      NRep = 1;
+      job->RepClus[0] = 1;
+   }
+
+   for(d=0; d<=NRep; d++)
+   {
+      job->RepSize[d] = 0;
+      job->overlap[d] = 0;
    }
-   
-   if(length)
+   for(a=0; a<m; a++)
+      job->RepSize[job->RepClus[a]]++;
+
+   /* Best Jaccard of each original cluster over the loops drawn        */
+   for(c=1; c<=job->NClus; c++)
    {
-      /* Rejoin PDB linked lists                                        */
-      p=pdb1;
-      LAST(p);
-      p->next = end1;
-      p=pdb2;
-      LAST(p);
-      p->next = end2;
+      nc = nt = 0;
+      for(k=0; k<NCLUSMEMBERS(job->cm, c); k++)
+      {
+         if((a = job->pos[CLUSMEMBER(job->cm, c, k)]) < 0)
+            continue;
+         d = job->RepClus[a];
+         if(job->overlap[d]++ == 0)
+            job->touched[nt++] = d;
+         nc++;
+      }
+
+      best = (REAL)(-1.0);
+      for(k=0; k<nt; k++)
+      {
+         d  = job->touched[k];
+         jv = (REAL)job->overlap[d] / 
+              (REAL)(nc + job->RepSize[d] - job->overlap[d]);
+         if(jv > best)
+            best = jv;
+         job->overlap[d] = 0;
+      }
+      jac[c-1] = best;
    }
 
-   return((ok)?(REAL)sqrt((double)maxdev):(REAL)9999.0);
+   return(TRUE);
 }
 
 
@@ -2200,16 +6485,19 @@ int RenumClusters(int *clusters, int NVec)
 
 
 /************************************************************************/
-/*>int PostCluster(FILE *fp, int *clusters, REAL **data, int NVec, 
-                   int VecDim, REAL *crit, int NClus)
+/*>int PostCluster(FILE *fp, int *clusters, FEATURE **data, int NVec, 
+                   int VecDim, REAL *crit, int NClus, int *OldRaw)
    ---------------------------------------------------------------
-   Input:   FILE   *fp          Output file pointer
+   Input:   FILE   *fp          Output file pointer (or NULL)
             int    *clusters    Cluster vector
-            REAL   **data       Data used for clustering
+            FEATURE **data      Data used for clustering
             int    NVec         Number of vectors
             int    VecDim       Dimension of vectors
             REAL   *crit        Critical values
             int    NClus        Number of clusters
+            int    *OldRaw      Raw cluster in a previous run which each
+                                cluster is identical to (or 0), or NULL
+                                if not updating
    Returns: int                 Revised number of clusters   
                                 (0 if memory allocations failed)
    Globals: REAL   gPClusCut    Clustering RMS cutoffs
@@ -2229,23 +6517,37 @@ int RenumClusters(int *clusters, int NVec)
    12.09.95 If there are only 2 members in a cluster, both must be within
             the cutoffs in order to do a merge
    15.09.95 Removed unused variables
+   16.10.26 Added OldRaw. Pairs of clusters which are both unchanged
+            take the result from the previous run
+   16.10.26 Pairs of clusters are tested by sNThreads threads into a 
+            table of decisions. The merges are then made in the same
+            order as before so the output is unchanged
+   16.10.26 Representatives of all clusters from ClusterMedians()
+   16.10.26 Members of 2-member clusters from the CLUSMEMBERS lists
+   16.10.26 Nothing is written if fp is NULL
+   16.10.26 Clusters whose loops have no coordinates after loading are
+            not usable, so TestMerge() never needs to read a loop
 */
-int PostCluster(FILE *fp, int *clusters, REAL **data, int NVec, 
-                int VecDim, REAL *crit, int NClus)
-{
-   int      NMerge = 0,
-            NewNClus = NClus,
-            *NMembers,
-            *NewNumbers,
-            i, j;
-   DATALIST **repres,
-            *rep_i,
-            *rep_j,
-            *rep_k,
-            *rep_l;
-   REAL     rms, rms1, rms2, rms3, rms4,
-            CADev, CADev1, CADev2, CADev3, CADev4,
-            CBDev, CBDev1, CBDev2, CBDev3, CBDev4;
+int PostCluster(FILE *fp, int *clusters, FEATURE **data, int NVec, 
+                int VecDim, REAL *crit, int NClus, int *OldRaw)
+{
+   int             NMerge = 0,
+                   NewNClus = NClus,
+                   *NMembers,
+                   *NewNumbers,
+                   NThreads,
+                   NextRow,
+                   i, j, k;
+   DATALIST        **repres,
+                   **tests;
+   BOOL            *usable,
+                   NeedLoad = (OldRaw == NULL);
+   PAIRTEST        *table,
+                   *pt;
+   POSTJOB         *jobs;
+   CLUSMEMBERS     cm;
+   pthread_t       *threads;
+   pthread_mutex_t mutex;
    
    /* Allocate memory for array of representitives                      */
    if((repres = (DATALIST **)malloc(NClus * sizeof(DATALIST *)))==NULL)
@@ -2265,136 +6567,158 @@ int PostCluster(FILE *fp, int *clusters, REAL **data, int NVec,
       free(NewNumbers);
       return(0);
    }
+
+   /* Allocate the loops tested for each cluster and the table of 
+      decisions for each pair of clusters
+   */
+   tests  = (DATALIST **)malloc(2 * NClus * sizeof(DATALIST *));
+   usable = (BOOL *)malloc(NClus * sizeof(BOOL));
+   table  = (PAIRTEST *)malloc((IOFFSET(NClus, NClus-1, NClus) + 1) *
+                               sizeof(PAIRTEST));
+   if(tests==NULL || usable==NULL || table==NULL)
+   {
+      if(tests  != NULL) free(tests);
+      if(usable != NULL) free(usable);
+      if(table  != NULL) free(table);
+      free(repres);
+      free(NewNumbers);
+      free(NMembers);
+      return(0);
+   }
    
    /* For each of these clusters, find a representitive and initialise
       the NewNumbers array
    */
+   if(!ClusterMedians(clusters,data,NVec,VecDim,NClus,repres,NMembers))
+   {
+      free(repres);
+      free(NewNumbers);
+      free(NMembers);
+      free(tests);
+      free(usable);
+      free(table);
+      return(0);
+   }
    for(i=1; i<=NClus; i++)
    {
-      if((repres[i-1]=FindMedian(clusters,data,NVec,VecDim,i,
-                                 &(NMembers[i-1])))==NULL)
-      {
-         free(repres);
-         free(NewNumbers);
-         return(0);
-      }
       NewNumbers[i-1] = i;
+      if((OldRaw != NULL) && !OldRaw[i-1])
+         NeedLoad = TRUE;
    }
 
-   fprintf(fp,"\nBEGIN POSTCLUSTER\n");
-
-   /* Compare each representitive against each other and if any matches 
-      with RMS < gPClusCut[0] and max CA deviation < gPClusCut[1]
-      and max CB deviation < gPClusCut[2] merge the clusters, printing 
-      a message.
+   /* Find the loops which are tested for each cluster: both members of
+      a cluster with 2 members must be within the cutoffs, otherwise the
+      representative is used. Any loop without stored coordinates is 
+      read now since this can't be done by several threads at once; a
+      cluster whose loops still have none can't be compared
    */
-   for(i=0; i<NClus-1; i++)
+   if(!BuildClusMembers(clusters, NVec, NClus, &cm))
    {
-      for(j=i+1; j<NClus; j++)
+      free(repres);
+      free(NewNumbers);
+      free(NMembers);
+      free(tests);
+      free(usable);
+      free(table);
+      return(0);
+   }
+   for(i=0; i<NClus; i++)
+   {
+      if(NMembers[i] == 2)
       {
-         if((NMembers[i] != 2) && (NMembers[j] != 2))
-         {
-            if(TestMerge(repres[i], repres[j], &rms, &CADev, &CBDev))
-            {
-               NMerge++;
-               DoMerge(fp,i,repres[i],j,repres[j],rms,CADev,CBDev,
-                       NewNumbers,NClus);
-            }
-         }
-         else if((NMembers[i] == 2) && (NMembers[j] != 2))
+         tests[2*i]   = FindLoop(&cm,i+1,0);
+         tests[2*i+1] = FindLoop(&cm,i+1,1);
+         for(k=0; k<2; k++)
          {
-            rep_i = FindLoop(clusters,NVec,i+1,0);
-            rep_j = FindLoop(clusters,NVec,i+1,1);
-            
-            if((rep_i != NULL) && (rep_j != NULL))
-            {
-               if(TestMerge(rep_i, repres[j], &rms1, &CADev1, &CBDev1) &&
-                  TestMerge(rep_j, repres[j], &rms2, &CADev2, &CBDev2))
-               {
-                  NMerge++;
-                  rms = (rms1 + rms2) / (REAL)2.0;
-                  CADev = (CADev1 + CADev2) / (REAL)2.0;               
-                  CBDev = (CBDev1 + CBDev2) / (REAL)2.0;               
-                  DoMerge(fp,i,repres[i],j,repres[j],rms,CADev,CBDev,
-                          NewNumbers,NClus);
-               }
-            }
-            else
-            {
-               if(rep_i == NULL)
-                  fprintf(stderr,"INTERR: Loop 0 not found in cluster \
-%d\n",i);
-               if(rep_j == NULL)
-                  fprintf(stderr,"INTERR: Loop 1 not found in cluster \
-%d\n",i);
-            }
+            if(tests[2*i+k] == NULL)
+               fprintf(stderr,"INTERR: Loop %d not found in cluster \
+%d\n",k,i);
          }
-         else if((NMembers[i] != 2) && (NMembers[j] == 2))
+         usable[i] = ((tests[2*i] != NULL) && (tests[2*i+1] != NULL));
+      }
+      else
+      {
+         tests[2*i]   = repres[i];
+         tests[2*i+1] = NULL;
+         usable[i]    = TRUE;
+      }
+
+      if(usable[i] && NeedLoad)
+      {
+         for(k=0; k<2 && tests[2*i+k]!=NULL; k++)
          {
-            rep_i = FindLoop(clusters,NVec,j+1,0);
-            rep_j = FindLoop(clusters,NVec,j+1,1);
-            
-            if((rep_i != NULL) && (rep_j != NULL))
-            {
-               if(TestMerge(repres[i], rep_i, &rms1, &CADev1, &CBDev1) &&
-                  TestMerge(repres[i], rep_j, &rms2, &CADev2, &CBDev2))
-               {               
-                  NMerge++;
-                  rms = (rms1 + rms2) / (REAL)2.0;
-                  CADev = (CADev1 + CADev2) / (REAL)2.0;
-                  CBDev = (CBDev1 + CBDev2) / (REAL)2.0;               
-                  DoMerge(fp,i,repres[i],j,repres[j],rms,CADev,CBDev,
-                          NewNumbers,NClus);
-               }
-            }
-            else
-            {
-               if(rep_i == NULL)
-                  fprintf(stderr,"INTERR: Loop 0 not found in cluster \
-%d\n",j);
-               if(rep_j == NULL)
-                  fprintf(stderr,"INTERR: Loop 1 not found in cluster \
-%d\n",j);
-            }
+            if(!LoadLoop(tests[2*i+k], FALSE) || 
+               (tests[2*i+k]->ncoor == 0))
+               usable[i] = FALSE;
          }
-         else /* Both clusters have 2 members                           */
-         {
-            rep_i = FindLoop(clusters,NVec,i+1,0);
-            rep_j = FindLoop(clusters,NVec,i+1,1);
-            rep_k = FindLoop(clusters,NVec,j+1,0);
-            rep_l = FindLoop(clusters,NVec,j+1,1);
+      }
+   }
+   FreeClusMembers(&cm);
 
-            if((rep_i != NULL) && (rep_j != NULL) && 
-               (rep_k != NULL) && (rep_l != NULL))
-            {
-               if(TestMerge(rep_i, rep_k, &rms1, &CADev1, &CBDev1) &&
-                  TestMerge(rep_i, rep_l, &rms2, &CADev2, &CBDev2) &&
-                  TestMerge(rep_j, rep_l, &rms3, &CADev3, &CBDev3) &&
-                  TestMerge(rep_j, rep_k, &rms4, &CADev4, &CBDev4))
-               {
-                  NMerge++;
-                  rms = (rms1 + rms2 + rms3 + rms4) / (REAL)4.0;
-                  CADev = (CADev1 + CADev2 + CADev3 + CADev4) / (REAL)4.0;
-                  CBDev = (CBDev1 + CBDev2 + CBDev3 + CBDev4) / (REAL)4.0;
-                  DoMerge(fp,i,repres[i],j,repres[j],rms,CADev,CBDev,
-                          NewNumbers,NClus);
-               }
-            }
-            else
-            {
-               if(rep_i == NULL)
-                  fprintf(stderr,"INTERR: Loop 0 not found in cluster \
-%d\n",i);
-               if(rep_j == NULL)
-                  fprintf(stderr,"INTERR: Loop 1 not found in cluster \
-%d\n",i);
-               if(rep_k == NULL)
-                  fprintf(stderr,"INTERR: Loop 0 not found in cluster \
-%d\n",j);
-               if(rep_l == NULL)
-                  fprintf(stderr,"INTERR: Loop 1 not found in cluster \
-%d\n",j);
-            }
+   /* Compare each representitive against each other and record whether
+      they match with RMS < gPClusCut[0] and max CA deviation < 
+      gPClusCut[1] and max CB deviation < gPClusCut[2]. Rows of the 
+      table are shared out between sNThreads threads
+   */
+   NThreads = MIN(MAX(sNThreads, 1), MAX(NClus-1, 1));
+   NextRow  = NClus - 2;
+   jobs     = (POSTJOB *)malloc(NThreads * sizeof(POSTJOB));
+   threads  = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+   if(jobs==NULL || threads==NULL)
+   {
+      if(jobs!=NULL)    free(jobs);
+      if(threads!=NULL) free(threads);
+      free(repres);
+      free(NewNumbers);
+      free(NMembers);
+      free(tests);
+      free(usable);
+      free(table);
+      return(0);
+   }
+
+   pthread_mutex_init(&mutex, NULL);
+   for(k=0; k<NThreads; k++)
+   {
+      jobs[k].table   = table;
+      jobs[k].tests   = tests;
+      jobs[k].usable  = usable;
+      jobs[k].OldRaw  = OldRaw;
+      jobs[k].NClus   = NClus;
+      jobs[k].NextRow = &NextRow;
+      jobs[k].mutex   = &mutex;
+   }
+
+   /* Start the extra threads; the calling thread does a share too      */
+   for(k=1; k<NThreads; k++)
+   {
+      if(pthread_create(&(threads[k]), NULL, PostWorker, &(jobs[k])))
+      {
+         NThreads = k;
+         break;
+      }
+   }
+   PostWorker(&(jobs[0]));
+   for(k=1; k<NThreads; k++)
+      pthread_join(threads[k], NULL);
+
+   pthread_mutex_destroy(&mutex);
+   free(jobs);
+   free(threads);
+
+   /* Merge the matching clusters in order, printing a message          */
+   if(fp != NULL)
+      fprintf(fp,"\nBEGIN POSTCLUSTER\n");
+   for(i=0; i<NClus-1; i++)
+   {
+      for(j=i+1; j<NClus; j++)
+      {
+         pt = &(table[IOFFSET(NClus, i+1, j+1)]);
+         if(pt->merge)
+         {
+            NMerge++;
+            DoMerge(fp,i,repres[i],j,repres[j],pt->rms,pt->CADev,
+                    pt->CBDev,NewNumbers,NClus);
          }
       }
    }
@@ -2420,20 +6744,166 @@ int PostCluster(FILE *fp, int *clusters, REAL **data, int NVec,
 expect strange results!\n");
       }
    }
-   else
+   else if(fp != NULL)
    {
       fprintf(fp,"No merges were performed\n");
    }
 
-   fprintf(fp,"END POSTCLUSTER\n");
+   if(fp != NULL)
+      fprintf(fp,"END POSTCLUSTER\n");
 
    free(repres);
    free(NewNumbers);
+   free(NMembers);
+   free(tests);
+   free(usable);
+   free(table);
    
    return(NewNClus);
 }
 
 
+/************************************************************************/
+/*>void *PostWorker(void *arg)
+   ---------------------------
+   Input:   void  *arg      Pointer to a POSTJOB
+   Returns: void  *         NULL
+
+   Thread routine for PostCluster(). Takes rows of the table of pairs of
+   clusters off the shared counter until there are none left.
+
+   16.10.26 Original   By: ACRM
+*/
+void *PostWorker(void *arg)
+{
+   POSTJOB *job = (POSTJOB *)arg;
+   int     i;
+
+   for(;;)
+   {
+      pthread_mutex_lock(job->mutex);
+      i = (*(job->NextRow))--;
+      pthread_mutex_unlock(job->mutex);
+      if(i < 0)
+         break;
+
+      PostTestRow(job, i);
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>void PostTestRow(POSTJOB *job, int i)
+   -------------------------------------
+   I/O:     POSTJOB  *job     Job whose table is filled in
+   Input:   int      i        Cluster (from 0) for the row
+
+   Decides whether cluster i should be merged with each later cluster j
+   and stores the result with the mean RMS and deviations in the table.
+   When updating, clusters which are unchanged from the previous run are
+   merged only if they were merged then.
+
+   16.10.26 Original, taken out of PostCluster()   By: ACRM
+*/
+void PostTestRow(POSTJOB *job, int i)
+{
+   PAIRTEST *pt;
+   int      j;
+
+   for(j=i+1; j<job->NClus; j++)
+   {
+      pt = &(job->table[IOFFSET(job->NClus, i+1, j+1)]);
+
+      if((job->OldRaw != NULL) && job->OldRaw[i] && job->OldRaw[j])
+         pt->merge = PrevMerge(job->OldRaw[i], job->OldRaw[j], 
+                               &(pt->rms), &(pt->CADev), &(pt->CBDev));
+      else if(job->usable[i] && job->usable[j])
+         pt->merge = TestClusters(&(job->tests[2*i]), 
+                                  &(job->tests[2*j]), 
+                                  &(pt->rms), &(pt->CADev), 
+                                  &(pt->CBDev));
+      else
+         pt->merge = FALSE;
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL TestClusters(DATALIST **loops1, DATALIST **loops2, REAL *rms,
+                     REAL *CADev, REAL *CBDev)
+   ------------------------------------------------------------------
+   Input:   DATALIST **loops1       Loops tested for the first cluster
+            DATALIST **loops2       Loops tested for the second cluster
+   Output:  REAL     *rms           Mean RMS between the loops
+            REAL     *CADev         Mean max CA deviation
+            REAL     *CBDev         Mean max CB deviation
+   Returns: BOOL                    Should the clusters be merged?
+
+   Each cluster is represented by one loop or, if it has 2 members, by 
+   both of them (the second is NULL if there is only one). The clusters
+   are merged only if every pairing of their loops is within the 
+   cutoffs.
+
+   12.09.95 Original as part of PostCluster()   By: ACRM
+   16.10.26 Taken out of PostCluster()
+*/
+BOOL TestClusters(DATALIST **loops1, DATALIST **loops2, REAL *rms,
+                  REAL *CADev, REAL *CBDev)
+{
+   DATALIST *a[4], 
+            *b[4];
+   REAL     r, ca, cb;
+   int      k, 
+            n;
+
+   /* Pairs are tested (and their values summed) in the order always
+      used for 2-member clusters
+   */
+   if(loops1[1] == NULL && loops2[1] == NULL)
+   {
+      a[0] = loops1[0];   b[0] = loops2[0];
+      n    = 1;
+   }
+   else if(loops2[1] == NULL)
+   {
+      a[0] = loops1[0];   b[0] = loops2[0];
+      a[1] = loops1[1];   b[1] = loops2[0];
+      n    = 2;
+   }
+   else if(loops1[1] == NULL)
+   {
+      a[0] = loops1[0];   b[0] = loops2[0];
+      a[1] = loops1[0];   b[1] = loops2[1];
+      n    = 2;
+   }
+   else
+   {
+      a[0] = loops1[0];   b[0] = loops2[0];
+      a[1] = loops1[0];   b[1] = loops2[1];
+      a[2] = loops1[1];   b[2] = loops2[1];
+      a[3] = loops1[1];   b[3] = loops2[0];
+      n    = 4;
+   }
+
+   *rms = *CADev = *CBDev = (REAL)0.0;
+   for(k=0; k<n; k++)
+   {
+      if(!TestMerge(a[k], b[k], &r, &ca, &cb))
+         return(FALSE);
+      *rms   += r;
+      *CADev += ca;
+      *CBDev += cb;
+   }
+   *rms   /= (REAL)n;
+   *CADev /= (REAL)n;
+   *CBDev /= (REAL)n;
+
+   return(TRUE);
+}
+
+
 /************************************************************************/
 /*>BOOL TestMerge(DATALIST *loop1, DATALIST *loop2, REAL *rms, 
                   REAL *CADev, REAL *CBDev)
@@ -2445,7 +6915,9 @@ expect strange results!\n");
             REAL     *CBDev         Max CB deviation between loops
    Returns: BOOL                    Should they be merged?
 
-   Tests whether two loop examples should be merged into one cluster
+   Tests whether two loop examples should be merged into one cluster.
+   Only the coordinates stored with the loops are used, so this is safe
+   to call from several threads at once.
 
    12.09.95 Original    By: ACRM
    26.09.95 Changed to use RmsCAPDB()
@@ -2456,88 +6928,35 @@ expect strange results!\n");
    15.04.96 This causes a problem if critical residues have not been
             requested, as these data are not available. Prompts with
             a message in this case. Only gives one warning message.
+   16.10.26 Reads loops carried over from a previous run
+   16.10.26 Uses the coordinates stored with each loop by 
+            StoreLoopCoor() rather than duplicating the all-atom PDB
+            linked lists, so critical residues are no longer needed
+   16.10.26 Loops from a checkpoint are not read again
+   16.10.26 No longer reads loops, since it is called by several threads
+            at once. PostCluster() reads them first; a loop without 
+            coordinates is an error
 */
 BOOL TestMerge(DATALIST *loop1, DATALIST *loop2, REAL *rms, REAL *CADev,
                REAL *CBDev)
 {
-   static BOOL Warned = FALSE;
-   PDB         *dupe1 = NULL,
-               *dupe2 = NULL,
-               *p, *end;
-   BOOL        DupeDone = TRUE;
-   
    if((loop1 != (DATALIST *)(-1)) && (loop2 != (DATALIST *)(-1)))
    {
+      /* PostCluster() has already read any loops which were needed     */
+      if((loop1->ncoor == 0) || (loop2->ncoor == 0))
+      {
+         fprintf(stderr,"INTERR: Loop %s has not been read for \
+post-clustering\n", 
+                 ((loop1->ncoor == 0) ? loop1->loopid : loop2->loopid));
+         return(FALSE);
+      }
+
       /* Only bother trying to merge clusters if loops are of the same 
          length.
       */
       if(loop1->length == loop2->length)
       {
-
-         /* If less than cutoff, merge clusters. Note that this must
-            be done on a copy of the all-atom linked list, otherwise
-            the search for critical residues will fail since these
-            routines move the loops in space 
-         */
-         if((p=blFindResidueSpec(loop1->allatompdb,loop1->start))!=NULL)
-         {
-            /* Duplicate from the start res on                          */
-            if((dupe1 = blDupePDB(p))!=NULL)
-            {
-               if((end = blTermPDB(dupe1, loop1->length + 1))!=NULL)
-                  FREELIST(end,PDB);
-            }
-         }
-         if((p=blFindResidueSpec(loop2->allatompdb,loop2->start))!=NULL)
-         {
-            /* Duplicate from the start res on                          */
-            if((dupe2 = blDupePDB(p))!=NULL)
-            {
-               if((end = blTermPDB(dupe2, loop2->length + 1))!=NULL)
-                  FREELIST(end,PDB);
-            }
-         }
-         
-         if(dupe1==NULL || dupe2==NULL)
-         {
-            if(dupe1!=NULL) FREELIST(dupe1, PDB);
-            if(dupe2!=NULL) FREELIST(dupe2, PDB);
-            if(!Warned)
-            {
-               fprintf(stderr,"Warning: Unable to duplicate PDB linked \
-lists.\n");
-               fprintf(stderr,"         Max deviations in merging will \
-only be done on CA, not CB\n");
-
-               if(loop1->allatompdb == NULL || loop2->allatompdb == NULL)
-               {
-                  fprintf(stderr,"         You can solve this by using \
-the CRITICAL keyword *before* the LOOP specifications.\n");
-               }
-               Warned = TRUE;
-            }
-            
-            dupe1    = loop1->pdbloop;
-            dupe2    = loop2->pdbloop;
-            DupeDone = FALSE;
-         }
-            
-         *rms = RmsCAPDB(dupe1, 
-                         dupe2, 
-                         loop1->length);
-         *CADev = MaxCADeviationPDB(dupe1, 
-                                    dupe2,
-                                    loop1->length);
-         *CBDev = MaxCBDeviationPDB(dupe1, 
-                                    dupe2,
-                                    loop1->length);
-
-         /* If we managed to duplicate our PDB linked lists, free them  */
-         if(DupeDone)
-         {
-            FREELIST(dupe1, PDB);
-            FREELIST(dupe2, PDB);
-         }
+         *rms = FitLoopCoor(loop1, loop2, CADev, CBDev);
 
          if(sInfoLevel)
          {
@@ -2562,7 +6981,7 @@ MAXCB=%.3f\n", loop1->loopid, loop2->loopid, *rms, *CADev, *CBDev);
                 REAL rms, REAL CADev, REAL CBDev, int *NewNumbers, 
                 int NClus)
    ----------------------------------------------------------------------
-   Input:   FILE     *fp          File to write information to
+   Input:   FILE     *fp          File to write information to (or NULL)
             int      i            First cluster number
             DATALIST *loop1       Representative of first cluster
             int      j            Second cluster number
@@ -2581,6 +7000,7 @@ MAXCB=%.3f\n", loop1->loopid, loop2->loopid, *rms, *CADev, *CBDev);
 
    12.09.95 Original    By: ACRM
    14.03.96 Added CBDev printing & parameter
+   16.10.26 Nothing is written if fp is NULL
 */
 void DoMerge(FILE *fp, int i, DATALIST *loop1, int j, DATALIST *loop2, 
              REAL rms, REAL CADev, REAL CBDev, int *NewNumbers, int NClus)
@@ -2589,13 +7009,16 @@ void DoMerge(FILE *fp, int i, DATALIST *loop1, int j, DATALIST *loop2,
        NewClusNum,
        k;
 
-   fprintf(fp,"MERGED cluster %d (%s) with %d (%s), rmsd = %f, \
+   if(fp != NULL)
+   {
+      fprintf(fp,"MERGED cluster %d (%s) with %d (%s), rmsd = %f, \
 max CA deviation = %f, max CB deviation = %f\n",
-           i+1,
-           loop1->loopid,
-           j+1,
-           loop2->loopid,
-           rms, CADev, CBDev);
+              i+1,
+              loop1->loopid,
+              j+1,
+              loop2->loopid,
+              rms, CADev, CBDev);
+   }
    
    
    /* Merge these two clusters                                          */
@@ -2618,10 +7041,9 @@ max CA deviation = %f, max CB deviation = %f\n",
 
 
 /************************************************************************/
-/*>DATALIST *FindLoop(int *clusters, int NVec, int ClusNum, int loopnum)
-   ---------------------------------------------------------------------
-   Input:   int   *clusters     Clustring vector
-            int   NVec          Number of vectors
+/*>DATALIST *FindLoop(CLUSMEMBERS *cm, int ClusNum, int loopnum)
+   --------------------------------------------------------------
+   Input:   CLUSMEMBERS *cm     Members of each cluster
             int   ClusNum       Cluster of interest
             int   loopnum       Example number within this cluster
    Returns: DATALIST *          Pointer to loop example in this cluster.
@@ -2630,49 +7052,44 @@ max CA deviation = %f, max CB deviation = %f\n",
    Finds the loopnum'th example within this cluster (counts from 0)
 
    12.09.95 Original    By: ACRM
+   16.10.26 Takes the cluster member lists and picks the loop from 
+            gLoopTable
 */
-DATALIST *FindLoop(int *clusters, int NVec, int ClusNum, int loopnum)
+DATALIST *FindLoop(CLUSMEMBERS *cm, int ClusNum, int loopnum)
 {
-   DATALIST *p;
-   int      i, j,
-            example = 0;
+   int i;
 
-   for(i=0; i<NVec; i++)
-   {
-      if(clusters[i]==ClusNum)
-      {
-         if(example == loopnum)
-         {
-            /* Run through the global data linked list to find the
-               example's loop pointer
-            */
-            for(p=gDataList, j=0; p!=NULL && j<i; NEXT(p), j++) ;
-            return(p);
-         }
-         example++;
-      }
-   }
-   
-   return(NULL);
+   if((ClusNum < 1) || (ClusNum > cm->NClus) || (loopnum < 0) ||
+      (loopnum >= NCLUSMEMBERS(cm, ClusNum)))
+      return(NULL);
+
+   i = CLUSMEMBER(cm, ClusNum, loopnum);
+   return((i < gNLoops) ? gLoopTable[i] : NULL);
 }
 
 
 /************************************************************************/
-/*>BOOL DefineCriticalResidues(FILE *fp, int *clusters, REAL **data, 
+/*>BOOL DefineCriticalResidues(FILE *fp, int *clusters, FEATURE **data, 
                                int NVec, int VecDim, REAL *crit, 
-                               int NClus)
+                               int NClus, char **CritCopy)
    -----------------------------------------------------------------
    Input:   FILE   *fp         Output file pointer
             int    *clusters   Clustering table
-            REAL   **data      Data for clustering
+            FEATURE **data     Data for clustering
             int    NVec        Number of vectors
             int    VecDim      Dimesion of vector
             REAL   *crit       Critical values
             int    NClus       Number of clusters
+            char   **CritCopy  Text to print for each cluster in place
+                               of working it out (or NULL), or NULL
 
    Does all set up from definition of clusters to call routines which
    analyse critical residues.
 
+   Clusters copied from a previous run are not analysed again. Since 
+   the residues conserved in any cluster are then not known, the
+   ALLCRITICALRESIDUES section is not written if any are copied.
+
    08.08.95 Original    By: ACRM
    15.08.95 Modified to use cluster vector rather than matrix
    04.10.95 Modified additionally to show details of residues conserved
@@ -2681,23 +7098,37 @@ DATALIST *FindLoop(int *clusters, int NVec, int ClusNum, int loopnum)
    05.10.95 Removed First checking for MergeAllProperties() as this
             is now done on a per-residue basis within that routine.
    06.11.95 Added check on exclude list before processing
+   16.10.26 Added CritCopy. Reads loops carried over from a previous run
+   16.10.26 Visits the members of each cluster from the CLUSMEMBERS
+            lists and gLoopTable rather than scanning every vector and
+            walking the linked list
+   16.10.26 Keeps a hash of the conserved residues list and frees the
+            list
+   16.10.26 Pins the structures of each cluster in the structure cache
+            until its properties are merged. ALLCRITICALRESIDUES reads
+            structures again if needed, visiting the loops in reverse
+            order
 */
-BOOL DefineCriticalResidues(FILE *fp, int *clusters, REAL **data, 
-                            int NVec, int VecDim, REAL *crit, int NClus)
+BOOL DefineCriticalResidues(FILE *fp, int *clusters, FEATURE **data, 
+                            int NVec, int VecDim, REAL *crit, int NClus,
+                            char **CritCopy)
 {
    int         clusnum,
-               i,  j,
+               i,  k,
                *NMembers,
+               NCopied   = 0,
                NCons,
                InfoPos   = 0,
                InfoStart = 0;
    LOOPINFO    *loopinfo;
    DATALIST    *p;
    CLUSTERINFO *cinfo;
+   CLUSMEMBERS cm;
    PDB         *pdb,
                *pdb_start,
                *pdb_end;
    RESSPEC     *ConsList = NULL;
+   RESKEYHASH  *ConsHash = NULL;
 
    /* Allocate memory for maximum possible amount of loop data          */
    if((loopinfo=(LOOPINFO *)malloc(NVec * sizeof(LOOPINFO)))==NULL)
@@ -2722,6 +7153,15 @@ BOOL DefineCriticalResidues(FILE *fp, int *clusters, REAL **data,
       return(FALSE);
    }
 
+   /* Find the members of each cluster                                  */
+   if(!BuildClusMembers(clusters, NVec, NClus, &cm))
+   {
+      free(loopinfo);
+      free(cinfo);
+      free(NMembers);
+      return(FALSE);
+   }
+
    for(i=0; i<=NClus; i++)
       NMembers[i] = 0;
    
@@ -2740,52 +7180,67 @@ BOOL DefineCriticalResidues(FILE *fp, int *clusters, REAL **data,
    {
       /* Currently no members in this cluster                           */
       NMembers[clusnum] = 0;
+
+      /* Copy clusters which are unchanged from a previous run          */
+      if((CritCopy != NULL) && (CritCopy[clusnum-1] != NULL))
+      {
+         fprintf(fp,"CLUSTER %d%s",clusnum,CritCopy[clusnum-1]);
+         InfoStart += NMembers[clusnum-1];
+         NCopied++;
+         continue;
+      }
       
-      /* Run through the cluster table to find members of this cluster  */
-      for(i=0; i<NVec; i++)
+      /* Run through the members of this cluster                        */
+      for(k=0; k<NCLUSMEMBERS(&cm, clusnum); k++)
       {
-         /* If this is the current cluster                              */
-         if(clusters[i] == clusnum)
+         /* Find the PDB linked list for this example                   */
+         p = gLoopTable[CLUSMEMBER(&cm, clusnum, k)];
+         if(!LoadLoop(p, TRUE))
          {
-            /* Find the PDB linked list for this example                */
-            for(j=0, p=gDataList; j<i && p!=NULL; j++, NEXT(p));
+            free(loopinfo);
+            FreeClusMembers(&cm);
+            return(FALSE);
+         }
+
+         /* loopinfo points into the structure until merged            */
+         PinStructure(p, TRUE);
 
-            /* Find PDB pointers for the structure and the start and end 
-               of the loop itself.
+         /* Find PDB pointers for the structure and the start and end 
+            of the loop itself.
+         */
+         pdb       = p->allatompdb;
+         pdb_start = blFindResidueSpec(pdb, p->start);
+         pdb_end   = blFindResidueSpec(pdb, p->end);
+         if(pdb_end != NULL)
+            pdb_end   = blFindNextResidue(pdb_end);
+         
+         if(pdb_start != NULL)
+         {
+            /* If this loop is not in the list of loops to be ignored
+               in sequence template analysis
             */
-            pdb       = p->allatompdb;
-            pdb_start = blFindResidueSpec(pdb, p->start);
-            pdb_end   = blFindResidueSpec(pdb, p->end);
-            if(pdb_end != NULL)
-               pdb_end   = blFindNextResidue(pdb_end);
-            
-            if(pdb_start != NULL)
+            if(!blInStringList(gStringList, p->loopid))
             {
-               /* If this loop is not in the list of loops to be ignored
-                  in sequence template analysis
-               */
-               if(!blInStringList(gStringList, p->loopid))
+               /* Store the loop properties in the array                */
+               if(!FindNeighbourProps(pdb, pdb_start, pdb_end, clusnum,
+                                      &(loopinfo[InfoPos])))
                {
-                  /* Store the loop properties in the array             */
-                  if(!FindNeighbourProps(pdb, pdb_start, pdb_end, clusnum,
-                                         &(loopinfo[InfoPos])))
-                  {
-                     free(loopinfo);
-                     return(FALSE);
-                  }
-                  
-                  InfoPos++;
-                  (NMembers[clusnum])++;
+                  free(loopinfo);
+                  FreeClusMembers(&cm);
+                  return(FALSE);
                }
+               
+               InfoPos++;
+               (NMembers[clusnum])++;
             }
-            else
-            {
-               fprintf(stderr,"Unable to find start residue (%s) in PDB \
+         }
+         else
+         {
+            fprintf(stderr,"Unable to find start residue (%s) in PDB \
 file (%s)\n",p->start,p->loopid);
-               return(FALSE);
-            }
-         }  /* Correct cluster                                          */
-      }  /* End of for(each vector)                                     */
+            return(FALSE);
+         }
+      }  /* End of for(each member)                                     */
 
       InfoStart += NMembers[clusnum-1];
 
@@ -2812,14 +7267,23 @@ file (%s)\n",p->start,p->loopid);
                                NMembers[clusnum]);
          fprintf(fp,"\n");
       }
+
+      /* The structure cache may now free this cluster's structures     */
+      for(k=0; k<NCLUSMEMBERS(&cm, clusnum); k++)
+         PinStructure(gLoopTable[CLUSMEMBER(&cm, clusnum, k)], FALSE);
    }  /* End of for(each cluster)                                       */
    fprintf(fp, "END CRITICALRESIDUES\n");
 
    /* Build a list of all the residues which are conserved in any one
       cluster
    */
-   InfoStart = 0;
-   if((ConsList = BuildConservedList(cinfo, NClus, &NCons))!=NULL)
+   if(NCopied)
+   {
+      fprintf(stderr,"Note: ALLCRITICALRESIDUES is not written when \
+clusters are copied from a previous run\n");
+   }
+   else if((ConsList = BuildConservedList(cinfo, NClus, &NCons, 
+                                          &ConsHash))!=NULL)
    {
       /* Print a header                                                 */
       fprintf(fp, "\nBEGIN ALLCRITICALRESIDUES %d\n", NClus);
@@ -2828,50 +7292,67 @@ file (%s)\n",p->start,p->loopid);
       for(i=0; i<NClus; i++)
          CleanClusInfo(&(cinfo[i]));
 
-      /* For each cluster in turn                                       */
-      for(clusnum=1; clusnum<=NClus; clusnum++)
+      /* For each cluster in turn. The merged properties do not depend
+         on the order of the loops, so visit them in the reverse of the
+         order used above: the structures used most recently are those
+         still in the structure cache.
+      */
+      for(clusnum=NClus; clusnum>=1; clusnum--)
       {
-         InfoStart += NMembers[clusnum-1];
-
          /* If there were some members in this cluster                  */
          if(NMembers[clusnum])
          {
-            for(i=0; i<NVec; i++)
+            for(k=NCLUSMEMBERS(&cm, clusnum)-1; k>=0; k--)
             {
-               /* If this is our cluster                                */
-               if(clusters[i] == clusnum)
-               {
-                  /* Find the PDB linked list for this example          */
-                  for(j=0, p=gDataList; j<i && p!=NULL; j++, NEXT(p));
+               /* Find the PDB linked list for this example             */
+               p = gLoopTable[CLUSMEMBER(&cm, clusnum, k)];
 
-                  if(!blInStringList(gStringList, p->loopid))
+               if(!blInStringList(gStringList, p->loopid))
+               {
+                  if(!LoadLoop(p, TRUE))
                   {
-                     /* Find PDB pointer for the structure.             */
-                     pdb = p->allatompdb;
-                     
-                     if(!MergeAllProperties(pdb, ConsList, NCons,
-                                            &(cinfo[clusnum-1])))
-                     {
-                        fprintf(fp,"END ALLCRITICALRESIDUES (failed!)\n");
-                        fprintf(stderr,"MergeAllProperties() failed\n");
-                        return(FALSE);
-                     }
+                     fprintf(fp,"END ALLCRITICALRESIDUES (failed!)\n");
+                     return(FALSE);
                   }
+
+                  /* Find PDB pointer for the structure.                */
+                  pdb = p->allatompdb;
                   
-               }  /* Correct cluster                                    */
-            }  /* End of for(each vector)                               */
+                  if(!MergeAllProperties(pdb, ConsList, ConsHash, NCons,
+                                         &(cinfo[clusnum-1])))
+                  {
+                     fprintf(fp,"END ALLCRITICALRESIDUES (failed!)\n");
+                     fprintf(stderr,"MergeAllProperties() failed\n");
+                     return(FALSE);
+                  }
+               }
+               
+            }  /* End of for(each member)                               */
          }  /* There were members of this cluster                       */
-         
+      }
+
+      for(clusnum=1; clusnum<=NClus; clusnum++)
+      {
          /* Print merged properties for this cluster                    */
          PrintMergedProperties(fp, clusnum, cinfo[clusnum-1], 
                                NMembers[clusnum]);
-         PrintDeletedResidues(fp, cinfo[clusnum-1], ConsList, NCons);
+         PrintDeletedResidues(fp, cinfo[clusnum-1], ConsList, ConsHash,
+                              NCons);
          fprintf(fp,"\n");
       }
       fprintf(fp, "END ALLCRITICALRESIDUES\n");
+
+      free(ConsList);
+      blFreeResKeyHash(ConsHash);
    }
    
-   
+   if(sInfoLevel > 0)
+   {
+      fprintf(stderr,"Structure cache: %lu used, %lu read, peak %.1f \
+Mbytes\n", sCacheHits, sCacheReads,
+              (double)StructureCachePeak() / 1048576.0);
+   }
+
 
    /* Clean up allocated memory in the loopinfo and clusinfo structures */
    CleanLoopInfo(loopinfo, InfoPos);  /* 07.11.95 Changed to InfoPos
@@ -2883,6 +7364,7 @@ file (%s)\n",p->start,p->loopid);
    free(loopinfo);
    free(cinfo);
    free(NMembers);
+   FreeClusMembers(&cm);
 
    return(TRUE);
 }
@@ -6,15 +6,56 @@ BOOL ReadInputFile(FILE *fp, BOOL CATorsions)
 ;
 BOOL SetupParser(void)
 ;
+BOOL SetDissimStore(char *type, char *filename, char *element)
+;
+BOOL SetRepresentative(char *type, char *maxexact)
+;
+BOOL SetBootstrap(char *count, char *mode)
+;
 BOOL DoCmdLoop(FILE *fp, BOOL CATorsions)
 ;
-BOOL ShowClusters(FILE *fp, REAL **data, int NVec, int VecDim, 
+BOOL WriteCheckpoint(char *filename, FEATURE **data, int NVec, 
+                     int VecDim, int NItems, int Method, int *ia, 
+                     int *ib, REAL *crit, int *micro)
+;
+BOOL PadCheckpoint(FILE *fp, unsigned long nbytes)
+;
+BOOL ShowClusters(FILE *fp, FEATURE **data, int NVec, int VecDim, 
                   int Method, BOOL ShowTable, BOOL ShowDendogram)
 ;
-BOOL HierClus(int NVec, int VecDim, int ClusterMethod, REAL **data, 
+BOOL HierClus(int NVec, int VecDim, int ClusterMethod, FEATURE **data, 
+              REAL *weights, int NThreads, int StoreType, char *StoreFile,
               int *ia, int *ib, REAL *crit)
 ;
-int **ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, REAL *crit, 
+void *DissimWorker(void *arg)
+;
+REAL LanceWilliams(int ClusterMethod, REAL dik, REAL djk, REAL dij,
+                   REAL ni, REAL nj, REAL nk)
+;
+int CompareMerges(const void *m1, const void *m2)
+;
+unsigned long DissimStoreBytes(int NVec, int ClusterMethod)
+;
+BOOL MSTCluster(int NVec, int VecDim, FEATURE **data, int *ia, int *ib, 
+                REAL *crit, int NThreads)
+;
+void *MSTWorker(void *arg)
+;
+int MicroCluster(FEATURE **data, int NVec, int VecDim, int NMicro, 
+                 FEATURE **centres, REAL *weights, int *micro)
+;
+void *MicroWorker(void *arg)
+;
+int NearestCentre(FEATURE *x, FEATURE **centres, int NCentre, 
+                  int VecDim)
+;
+int CollapseDuplicates(FEATURE **data, int NVec, int VecDim, REAL tol,
+                       FEATURE **centres, REAL *weights, int *items)
+;
+int *ClusterAssign(FILE *fp, int NVec, int *ia, int *ib, int lev,
+                   int NLoops, int *micro)
+;
+void DendogramOrder(int NVec, int *ia, int *ib, REAL *crit, int *merged,
                     int lev, int *iorder, REAL *critval, int *height)
 ;
 char **ClusterDendogram(FILE *fp, int lev, int *iorder, int *height, 
@@ -22,41 +63,68 @@ char **ClusterDendogram(FILE *fp, int lev, int *iorder, int *height,
 ;
 BOOL DoClustering(BOOL CATorsions)
 ;
+BOOL CheckPrevClan(int VecDim)
+;
+BOOL AddPrevLoops(void)
+;
+BOOL LoadLoop(DATALIST *loop, BOOL Structure)
+;
+int PrevClanItems(FEATURE **data, int NVec, int VecDim, 
+                  FEATURE **centres, REAL *weights, int *items)
+;
+int *UnchangedClusters(int *ItemClusters, int NItems, int NClus)
+;
+BOOL PrevMerge(int i, int j, REAL *rms, REAL *CADev, REAL *CBDev)
+;
+char **PrevCritRes(int *clusters, int NVec, int NClus)
+;
 void Usage(void)
 ;
 void CreateDefaultScheme(int maxres)
 ;
 BOOL InsertIorder(int *iorder, int lev, int cluster, int parent)
 ;
-void WriteHeader(FILE *fp, int Method, int NVec, int VecDim, int *Scheme)
+void WriteHeader(FILE *fp, int Method, int NVec, int NItems, int VecDim,
+                 int *Scheme)
 ;
-BOOL WriteResults(FILE *fp, int *clusters, int NClus, REAL **data, 
+BOOL WriteResults(FILE *fp, int *clusters, int NClus, FEATURE **data, 
                   int NVec, int VecDim, REAL *crit, BOOL PostClus)
 ;
-int FindNumTrueClusters(REAL *crit, int lev, int VecDim)
+int FindNumTrueClusters(REAL *crit, int lev, int VecDim, REAL cutoff)
 ;
 void CleanUp(void)
 ;
-void WriteClusData(FILE *fp, int NVec, int VecDim, REAL **data)
+void WriteClusData(FILE *fp, int NVec, int VecDim, FEATURE **data)
 ;
-DATALIST *FindMedian(int *clusters, REAL **data, int NVec, int VecDim, 
-                     int ClusNum, int *NMemb)
+BOOL ClusterMedians(int *clusters, FEATURE **data, int NVec, int VecDim,
+                    int NClus, DATALIST **repres, int *NMemb)
 ;
-void FillClusterArray(int **clusters, int NVec, int NClus,
-                      int *TheClusters)
+void *MedianWorker(void *arg)
 ;
-REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
+void FillClusterArray(int NVec, int *ia, int *ib, int *merged, 
+                      int NClus, int *TheClusters)
 ;
-REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
+void CutTree(int NVec, int NItems, int *ia, int *ib, int *merged,
+             int NClus, int *micro, int *ItemClusters, int *TheClusters)
 ;
-REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+BOOL SweepClusters(FILE *fp, FEATURE **data, int NVec, int VecDim,
+                   int NItems, int *ia, int *ib, int *merged,
+                   REAL *crit, int lev, int *micro)
 ;
-REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+BOOL Bootstrap(FILE *fp, FEATURE **data, int NVec, int VecDim, 
+               int Method, int *clusters, int NClus, int *post)
+;
+void *BootWorker(void *arg)
 ;
 int RenumClusters(int *clusters, int NVec)
 ;
-int PostCluster(FILE *fp, int *clusters, REAL **data, int NVec, 
-                int VecDim, REAL *crit, int NClus)
+int PostCluster(FILE *fp, int *clusters, FEATURE **data, int NVec, 
+                int VecDim, REAL *crit, int NClus, int *OldRaw)
+;
+void *PostWorker(void *arg)
+;
+BOOL TestClusters(DATALIST **loops1, DATALIST **loops2, REAL *rms,
+                  REAL *CADev, REAL *CBDev)
 ;
 BOOL TestMerge(DATALIST *loop1, DATALIST *loop2, REAL *rms, REAL *CADev,
                REAL *CBDev)
@@ -64,8 +132,9 @@ BOOL TestMerge(DATALIST *loop1, DATALIST *loop2, REAL *rms, REAL *CADev,
 void DoMerge(FILE *fp, int i, DATALIST *loop1, int j, DATALIST *loop2, 
              REAL rms, REAL CADev, REAL CBDev, int *NewNumbers, int NClus)
 ;
-DATALIST *FindLoop(int *clusters, int NVec, int ClusNum, int loopnum)
+DATALIST *FindLoop(CLUSMEMBERS *cm, int ClusNum, int loopnum)
 ;
-BOOL DefineCriticalResidues(FILE *fp, int *clusters, REAL **data, 
-                            int NVec, int VecDim, REAL *crit, int NClus)
+BOOL DefineCriticalResidues(FILE *fp, int *clusters, FEATURE **data, 
+                            int NVec, int VecDim, REAL *crit, int NClus,
+                            char **CritCopy)
 ;
@@ -3,8 +3,8 @@
    Program:    
    File:       decr.c
    
-   Version:    V3.7
-   Date:       06.02.96
+   Version:    V3.11
+   Date:       16.10.26
    Function:   DEfine Critical Residues
    
    Copyright:  (c) Dr. Andrew C. R. Martin 1995-6
@@ -57,6 +57,14 @@
    V3.6  09.01.96 Skipped
    V3.7  06.02.96 Separated out bits for findsdrs
    V3.7a 30.01.09 Fixed initial check on same residue
+   V3.8  16.10.26 FindNeighbourProps() finds contacts from a cell list
+   V3.9  16.10.26 Residue ids are matched with a hash of packed keys in
+                  FlagCommonResidues(), MergeProperties() and 
+                  InConsList()
+   V3.10 16.10.26 Residue properties and atom tests use the residue type
+                  and atom role codes set when the PDB file is read
+   V3.11 16.10.26 Removed ResidueContact() which is replaced by the cell
+                  list in FindNeighbourProps()
 
 *************************************************************************/
 /* Includes
@@ -68,6 +76,12 @@
 /************************************************************************/
 /* Defines and macros
 */
+#define RESSTATE_OTHER   0     /* Residue states in FindNeighbourProps() */
+#define RESSTATE_LOOP    1
+#define RESSTATE_CONTACT 2
+
+/* Packed residue id of a PDB record                                    */
+#define RESKEYOF(p) blPackResKey((p)->chain[0], (p)->resnum, (p)->insert[0])
 
 /************************************************************************/
 /* Globals
@@ -94,87 +108,128 @@
    Peforms all allocations in a LOOPINFO structure and fills it in with
    details of the loop and contacting residues.
 
+   Contacts are found from a cell list of the structure, so only atoms
+   near each loop residue are examined. A residue is a contact if any
+   of its sidechain atoms is within CONTACTDIST of a loop atom. For each
+   loop residue in turn, the new contacts are stored in sequence order.
+
    01.08.95 Original    By: ACRM
    02.08.95 Added AALoop and AAContact, clusnum parameter
    10.10.95 Changed USHORT to PROP_T
+   16.10.26 Uses a cell list rather than testing every residue in the
+            structure against the loop
 */
 BOOL FindNeighbourProps(PDB *pdb, PDB *start, PDB *stop, int clusnum,
                         LOOPINFO *loopinfo)
 {
-   PDB  *p, *p_next,
-        *q, *q_next,
-        **contacts;
-   int  ncontacts   = 0,
-        maxcontacts = ALLOCQUANTUM,
-        looplen     = 0;
-   BOOL InArray;
-
-   /* Allocate an array to store the contact PDB pointers               */
-   if((contacts=(PDB **)malloc(maxcontacts*sizeof(PDB)))==NULL)
+   PDB      *p, *p_next,
+            *q, *q_next,
+            **contacts  = NULL,
+            **NewContacts,
+            **ResStart  = NULL;
+   CELLLIST *cells;
+   int      *AtomRes    = NULL,
+            *found      = NULL,
+            *NewRes     = NULL,
+            ncontacts   = 0,
+            maxcontacts = ALLOCQUANTUM,
+            looplen     = 0,
+            NRes, natom, nfound, NNew,
+            i, r;
+   char     *ResState   = NULL;
+   BOOL     InLoop      = FALSE,
+            ok;
+
+   /* Sort the atoms into cells of the contact distance                 */
+   if((cells = blBuildCellListPDB(pdb, CONTACTDIST))==NULL)
       return(FALSE);
-   
-   /* Step through the loop                                             */
-   for(p=start,looplen=0; p!=stop; p=p_next)
-   {
-      /* Find the following residue                                     */
-      p_next = blFindNextResidue(p);
-      looplen++;
+   natom = cells->natom;
 
-      /* For each residue N-ter to the loop                             */
-      for(q=pdb; q!=start && q!=NULL; q=q_next)
+   /* Allocate an array to store the contact PDB pointers and arrays 
+      indexed by atom and by residue (never more residues than atoms)
+   */
+   contacts = (PDB **)malloc(maxcontacts * sizeof(PDB *));
+   AtomRes  = (int *)malloc((natom+1) * sizeof(int));
+   found    = (int *)malloc((natom+1) * sizeof(int));
+   NewRes   = (int *)malloc((natom+1) * sizeof(int));
+   ResStart = (PDB **)malloc((natom+1) * sizeof(PDB *));
+   ResState = (char *)malloc((natom+1) * sizeof(char));
+   ok = ((contacts != NULL) && (AtomRes != NULL) && (found != NULL) &&
+         (NewRes != NULL) && (ResStart != NULL) && (ResState != NULL));
+
+   if(ok)
+   {
+      /* Number the residues and flag those in the loop                 */
+      for(q=pdb, i=0, NRes=0; q!=NULL; q=q_next, NRes++)
       {
          q_next = blFindNextResidue(q);
+         if(q==start)
+            InLoop = TRUE;
+         else if(q==stop)
+            InLoop = FALSE;
+         ResStart[NRes] = q;
+         ResState[NRes] = (char)(InLoop?RESSTATE_LOOP:RESSTATE_OTHER);
+         for(p=q; p!=q_next; NEXT(p))
+            AtomRes[i++] = NRes;
+      }
+   
+      /* Step through the loop                                          */
+      for(p=start,looplen=0; p!=stop; p=p_next)
+      {
+         /* Find the following residue                                  */
+         p_next = blFindNextResidue(p);
+         looplen++;
 
-         /* If loop residue makes contact with this non-loop residue    */
-         if(ResidueContact(p,p_next,q,q_next,CONTACTDIST))
+         /* Find non-loop residues with a sidechain atom in contact 
+            which are not already stored
+         */
+         nfound = blFindCellNeighboursPDB(cells, p, p_next, CONTACTDIST,
+                                          TRUE, found);
+         for(i=0, NNew=0; i<nfound; i++)
          {
-            /* If this non-loop residue is not already stored           */
-            TESTINARRAY(contacts,ncontacts,q,InArray);
-            if(!InArray)
+            r = AtomRes[found[i]];
+            if(ResState[r] == RESSTATE_OTHER)
             {
-               /* Store the contact residue pointer                     */
-               contacts[ncontacts++] = q;
-
-               /* Increase the contacts array size                      */
-               if(ncontacts==maxcontacts)
-               {
-                  maxcontacts += ALLOCQUANTUM;
-                  if((contacts=(PDB **)
-                      realloc(contacts, maxcontacts*sizeof(PDB)))==NULL)
-                     return(FALSE);
-               }
+               ResState[r]    = RESSTATE_CONTACT;
+               NewRes[NNew++] = r;
             }
          }
-      }
-                  
-      /* For each residue C-ter to the loop                             */
-      for(q=stop; q!=NULL; q=q_next)
-      {
-         q_next = blFindNextResidue(q);
 
-         /* If loop residue makes contact with this non-loop residue    */
-         if(ResidueContact(p,p_next,q,q_next,CONTACTDIST))
+         /* Increase the contacts array size                            */
+         if(ncontacts + NNew > maxcontacts)
          {
-            /* If this non-loop residue is not already stored           */
-            TESTINARRAY(contacts,ncontacts,q,InArray);
-            if(!InArray)
+            maxcontacts = ALLOCQUANTUM * 
+                          ((ncontacts + NNew) / ALLOCQUANTUM + 1);
+            if((NewContacts=(PDB **)
+                realloc(contacts, maxcontacts*sizeof(PDB *)))==NULL)
             {
-               /* Store the contact residue pointer                     */
-               contacts[ncontacts++] = q;
-
-               /* Increase the contacts array size                      */
-               if(ncontacts==maxcontacts)
-               {
-                  maxcontacts += ALLOCQUANTUM;
-                  if((contacts=(PDB **)
-                      realloc(contacts, maxcontacts*sizeof(PDB)))==NULL)
-                     return(FALSE);
-               }
+               ok = FALSE;
+               break;
             }
+            contacts = NewContacts;
          }
+
+         /* Store the contact residue pointers in sequence order, as
+            testing each residue in turn would have found them
+         */
+         qsort(NewRes, NNew, sizeof(int), CompareResIndex);
+         for(i=0; i<NNew; i++)
+            contacts[ncontacts++] = ResStart[NewRes[i]];
       }
    }
 
+   blFreeCellListPDB(cells);
+   if(AtomRes  != NULL) free(AtomRes);
+   if(found    != NULL) free(found);
+   if(NewRes   != NULL) free(NewRes);
+   if(ResStart != NULL) free(ResStart);
+   if(ResState != NULL) free(ResState);
+   if(!ok)
+   {
+      if(contacts != NULL) free(contacts);
+      return(FALSE);
+   }
+
    /* Set values in the loopinfo structure                              */
    loopinfo->ncontacts = ncontacts;
    loopinfo->contacts  = contacts;
@@ -246,51 +301,26 @@ BOOL FindNeighbourProps(PDB *pdb, PDB *start, PDB *stop, int clusnum,
 
 
 /************************************************************************/
-/*>BOOL ResidueContact(PDB *p_start, PDB *p_stop, PDB *q_start, 
-                       PDB *q_stop, REAL dist)
-   ------------------------------------------------------------
-   Input:   PDB  *p_start    Start of first residue
-            PDB  *p_stop     Record after end of first residue
-            PDB  *q_start    Start of second residue
-            PDB  *q_stop     Record after end of second residue
-            REAL dist        Maximum distace to define contact
-   Returns: BOOL             In contact?
-
-   See if a contact of <= dist Angstroms is made between atoms in the 
-   residue bounded by pointers p_start/p_stop and sidechain atoms
-   bounded by q_start/q_stop
+/*>int CompareResIndex(const void *r1, const void *r2)
+   ---------------------------------------------------
+   Input:   const void *r1     Pointer to first residue index (int)
+            const void *r2     Pointer to second residue index (int)
+   Returns: int                -1, 0 or 1 for qsort()
 
-   01.08.95 Original    By: ACRM
-   30.01.09 Corrected initial self-contact check
+   Compares residue indexes so qsort() sorts them into ascending order
+
+   16.10.26 Original    By: ACRM
 */
-BOOL ResidueContact(PDB *p_start, PDB *p_stop, PDB *q_start, PDB *q_stop,
-                    REAL dist)
+int CompareResIndex(const void *r1, const void *r2)
 {
-   PDB *p, *q;
-
-   /* Ignore contact with itself                                        */
-   if(p_start==q_start)  /* 30.01.09 Corrected from p and q             */
-      return(FALSE);
-
-   /* Square the distance to save on doing square roots                 */
-   dist *= dist;
-   
-   for(p=p_start; p!=p_stop; NEXT(p))
-   {
-      for(q=q_start; q!=q_stop; NEXT(q))
-      {
-         if(strncmp(q->atnam,"N   ",4) &&
-            strncmp(q->atnam,"CA  ",4) &&
-            strncmp(q->atnam,"C   ",4) &&
-            strncmp(q->atnam,"O   ",4))
-         {
-            if(DISTSQ(p,q) <= dist)
-               return(TRUE);
-         }
-      }
-   }
-
-   return(FALSE);
+   int i1 = *(const int *)r1,
+       i2 = *(const int *)r2;
+
+   if(i1 < i2)
+      return(-1);
+   if(i1 > i2)
+      return(1);
+   return(0);
 }
 
 
@@ -308,24 +338,25 @@ BOOL ResidueContact(PDB *p_start, PDB *p_stop, PDB *q_start, PDB *q_stop,
 
    01.08.95 Original    By: ACRM
    02.08.95 Added AALoop and AAContact
+   16.10.26 Looks up the residue type code rather than the name
 */
 void FillLoopInfo(LOOPINFO *loopinfo)
 {
-   int  i;
-   char res;
+   int  i,
+        restype;
    
    
    for(i=0; i<loopinfo->length; i++)
    {
-      res = blThrone((loopinfo->residues[i])->resnam);
-      loopinfo->AALoop[i] = res;
-      loopinfo->ResProps[i] = SetProperties(res);
+      restype = RESTYPE(loopinfo->residues[i]);
+      loopinfo->AALoop[i] = blResTypeOne(restype);
+      loopinfo->ResProps[i] = ResTypeProperties(restype);
    }
    for(i=0; i<loopinfo->ncontacts; i++)
    {
-      res = blThrone((loopinfo->contacts[i])->resnam);
-      loopinfo->AAContact[i] = res;
-      loopinfo->ContactProps[i] = SetProperties(res);
+      restype = RESTYPE(loopinfo->contacts[i]);
+      loopinfo->AAContact[i] = blResTypeOne(restype);
+      loopinfo->ContactProps[i] = ResTypeProperties(restype);
    }
 }
 
@@ -356,14 +387,16 @@ void FillLoopInfo(LOOPINFO *loopinfo)
    05.10.95 Added clusterinfo->First = NULL;
    10.10.95 Added clusterinfo->deletable = NULL;
             Changed USHORT to PROP_T
+   16.10.26 Finds residue ids from a hash rather than searching the
+            arrays for each residue of each loop
 */
 BOOL MergeProperties(int NLoops, LOOPINFO *loopinfo, int clusnum,
                      CLUSTERINFO *clusterinfo)
 {
-   int  i,j,k,
-        NRes,
-        first;
-   BOOL GotResid;
+   RESKEYHASH *hash;
+   int        i,j,k,
+              NRes,
+              first;
 
    /* Find the residue IDs common to all loops in this cluster          */
    if((NRes = FlagCommonResidues(NLoops, loopinfo, clusnum)) < 0)
@@ -470,6 +503,16 @@ MergeProperties() can't\n",clusnum);
       }
    }
 
+   /* Index the residue ids. A repeated id is found at its first
+      position as the search did previously
+   */
+   if((hash = blCreateResKeyHash(NRes))==NULL)
+      return(FALSE);
+   for(k=NRes-1; k>=0; k--)
+      blSetResKeyHash(hash, blPackResKey(clusterinfo->chain[k],
+                                         clusterinfo->resnum[k],
+                                         clusterinfo->insert[k]), k);
+
    /* Examine the loopinfo array for each loop                          */
    for(i=0; i<NLoops; i++)
    {
@@ -483,22 +526,9 @@ MergeProperties() can't\n",clusnum);
             if(loopinfo[i].ResFlag[j])
             {
                /* Find it in the residue id arrays                      */
-               GotResid = FALSE;
-               for(k=0; k<clusterinfo->NRes; k++)
-               {
-                  if((clusterinfo->chain[k] == 
-                      loopinfo[i].residues[j]->chain[0]) &&
-                     (clusterinfo->resnum[k] ==
-                      loopinfo[i].residues[j]->resnum)   &&
-                     (clusterinfo->insert[k] ==
-                      loopinfo[i].residues[j]->insert[0]))
-                  {
-                     GotResid = TRUE;
-                     break;
-                  }
-               }               
+               k = blGetResKeyHash(hash, RESKEYOF(loopinfo[i].residues[j]));
                
-               if(GotResid)
+               if(k >= 0)
                {
                   /* If this residue id is already stored, combine 
                      properties from this loop into the array  
@@ -527,22 +557,9 @@ common but not in loop 0\n",i);
             if(loopinfo[i].ContactFlag[j])
             {
                /* Find it in the residue id arrays                      */
-               GotResid = FALSE;
-               for(k=0; k<clusterinfo->NRes; k++)
-               {
-                  if((clusterinfo->chain[k] == 
-                      loopinfo[i].contacts[j]->chain[0]) &&
-                     (clusterinfo->resnum[k] ==
-                      loopinfo[i].contacts[j]->resnum)   &&
-                     (clusterinfo->insert[k] ==
-                      loopinfo[i].contacts[j]->insert[0]))
-                  {
-                     GotResid = TRUE;
-                     break;
-                  }
-               }               
-
-               if(GotResid)
+               k = blGetResKeyHash(hash, RESKEYOF(loopinfo[i].contacts[j]));
+
+               if(k >= 0)
                {
                   /* If this residue id is already stored, combine 
                      properties from this loop into the array  
@@ -565,6 +582,8 @@ common but not in loop 0\n",i);
          }
       }
    }
+
+   blFreeResKeyHash(hash);
    return(TRUE);
 }
 
@@ -641,32 +660,32 @@ void BlankLoopInfo(LOOPINFO *loopinfo)
    Returns the total number of common residues.
 
    03.08.95 Original   By: ACRM
+   16.10.26 Finds residue ids from a hash of the first loop's ids rather
+            than searching them for every residue of every loop
 */
 int FlagCommonResidues(int NLoops, LOOPINFO *loopinfo, int clusnum)
 {
-   int  i, j, k,
-        looplen,
-        *resnum,
-        *count,
-        nres,
-        retval = (-1),
-        first;
-   char *chain,
-        *insert;
+   RESKEYHASH *hash;
+   PDB        *p;
+   int        i, j, k,
+              looplen,
+              *rep,
+              *count,
+              nres,
+              retval = (-1),
+              first;
 
    /* Find how many residues there are in the first example and allocate
       memory of this size
    */
    nres = loopinfo[0].length + loopinfo[0].ncontacts;
 
-   chain  = (char *)malloc(nres * sizeof(char));
-   insert = (char *)malloc(nres * sizeof(char));
-   resnum = (int *)malloc(nres * sizeof(int));
-   count  = (int *)malloc(nres * sizeof(int));
+   rep    = (int *)malloc((nres+1) * sizeof(int));
+   count  = (int *)malloc((nres+1) * sizeof(int));
+   hash   = blCreateResKeyHash(nres);
 
    /* If allocations all OK, continue                                   */
-   if((chain  != NULL) && (insert != NULL) && 
-      (resnum != NULL) && (count  != NULL))
+   if((rep != NULL) && (count != NULL) && (hash != NULL))
    {
       /* Initialise retval to 0 to say that allocations succeeded       */
       retval = 0;
@@ -685,24 +704,25 @@ int FlagCommonResidues(int NLoops, LOOPINFO *loopinfo, int clusnum)
       /* If a loop is found in the required cluster                     */
       if(first != (-1))
       {
-         /* Copy the residue ids into the arrays for first loop         */
+         /* Index the residue ids for first loop (loop residues then
+            contacting residues). A repeated id shares the count of its
+            first occurrence.
+         */
          looplen = loopinfo[first].length;
-         for(j=0; j<looplen; j++)                /* Loop residues       */
-         {
-            chain[j]  = loopinfo[first].residues[j]->chain[0];
-            resnum[j] = loopinfo[first].residues[j]->resnum;
-            insert[j] = loopinfo[first].residues[j]->insert[0];
-            count[j]  = 1;
-         }
-         for(j=0; j<loopinfo[0].ncontacts; j++)  /* Contacting residues */
+         for(j=0; j<nres; j++)
          {
-            chain[looplen+j]  = loopinfo[first].contacts[j]->chain[0];
-            resnum[looplen+j] = loopinfo[first].contacts[j]->resnum;
-            insert[looplen+j] = loopinfo[first].contacts[j]->insert[0];
-            count[looplen+j]  = 1;
+            p = (j < looplen) ? loopinfo[first].residues[j] :
+                                loopinfo[first].contacts[j-looplen];
+            if((k = blGetResKeyHash(hash, RESKEYOF(p))) < 0)
+            {
+               /* The hash was sized for nres keys so can't need to grow */
+               k = j;
+               blSetResKeyHash(hash, RESKEYOF(p), k);
+            }
+            rep[j]   = k;
+            count[j] = 1;
          }
          
-         
          /* Run through the rest of the loops incrementing the count if
             the residue label is found in this loop
          */
@@ -712,24 +732,16 @@ int FlagCommonResidues(int NLoops, LOOPINFO *loopinfo, int clusnum)
             {
                for(j=0; j<loopinfo[i].length; j++)    /* Loop residues  */
                {
-                  for(k=0; k<nres; k++)
-                  {
-                     if((chain[k] ==loopinfo[i].residues[j]->chain[0]) &&
-                        (resnum[k]==loopinfo[i].residues[j]->resnum)   &&
-                        (insert[k]==loopinfo[i].residues[j]->insert[0]))
-                        (count[k])++;
-                  }
+                  if((k = blGetResKeyHash(hash, 
+                                  RESKEYOF(loopinfo[i].residues[j]))) >= 0)
+                     (count[k])++;
                }
                
                for(j=0; j<loopinfo[i].ncontacts; j++) /* Contacting res */
                {
-                  for(k=0; k<nres; k++)
-                  {
-                     if((chain[k] ==loopinfo[i].contacts[j]->chain[0]) &&
-                        (resnum[k]==loopinfo[i].contacts[j]->resnum)   &&
-                        (insert[k]==loopinfo[i].contacts[j]->insert[0]))
-                        (count[k])++;
-                  }
+                  if((k = blGetResKeyHash(hash, 
+                                  RESKEYOF(loopinfo[i].contacts[j]))) >= 0)
+                     (count[k])++;
                }
             }
          }
@@ -743,34 +755,18 @@ int FlagCommonResidues(int NLoops, LOOPINFO *loopinfo, int clusnum)
             {
                for(j=0; j<loopinfo[i].length; j++)    /* Loop residues  */
                {
-                  loopinfo[i].ResFlag[j] = FALSE;
-                  for(k=0; k<nres; k++)
-                  {
-                     if((chain[k] ==loopinfo[i].residues[j]->chain[0])  &&
-                        (resnum[k]==loopinfo[i].residues[j]->resnum)    &&
-                        (insert[k]==loopinfo[i].residues[j]->insert[0]) &&
-                        (count[k] ==NLoops))
-                     {
-                        loopinfo[i].ResFlag[j] = TRUE;
-                        break;
-                     }
-                  }
+                  k = blGetResKeyHash(hash, 
+                                      RESKEYOF(loopinfo[i].residues[j]));
+                  loopinfo[i].ResFlag[j] = ((k >= 0) && 
+                                            (count[k] == NLoops));
                }
                
                for(j=0; j<loopinfo[i].ncontacts; j++) /* Contacting res */
                {
-                  loopinfo[i].ContactFlag[j] = FALSE;
-                  for(k=0; k<nres; k++)
-                  {
-                     if((chain[k] ==loopinfo[i].contacts[j]->chain[0])  &&
-                        (resnum[k]==loopinfo[i].contacts[j]->resnum)    &&
-                        (insert[k]==loopinfo[i].contacts[j]->insert[0]) &&
-                        (count[k] ==NLoops))
-                     {
-                        loopinfo[i].ContactFlag[j] = TRUE;
-                        break;
-                     }
-                  }
+                  k = blGetResKeyHash(hash, 
+                                      RESKEYOF(loopinfo[i].contacts[j]));
+                  loopinfo[i].ContactFlag[j] = ((k >= 0) && 
+                                                (count[k] == NLoops));
                }
             }
          }
@@ -779,17 +775,16 @@ int FlagCommonResidues(int NLoops, LOOPINFO *loopinfo, int clusnum)
          retval = 0;
          for(k=0; k<nres; k++)
          {
-            if(count[k] == NLoops)
+            if(count[rep[k]] == NLoops)
                retval++;
          }
       }  /* There was a loop in the specified cluster                   */
    }  /* Memory allocations OK                                          */
    
    /* Free up allocated memory                                          */
-   if(chain  != NULL) free(chain);
-   if(insert != NULL) free(insert);
-   if(resnum != NULL) free(resnum);
+   if(rep    != NULL) free(rep);
    if(count  != NULL) free(count);
+   blFreeResKeyHash(hash);
    
    return(retval);
 }
@@ -937,11 +932,14 @@ cluster!\n");
 
 
 /************************************************************************/
-/*>RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
+/*>RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons,
+                               RESKEYHASH **ConsHash)
    ----------------------------------------------------------------------
    Input:   CLUSTERINFO  *cinfo      Array of cluster info structures
             int          NClus       Number of clusters
    Output:  int          *NCons      Number of conserved residues
+            RESKEYHASH   **ConsHash  Hash giving the position of each
+                                     residue id in the list
    Returns: RESSPEC      *           Allocated array of residue
                                      sepcifications
 
@@ -949,8 +947,10 @@ cluster!\n");
    structure array.
 
    04.10.95 Original    By: ACRM
+   16.10.26 Also builds a hash of the list for InConsList()
 */
-RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
+RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons,
+                            RESKEYHASH **ConsHash)
 {
    int     i, j,
            MaxCons   = ALLOCQUANTUM;
@@ -958,9 +958,15 @@ RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
 
    *NCons = 0;
 
-   /* Initialise the conserved list                                     */
+   /* Initialise the conserved list and its hash                        */
+   if((*ConsHash = blCreateResKeyHash(MaxCons))==NULL)
+      return(NULL);
    if((ConsList=(RESSPEC *)malloc(MaxCons * sizeof(RESSPEC)))==NULL)
+   {
+      blFreeResKeyHash(*ConsHash);
+      *ConsHash = NULL;
       return(NULL);
+   }
 
    /* Step through each cluster                                         */
    for(i=0; i<NClus; i++)
@@ -969,7 +975,7 @@ RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
       for(j=0; j<cinfo[i].NRes; j++)
       {
          /* If this residue is not already stored, then store it        */
-         if(InConsList(ConsList, *NCons, 
+         if(InConsList(ConsList, *ConsHash, 
                        cinfo[i].chain[j], 
                        cinfo[i].resnum[j], 
                        cinfo[i].insert[j]) == (-1))
@@ -981,15 +987,29 @@ RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
                if((ConsList=(RESSPEC *)
                    realloc(ConsList, MaxCons*sizeof(RESSPEC)))==NULL)
                {
+                  blFreeResKeyHash(*ConsHash);
+                  *ConsHash = NULL;
                   *NCons = (-1);
                   return(NULL);
                }
             }
             
-            /* Store this residue in the conserved list                 */
+            /* Store this residue in the conserved list and hash        */
             ConsList[*NCons].chain  = cinfo[i].chain[j];
             ConsList[*NCons].resnum = cinfo[i].resnum[j];
             ConsList[*NCons].insert = cinfo[i].insert[j];
+            if(!blSetResKeyHash(*ConsHash, 
+                                blPackResKey(cinfo[i].chain[j],
+                                             cinfo[i].resnum[j],
+                                             cinfo[i].insert[j]),
+                                *NCons))
+            {
+               free(ConsList);
+               blFreeResKeyHash(*ConsHash);
+               *ConsHash = NULL;
+               *NCons = (-1);
+               return(NULL);
+            }
 
             /* Increment the number of conserved residues counter       */
             (*NCons)++;
@@ -1002,44 +1022,41 @@ RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
 
 
 /************************************************************************/
-/*>int InConsList(RESSPEC *ConsList, int NCons, char *chain, int resnum, 
-                  char *insert)
+/*>int InConsList(RESSPEC *ConsList, RESKEYHASH *ConsHash, char chain, 
+                  int resnum, char insert)
    ----------------------------------------------------------------------
    Input:   RESSPEC    *ConsList    Array of residue specifications
-            int        NCons        Number of specs in ConsList
-            char       *chain       Chain specification to look for
+            RESKEYHASH *ConsHash    Hash of ConsList from 
+                                    BuildConservedList()
+            char       chain        Chain specification to look for
             int        resnum       Res num specification to look for
-            char       *insert      Insert specification to look for
+            char       insert       Insert specification to look for
    Returns: int                     Position in ConsList (-1 if not found)
 
-   Test whether the specified residue is in the ConsList
+   Test whether the specified residue is in the ConsList and flag it if 
+   so
 
    04.10.95 Original    By: ACRM
    05.10.95 Returns int rather than BOOL
+   16.10.26 Looks up the residue in a hash rather than searching the 
+            list. Takes the hash instead of the number of residues
 */
-int InConsList(RESSPEC *ConsList, int NCons, char chain, int resnum, 
-                char insert)
+int InConsList(RESSPEC *ConsList, RESKEYHASH *ConsHash, char chain, 
+               int resnum, char insert)
 {
    int i;
+
+   if((i = blGetResKeyHash(ConsHash, 
+                           blPackResKey(chain, resnum, insert))) >= 0)
+      ConsList[i].flag = TRUE;
    
-   for(i=0; i<NCons; i++)
-   {
-      if((ConsList[i].chain  == chain)  &&
-         (ConsList[i].resnum == resnum) &&
-         (ConsList[i].insert == insert))
-      {
-         ConsList[i].flag = TRUE;
-         return(i);
-      }
-   }
-   
-   return(-1);
+   return(i);
 }
 
 
 /************************************************************************/
-/*>BOOL MergeAllProperties(int NLoops, LOOPINFO *loopinfo, int clusnum, 
-                           RESSPEC *ConsList, int NRes,
+/*>BOOL MergeAllProperties(PDB *pdb, RESSPEC *ConsList, 
+                           RESKEYHASH *ConsHash, int NRes,
                            CLUSTERINFO *clusterinfo)
    --------------------------------------------------------------------
    Input:   int         NLoops       Number of loops in a cluster
@@ -1048,6 +1065,7 @@ int InConsList(RESSPEC *ConsList, int NCons, char chain, int resnum,
             int         clusnum      The number of the cluster in which
                                      we are interested
             RESSPEC     *ConsList    Conserved residue list
+            RESKEYHASH  *ConsHash    Hash of ConsList
             int         NRes         Number of items in ConsList
    Output:  CLUSTERINFO *clusterinfo Compiled data about this cluster
                                      (Memory allocated within this
@@ -1069,14 +1087,17 @@ int InConsList(RESSPEC *ConsList, int NCons, char chain, int resnum,
    10.10.95 Handles deletable as a separate array rather than as a residue
             property flag. Simplifies various logic!
             Changed USHORT to PROP_T
+   16.10.26 Added ConsHash for InConsList()
+            Uses the atom role and residue type codes
 */
 BOOL MergeAllProperties(PDB *pdb,
-                        RESSPEC *ConsList, int NRes,
+                        RESSPEC *ConsList, RESKEYHASH *ConsHash, int NRes,
                         CLUSTERINFO *clusterinfo)
 {
-   int  i,k;
-   char res;
-   PDB *p;
+   int    i,k;
+   char   res;
+   PROP_T props;
+   PDB    *p;
 
    if(NRes==(-1))
       return(FALSE);
@@ -1150,14 +1171,15 @@ BOOL MergeAllProperties(PDB *pdb,
 
    for(p=pdb; p!=NULL; NEXT(p))
    {
-      if(!strncmp(p->atnam,"CA  ",4))
+      if(ATOMROLE(p) == ATOMROLE_CA)
       {
-         if((k=InConsList(ConsList, NRes, 
+         if((k=InConsList(ConsList, ConsHash, 
                           p->chain[0], 
                           p->resnum,
                           p->insert[0]))!=(-1))
          {
-            res = blThrone(p->resnam);
+            res   = blResTypeOne(RESTYPE(p));
+            props = ResTypeProperties(RESTYPE(p));
             
             clusterinfo->chain[k]          = p->chain[0];
             clusterinfo->resnum[k]         = p->resnum;
@@ -1165,16 +1187,16 @@ BOOL MergeAllProperties(PDB *pdb,
 
             if(clusterinfo->First[k])
             {
-               clusterinfo->ConservedProps[k] = SetProperties(res);
-               clusterinfo->RangeOfProps[k]   = SetProperties(res);
+               clusterinfo->ConservedProps[k] = props;
+               clusterinfo->RangeOfProps[k]   = props;
                clusterinfo->ConsRes[k]        = res;
 
                clusterinfo->First[k]          = FALSE;
             }
             else
             {
-               clusterinfo->ConservedProps[k] &= SetProperties(res);
-               clusterinfo->RangeOfProps[k]   |= SetProperties(res);
+               clusterinfo->ConservedProps[k] &= props;
+               clusterinfo->RangeOfProps[k]   |= props;
                if(res != clusterinfo->ConsRes[k])
                   clusterinfo->absolute[k] = FALSE;
             }
@@ -1206,21 +1228,25 @@ BOOL MergeAllProperties(PDB *pdb,
 
 /************************************************************************/
 /*>void PrintDeletedResidues(FILE *fp, CLUSTERINFO cinfo, 
-                             RESSPEC *ConsList, int NCons)
+                             RESSPEC *ConsList, RESKEYHASH *ConsHash,
+                             int NCons)
    -------------------------------------------------------
    Input:   FILE         *fp           Output file pointer
             CLUSTERINFO  cinfo         Information on this cluster
             RESSPEC      *ConsList     Array of residue specifications
                                        forming the conserved residues list
+            RESKEYHASH   *ConsHash     Hash of ConsList
             int          NCons         Number of members of ConsList
 
    Print any residues which appear in the conserved residues list but
    which haven't been flagged.
 
    04.10.95 Original    By: ACRM
+   16.10.26 Added ConsHash for InConsList()
 */
 void PrintDeletedResidues(FILE *fp, CLUSTERINFO cinfo, 
-                          RESSPEC *ConsList, int NCons)
+                          RESSPEC *ConsList, RESKEYHASH *ConsHash,
+                          int NCons)
 {
    int  i;
    BOOL found;
@@ -1234,7 +1260,7 @@ void PrintDeletedResidues(FILE *fp, CLUSTERINFO cinfo,
    */
    for(i=0; i<cinfo.NRes; i++)
    {
-      found = (InConsList(ConsList, NCons, 
+      found = (InConsList(ConsList, ConsHash, 
                           cinfo.chain[i], 
                           cinfo.resnum[i], 
                           cinfo.insert[i]) != (-1));
@@ -3,8 +3,8 @@
    Program:    
    File:       decr.h
    
-   Version:    V3.6
-   Date:       09.01.96
+   Version:    V3.10
+   Date:       16.10.26
    Function:   DEfine Critical Residues
    
    Copyright:  (c) Dr. Andrew C. R. Martin 1995-6
@@ -52,6 +52,9 @@
                   residues conserved in at least one cluster
    V3.5  06.11.95 Skipped
    V3.6  09.01.96 Skipped
+   V3.8  16.10.26 Added CompareResIndex()
+   V3.9  16.10.26 InConsList() and friends take a RESKEYHASH
+   V3.10 16.10.26 Removed ResidueContact()
 
 *************************************************************************/
 /* Includes
@@ -119,8 +122,7 @@ typedef struct
 BOOL FindNeighbourProps(PDB *pdb, PDB *start, PDB *stop, int clusnum,
                         LOOPINFO *loopinfo)
 ;
-BOOL ResidueContact(PDB *p_start, PDB *p_stop, PDB *q_start, PDB *q_stop,
-                    REAL dist)
+int CompareResIndex(const void *r1, const void *r2)
 ;
 void FillLoopInfo(LOOPINFO *loopinfo)
 ;
@@ -140,16 +142,18 @@ void CleanClusInfo(CLUSTERINFO *cinfo)
 void PrintMergedProperties(FILE *fp, int clusnum, CLUSTERINFO cinfo,
                            int NMembers)
 ;
-RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons)
+RESSPEC *BuildConservedList(CLUSTERINFO *cinfo, int NClus, int *NCons,
+                            RESKEYHASH **ConsHash)
 ;
-int InConsList(RESSPEC *ConsList, int NCons, char chain, int resnum, 
-                char insert)
+int InConsList(RESSPEC *ConsList, RESKEYHASH *ConsHash, char chain, 
+               int resnum, char insert)
 ;
 BOOL MergeAllProperties(PDB *pdb,
-                        RESSPEC *ConsList, int NRes,
+                        RESSPEC *ConsList, RESKEYHASH *ConsHash, int NRes,
                         CLUSTERINFO *clusterinfo)
 ;
 void PrintDeletedResidues(FILE *fp, CLUSTERINFO cinfo, 
-                          RESSPEC *ConsList, int NCons)
+                          RESSPEC *ConsList, RESKEYHASH *ConsHash,
+                          int NCons)
 ;
 
@@ -3,11 +3,11 @@
    Program:    
    File:       decr2.c
    
-   Version:    V3.7
-   Date:       06.02.96
+   Version:    V3.8
+   Date:       16.10.26
    Function:   DEfine Critical Residues
    
-   Copyright:  (c) Dr. Andrew C. R. Martin 1995-6
+   Copyright:  (c) Dr. Andrew C. R. Martin 1995-2026
    Author:     Dr. Andrew C. R. Martin
    Address:    Biomolecular Structure & Modelling Unit,
                Department of Biochemistry & Molecular Biology,
@@ -56,6 +56,7 @@
    V3.5  06.11.95 Skipped
    V3.6  09.01.96 Skipped
    V3.7  06.02.96 Separated out bits for findsdrs
+   V3.8  16.10.26 Added ResTypeProperties() for residue type codes
 
 *************************************************************************/
 /* Includes
@@ -65,6 +66,7 @@
 #include "resprops.h"
 #include "bioplib/SysDefs.h"
 #include "bioplib/macros.h"
+#include "bioplib/pdb.h"
 #include "decr2.h"
 
 /************************************************************************/
@@ -78,6 +80,7 @@
 */
 PROP_T sPropsArray[MAXPROPAA];   /* Properties for the 20 aa's and -    */
 char   sResArray[MAXPROPAA];     /* 1-letter codes in same order        */
+PROP_T sResTypeProps[blMAXRESTYPE+1]; /* Properties by residue type     */
 
 
 /************************************************************************/
@@ -245,9 +248,12 @@ void PrintProps(FILE *fp, PROP_T props, BOOL deletable)
    
    01.08.95 Original    By: ACRM
    06.10.95 Added -
+   16.10.26 Fills in the properties for each residue type code
 */
 void InitProperties(void)
 {
+   int i;
+   
    sResArray[0] = 'A';
    SET(sPropsArray[0], HPHOB_FLAG);
    SET(sPropsArray[0], UNCHARGED_FLAG);
@@ -410,6 +416,9 @@ void InitProperties(void)
 
    sResArray[20] = '-';
    SET(sPropsArray[20], DELETED_FLAG);
+
+   for(i=0; i<=blMAXRESTYPE; i++)
+      sResTypeProps[i] = SetProperties(blResTypeOne(i));
 }
 
 
@@ -444,3 +453,22 @@ PROP_T SetProperties(char res)
 }
 
 
+/************************************************************************/
+/*>PROP_T ResTypeProperties(int restype)
+   -------------------------------------
+   Input:   int     restype    Residue type code (RESTYPE_XXX)
+   Returns: PROP_T             Property flags for residue
+                               (0 if not found)
+
+   Gets the props variable for a residue type code from the table 
+   filled in by InitProperties(). Gives the same result as calling
+   SetProperties() with the 1-letter code.
+
+   16.10.26 Original    By: ACRM
+*/
+PROP_T ResTypeProperties(int restype)
+{
+   if((restype < 0) || (restype > blMAXRESTYPE))
+      return((PROP_T)0);
+   return(sResTypeProps[restype]);
+}
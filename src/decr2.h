@@ -6,3 +6,5 @@ void InitProperties(void)
 ;
 PROP_T SetProperties(char res)
 ;
+PROP_T ResTypeProperties(int restype)
+;
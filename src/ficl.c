@@ -51,6 +51,13 @@
    V3.6  09.01.96 Skipped
    V3.6a 30.01.09 Compile cleanups
    V3.7  17.01.23 Updated for new bioplib
+   V3.8  16.10.26 Cluster data held in an aligned FEATURE matrix shared
+                  with clan
+                  Reads data clustered with the angular metric
+                  Refuses data clustered with METRIC RMSD
+                  Matches against cluster medoids when clan was run
+                  with REPRESENTATIVE MEDOID
+                  Feature layout reset after expanding angular data
 
 *************************************************************************/
 /* Includes
@@ -58,16 +65,21 @@
 #define MAIN
 #include "acaca.h"
 #include "bioplib/matrix.h"
+#include "medoid.h"
 
 /************************************************************************/
 /* Defines and macros
 */
 #define HUGEBUFF 3600
+#define MEDOIDMAX 2000       /* Largest cluster with an exact medoid    */
 
 
 /************************************************************************/
 /* Globals
 */
+static BOOL sUseMedoids = FALSE;  /* Clusters represented by medoids    */
+static int  sMedoidMax  = MEDOIDMAX; /* Largest exact medoid            */
+static int  *sMedoids   = NULL;   /* Medoid of each cluster (from 0)    */
 
 /************************************************************************/
 /* Prototypes
@@ -76,33 +88,35 @@ int main(int argc, char **argv);
 BOOL ParseCmdLine(int argc, char **argv, char *datafile, char *pdbfile, 
                   char *startres, char *lastres, 
                   BOOL *Verbose);
-REAL **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
-                       int *pNData, int *pVecLength, 
-                       CLUSTER **ppClusters, int *NClusters,
-                       CLUSTER **ppMedians,  int *NMedians);
-BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength);
+FEATURE **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
+                          int *pNData, int *pVecLength, 
+                          CLUSTER **ppClusters, int *NClusters,
+                          CLUSTER **ppMedians,  int *NMedians);
+BOOL ReadData(FILE *fp, FEATURE **data, int NLoops, int VecLength);
 BOOL ReadHeader(FILE *fp, int *pMethod, int *pNLoops, int *pMaxLen,
                 BOOL *CATorsions);
-REAL **AllocateDataArrays(int NLoops, int VecLength, CLUSTER **ppClusters);
+FEATURE **AllocateDataArrays(int NLoops, int VecLength, 
+                             CLUSTER **ppClusters);
 void Usage(void);
-void CleanUp(REAL **data1, int NData1, int VecLen1,
-             REAL **data2, int NData2, int VecLen2);
+void CleanUp(FEATURE **data1, FEATURE **data2);
 int ReadClusters(FILE *fp, CLUSTER *clusters);
-int MatchCluster(REAL **data, int NData, int VecLength, 
-                 CLUSTER *clusters, int NClusters, REAL *LoopData, 
+int MatchCluster(FEATURE **data, int NData, int VecLength, 
+                 CLUSTER *clusters, int NClusters, FEATURE *LoopData, 
                  BOOL CATorsions, int method, BOOL *pError);
-int ConfirmCluster(REAL **data, int NVec, int VecLen, 
-                   CLUSTER *clusters, int TheCluster, REAL *vector,
+int ConfirmCluster(FEATURE **data, int NVec, int VecLen, 
+                   CLUSTER *clusters, int TheCluster, FEATURE *vector,
                    BOOL *pError);
-int InClusterBounds(REAL **data, int NVec, int VecDim, CLUSTER *clusters,
-                    int ClusNum, REAL *vector);
-REAL MinDistInCluster(REAL **data, int NVec, int VecLen, 
-                      CLUSTER *clusters, REAL *vector, int ClusNum);
-int FindNearestMedian(REAL **data, int NVec, int VecLen, 
-                      CLUSTER *clusters, int NClusters, REAL *vector);
-REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters, 
-                 int ClusNum);
+int InClusterBounds(FEATURE **data, int NVec, int VecDim, 
+                    CLUSTER *clusters, int ClusNum, FEATURE *vector);
+REAL MinDistInCluster(FEATURE **data, int NVec, int VecLen, 
+                      CLUSTER *clusters, FEATURE *vector, int ClusNum);
+int FindNearestMedian(FEATURE **data, int NVec, int VecLen, 
+                      CLUSTER *clusters, int NClusters, FEATURE *vector);
+FEATURE *FindMedian(FEATURE **data, int NVec, int VecLen, 
+                    CLUSTER *clusters, int ClusNum);
 int ReadMedians(FILE *fp, CLUSTER **ppMedians);
+int *ClusterMedoids(FEATURE **data, int NVec, int VecLen, 
+                    CLUSTER *clusters, int NClusters);
 void PrintClusterInfo(int TheCluster, CLUSTER *MedianData, int NMedians,
                       REAL dist, BOOL Verbose);
 
@@ -132,9 +146,9 @@ int main(int argc, char **argv)
    BOOL    CATorsions = FALSE,
            Error      = FALSE,
            Verbose    = FALSE;
-   REAL    **data     = NULL,
-           **LoopData = NULL,
-           dist;
+   FEATURE **data     = NULL,
+           **LoopData = NULL;
+   REAL    dist;
    CLUSTER *clusters  = NULL,
            *medians   = NULL;
    
@@ -194,7 +208,7 @@ int main(int argc, char **argv)
       Usage();
    }
 
-   CleanUp(data, NData, VecLength, LoopData, NLoopData, VecLength);
+   CleanUp(data, LoopData);
 
    return(retval);
 }
@@ -261,28 +275,41 @@ BOOL ParseCmdLine(int argc, char **argv, char *datafile, char *pdbfile,
 
 
 /************************************************************************/
-/*>REAL **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
-                          int *pNData, int *pVecLength, 
-                          CLUSTER **ppClusters, int *NClusters,
-                          CLUSTER **ppMedians,  int *NMedians)
+/*>FEATURE **ReadClusterFile(char *datafile, BOOL CATorsions, 
+                             int *pMethod, int *pNData, int *pVecLength, 
+                             CLUSTER **ppClusters, int *NClusters,
+                             CLUSTER **ppMedians,  int *NMedians)
    ---------------------------------------------------------------------
    Read the file produced by CLAN which defines the known clusters
 
-   Returns: REAL   **     Array of cluster data
+   Returns: FEATURE **    Array of cluster data
                           NULL on error
 
+   Data clustered with the angular metric hold raw torsions. They are 
+   expanded to sin/cos pairs as they are read since the cluster bounds
+   and medians need coordinates, and gMetric and the feature layout are
+   reset so the loop being matched is converted in the same way and 
+   FeatureDist2() sees plain coordinates. Distances are the same.
+   If clan used medoids as representatives, the medoids of the clusters
+   are found once here.
+
    26.07.95 Original    By: ACRM
+   16.10.26 Returns a FEATURE array
+   16.10.26 Handles the angular metric
+   16.10.26 Finds the cluster medoids for REPRESENTATIVE MEDOID
+   16.10.26 Resets the feature layout once the data are expanded
 */
-REAL **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
-                       int *pNData, int *pVecLength, 
-                       CLUSTER **ppClusters, int *NClusters,
-                       CLUSTER **ppMedians,  int *NMedians)
+FEATURE **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
+                          int *pNData, int *pVecLength, 
+                          CLUSTER **ppClusters, int *NClusters,
+                          CLUSTER **ppMedians,  int *NMedians)
 {
-   FILE *fp;
-   BOOL ok = TRUE;
-   int  NLoops,
-        MaxLen;
-   REAL **data = NULL;
+   FILE    *fp;
+   BOOL    ok = TRUE;
+   int     NLoops,
+           MaxLen,
+           FileVecLength;
+   FEATURE **data = NULL;
    
    /* Open the datafile for reading                                     */
    if((fp=fopen(datafile,"r"))==NULL)
@@ -291,8 +318,9 @@ REAL **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
    /* Read in the required header info                                  */
    if(ReadHeader(fp, pMethod, &NLoops, &MaxLen, &CATorsions))
    {
-      *pNData     = NLoops;
-      *pVecLength = MaxLen * 2 * (CATorsions ? 1 : 3);
+      *pNData       = NLoops;
+      *pVecLength   = MaxLen * 2 * (CATorsions ? 1 : 3);
+      FileVecLength = MaxLen * FeatureLayout(CATorsions);
 
 #ifdef DEBUG
       printf("VecLen = %d\n", *pVecLength);
@@ -301,8 +329,12 @@ REAL **ReadClusterFile(char *datafile, BOOL CATorsions, int *pMethod,
       if((data=AllocateDataArrays(NLoops, *pVecLength, ppClusters))!=NULL)
       {
          /* Read in the clustering data                                 */
-         if(ReadData(fp, data, NLoops, *pVecLength))
+         if(ReadData(fp, data, NLoops, FileVecLength))
          {
+            /* The data now hold sin/cos pairs                          */
+            gMetric = METRIC_EUCLIDEAN;
+            FeatureLayout(CATorsions);
+
             /* Read the cluster table                                   */
             if((*NClusters = ReadClusters(fp, *ppClusters))==0)
             {
@@ -318,6 +350,15 @@ CLAN output\n");
 CLAN output\n");
                   ok = FALSE;
                }
+               else if(sUseMedoids &&
+                       ((sMedoids = ClusterMedoids(data, NLoops, 
+                                                   *pVecLength,
+                                                   *ppClusters,
+                                                   *NClusters))==NULL))
+               {
+                  fprintf(stderr,"Unable to find cluster medoids\n");
+                  ok = FALSE;
+               }
             }
          }
          else
@@ -343,9 +384,7 @@ output\n");
    fclose(fp);
    if(!ok)
    {
-      if(data!=NULL)
-         blFreeArray2D((char **)data, NLoops, 
-                       (MaxLen * 2 * (CATorsions ? 1 : 3)));
+      FreeFeatures(data);
       data = NULL;
    }
       
@@ -354,22 +393,30 @@ output\n");
 
 
 /************************************************************************/
-/*>BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
-   ---------------------------------------------------------------
+/*>BOOL ReadData(FILE *fp, FEATURE **data, int NLoops, int VecLength)
+   ------------------------------------------------------------------
    Read the DATA section from the CLAN output file
 
    Returns: BOOL               Success?
 
    26.07.95 Original    By: ACRM
+   16.10.26 Reads into a FEATURE array. Raw torsions are expanded to 
+            sin/cos pairs with ExpandFeature()
 */
-BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
+BOOL ReadData(FILE *fp, FEATURE **data, int NLoops, int VecLength)
 {
-   char buffer[HUGEBUFF],
-        word[MAXBUFF],
-        *p;
-   BOOL InSection = FALSE;
-   int  i,
-        LoopCount = 0;
+   char    buffer[HUGEBUFF],
+           word[MAXBUFF],
+           *p;
+   BOOL    InSection = FALSE,
+           ok        = FALSE;
+   int     i,
+           LoopCount = 0;
+   double  val;
+   FEATURE *vec;
+
+   if((vec = (FEATURE *)malloc(VecLength * sizeof(FEATURE)))==NULL)
+      return(FALSE);
 
    rewind(fp);
    
@@ -379,7 +426,10 @@ BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
 
       /* Check for end of data section                                  */
       if(!strncmp(buffer,"END DATA",8))
-         return(TRUE);
+      {
+         ok = TRUE;
+         break;
+      }
 
       /* If in section, check for required data                         */
       if(InSection)
@@ -391,15 +441,18 @@ BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
          {
             fprintf(stderr,"Records are too long - increase HUGEBUFF\n");
          }
+         if(LoopCount >= NLoops)
+            break;
          for(i=0, p=buffer; p!=NULL && i<VecLength; i++)
          {
             p = blGetWord(p,word,MAXBUFF);
-            if(!sscanf(word,"%lf",&(data[LoopCount][i])))
-               return(FALSE);
+            if(!sscanf(word,"%lf",&val))
+               break;
+            vec[i] = (FEATURE)val;
          }
-         
-         if(++LoopCount > NLoops)
-            return(FALSE);
+         if(i < VecLength)
+            break;
+         ExpandFeature(vec, VecLength, data[LoopCount++]);
       }
 
       /* Check for beginning of data section                            */
@@ -407,7 +460,8 @@ BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
          InSection = TRUE;
    }
    
-   return(FALSE);
+   free(vec);
+   return(ok);
 }
 
 
@@ -421,6 +475,9 @@ BOOL ReadData(FILE *fp, REAL **data, int NLoops, int VecLength)
 
    26.07.95 Original    By: ACRM
    17.01.23 Added CATorsions
+   16.10.26 Sets gMetric from METRIC
+   16.10.26 Refuses METRIC RMSD
+   16.10.26 Sets sUseMedoids from REPRESENTATIVE
 */
 BOOL ReadHeader(FILE *fp, int *pMethod, int *pNLoops, int *pMaxLen,
                 BOOL *CATorsions)
@@ -472,6 +529,31 @@ BOOL ReadHeader(FILE *fp, int *pMethod, int *pNLoops, int *pMaxLen,
          {
             *CATorsions = FALSE;
          }
+         else if(!strncmp(word,"METRIC",6))
+         {
+            blGetWord(p,word,MAXBUFF);
+            if(!SetMetric(word))
+               return(FALSE);
+            if(gMetric == METRIC_RMSD)
+            {
+               fprintf(stderr,"Clusters made with METRIC RMSD cannot \
+be used to assign loops\n");
+               return(FALSE);
+            }
+         }
+         else if(!strncmp(word,"REPRESENTATIVE",14))
+         {
+            p = blGetWord(p,word,MAXBUFF);
+            if(!strncmp(word,"MEDOID",6))
+            {
+               sUseMedoids = TRUE;
+               if(p != NULL)
+               {
+                  blGetWord(p,word,MAXBUFF);
+                  sscanf(word,"%d",&sMedoidMax);
+               }
+            }
+         }
          else if(!strncmp(word,"SCHEME",6))
          {
             /* Read the scheme out of the following values              */
@@ -491,22 +573,24 @@ BOOL ReadHeader(FILE *fp, int *pMethod, int *pNLoops, int *pMaxLen,
 
 
 /************************************************************************/
-/*>REAL **AllocateDataArrays(int NLoops, int VecLength, 
-                             CLUSTER **ppClusters)
-   ----------------------------------------------------
+/*>FEATURE **AllocateDataArrays(int NLoops, int VecLength, 
+                                CLUSTER **ppClusters)
+   -------------------------------------------------------
    Allocate array to store the data section from the CLAN output
 
-   Returns: REAL    **   Data matrix storage
+   Returns: FEATURE **   Data matrix storage
                          NULL on error
 
    26.07.95 Original    By: ACRM
+   16.10.26 Uses AllocFeatures()
 */
-REAL **AllocateDataArrays(int NLoops, int VecLength, CLUSTER **ppClusters)
+FEATURE **AllocateDataArrays(int NLoops, int VecLength, 
+                             CLUSTER **ppClusters)
 {
-   REAL **data;
+   FEATURE **data;
 
    /* Allocate and check 2D array                                       */
-   if((data = (REAL **)blArray2D(sizeof(REAL),NLoops,VecLength))==NULL)
+   if((data = AllocFeatures(NLoops, VecLength))==NULL)
    {
       fprintf(stderr,"No memory for data array.\n");
       return(NULL);
@@ -515,7 +599,7 @@ REAL **AllocateDataArrays(int NLoops, int VecLength, CLUSTER **ppClusters)
    /* Allocate memory for clusters                                      */
    if((*ppClusters = (CLUSTER *)malloc(NLoops * sizeof(CLUSTER)))==NULL)
    {
-      blFreeArray2D((char **)data, NLoops, VecLength);
+      FreeFeatures(data);
       return(NULL);
    }
    
@@ -549,18 +633,21 @@ any of the existing\n");
 
 
 /************************************************************************/
-/*>void CleanUp(REAL **data1, int NData1, int VecLen1, 
-                REAL **data2, int NData2, int VecLen2)
-   ---------------------------------------------------
+/*>void CleanUp(FEATURE **data1, FEATURE **data2)
+   -----------------------------------------------
    Free allocated data
 
    26.07.95 Original    By: ACRM
+   16.10.26 Frees FEATURE arrays so the sizes are no longer needed
+   16.10.26 Frees the cluster medoids
 */
-void CleanUp(REAL **data1, int NData1, int VecLen1, 
-             REAL **data2, int NData2, int VecLen2)
+void CleanUp(FEATURE **data1, FEATURE **data2)
 {
-   blFreeArray2D((char **)data1, NData1, VecLen1);
-   blFreeArray2D((char **)data2, NData2, VecLen2);
+   FreeFeatures(data1);
+   FreeFeatures(data2);
+   if(sMedoids != NULL)
+      free(sMedoids);
+   sMedoids = NULL;
 }
 
 
@@ -648,8 +735,8 @@ of clusters\n");
 
 
 /************************************************************************/
-/*>int MatchCluster(REAL **data, int NData, int VecLength, 
-                    CLUSTER *clusters, int NClusters, REAL *LoopData, 
+/*>int MatchCluster(FEATURE **data, int NData, int VecLength, 
+                    CLUSTER *clusters, int NClusters, FEATURE *LoopData, 
                     BOOL CATorsions, int method, BOOL *pError)
    ---------------------------------------------------------------
    Returns: int             Appropriate cluster 
@@ -678,8 +765,8 @@ of clusters\n");
    31.07.95 Added error check from InClusterBounds()
             Added error check from FindNearestMedian()
 */
-int MatchCluster(REAL **data, int NData, int VecLength, 
-                 CLUSTER *clusters, int NClusters, REAL *LoopData, 
+int MatchCluster(FEATURE **data, int NData, int VecLength, 
+                 CLUSTER *clusters, int NClusters, FEATURE *LoopData, 
                  BOOL CATorsions, int method, BOOL *pError)
 {
    int  i,
@@ -747,8 +834,8 @@ int MatchCluster(REAL **data, int NData, int VecLength,
 
 
 /************************************************************************/
-/*>int ConfirmCluster(REAL **data, int NVec, int VecLen, 
-                      CLUSTER *clusters, int TheCluster, REAL *vector,
+/*>int ConfirmCluster(FEATURE **data, int NVec, int VecLen, 
+                      CLUSTER *clusters, int TheCluster, FEATURE *vector,
                       BOOL *pError)
    -------------------------------------------------------------------
    Returns: int                   The cluster number
@@ -762,19 +849,21 @@ int MatchCluster(REAL **data, int NData, int VecLength,
 
    28.07.95 Original    By: ACRM
    30.01.09 Initialize some variables
+   16.10.26 Takes FEATURE arrays. Distance to the median from 
+            FeatureDist2()
 */
-int ConfirmCluster(REAL **data, int NVec, int VecLen, 
-                   CLUSTER *clusters, int TheCluster, REAL *vector,
+int ConfirmCluster(FEATURE **data, int NVec, int VecLen, 
+                   CLUSTER *clusters, int TheCluster, FEATURE *vector,
                    BOOL *pError)
 {
-   REAL *median,
-        DistMedian,
-        DistNearest,
-        dist,
-        MaxVal = 0.0,
-        MinVal = 0.0;
-   int  i, j, ok,
-        NMembers;
+   FEATURE *median;
+   REAL    DistMedian,
+           DistNearest,
+           dist,
+           MaxVal = 0.0,
+           MinVal = 0.0;
+   int     i, j, ok,
+           NMembers;
 
    *pError = FALSE;
    
@@ -791,7 +880,7 @@ int ConfirmCluster(REAL **data, int NVec, int VecLen,
          return(0);
       }
       
-      DistMedian  = blVecDist(vector, median, VecLen);
+      DistMedian  = sqrt(FeatureDist2(vector, median, VecLen));
       free(median);
       median = NULL;
       
@@ -862,8 +951,8 @@ int ConfirmCluster(REAL **data, int NVec, int VecLen,
 
 
 /************************************************************************/
-/*>int InClusterBounds(REAL **data, int NVec, int VecDim, 
-                       CLUSTER *clusters, int ClusNum, REAL *vector)
+/*>int InClusterBounds(FEATURE **data, int NVec, int VecDim, 
+                       CLUSTER *clusters, int ClusNum, FEATURE *vector)
    -----------------------------------------------------------------
    Sees if a vector is within the bounds of a cluster.
    The bounds are extended by 10% to account for rounding error resulting
@@ -871,9 +960,10 @@ int ConfirmCluster(REAL **data, int NVec, int VecLen,
    true values.
 
    31.07.95 Original    By: ACRM
+   16.10.26 Takes FEATURE arrays
 */
-int InClusterBounds(REAL **data, int NVec, int VecDim, CLUSTER *clusters,
-                    int ClusNum, REAL *vector)
+int InClusterBounds(FEATURE **data, int NVec, int VecDim, 
+                    CLUSTER *clusters, int ClusNum, FEATURE *vector)
 {
    int      i, j,
             retval = 1;
@@ -950,16 +1040,18 @@ int InClusterBounds(REAL **data, int NVec, int VecDim, CLUSTER *clusters,
 
 
 /************************************************************************/
-/*>REAL MinDistInCluster(REAL **data, int NVec, int VecLen, 
-                         CLUSTER *clusters, REAL *vector, int ClusNum)
-   -------------------------------------------------------------------
+/*>REAL MinDistInCluster(FEATURE **data, int NVec, int VecLen, 
+                         CLUSTER *clusters, FEATURE *vector, int ClusNum)
+   ----------------------------------------------------------------------
    Returns the minimum distance from the vector to a member of the
    cluster.
 
    31.07.95 Original    By: ACRM
+   16.10.26 Compares squared distances from FeatureDist2() and takes
+            the square root of the minimum only
 */
-REAL MinDistInCluster(REAL **data, int NVec, int VecLen, 
-                      CLUSTER *clusters, REAL *vector, int ClusNum)
+REAL MinDistInCluster(FEATURE **data, int NVec, int VecLen, 
+                      CLUSTER *clusters, FEATURE *vector, int ClusNum)
 {
    int  i;
    REAL DMin = INF,
@@ -969,36 +1061,39 @@ REAL MinDistInCluster(REAL **data, int NVec, int VecLen,
    {
       if(clusters[i].clusnum == ClusNum)
       {
-         dist = blVecDist(vector,data[i],VecLen);
+         dist = FeatureDist2(vector,data[i],VecLen);
          if(dist < DMin)
             DMin = dist;
       }
    }
    
-   return(DMin);
+   return((DMin == INF) ? DMin : sqrt(DMin));
 }
 
 
 /************************************************************************/
-/*>int FindNearestMedian(REAL **data, int NVec, int VecLen, 
-                         CLUSTER *clusters, int NClusters, REAL *vector)
+/*>int FindNearestMedian(FEATURE **data, int NVec, int VecLen, 
+                         CLUSTER *clusters, int NClusters, 
+                         FEATURE *vector)
    ---------------------------------------------------------------------
    Finds the cluster with the median closest to the vector.
    Returns 0 on error.
 
    31.07.95 Original    By: ACRM
+   16.10.26 Compares squared distances from FeatureDist2()
 */
-int FindNearestMedian(REAL **data, int NVec, int VecLen, 
-                      CLUSTER *clusters, int NClusters, REAL *vector)
+int FindNearestMedian(FEATURE **data, int NVec, int VecLen, 
+                      CLUSTER *clusters, int NClusters, FEATURE *vector)
 {
-   int  i, j,
-        ClusNum = 0;
-   REAL **medians,
-        dist,
-        DMin = INF;
+   int     i, j,
+           ClusNum = 0;
+   FEATURE **medians;
+   REAL    dist,
+           DMin = INF;
    
    /* Allocate memory to store median arrays                            */
-   if((medians = (REAL **)malloc(NClusters * sizeof(REAL *)))==NULL)
+   if((medians = (FEATURE **)malloc(NClusters * sizeof(FEATURE *)))
+      ==NULL)
       return(0);
 
    /* For each cluster, find the median                                 */
@@ -1018,7 +1113,7 @@ int FindNearestMedian(REAL **data, int NVec, int VecLen,
    /* Find the nearest median                                           */
    for(i=0; i<NClusters; i++)
    {
-      if((dist = blVecDist(vector, medians[i], VecLen)) < DMin)
+      if((dist = FeatureDist2(vector, medians[i], VecLen)) < DMin)
       {
          DMin    = dist;
          ClusNum = i+1;
@@ -1036,21 +1131,25 @@ int FindNearestMedian(REAL **data, int NVec, int VecLen,
 
 
 /************************************************************************/
-/*>REAL *FindMedian(REAL **data, int Nvec, int VecLen, 
-                    CLUSTER *clusters, int ClusNum)
-   ----------------------------------------------------
+/*>FEATURE *FindMedian(FEATURE **data, int Nvec, int VecLen, 
+                       CLUSTER *clusters, int ClusNum)
+   -------------------------------------------------------
    Find the median of cluster ClusNum.
-   Returns a REAL pointer (array) containing the median vector. This
+   Returns a FEATURE pointer (array) containing the median vector. This
    must be freed after use!
    Returns NULL on error.
+   If the cluster medoids have been found, the medoid is returned 
+   instead.
 
    28.07.95 Original based on code from cluster.c    By: ACRM
+   16.10.26 Takes and returns FEATURE arrays
+   16.10.26 Returns a copy of the medoid if there are medoids
 */
-REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters, 
-                 int ClusNum)
+FEATURE *FindMedian(FEATURE **data, int NVec, int VecLen, 
+                    CLUSTER *clusters, int ClusNum)
 {
    int      i, j;
-   REAL     *minval, 
+   FEATURE  *minval, 
             *maxval,
             *medval;
    BOOL     Done = FALSE;
@@ -1058,9 +1157,9 @@ REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters,
    /* Allocate arrays to store min and max values in each dimension and 
       the median which will be returned.
    */
-   minval=(REAL *)malloc(VecLen*sizeof(REAL));
-   maxval=(REAL *)malloc(VecLen*sizeof(REAL));
-   medval=(REAL *)malloc(VecLen*sizeof(REAL));
+   minval=(FEATURE *)malloc(VecLen*sizeof(FEATURE));
+   maxval=(FEATURE *)malloc(VecLen*sizeof(FEATURE));
+   medval=(FEATURE *)malloc(VecLen*sizeof(FEATURE));
 
    if(minval==NULL || maxval==NULL || medval==NULL)
    {
@@ -1071,6 +1170,16 @@ REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters,
       return(NULL);
    }
 
+   /* Use the medoid if there is one                                    */
+   if((sMedoids != NULL) && (sMedoids[ClusNum-1] >= 0))
+   {
+      for(j=0; j<VecLen; j++)
+         medval[j] = data[sMedoids[ClusNum-1]][j];
+      free(minval);
+      free(maxval);
+      return(medval);
+   }
+
    /* Find the min and max values in each dimension                     */
    for(i=0, Done=FALSE; i<NVec; i++)
    {
@@ -1098,7 +1207,7 @@ REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters,
 
    /* Now store the median values                                       */
    for(j=0; j<VecLen; j++)
-      medval[j] = (minval[j] + maxval[j]) / (REAL)2.0;
+      medval[j] = (minval[j] + maxval[j]) / (FEATURE)2.0;
       
    /* Free up the arrays                                                */
    free(minval);
@@ -1109,6 +1218,62 @@ REAL *FindMedian(REAL **data, int NVec, int VecLen, CLUSTER *clusters,
 }
 
 
+/************************************************************************/
+/*>int *ClusterMedoids(FEATURE **data, int NVec, int VecLen, 
+                       CLUSTER *clusters, int NClusters)
+   ------------------------------------------------------------
+   Input:   FEATURE **data       Cluster data
+            int     NVec         Number of vectors
+            int     VecLen       Dimension of vectors
+            CLUSTER *clusters    Cluster of each vector
+            int     NClusters    Number of clusters
+   Returns: int *                Vector number of each cluster's medoid
+                                 [NClusters] (-1 if empty). NULL on 
+                                 error
+   Globals: int     sMedoidMax   Largest cluster with an exact medoid
+
+   Finds the medoids of the clusters in the cluster table with 
+   FindMedoids(). The MEDIANS section cannot be used directly since 
+   ficl works on the clusters in the table, not the post-clustered 
+   ones.
+
+   16.10.26 Original    By: ACRM
+*/
+int *ClusterMedoids(FEATURE **data, int NVec, int VecLen, 
+                    CLUSTER *clusters, int NClusters)
+{
+   CLUSMEMBERS cm;
+   int         *clusnum,
+               *medoids,
+               i;
+
+   clusnum = (int *)malloc(MAX(NVec,1) * sizeof(int));
+   medoids = (int *)malloc(MAX(NClusters,1) * sizeof(int));
+   if(clusnum==NULL || medoids==NULL)
+   {
+      if(clusnum!=NULL) free(clusnum);
+      if(medoids!=NULL) free(medoids);
+      return(NULL);
+   }
+
+   for(i=0; i<NVec; i++)
+      clusnum[i] = clusters[i].clusnum;
+
+   if(!BuildClusMembers(clusnum, NVec, NClusters, &cm) ||
+      !FindMedoids(data, VecLen, &cm, sMedoidMax, 1, FeatureDist2,
+                   medoids))
+   {
+      free(medoids);
+      medoids = NULL;
+   }
+
+   FreeClusMembers(&cm);
+   free(clusnum);
+
+   return(medoids);
+}
+
+
 /************************************************************************/
 /*>int ReadMedians(FILE *fp, CLUSTER **ppMedians)
    ----------------------------------------------
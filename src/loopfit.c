@@ -0,0 +1,767 @@
+/*************************************************************************
+
+   Program:    
+   File:       loopfit.c
+   
+   Version:    V1.1
+   Date:       16.10.26
+   Function:   Superposition of loops for post-clustering
+   
+   Copyright:  (c) Dr. Andrew C. R. Martin 1995-2026
+   Author:     Dr. Andrew C. R. Martin
+   Address:    Biomolecular Structure & Modelling Unit,
+               Department of Biochemistry & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   EMail:      INTERNET: martin@biochem.ucl.ac.uk
+               
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work! 
+
+   The code may not be sold commercially or included as part of a 
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Routines to compare the conformations of two loops after fitting.
+   FitLoopCoor() works on the coordinate arrays stored with each loop
+   by StoreLoopCoor() and finds the RMS, maximum CA and maximum CB
+   deviations from a single superposition found in closed form with
+   QCPRotation(). The PDB linked list versions used previously are
+   kept for comparison (see benchfit.c). CoorDist2() gives the
+   superposed sum of squared deviations used as the dissimilarity by
+   METRIC RMSD.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  16.10.26 Original. RmsPDB(), RmsCAPDB(), MaxCADeviationPDB()
+                  and MaxCBDeviationPDB() moved from clan.c
+   V1.1  16.10.26 Added QCPMaxEigen() and CoorDist2() for METRIC RMSD
+
+*************************************************************************/
+/* Includes
+*/
+#include "acaca.h"
+#include "bioplib/fit.h"
+#include "bioplib/matrix.h"
+#include "loopfit.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define QCPEVALPREC 1.0e-11    /* Precision of the largest eigenvalue   */
+#define QCPEVECPREC 1.0e-6     /* Smallest usable quaternion norm^2     */
+#define QCPMAXITER  50         /* Max. Newton-Raphson iterations        */
+
+
+/************************************************************************/
+/*>double QCPMaxEigen(double S[3][3], double E0)
+   ---------------------------------------------
+   Input:   double  S[3][3]    Inner product matrix of the reference and
+                               mobile coordinates (sum of ref.mob^T)
+            double  E0         Half the sum of the squared norms of the
+                               two sets of coordinates
+   Returns: double             Largest eigenvalue of the 4x4 key matrix
+
+   Finds the largest eigenvalue of the key matrix by the quaternion 
+   characteristic polynomial method (Theobald, Acta Cryst. A61, 478-480,
+   2005; Liu et al., J. Comput. Chem. 31, 1561-1563, 2010). The 
+   coefficients of the characteristic polynomial are formed from S and
+   its largest root is found by Newton-Raphson starting from the upper
+   bound E0. The sum of squared deviations after optimal superposition
+   is 2(E0 - lambda).
+
+   16.10.26 Original, taken out of QCPRotation()   By: ACRM
+*/
+double QCPMaxEigen(double S[3][3], double E0)
+{
+   double Sxx = S[0][0], Sxy = S[0][1], Sxz = S[0][2],
+          Syx = S[1][0], Syy = S[1][1], Syz = S[1][2],
+          Szx = S[2][0], Szy = S[2][1], Szz = S[2][2],
+          Sxx2, Syy2, Szz2, Sxy2, Syz2, Sxz2, Syx2, Szy2, Szx2,
+          SyzSzymSyySzz2, Sxx2Syy2Szz2Syz2Szy2, Sxy2Sxz2Syx2Szx2,
+          SxzpSzx, SyzpSzy, SxypSyx, SyzmSzy, SxzmSzx, SxymSyx,
+          SxxpSyy, SxxmSyy,
+          C0, C1, C2,
+          lambda, old, x2, a, b;
+   int    i;
+
+   /* Coefficients of the characteristic polynomial                     */
+   Sxx2 = Sxx * Sxx;   Syy2 = Syy * Syy;   Szz2 = Szz * Szz;
+   Sxy2 = Sxy * Sxy;   Syz2 = Syz * Syz;   Sxz2 = Sxz * Sxz;
+   Syx2 = Syx * Syx;   Szy2 = Szy * Szy;   Szx2 = Szx * Szx;
+
+   SyzSzymSyySzz2       = 2.0 * (Syz * Szy - Syy * Szz);
+   Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+   Sxy2Sxz2Syx2Szx2     = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+   C2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + 
+                Syz2 + Szy2);
+   C1 =  8.0 * (Sxx * Syz * Szy + Syy * Szx * Sxz + Szz * Sxy * Syx -
+                Sxx * Syy * Szz - Syz * Szx * Sxy - Szy * Syx * Sxz);
+
+   SxzpSzx = Sxz + Szx;   SyzpSzy = Syz + Szy;   SxypSyx = Sxy + Syx;
+   SyzmSzy = Syz - Szy;   SxzmSzx = Sxz - Szx;   SxymSyx = Sxy - Syx;
+   SxxpSyy = Sxx + Syy;   SxxmSyy = Sxx - Syy;
+
+   C0 = Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2 +
+        (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) * 
+        (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2) +
+        (-SxzpSzx * SyzmSzy + SxymSyx * (SxxmSyy - Szz)) *
+        (-SxzmSzx * SyzpSzy + SxymSyx * (SxxmSyy + Szz)) +
+        (-SxzpSzx * SyzpSzy - SxypSyx * (SxxpSyy - Szz)) *
+        (-SxzmSzx * SyzmSzy - SxypSyx * (SxxpSyy + Szz)) +
+        ( SxypSyx * SyzpSzy + SxzpSzx * (SxxmSyy + Szz)) *
+        (-SxymSyx * SyzmSzy + SxzpSzx * (SxxpSyy + Szz)) +
+        ( SxypSyx * SyzmSzy + SxzmSzx * (SxxmSyy - Szz)) *
+        (-SxymSyx * SyzpSzy + SxzmSzx * (SxxpSyy - Szz));
+
+   /* Newton-Raphson for the largest root                               */
+   lambda = E0;
+   for(i=0; i<QCPMAXITER; i++)
+   {
+      old     = lambda;
+      x2      = lambda * lambda;
+      b       = (x2 + C2) * lambda;
+      a       = b + C1;
+      lambda -= (a * lambda + C0) / (2.0 * x2 * lambda + b + a);
+      if(fabs(lambda - old) < fabs(QCPEVALPREC * lambda))
+         break;
+   }
+
+   return(lambda);
+}
+
+
+/************************************************************************/
+/*>BOOL QCPRotation(COOR *ref, COOR *mob, int n, REAL rot[3][3])
+   -------------------------------------------------------------
+   Input:   COOR  *ref         Reference coordinates centred on origin
+            COOR  *mob         Mobile coordinates centred on origin
+            int   n            Number of coordinates
+   Output:  REAL  rot[3][3]    Rotation matrix to apply to mob as a 
+                               column vector (rot . mob)
+   Returns: BOOL               Success
+
+   Finds the rotation which best superimposes mob on ref by the 
+   quaternion characteristic polynomial method. The largest eigenvalue
+   comes from QCPMaxEigen() and the rotation is built from the 
+   corresponding eigenvector taken from the adjoint of the shifted key 
+   matrix. This is a fixed amount of work independent of n beyond 
+   forming the 3x3 inner product matrix, unlike the iterative 
+   blMatfit(). Returns FALSE if the eigenvector is degenerate (e.g. 
+   for collinear coordinates) so the caller can fall back to 
+   blMatfit().
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Eigenvalue found by QCPMaxEigen()
+*/
+BOOL QCPRotation(COOR *ref, COOR *mob, int n, REAL rot[3][3])
+{
+   double S[3][3],
+          G1 = 0.0, 
+          G2 = 0.0,
+          SxzpSzx, SyzpSzy, SxypSyx, SyzmSzy, SxzmSzx, SxymSyx,
+          SxxpSyy, SxxmSyy,
+          lambda,
+          a11, a12, a13, a14, a21, a22, a23, a24,
+          a31, a32, a33, a34, a41, a42, a43, a44,
+          a3344_4334, a3244_4234, a3243_4233, a3143_4133,
+          a3144_4134, a3142_4132,
+          q1, q2, q3, q4, qsqr, qnorm,
+          aa, xx, yy, zz, xy, az, zx, ay, yz, ax;
+   int    i, j;
+
+   /* Inner product matrix and the sums of squares                      */
+   for(i=0; i<3; i++)
+      for(j=0; j<3; j++)
+         S[i][j] = 0.0;
+   for(i=0; i<n; i++)
+   {
+      S[0][0] += ref[i].x * mob[i].x;
+      S[0][1] += ref[i].x * mob[i].y;
+      S[0][2] += ref[i].x * mob[i].z;
+      S[1][0] += ref[i].y * mob[i].x;
+      S[1][1] += ref[i].y * mob[i].y;
+      S[1][2] += ref[i].y * mob[i].z;
+      S[2][0] += ref[i].z * mob[i].x;
+      S[2][1] += ref[i].z * mob[i].y;
+      S[2][2] += ref[i].z * mob[i].z;
+      G1      += ref[i].x * ref[i].x + ref[i].y * ref[i].y + 
+                 ref[i].z * ref[i].z;
+      G2      += mob[i].x * mob[i].x + mob[i].y * mob[i].y + 
+                 mob[i].z * mob[i].z;
+   }
+   lambda = QCPMaxEigen(S, (G1 + G2) / 2.0);
+
+   /* Eigenvector from the first column of the adjoint of the key 
+      matrix less lambda
+   */
+   SxzpSzx = S[0][2] + S[2][0];   
+   SyzpSzy = S[1][2] + S[2][1];   
+   SxypSyx = S[0][1] + S[1][0];
+   SyzmSzy = S[1][2] - S[2][1];   
+   SxzmSzx = S[0][2] - S[2][0];   
+   SxymSyx = S[0][1] - S[1][0];
+   SxxpSyy = S[0][0] + S[1][1];   
+   SxxmSyy = S[0][0] - S[1][1];
+
+   a11 = SxxpSyy + S[2][2] - lambda;
+   a12 = SyzmSzy;
+   a13 = -SxzmSzx;
+   a14 = SxymSyx;
+   a21 = SyzmSzy;
+   a22 = SxxmSyy - S[2][2] - lambda;
+   a23 = SxypSyx;
+   a24 = SxzpSzx;
+   a31 = a13;
+   a32 = a23;
+   a33 = S[1][1] - S[0][0] - S[2][2] - lambda;
+   a34 = SyzpSzy;
+   a41 = a14;
+   a42 = a24;
+   a43 = a34;
+   a44 = S[2][2] - SxxpSyy - lambda;
+
+   a3344_4334 = a33 * a44 - a43 * a34;
+   a3244_4234 = a32 * a44 - a42 * a34;
+   a3243_4233 = a32 * a43 - a42 * a33;
+   a3143_4133 = a31 * a43 - a41 * a33;
+   a3144_4134 = a31 * a44 - a41 * a34;
+   a3142_4132 = a31 * a42 - a41 * a32;
+
+   q1 =  a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233;
+   q2 = -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133;
+   q3 =  a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132;
+   q4 = -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132;
+   qsqr = q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4;
+
+   /* Try the second column if the first is degenerate                  */
+   if(qsqr < QCPEVECPREC)
+   {
+      q1 =  a12 * a3344_4334 - a13 * a3244_4234 + a14 * a3243_4233;
+      q2 = -a11 * a3344_4334 + a13 * a3144_4134 - a14 * a3143_4133;
+      q3 =  a11 * a3244_4234 - a12 * a3144_4134 + a14 * a3142_4132;
+      q4 = -a11 * a3243_4233 + a12 * a3143_4133 - a13 * a3142_4132;
+      qsqr = q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4;
+
+      if(qsqr < QCPEVECPREC)
+         return(FALSE);
+   }
+
+   /* Rotation matrix from the normalized quaternion                    */
+   qnorm = sqrt(qsqr);
+   q1 /= qnorm;   q2 /= qnorm;   q3 /= qnorm;   q4 /= qnorm;
+
+   aa = q1 * q1;   xx = q2 * q2;   yy = q3 * q3;   zz = q4 * q4;
+   xy = q2 * q3;   az = q1 * q4;   zx = q4 * q2;
+   ay = q1 * q3;   yz = q3 * q4;   ax = q1 * q2;
+
+   rot[0][0] = (REAL)(aa + xx - yy - zz);
+   rot[0][1] = (REAL)(2.0 * (xy + az));
+   rot[0][2] = (REAL)(2.0 * (zx - ay));
+   rot[1][0] = (REAL)(2.0 * (xy - az));
+   rot[1][1] = (REAL)(aa - xx + yy - zz);
+   rot[1][2] = (REAL)(2.0 * (yz + ax));
+   rot[2][0] = (REAL)(2.0 * (zx + ay));
+   rot[2][1] = (REAL)(2.0 * (yz - ax));
+   rot[2][2] = (REAL)(aa - xx - yy + zz);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>REAL FitLoopCoor(DATALIST *loop1, DATALIST *loop2, REAL *CADev, 
+                    REAL *CBDev)
+   ---------------------------------------------------------------
+   Input:   DATALIST *loop1         Reference loop
+            DATALIST *loop2         Mobile loop
+   Output:  REAL     *CADev         Max CA deviation between loops
+            REAL     *CBDev         Max CB deviation between loops
+   Returns: REAL                    CA RMS deviation (9999.0 if the 
+                                    loops could not be fitted)
+
+   Fits the CAs of loop2 onto those of loop1 using the coordinate 
+   arrays stored by StoreLoopCoor() and returns the RMS, maximum CA 
+   deviation and maximum CB deviation (over residues where neither loop
+   has a glycine or missing CB) after fitting. This gives the same 
+   values as RmsCAPDB(), MaxCADeviationPDB() and MaxCBDeviationPDB() 
+   from a single fit and a single pass over the residues, without 
+   copying or moving any PDB linked list. The rotation is found with 
+   QCPRotation(), falling back to blMatfit() if that fails.
+
+   16.10.26 Original   By: ACRM
+   16.10.26 Uses QCPRotation()
+*/
+REAL FitLoopCoor(DATALIST *loop1, DATALIST *loop2, REAL *CADev, 
+                 REAL *CBDev)
+{
+   COOR  ref[MAXLOOPLEN],
+         mob[MAXLOOPLEN],
+         v;
+   VEC3F RefCofG,
+         MobCofG;
+   REAL  rot[3][3],
+         dx, dy, dz,
+         dev,
+         sumsq  = (REAL)0.0,
+         maxca  = (REAL)0.0,
+         maxcb  = (REAL)0.0;
+   int   i,
+         n      = loop1->ncoor;
+
+   *CADev = *CBDev = (REAL)9999.0;
+   
+   /* Can't fit with fewer than 3 CAs or if the numbers differ          */
+   if((n < 3) || (loop2->ncoor != n))
+      return((REAL)9999.0);
+
+   /* Find the centres of geometry of the CAs                           */
+   RefCofG.x = RefCofG.y = RefCofG.z = (REAL)0.0;
+   MobCofG.x = MobCofG.y = MobCofG.z = (REAL)0.0;
+   for(i=0; i<n; i++)
+   {
+      RefCofG.x += loop1->ca[i].x;
+      RefCofG.y += loop1->ca[i].y;
+      RefCofG.z += loop1->ca[i].z;
+      MobCofG.x += loop2->ca[i].x;
+      MobCofG.y += loop2->ca[i].y;
+      MobCofG.z += loop2->ca[i].z;
+   }
+   RefCofG.x /= (REAL)n;   RefCofG.y /= (REAL)n;   RefCofG.z /= (REAL)n;
+   MobCofG.x /= (REAL)n;   MobCofG.y /= (REAL)n;   MobCofG.z /= (REAL)n;
+
+   /* Move the CAs to the origin and find the rotation                  */
+   for(i=0; i<n; i++)
+   {
+      ref[i].x = loop1->ca[i].x - RefCofG.x;
+      ref[i].y = loop1->ca[i].y - RefCofG.y;
+      ref[i].z = loop1->ca[i].z - RefCofG.z;
+      mob[i].x = loop2->ca[i].x - MobCofG.x;
+      mob[i].y = loop2->ca[i].y - MobCofG.y;
+      mob[i].z = loop2->ca[i].z - MobCofG.z;
+   }
+   if(!QCPRotation(ref, mob, n, rot) &&
+      !blMatfit(ref, mob, rot, n, NULL, TRUE))
+      return((REAL)9999.0);
+
+   /* Rotate the mobile CAs and CBs and find all the deviations in one 
+      pass
+   */
+   for(i=0; i<n; i++)
+   {
+      dx     = rot[0][0]*mob[i].x + rot[0][1]*mob[i].y + 
+               rot[0][2]*mob[i].z - ref[i].x;
+      dy     = rot[1][0]*mob[i].x + rot[1][1]*mob[i].y + 
+               rot[1][2]*mob[i].z - ref[i].y;
+      dz     = rot[2][0]*mob[i].x + rot[2][1]*mob[i].y + 
+               rot[2][2]*mob[i].z - ref[i].z;
+      dev    = dx*dx + dy*dy + dz*dz;
+      sumsq += dev;
+      if(dev > maxca)
+         maxca = dev;
+
+      if(loop1->hascb[i] && loop2->hascb[i])
+      {
+         v.x = loop2->cb[i].x - MobCofG.x;
+         v.y = loop2->cb[i].y - MobCofG.y;
+         v.z = loop2->cb[i].z - MobCofG.z;
+         dx  = rot[0][0]*v.x + rot[0][1]*v.y + rot[0][2]*v.z - 
+               (loop1->cb[i].x - RefCofG.x);
+         dy  = rot[1][0]*v.x + rot[1][1]*v.y + rot[1][2]*v.z - 
+               (loop1->cb[i].y - RefCofG.y);
+         dz  = rot[2][0]*v.x + rot[2][1]*v.y + rot[2][2]*v.z - 
+               (loop1->cb[i].z - RefCofG.z);
+         dev = dx*dx + dy*dy + dz*dz;
+         if(dev > maxcb)
+            maxcb = dev;
+      }
+   }
+
+   *CADev = (REAL)sqrt((double)maxca);
+   *CBDev = (REAL)sqrt((double)maxcb);
+   return((REAL)sqrt((double)(sumsq / (REAL)n)));
+}
+
+
+/************************************************************************/
+/*>REAL CoorDist2(FEATURE *x, FEATURE *y, int VecDim)
+   --------------------------------------------------
+   Input:   FEATURE *x         First loop as centred x,y,z triples
+            FEATURE *y         Second loop as centred x,y,z triples
+            int     VecDim     Number of features (3 x coordinates)
+   Returns: REAL               Sum of squared deviations after optimal
+                               superposition (n x RMSD^2)
+
+   Dissimilarity for METRIC RMSD. The vectors are those made by
+   ConvertCoor() so are already centred on the origin and the optimal
+   superposition needs only the largest eigenvalue from QCPMaxEigen().
+   No rotation matrix is built and the coordinates are not moved.
+
+   16.10.26 Original   By: ACRM
+*/
+REAL CoorDist2(FEATURE *x, FEATURE *y, int VecDim)
+{
+   double S[3][3],
+          G     = 0.0,
+          lambda,
+          dist2;
+   int    i, j, k;
+
+   for(i=0; i<3; i++)
+      for(j=0; j<3; j++)
+         S[i][j] = 0.0;
+
+   for(k=0; k<VecDim; k+=3)
+   {
+      for(i=0; i<3; i++)
+      {
+         S[i][0] += (double)x[k+i] * (double)y[k];
+         S[i][1] += (double)x[k+i] * (double)y[k+1];
+         S[i][2] += (double)x[k+i] * (double)y[k+2];
+         G       += (double)x[k+i] * (double)x[k+i] +
+                    (double)y[k+i] * (double)y[k+i];
+      }
+   }
+
+   lambda = QCPMaxEigen(S, G / 2.0);
+   dist2  = G - 2.0 * lambda;
+
+   return((REAL)((dist2 > 0.0) ? dist2 : 0.0));
+}
+
+
+/************************************************************************/
+/*>REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
+   ---------------------------------------------
+   Input:   PDB   *pdb1        Reference PDB linked list
+            int   length       Number of residues to fit
+   I/O:     PDB   *pdb2        Mobile PDB linked list
+                               Note that this will be moved in space
+   Returns: REAL               RMS deviation
+
+   Returns the RMS over length residues of the two PDB linked lists.
+   If length is zero, all residues will be used.
+
+   Note that pdb2 will be moved in space at the end of this.
+
+   06.07.95 Original    By: ACRM
+   26.09.95 If FitPDB() returned an error, the lists weren't being
+            reassembled
+   30.01.09 Initialize some variables
+*/
+REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
+{
+   PDB  *end1 = NULL, 
+        *end2 = NULL, 
+        *p;
+   REAL rms = 0.0;
+   BOOL ok = TRUE;
+  
+   if(length)
+   {
+      /* Terminate each PDB linked list after length residues           */
+      end1 = blTermPDB(pdb1, length);
+      end2 = blTermPDB(pdb2, length);
+   }
+   
+   if(blFitPDB(pdb1, pdb2, NULL))
+   {
+      rms = blCalcRMSPDB(pdb1, pdb2);
+   }
+   else
+   {
+      ok = FALSE;
+   }
+
+   if(length)
+   {
+      /* Rejoin PDB linked lists                                        */
+      p=pdb1;
+      LAST(p);
+      p->next = end1;
+      p=pdb2;
+      LAST(p);
+      p->next = end2;
+   }
+
+   return((ok)?rms:(REAL)9999.0);
+}
+
+
+/************************************************************************/
+/*>REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
+   -----------------------------------------------
+   Input:   PDB   *pdb1        Reference PDB linked list
+            int   length       Number of residues to fit
+   I/O:     PDB   *pdb2        Mobile PDB linked list
+                               Note that this will be moved in space
+   Returns: REAL               RMS deviation
+
+   Returns the CA-RMS over length residues of the two PDB linked lists.
+   If length is zero, all residues will be used.
+
+   Note that pdb2 will be moved in space at the end of this.
+
+   26.09.95 Original based on RmsPDB   By: ACRM
+   30.01.09 Initialize some variables
+*/
+REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
+{
+   PDB  *end1 = NULL, 
+        *end2 = NULL, 
+        *p,
+        *pdbca1 = NULL,
+        *pdbca2 = NULL;
+   REAL rms = (REAL)9999.0;
+   int  natoms;
+   BOOL ok = TRUE;
+   char *sel[2];
+
+   SELECT(sel[0], "CA  ");
+   if(sel[0]==NULL)
+      return((REAL)9999.0);
+  
+   if(length)
+   {
+      /* Terminate each PDB linked list after length residues           */
+      end1 = blTermPDB(pdb1, length);
+      end2 = blTermPDB(pdb2, length);
+   }
+
+   if((pdbca1 = blSelectAtomsPDBAsCopy(pdb1, 1, sel, &natoms))==NULL)
+      ok = FALSE;
+   if((pdbca2 = blSelectAtomsPDBAsCopy(pdb2, 1, sel, &natoms))==NULL)
+      ok = FALSE;
+   free(sel[0]);
+
+   if(ok)
+   {
+      if(!blFitPDB(pdbca1, pdbca2, NULL))
+         ok = FALSE;
+   }
+
+   if(ok)
+      rms = blCalcRMSPDB(pdbca1, pdbca2);
+
+   if(length)
+   {
+      /* Rejoin PDB linked lists                                        */
+      p=pdb1;
+      LAST(p);
+      p->next = end1;
+      p=pdb2;
+      LAST(p);
+      p->next = end2;
+   }
+
+   if(pdbca1 != NULL)
+      FREELIST(pdbca1,PDB);
+   if(pdbca2 != NULL)
+      FREELIST(pdbca2,PDB);
+
+   return((ok)?rms:(REAL)9999.000);
+}
+
+
+/************************************************************************/
+/*>REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+   --------------------------------------------------------
+   Input:   PDB   *pdb1        Reference PDB linked list
+            int   length       Number of residues to fit
+   I/O:     PDB   *pdb2        Mobile PDB linked list
+                               Note that this will be moved in space
+   Returns: REAL               RMS deviation
+
+   Returns the max CA-CA deviation over length residues of the two PDB 
+   linked lists.
+   If length is zero, all residues will be used.
+
+   Note that pdb2 will be moved in space at the end of this.
+
+   06.07.95 Original    By: ACRM
+   26.09.95 Modified so fitting is done on CAs only
+            If FitPDB() returned an error, the lists weren't being
+            reassembled
+   14.03.96 Changed to use FitCaPDB() which fits the complete PDB linked
+            lists on CAs.
+   30.01.09 Removed redundant variables
+   30.01.09 Initialize some variables
+*/
+REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+{
+   PDB  *end1 = NULL, 
+        *end2 = NULL, 
+        *p,   *q;
+   REAL dev,
+        maxdev = (REAL)0.0;
+   BOOL ok = TRUE;
+
+   if(length)
+   {
+      /* Terminate each PDB linked list after length residues           */
+      end1 = blTermPDB(pdb1, length);
+      end2 = blTermPDB(pdb2, length);
+   }
+   
+   if(!blFitCaPDB(pdb1, pdb2, NULL))
+      ok = FALSE;
+
+   /* Check max CA deviation                                            */
+   if(ok)
+   {
+      for(p=pdb1, q=pdb2; p!=NULL; NEXT(p))
+      {
+         if(!strncmp(p->atnam,"CA  ",4))
+         {
+            /* Step q, until we hit a CA                                */
+            while((q!=NULL) && (strncmp(q->atnam,"CA  ",4))) NEXT(q);
+            
+            if(q!=NULL)
+            {
+               dev = DISTSQ(p,q);
+               if(dev > maxdev)
+                  maxdev = dev;
+
+               /* Step q on by one                                      */
+               NEXT(q);
+            }
+            else
+            {
+               fprintf(stderr,"MaxCADeviationPDB(): second list \
+expired!\n");
+               ok=FALSE;
+               break;
+            }
+         }
+      }
+   }
+   
+   if(length)
+   {
+      /* Rejoin PDB linked lists                                        */
+      p=pdb1;
+      LAST(p);
+      p->next = end1;
+      p=pdb2;
+      LAST(p);
+      p->next = end2;
+   }
+
+   return((ok)?(REAL)sqrt((double)maxdev):(REAL)9999.0);
+}
+
+
+/************************************************************************/
+/*>REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+   --------------------------------------------------------
+   Input:   PDB   *pdb1        Reference PDB linked list
+            int   length       Number of residues to fit
+   I/O:     PDB   *pdb2        Mobile PDB linked list
+                               Note that this will be moved in space
+   Returns: REAL               RMS deviation
+
+   Returns the max CB-CB deviation over length residues of the two PDB 
+   linked lists.
+   If length is zero, all residues will be used.
+
+   Note that pdb2 will be moved in space at the end of this.
+
+   14.03.96 Original based on MaxCADeviationPDB()   By: ACRM
+   30.01.09 Removed redundant variables
+   30.01.09 Initialize some variables
+*/
+REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+{
+   PDB  *end1 = NULL, 
+        *end2 = NULL, 
+        *p,   *q,
+        *pcb, *qcb;
+   REAL dev,
+        maxdev = (REAL)0.0;
+   BOOL ok = TRUE;
+
+   if(length)
+   {
+      /* Terminate each PDB linked list after length residues           */
+      end1 = blTermPDB(pdb1, length);
+      end2 = blTermPDB(pdb2, length);
+   }
+   
+   if(!blFitCaPDB(pdb1, pdb2, NULL))
+      ok = FALSE;
+
+   /* Check max CB deviation                                            */
+   if(ok)
+   {
+      for(p=pdb1, q=pdb2; p!=NULL; NEXT(p))
+      {
+         if(!strncmp(p->atnam,"N   ",4))
+         {
+            /* Step q, until we hit a N                                 */
+            while((q!=NULL) && (strncmp(q->atnam,"N   ",4))) NEXT(q);
+            
+            if(q!=NULL)
+            {
+               /* Now check CB                                          */
+               if(strncmp(p->resnam,"GLY ",4) && 
+                  strncmp(q->resnam,"GLY ",4))
+               {
+                  pcb=blFindAtomInRes(p,"CB  ");
+                  qcb=blFindAtomInRes(q,"CB  ");
+
+                  if(pcb!=NULL && qcb!=NULL)
+                  {
+                     dev = DISTSQ(pcb,qcb);
+                     if(dev > maxdev)
+                        maxdev = dev;
+                  }
+               }
+               
+               /* Step q on by one                                      */
+               NEXT(q);
+            }
+            else
+            {
+               fprintf(stderr,"MaxCBDeviationPDB(): second list \
+expired!\n");
+               ok=FALSE;
+               break;
+            }
+         }
+      }
+   }
+   
+   if(length)
+   {
+      /* Rejoin PDB linked lists                                        */
+      p=pdb1;
+      LAST(p);
+      p->next = end1;
+      p=pdb2;
+      LAST(p);
+      p->next = end2;
+   }
+
+   return((ok)?(REAL)sqrt((double)maxdev):(REAL)9999.0);
+}
@@ -0,0 +1,17 @@
+double QCPMaxEigen(double S[3][3], double E0)
+;
+BOOL QCPRotation(COOR *ref, COOR *mob, int n, REAL rot[3][3])
+;
+REAL FitLoopCoor(DATALIST *loop1, DATALIST *loop2, REAL *CADev, 
+                 REAL *CBDev)
+;
+REAL CoorDist2(FEATURE *x, FEATURE *y, int VecDim)
+;
+REAL RmsPDB(PDB *pdb1, PDB *pdb2, int length)
+;
+REAL RmsCAPDB(PDB *pdb1, PDB *pdb2, int length)
+;
+REAL MaxCADeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+;
+REAL MaxCBDeviationPDB(PDB *pdb1, PDB *pdb2, int length)
+;
@@ -0,0 +1,409 @@
+/*************************************************************************
+
+   Program:
+   File:       medoid.c
+
+   Version:    V1.0
+   Date:       16.10.26
+   Function:   Exact and sampled medoids of clusters
+
+   Copyright:  (c) Dr. Andrew C. R. Martin 2026
+   Author:     Dr. Andrew C. R. Martin
+   Address:    Biomolecular Structure & Modelling Unit,
+               Department of Biochemistry & Molecular Biology,
+               University College,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   EMail:      INTERNET: martin@biochem.ucl.ac.uk
+
+**************************************************************************
+
+   This program is not in the public domain, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified. If someone
+   else breaks this code, I don't want to be blamed for code that does not
+   work!
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   The medoid of a cluster is the member with the smallest summed
+   distance to the other members. Unlike the middle of the bounding box
+   it is always a real loop and is not pulled about by a single outlier
+   in one dimension. FindMedoids() finds the medoids of all clusters at
+   once, sharing blocks of rows of the intra-cluster distances between
+   threads. Clusters too big for an exact answer are handled as in
+   CLARA: the exact medoids of several random samples are found and the
+   one with the smallest summed distance to the whole cluster is kept.
+
+   The distance function is passed in so that clan can use superposed
+   coordinates (CoorDist2()) while ficl uses FeatureDist2().
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0  16.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <pthread.h>
+#include "acaca.h"
+#include "medoid.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MEDOIDBLOCK   64     /* Rows (and columns) in a block of work   */
+#define MEDOIDSAMPLES 5      /* Samples taken of a big cluster          */
+#define NBLOCKS(n)    (((n) + MEDOIDBLOCK - 1) / MEDOIDBLOCK)
+
+typedef struct
+{
+   int  *members,              /* Vector numbers (from 0) [NMemb]       */
+        NMemb;
+   REAL *sums;                 /* Summed distance from each member to
+                                  the others [NMemb]                    */
+}  MEDOIDGROUP;
+
+typedef struct
+{
+   FEATURE         **data;     /* Vectors (from 0)                      */
+   MEDOIDGROUP     *groups;
+   int             *UnitGroup, /* Group for each block of rows          */
+                   *UnitRow,   /* First row of each block               */
+                   VecDim,
+                   *NextUnit;  /* Shared count of blocks left to do     */
+   REAL            (*Dist2)(FEATURE *, FEATURE *, int);
+   pthread_mutex_t *mutex;     /* Protects NextUnit                     */
+}  MEDOIDJOB;
+
+
+/************************************************************************/
+/*>BOOL FindMedoids(FEATURE **data, int VecDim, CLUSMEMBERS *cm,
+                    int MaxExact, int NThreads,
+                    REAL (*Dist2)(FEATURE *, FEATURE *, int),
+                    int *medoids)
+   -------------------------------------------------------------------
+   Input:   FEATURE     **data    Vectors (from 0)
+            int         VecDim    Dimension of vectors
+            CLUSMEMBERS *cm       Members of each cluster
+            int         MaxExact  Largest cluster given an exact medoid
+            int         NThreads  Number of threads to use
+            REAL        (*Dist2)() Squared distance between two vectors
+   Output:  int         *medoids  Vector number of each cluster's
+                                  medoid [cm->NClus], -1 if the cluster
+                                  is empty
+   Returns: BOOL                  Success of memory allocations
+
+   Finds the medoid of every cluster. A cluster of up to MaxExact
+   members is one group; a bigger one gives MEDOIDSAMPLES groups each
+   of MaxExact members picked by SampleMembers(). Each block of
+   MEDOIDBLOCK rows of a group's distance matrix is a unit of work
+   taken off a shared counter by the threads. Every row is summed in
+   full, in column order, by one thread rather than summing each pair
+   once into two rows, so the threads never write to the same sums and
+   the result does not depend on the number of threads. Ties go to the
+   earliest member.
+
+   16.10.26 Original   By: ACRM
+*/
+BOOL FindMedoids(FEATURE **data, int VecDim, CLUSMEMBERS *cm,
+                 int MaxExact, int NThreads,
+                 REAL (*Dist2)(FEATURE *, FEATURE *, int), int *medoids)
+{
+   MEDOIDGROUP     *groups    = NULL,
+                   *g;
+   MEDOIDJOB       *jobs      = NULL;
+   pthread_t       *threads   = NULL;
+   pthread_mutex_t mutex;
+   int             *samples   = NULL,
+                   *UnitGroup = NULL,
+                   *UnitRow   = NULL,
+                   NGroups    = 0,
+                   NSampled   = 0,
+                   NSums      = 0,
+                   NUnits     = 0,
+                   NextUnit,
+                   n, c, s, i, j, k, u,
+                   best, cand;
+   REAL            *sums      = NULL,
+                   cost,
+                   BestCost   = (REAL)0.0;
+   unsigned long   seed;
+   BOOL            ok         = TRUE;
+
+   MaxExact = MAX(MaxExact, 2);
+
+   /* Count the groups and blocks of work                               */
+   for(c=1; c<=cm->NClus; c++)
+   {
+      n = NCLUSMEMBERS(cm, c);
+      if(n > MaxExact)
+      {
+         NGroups  += MEDOIDSAMPLES;
+         NSampled += MEDOIDSAMPLES * MaxExact;
+         NSums    += MEDOIDSAMPLES * MaxExact;
+         NUnits   += MEDOIDSAMPLES * NBLOCKS(MaxExact);
+      }
+      else if(n > 0)
+      {
+         NGroups++;
+         NSums    += n;
+         NUnits   += NBLOCKS(n);
+      }
+   }
+
+   groups    = (MEDOIDGROUP *)malloc(MAX(NGroups,1) * sizeof(MEDOIDGROUP));
+   samples   = (int *)malloc(MAX(NSampled,1) * sizeof(int));
+   sums      = (REAL *)malloc(MAX(NSums,1) * sizeof(REAL));
+   UnitGroup = (int *)malloc(MAX(NUnits,1) * sizeof(int));
+   UnitRow   = (int *)malloc(MAX(NUnits,1) * sizeof(int));
+   NThreads  = MAX(NThreads, 1);
+   NThreads  = MIN(NThreads, MAX(NUnits,1));
+   jobs      = (MEDOIDJOB *)malloc(NThreads * sizeof(MEDOIDJOB));
+   threads   = (pthread_t *)malloc(NThreads * sizeof(pthread_t));
+
+   if(groups    == NULL ||
+      samples   == NULL ||
+      sums      == NULL ||
+      UnitGroup == NULL ||
+      UnitRow   == NULL ||
+      jobs      == NULL ||
+      threads   == NULL)
+   {
+      ok = FALSE;
+   }
+   else
+   {
+      /* Set up the groups and their blocks of rows. Each cluster has
+         its own random number sequence so the samples do not depend
+         on the other clusters
+      */
+      NGroups = NSampled = NSums = NUnits = 0;
+      for(c=1; c<=cm->NClus; c++)
+      {
+         n = NCLUSMEMBERS(cm, c);
+         if(n == 0)
+            continue;
+
+         seed = (unsigned long)c;
+         for(s=0; s<((n > MaxExact) ? MEDOIDSAMPLES : 1); s++)
+         {
+            g = &(groups[NGroups]);
+            if(n > MaxExact)
+            {
+               g->members = samples + NSampled;
+               g->NMemb   = MaxExact;
+               SampleMembers(&CLUSMEMBER(cm, c, 0), n, MaxExact, &seed,
+                             g->members);
+               NSampled  += MaxExact;
+            }
+            else
+            {
+               g->members = &CLUSMEMBER(cm, c, 0);
+               g->NMemb   = n;
+            }
+            g->sums = sums + NSums;
+            NSums  += g->NMemb;
+
+            for(i=0; i<g->NMemb; i+=MEDOIDBLOCK)
+            {
+               UnitGroup[NUnits] = NGroups;
+               UnitRow[NUnits]   = i;
+               NUnits++;
+            }
+            NGroups++;
+         }
+      }
+
+      /* Sum the rows in parallel                                       */
+      NextUnit = NUnits - 1;
+      pthread_mutex_init(&mutex, NULL);
+      for(i=0; i<NThreads; i++)
+      {
+         jobs[i].data      = data;
+         jobs[i].groups    = groups;
+         jobs[i].UnitGroup = UnitGroup;
+         jobs[i].UnitRow   = UnitRow;
+         jobs[i].VecDim    = VecDim;
+         jobs[i].NextUnit  = &NextUnit;
+         jobs[i].Dist2     = Dist2;
+         jobs[i].mutex     = &mutex;
+      }
+
+      /* Start the extra threads; the calling thread does a share too   */
+      for(i=1; i<NThreads; i++)
+      {
+         if(pthread_create(&(threads[i]), NULL, MedoidWorker,
+                           &(jobs[i])))
+         {
+            NThreads = i;
+            break;
+         }
+      }
+      MedoidWorker(&(jobs[0]));
+      for(i=1; i<NThreads; i++)
+         pthread_join(threads[i], NULL);
+      pthread_mutex_destroy(&mutex);
+
+      /* Pick the medoid of each cluster                                */
+      for(c=1, k=0; c<=cm->NClus; c++)
+      {
+         n = NCLUSMEMBERS(cm, c);
+         medoids[c-1] = -1;
+         if(n == 0)
+            continue;
+
+         for(s=0; s<((n > MaxExact) ? MEDOIDSAMPLES : 1); s++, k++)
+         {
+            /* Exact medoid of this group                               */
+            g    = &(groups[k]);
+            best = 0;
+            for(i=1; i<g->NMemb; i++)
+            {
+               if(g->sums[i] < g->sums[best])
+                  best = i;
+            }
+            cand = g->members[best];
+
+            if(n <= MaxExact)
+            {
+               medoids[c-1] = cand;
+               continue;
+            }
+
+            /* For a sample, score the candidate against the whole
+               cluster
+            */
+            cost = (REAL)0.0;
+            for(j=0; j<n; j++)
+            {
+               u = CLUSMEMBER(cm, c, j);
+               if(u != cand)
+                  cost += (REAL)sqrt((double)(*Dist2)(data[cand],
+                                                       data[u], VecDim));
+            }
+            if((s == 0) || (cost < BestCost))
+            {
+               BestCost     = cost;
+               medoids[c-1] = cand;
+            }
+         }
+      }
+   }
+
+   if(groups    != NULL) free(groups);
+   if(samples   != NULL) free(samples);
+   if(sums      != NULL) free(sums);
+   if(UnitGroup != NULL) free(UnitGroup);
+   if(UnitRow   != NULL) free(UnitRow);
+   if(jobs      != NULL) free(jobs);
+   if(threads   != NULL) free(threads);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>void *MedoidWorker(void *arg)
+   -----------------------------
+   Input:   void  *arg      Pointer to a MEDOIDJOB
+   Returns: void  *         NULL
+
+   Thread routine for FindMedoids(). Takes blocks of rows off the
+   shared counter until there are none left. The columns are also
+   taken in blocks so that the vectors for a block of rows stay in
+   cache while they are compared with each block of columns.
+
+   16.10.26 Original   By: ACRM
+*/
+void *MedoidWorker(void *arg)
+{
+   MEDOIDJOB   *job = (MEDOIDJOB *)arg;
+   MEDOIDGROUP *g;
+   FEATURE     *x;
+   int         u, i, i1, j, j0, j1, r0;
+
+   for(;;)
+   {
+      pthread_mutex_lock(job->mutex);
+      u = (*(job->NextUnit))--;
+      pthread_mutex_unlock(job->mutex);
+      if(u < 0)
+         break;
+
+      g  = &(job->groups[job->UnitGroup[u]]);
+      r0 = job->UnitRow[u];
+      i1 = MIN(r0 + MEDOIDBLOCK, g->NMemb);
+
+      for(i=r0; i<i1; i++)
+         g->sums[i] = (REAL)0.0;
+
+      for(j0=0; j0<g->NMemb; j0+=MEDOIDBLOCK)
+      {
+         j1 = MIN(j0 + MEDOIDBLOCK, g->NMemb);
+         for(i=r0; i<i1; i++)
+         {
+            x = job->data[g->members[i]];
+            for(j=j0; j<j1; j++)
+            {
+               if(j != i)
+                  g->sums[i] +=
+                     (REAL)sqrt((double)(*(job->Dist2))(x,
+                                   job->data[g->members[j]],
+                                   job->VecDim));
+            }
+         }
+      }
+   }
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>void SampleMembers(int *members, int NMemb, int NSample,
+                      unsigned long *seed, int *sample)
+   --------------------------------------------------------
+   Input:   int           *members  Vector numbers of a cluster
+            int           NMemb     Number of members
+            int           NSample   Number to pick (<=NMemb)
+   I/O:     unsigned long *seed     Random number state
+   Output:  int           *sample   The picked members [NSample]
+
+   Picks NSample members at random without replacement by selection
+   sampling (Knuth's Algorithm S), so the sample stays in the same
+   order as the members. Uses the same random number sequence as
+   MicroCluster().
+
+   16.10.26 Original   By: ACRM
+*/
+void SampleMembers(int *members, int NMemb, int NSample,
+                   unsigned long *seed, int *sample)
+{
+   int    t, k;
+   double u;
+
+   for(t=0, k=0; (t<NMemb) && (k<NSample); t++)
+   {
+      *seed = (*seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+      u     = (double)(*seed) / 2147483648.0;
+      if((double)(NMemb - t) * u < (double)(NSample - k))
+         sample[k++] = members[t];
+   }
+}
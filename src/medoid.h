@@ -0,0 +1,9 @@
+BOOL FindMedoids(FEATURE **data, int VecDim, CLUSMEMBERS *cm,
+                 int MaxExact, int NThreads,
+                 REAL (*Dist2)(FEATURE *, FEATURE *, int), int *medoids)
+;
+void *MedoidWorker(void *arg)
+;
+void SampleMembers(int *members, int NMemb, int NSample,
+                   unsigned long *seed, int *sample)
+;
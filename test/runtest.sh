@@ -1,2 +1,54 @@
 ../bin/clan test_clan.in
 ../bin/findsdrs test_clan.out test_sdrs.out
+
+# Regression runs for options which must not change the clustering, and
+# for those with their own reference output. Each input is test_clan.in
+# with the option added before the LOOP commands.
+check()
+{
+   if cmp -s $1 $2
+   then
+      echo "$1: OK"
+   else
+      echo "$1: differs from $2"
+   fi
+}
+
+variant()
+{
+   ( echo "$2"; sed "s/^OUTPUT .*/OUTPUT $1.out/" test_clan.in ) > $1.in
+}
+
+check test_clan.out test_clan.out.ref
+
+../bin/clan -j 4 test_clan.in
+check test_clan.out test_clan.out.ref
+
+variant test_clan_ckpt "CHECKPOINT test_clan.ckpt"
+../bin/clan test_clan_ckpt.in
+check test_clan_ckpt.out test_clan.out.ref
+variant test_clan_resume "RESUME test_clan.ckpt"
+../bin/clan test_clan_resume.in
+check test_clan_resume.out test_clan.out.ref
+
+variant test_clan_cache "STRUCTURECACHE 1"
+../bin/clan test_clan_cache.in
+check test_clan_cache.out test_clan.out.ref
+
+variant test_clan_float "DISSIMSTORE FLOAT"
+../bin/clan test_clan_float.in
+check test_clan_float.out test_clan_float.out.ref
+
+# Without CRITICAL the CB cutoff still applies to the CB coordinates
+# stored with each loop
+( echo "POSTCLUSTER 1.0 1.5 1.9"
+  grep -v '^CRITICAL' test_clan.in | 
+  sed "s/^OUTPUT .*/OUTPUT test_clan_nocrit.out/" ) > test_clan_nocrit.in
+../bin/clan test_clan_nocrit.in
+check test_clan_nocrit.out test_clan_nocrit.out.ref
+
+# Repeat the first three loops so COLLAPSE has duplicates to collapse
+variant test_clan_collapse "COLLAPSE"
+grep '^LOOP' test_clan.in | head -3 >> test_clan_collapse.in
+../bin/clan test_clan_collapse.in
+check test_clan_collapse.out test_clan_collapse.out.ref